@@ -0,0 +1,64 @@
+// Scaling benchmark for the parallel row-group writer and reader.
+// Compresses a table of the given rows (sorted ids, a low-cardinality status, random customers and
+// amounts) into row groups with adaptive encodings, then decompresses it again, with 1, 2, 4, ...
+// threads up to the given maximum and prints time and speedup of both.
+//
+// Usage: ./bench_compress [num_rows] [max_threads]
+
+#include "../rt/rt.hpp"
+#include "../rt/helper.hpp"
+#include "../rt/table_writer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+
+int main(int argc, char *argv[])
+{
+    uint32_t num_rows = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    uint32_t max_threads = argc > 2 ? std::stoul(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+
+    removeFile("bench_orders.tbl");
+    RelationalTable orders("bench_orders.tbl", 4);
+    std::mt19937 rng(1);
+    {
+        TableWriter writer("bench_orders.tbl");
+        for (uint32_t id = 0; id < num_rows; id++)
+        {
+            uint32_t row[4] = {id, uint32_t(rng() % 100000), (id / 5000) % 4, uint32_t(rng() % 1000000)};
+            writer.appendRow_uint32_t(row);
+        }
+    }
+    orders = RelationalTable("bench_orders.tbl");
+    std::vector<RepresentationKind> adaptive(4, RepresentationKind::Adaptive);
+
+    std::printf("%8s %12s %10s %12s %10s\n", "threads", "compress", "speedup", "decompress", "speedup");
+    double single_compress = 0, single_decompress = 0;
+    for (uint32_t threads = 1; threads <= max_threads; threads *= 2)
+    {
+        removeFile("bench_orders_compressed.tbl");
+        removeFile("bench_orders_decompressed.tbl");
+        auto start = std::chrono::steady_clock::now();
+        orders.compressData("bench_orders_compressed.tbl", adaptive, 1024, 0, threads);
+        std::chrono::duration<double> compress = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        RelationalTable::decompressData("bench_orders_compressed.tbl", "bench_orders_decompressed.tbl", threads);
+        std::chrono::duration<double> decompress = std::chrono::steady_clock::now() - start;
+
+        if (threads == 1)
+        {
+            single_compress = compress.count();
+            single_decompress = decompress.count();
+        }
+        std::printf("%8u %11.3fs %10.2f %11.3fs %10.2f\n", threads, compress.count(), single_compress / compress.count(), decompress.count(),
+                    single_decompress / decompress.count());
+    }
+
+    removeFile("bench_orders.tbl");
+    removeFile("bench_orders_compressed.tbl");
+    removeFile("bench_orders_decompressed.tbl");
+    return 0;
+}
@@ -0,0 +1,120 @@
+// Microbenchmark for the bit-unpacking and delta-decoding kernels.
+// Prints decoded values per second for every kernel set this CPU supports and every bit width.
+
+#include "../coding/coding.hpp"
+#include "../coding/kernels.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+    const size_t NUM_VALUES = 1 << 20;
+    const int REPEATS = 20;
+
+    // Encode values as bit-packed chunks and collect each chunk's bit width and words
+    struct PackedChunk
+    {
+        uint32_t bits;
+        size_t count;
+        std::vector<uint8_t> words;
+    };
+
+    std::vector<PackedChunk> packChunks(const std::vector<uint32_t> &values)
+    {
+        std::vector<uint8_t> bytes;
+        EncodeColumn_uint32(values.data(), values.size(), BitPacked, bytes);
+
+        std::vector<PackedChunk> chunks;
+        size_t offset = 2 * sizeof(uint32_t);
+        for (size_t i = 0; i < values.size(); i += BIT_PACKING_CHUNK_SIZE)
+        {
+            PackedChunk chunk;
+            chunk.bits = bytes[offset];
+            chunk.count = std::min<size_t>(BIT_PACKING_CHUNK_SIZE, values.size() - i);
+            uint32_t num_packed;
+            std::memcpy(&num_packed, &bytes[offset + 1], sizeof(num_packed));
+            chunk.words.assign(bytes.begin() + offset + 5, bytes.begin() + offset + 5 + 4 * num_packed);
+            offset += 5 + 4 * num_packed;
+            chunks.push_back(std::move(chunk));
+        }
+        return chunks;
+    }
+
+    template <typename F>
+    double valuesPerSecond(size_t values_per_repeat, F run)
+    {
+        run(); // warm up
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < REPEATS; r++)
+        {
+            run();
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return double(values_per_repeat) * REPEATS / elapsed.count();
+    }
+}
+
+int main()
+{
+    std::mt19937 rng(42);
+    std::vector<uint32_t> out(NUM_VALUES + 1);
+    std::vector<const DecodeKernels *> kernels = AvailableDecodeKernels();
+
+    std::printf("%-6s", "bits");
+    for (const DecodeKernels *k : kernels)
+    {
+        std::printf("%16s", k->name);
+    }
+    std::printf("   (million values/s)\n");
+
+    for (uint32_t bits = 1; bits <= 32; bits++)
+    {
+        std::vector<uint32_t> values(NUM_VALUES);
+        uint32_t top = bits == 32 ? 0xFFFFFFFFu : (1u << bits) - 1;
+        for (uint32_t &v : values)
+        {
+            v = rng() & top;
+        }
+        values[0] = top; // every chunk gets the full width
+        for (size_t i = 0; i < NUM_VALUES; i += BIT_PACKING_CHUNK_SIZE)
+        {
+            values[i] = top;
+        }
+        std::vector<PackedChunk> chunks = packChunks(values);
+
+        std::printf("%-6u", bits);
+        for (const DecodeKernels *k : kernels)
+        {
+            double rate = valuesPerSecond(NUM_VALUES, [&]()
+                                          {
+                                              uint32_t *dst = out.data();
+                                              for (const PackedChunk &chunk : chunks)
+                                              {
+                                                  k->unpack_bits(chunk.words.data(), chunk.bits, chunk.count, dst);
+                                                  dst += chunk.count;
+                                              } });
+            std::printf("%16.1f", rate / 1e6);
+        }
+        std::printf("\n");
+    }
+
+    std::vector<int8_t> deltas(NUM_VALUES);
+    for (int8_t &d : deltas)
+    {
+        d = int8_t(rng());
+    }
+    std::printf("%-6s", "delta");
+    for (const DecodeKernels *k : kernels)
+    {
+        double rate = valuesPerSecond(NUM_VALUES, [&]()
+                                      { k->decode_deltas(7, deltas.data(), deltas.size(), out.data()); });
+        std::printf("%16.1f", rate / 1e6);
+    }
+    std::printf("\n");
+    return 0;
+}
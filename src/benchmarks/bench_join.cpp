@@ -0,0 +1,71 @@
+// Scaling benchmark for the partitioned parallel hash join.
+// Joins a users table with a purchases table (as in populate_tables.py) on the user id
+// with 1, 2, 4, ... threads up to the given maximum and prints time and speedup.
+//
+// Usage: ./bench_join [num_users] [num_purchases] [max_threads]
+
+#include "../rt/rt.hpp"
+#include "../rt/helper.hpp"
+#include "../rt/table_writer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <thread>
+
+int main(int argc, char *argv[])
+{
+    uint32_t num_users = argc > 1 ? std::stoul(argv[1]) : 100000;
+    uint32_t num_purchases = argc > 2 ? std::stoul(argv[2]) : 4000000;
+    uint32_t max_threads = argc > 3 ? std::stoul(argv[3]) : std::max(1u, std::thread::hardware_concurrency());
+
+    removeFile("bench_users.tbl");
+    removeFile("bench_purchases.tbl");
+    RelationalTable users("bench_users.tbl", 3);
+    RelationalTable purchases("bench_purchases.tbl", 3);
+
+    std::mt19937 rng(1);
+    {
+        TableWriter writer("bench_users.tbl");
+        for (uint32_t id = 0; id < num_users; id++)
+        {
+            uint32_t row[3] = {id, uint32_t(rng() % 100 < 99), uint32_t(1 + rng() % 2)};
+            writer.appendRow_uint32_t(row);
+        }
+    }
+    {
+        TableWriter writer("bench_purchases.tbl");
+        for (uint32_t i = 0; i < num_purchases; i++)
+        {
+            float price = 10.0f * (rng() % 1000) / 1000.0f;
+            uint32_t row[3] = {uint32_t(rng() % num_users), uint32_t(rng() & 0x7FFFFFFF), 0};
+            std::memcpy(&row[2], &price, sizeof(price));
+            writer.appendRow_uint32_t(row);
+        }
+    }
+    users = RelationalTable("bench_users.tbl");
+    purchases = RelationalTable("bench_purchases.tbl");
+
+    std::printf("%8s %12s %14s %10s\n", "threads", "seconds", "rows/s", "speedup");
+    double single_thread_seconds = 0;
+    for (uint32_t threads = 1; threads <= max_threads; threads *= 2)
+    {
+        removeFile("bench_joined.tbl");
+        auto start = std::chrono::steady_clock::now();
+        RelationalTable joined = users.inner_join(purchases, "bench_joined.tbl", {0}, {0}, threads);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        if (threads == 1)
+        {
+            single_thread_seconds = elapsed.count();
+        }
+        std::printf("%8u %12.3f %14.0f %10.2f\n", threads, elapsed.count(), joined.readNumEntries() / elapsed.count(), single_thread_seconds / elapsed.count());
+    }
+
+    removeFile("bench_users.tbl");
+    removeFile("bench_purchases.tbl");
+    removeFile("bench_joined.tbl");
+    return 0;
+}
@@ -0,0 +1,420 @@
+// Benchmark suite for the codecs, scans, appends and joins.
+// Generates the users and purchases tables of populate_tables.py in memory (users(id, is_active, gender),
+// purchases(user_id, item_id, price)) and measures, per benchmark, throughput in rows (or values) and
+// MB of plain cells per second, latency percentiles of its operations (a chunk, a batch or a whole run)
+// and, for encoders and columnar files, the size written. Prints a table and writes every result to a
+// JSON file, so runs of two releases can be compared.
+//
+// Usage: ./bench_suite [num_purchases] [output.json]   (a tenth as many users; `make bench` runs it)
+
+#include "../rt/rt.hpp"
+#include "../rt/helper.hpp"
+#include "../rt/table_writer.hpp"
+#include "../columnar-rt/columnar_rt.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const uint32_t CHUNK_SIZE = 1024;  // values per codec chunk and rows per columnar row group
+    const uint32_t APPEND_BATCH = 4096; // rows per append call
+    const int REPEATS = 5;
+    const int JOIN_REPEATS = 3;
+
+    typedef std::chrono::steady_clock Clock;
+
+    struct Result
+    {
+        std::string name;
+        uint64_t rows = 0;             // rows or values over all operations (output rows for joins)
+        uint64_t bytes = 0;            // the same as plain 4-byte cells
+        uint64_t compressed_bytes = 0; // encoded size, 0 when the benchmark doesn't encode
+        std::vector<double> latencies; // seconds per operation
+
+        double seconds() const
+        {
+            double total = 0;
+            for (double latency : latencies)
+            {
+                total += latency;
+            }
+            return total;
+        }
+
+        // Latency below which the given fraction of the operations finished
+        double percentile(double fraction) const
+        {
+            std::vector<double> sorted = latencies;
+            std::sort(sorted.begin(), sorted.end());
+            return sorted.empty() ? 0 : sorted[std::min(sorted.size() - 1, size_t(fraction * sorted.size()))];
+        }
+    };
+
+    std::vector<Result> results;
+    volatile uint64_t scan_sink; // keeps the scans from being optimised away
+
+    // Time op() as one operation of the result
+    template <typename F>
+    void timed(Result &result, F op)
+    {
+        Clock::time_point start = Clock::now();
+        op();
+        result.latencies.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+    }
+
+    void report(Result result)
+    {
+        double seconds = result.seconds();
+        std::printf("%-44s %14.0f %10.1f %10.1f %10.1f %10.1f", result.name.c_str(), result.rows / seconds, result.bytes / seconds / 1e6,
+                    result.percentile(0.5) * 1e6, result.percentile(0.9) * 1e6, result.percentile(0.99) * 1e6);
+        if (result.compressed_bytes != 0)
+        {
+            std::printf(" %12llu", (unsigned long long)result.compressed_bytes);
+        }
+        std::printf("\n");
+        results.push_back(std::move(result));
+    }
+
+    uint64_t fileSize(const std::string &file_name)
+    {
+        std::error_code error;
+        uint64_t size = std::filesystem::file_size(file_name, error);
+        return error ? 0 : size;
+    }
+
+    struct Dataset
+    {
+        std::string name;
+        std::vector<std::string> column_names;
+        uint32_t num_rows;
+        std::vector<uint32_t> rows; // row-major
+
+        uint32_t numColumns() const { return column_names.size(); }
+
+        std::vector<uint32_t> column(uint32_t c) const
+        {
+            std::vector<uint32_t> values(num_rows);
+            for (uint32_t row = 0; row < num_rows; row++)
+            {
+                values[row] = rows[size_t(row) * numColumns() + c];
+            }
+            return values;
+        }
+    };
+
+    // The generators of populate_tables.py
+    Dataset makeUsers(uint32_t num_users, std::mt19937 &rng)
+    {
+        Dataset users = {"users", {"id", "is_active", "gender"}, num_users, {}};
+        std::uniform_real_distribution<double> uniform(0, 1);
+        for (uint32_t id = 0; id < num_users; id++)
+        {
+            double r = uniform(rng);
+            users.rows.insert(users.rows.end(), {id, uniform(rng) < 0.99, r < 0.49 ? 1u : r < 0.98 ? 2u : 3u});
+        }
+        return users;
+    }
+
+    Dataset makePurchases(uint32_t num_purchases, uint32_t num_users, std::mt19937 &rng)
+    {
+        Dataset purchases = {"purchases", {"user_id", "item_id", "price"}, num_purchases, {}};
+        std::uniform_real_distribution<float> price(0, 10);
+        for (uint32_t i = 0; i < num_purchases; i++)
+        {
+            float p = price(rng);
+            uint32_t price_bits;
+            std::memcpy(&price_bits, &p, sizeof(p));
+            purchases.rows.insert(purchases.rows.end(), {uint32_t(rng() % num_users), uint32_t(rng() & 0x7FFFFFFF), price_bits});
+        }
+        return purchases;
+    }
+
+    // Encode and decode every column chunk by chunk with every representation that can hold all of it
+    void benchCodecs(const Dataset &dataset)
+    {
+        const RepresentationKind kinds[] = {RepresentationKind::Direct, RepresentationKind::RunLengthEncoded, RepresentationKind::DictionaryOneByte,
+                                            RepresentationKind::OneSByteDeltaEncoded, RepresentationKind::Constant, RepresentationKind::BitPacked,
+                                            RepresentationKind::Adaptive};
+        for (uint32_t c = 0; c < dataset.numColumns(); c++)
+        {
+            std::vector<uint32_t> values = dataset.column(c);
+            std::string column = dataset.name + "." + dataset.column_names[c];
+            for (RepresentationKind kind : kinds)
+            {
+                Result encode, decode;
+                encode.name = std::string("encode/") + RepresentationKindName(kind) + "/" + column;
+                decode.name = std::string("decode/") + RepresentationKindName(kind) + "/" + column;
+                std::vector<std::vector<uint8_t>> chunks((values.size() + CHUNK_SIZE - 1) / CHUNK_SIZE);
+                std::vector<RepresentationKind> chunk_kinds(chunks.size(), kind);
+                bool representable = true;
+                for (int r = 0; r < REPEATS && representable; r++)
+                {
+                    for (size_t i = 0; i < chunks.size() && representable; i++)
+                    {
+                        size_t count = std::min<size_t>(CHUNK_SIZE, values.size() - i * CHUNK_SIZE);
+                        chunks[i].clear();
+                        timed(encode, [&]()
+                              {
+                                  if (kind == RepresentationKind::Adaptive)
+                                  {
+                                      chunk_kinds[i] = EncodeColumnAdaptive_uint32(&values[i * CHUNK_SIZE], count, 0, chunks[i]);
+                                  }
+                                  else
+                                  {
+                                      representable = EncodeColumn_uint32(&values[i * CHUNK_SIZE], count, kind, chunks[i]);
+                                  } });
+                        encode.rows += count;
+                    }
+                }
+                if (!representable)
+                {
+                    continue;
+                }
+                for (const std::vector<uint8_t> &chunk : chunks)
+                {
+                    encode.compressed_bytes += chunk.size();
+                }
+                encode.bytes = encode.rows * sizeof(uint32_t);
+
+                std::vector<uint32_t> decoded;
+                decoded.reserve(CHUNK_SIZE);
+                for (int r = 0; r < REPEATS; r++)
+                {
+                    for (size_t i = 0; i < chunks.size(); i++)
+                    {
+                        decoded.clear();
+                        timed(decode, [&]()
+                              { DecodeColumn_uint32(chunk_kinds[i], chunks[i].data(), chunks[i].size(), decoded); });
+                        decode.rows += decoded.size();
+                    }
+                }
+                decode.bytes = decode.rows * sizeof(uint32_t);
+                decode.compressed_bytes = encode.compressed_bytes;
+                report(std::move(encode));
+                report(std::move(decode));
+            }
+        }
+    }
+
+    // Append the dataset in batches to a new row-major and a new columnar table (adaptive encodings)
+    void benchAppends(const Dataset &dataset)
+    {
+        uint32_t width = dataset.numColumns();
+        Result row_major, columnar;
+        row_major.name = "append/row-major/" + dataset.name;
+        columnar.name = "append/columnar/" + dataset.name;
+        for (int r = 0; r < REPEATS; r++)
+        {
+            std::string file_name = "bench_" + dataset.name + ".tbl";
+            removeFile(file_name);
+            RelationalTable create(file_name, width);
+            TableWriter writer(file_name);
+            for (uint32_t row = 0; row < dataset.num_rows; row += APPEND_BATCH)
+            {
+                uint32_t count = std::min(APPEND_BATCH, dataset.num_rows - row);
+                timed(row_major, [&]()
+                      { writer.appendRows_uint32_t(&dataset.rows[size_t(row) * width], count); });
+            }
+            timed(row_major, [&]()
+                  { writer.close(); });
+            row_major.rows += dataset.num_rows;
+
+            std::string columnar_name = "bench_" + dataset.name + "_columnar.tbl";
+            removeFile(columnar_name);
+            ColumnarRelationalTable table(columnar_name, width);
+            table.setRowGroupSize(CHUNK_SIZE);
+            for (uint32_t row = 0; row < dataset.num_rows; row += APPEND_BATCH)
+            {
+                uint32_t count = std::min(APPEND_BATCH, dataset.num_rows - row);
+                timed(columnar, [&]()
+                      { table.appendRows_uint32_t(&dataset.rows[size_t(row) * width], count); });
+            }
+            timed(columnar, [&]()
+                  { table.flush(); });
+            columnar.rows += dataset.num_rows;
+            columnar.compressed_bytes = fileSize(columnar_name);
+        }
+        row_major.bytes = row_major.rows * width * sizeof(uint32_t);
+        columnar.bytes = columnar.rows * width * sizeof(uint32_t);
+        report(std::move(row_major));
+        report(std::move(columnar));
+    }
+
+    // Sum every cell, and the cells of the last column alone, of the tables benchAppends left behind
+    void benchScans(const Dataset &dataset)
+    {
+        uint32_t width = dataset.numColumns();
+        RelationalTable table("bench_" + dataset.name + ".tbl");
+        table.mapFile();
+        ColumnarRelationalTable columnar("bench_" + dataset.name + "_columnar.tbl");
+
+        std::vector<uint32_t> all_columns(width);
+        for (uint32_t c = 0; c < width; c++)
+        {
+            all_columns[c] = c;
+        }
+        uint64_t checksum = 0;
+        for (uint32_t projected : {0u, 1u})
+        {
+            std::vector<uint32_t> columns = projected ? std::vector<uint32_t>{width - 1} : all_columns;
+            std::string kind = projected ? "projected" : "full";
+
+            Result row_major;
+            row_major.name = "scan/" + kind + "/row-major/" + dataset.name;
+            for (int r = 0; r < REPEATS; r++)
+            {
+                timed(row_major, [&]()
+                      {
+                          for (uint32_t c : columns)
+                          {
+                              ColumnView<uint32_t> view = table.viewColumn_uint32_t(c);
+                              for (uint32_t row = 0; row < view.size(); row++)
+                              {
+                                  checksum += view[row];
+                              }
+                          } });
+                row_major.rows += dataset.num_rows;
+            }
+            row_major.bytes = row_major.rows * columns.size() * sizeof(uint32_t);
+            report(std::move(row_major));
+
+            Result scan;
+            scan.name = "scan/" + kind + "/columnar/" + dataset.name;
+            for (int r = 0; r < REPEATS; r++)
+            {
+                timed(scan, [&]()
+                      { columnar.scanBatches(columns, [&](uint32_t, const ColumnBatch &batch)
+                                             {
+                                                 for (uint32_t k = 0; k < batch.numColumns(); k++)
+                                                 {
+                                                     const uint32_t *column = batch.column(k);
+                                                     for (size_t i = 0; i < batch.size(); i++)
+                                                     {
+                                                         checksum += column[i];
+                                                     }
+                                                 } }); });
+                scan.rows += dataset.num_rows;
+            }
+            scan.bytes = scan.rows * columns.size() * sizeof(uint32_t);
+            scan.compressed_bytes = fileSize("bench_" + dataset.name + "_columnar.tbl");
+            report(std::move(scan));
+        }
+        scan_sink = checksum;
+    }
+
+    template <typename F>
+    void benchJoin(const std::string &name, uint32_t output_width, F join)
+    {
+        Result result;
+        result.name = name;
+        for (int r = 0; r < JOIN_REPEATS; r++)
+        {
+            removeFile("bench_joined.tbl");
+            removeFile("bench_joined.tbl.nulls");
+            RelationalTable joined;
+            timed(result, [&]()
+                  { joined = join(); });
+            result.rows += joined.readNumEntries();
+        }
+        result.bytes = result.rows * output_width * sizeof(uint32_t);
+        report(std::move(result));
+    }
+
+    // Every join of users and purchases on the user id; the cross join takes the first 1000 rows of each
+    void benchJoins(const Dataset &users, const Dataset &purchases)
+    {
+        RelationalTable user_table("bench_users.tbl");
+        RelationalTable purchase_table("bench_purchases.tbl");
+        uint32_t width = users.numColumns() + purchases.numColumns();
+        uint32_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+        benchJoin("join/inner", width, [&]()
+                  { return user_table.inner_join(purchase_table, "bench_joined.tbl", {0}, {0}); });
+        if (max_threads > 1)
+        {
+            benchJoin("join/inner/" + std::to_string(max_threads) + "-threads", width, [&]()
+                      { return user_table.inner_join(purchase_table, "bench_joined.tbl", {0}, {0}, max_threads); });
+        }
+        benchJoin("join/full-outer", width, [&]()
+                  { return user_table.full_outer_join(purchase_table, "bench_joined.tbl", {0}, {0}); });
+
+        removeFile("bench_users_small.tbl");
+        removeFile("bench_purchases_small.tbl");
+        RelationalTable users_small("bench_users_small.tbl", users.numColumns());
+        users_small.appendRows_uint32_t(users.rows.data(), std::min(1000u, users.num_rows));
+        RelationalTable purchases_small("bench_purchases_small.tbl", purchases.numColumns());
+        purchases_small.appendRows_uint32_t(purchases.rows.data(), std::min(1000u, purchases.num_rows));
+        users_small = RelationalTable("bench_users_small.tbl");
+        purchases_small = RelationalTable("bench_purchases_small.tbl");
+        benchJoin("join/cross", width, [&]()
+                  { return users_small.cross_join(purchases_small, "bench_joined.tbl"); });
+
+        removeFile("bench_users_small.tbl");
+        removeFile("bench_purchases_small.tbl");
+        removeFile("bench_joined.tbl");
+        removeFile("bench_joined.tbl.nulls");
+    }
+
+    void writeJson(const std::string &file_name, uint32_t num_users, uint32_t num_purchases)
+    {
+        FILE *out = std::fopen(file_name.c_str(), "w");
+        if (out == nullptr)
+        {
+            std::fprintf(stderr, "Error: Unable to open file %s\n", file_name.c_str());
+            return;
+        }
+        std::fprintf(out, "{\n  \"config\": {\"num_users\": %u, \"num_purchases\": %u, \"chunk_size\": %u, \"repeats\": %d, \"hardware_threads\": %u},\n",
+                     num_users, num_purchases, CHUNK_SIZE, REPEATS, std::thread::hardware_concurrency());
+        std::fprintf(out, "  \"results\": [\n");
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const Result &result = results[i];
+            double seconds = result.seconds();
+            std::fprintf(out, "    {\"name\": \"%s\", \"operations\": %zu, \"seconds\": %.6f, \"rows\": %llu, \"rows_per_second\": %.1f, \"mb_per_second\": %.3f, "
+                              "\"latency_us\": {\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f}, \"compressed_bytes\": %llu}%s\n",
+                         result.name.c_str(), result.latencies.size(), seconds, (unsigned long long)result.rows, result.rows / seconds,
+                         result.bytes / seconds / 1e6, result.percentile(0.5) * 1e6, result.percentile(0.9) * 1e6, result.percentile(0.99) * 1e6,
+                         result.percentile(1) * 1e6, (unsigned long long)result.compressed_bytes, i + 1 < results.size() ? "," : "");
+        }
+        std::fprintf(out, "  ]\n}\n");
+        std::fclose(out);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t num_purchases = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    std::string output = argc > 2 ? argv[2] : "bench_results.json";
+    uint32_t num_users = std::max(1u, num_purchases / 10);
+
+    std::mt19937 rng(1);
+    Dataset users = makeUsers(num_users, rng);
+    Dataset purchases = makePurchases(num_purchases, num_users, rng);
+
+    std::printf("%-44s %14s %10s %10s %10s %10s %12s\n", "benchmark", "rows/s", "MB/s", "p50 us", "p90 us", "p99 us", "bytes");
+    benchCodecs(users);
+    benchCodecs(purchases);
+    benchAppends(users);
+    benchAppends(purchases);
+    benchScans(users);
+    benchScans(purchases);
+    benchJoins(users, purchases);
+
+    writeJson(output, num_users, num_purchases);
+    std::printf("Results written to %s\n", output.c_str());
+
+    for (const Dataset *dataset : {&users, &purchases})
+    {
+        removeFile("bench_" + dataset->name + ".tbl");
+        removeFile("bench_" + dataset->name + "_columnar.tbl");
+    }
+    return 0;
+}
@@ -0,0 +1,743 @@
+#include "aggregate.hpp"
+#include "block_codec.hpp"
+#include "../rt/instrumentation.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+    uint32_t loadU32(const uint8_t *data)
+    {
+        return uint32_t(data[0]) | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24);
+    }
+
+    float asFloat(uint32_t cell)
+    {
+        float value;
+        std::memcpy(&value, &cell, sizeof(value));
+        return value;
+    }
+
+    // The batch loops keep LANES independent accumulators so the compiler can put them in vector
+    // registers; the lanes are combined at the end. On x86 each loop is also compiled for AVX2 and
+    // the version the CPU supports is picked when the program loads.
+    const size_t LANES = 8;
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define BATCH_LOOP __attribute__((target_clones("avx2", "default")))
+#else
+#define BATCH_LOOP
+#endif
+
+    BATCH_LOOP uint64_t sumBatch_uint32(const uint32_t *cells, size_t count)
+    {
+        uint64_t lanes[LANES] = {};
+        size_t i = 0;
+        for (; i + LANES <= count; i += LANES)
+        {
+            for (size_t j = 0; j < LANES; j++)
+            {
+                lanes[j] += cells[i + j];
+            }
+        }
+        uint64_t sum = 0;
+        for (; i < count; i++)
+        {
+            sum += cells[i];
+        }
+        for (uint64_t lane : lanes)
+        {
+            sum += lane;
+        }
+        return sum;
+    }
+
+    // summed as uint64_t, which wraps the same as int64_t
+    BATCH_LOOP int64_t sumBatch_int32(const int32_t *cells, size_t count)
+    {
+        uint64_t lanes[LANES] = {};
+        size_t i = 0;
+        for (; i + LANES <= count; i += LANES)
+        {
+            for (size_t j = 0; j < LANES; j++)
+            {
+                lanes[j] += uint64_t(int64_t(cells[i + j]));
+            }
+        }
+        uint64_t sum = 0;
+        for (; i < count; i++)
+        {
+            sum += uint64_t(int64_t(cells[i]));
+        }
+        for (uint64_t lane : lanes)
+        {
+            sum += lane;
+        }
+        return int64_t(sum);
+    }
+
+    BATCH_LOOP double sumBatch_float(const float *cells, size_t count)
+    {
+        double lanes[LANES] = {};
+        size_t i = 0;
+        for (; i + LANES <= count; i += LANES)
+        {
+            for (size_t j = 0; j < LANES; j++)
+            {
+                lanes[j] += cells[i + j];
+            }
+        }
+        double sum = 0;
+        for (; i < count; i++)
+        {
+            sum += cells[i];
+        }
+        for (double lane : lanes)
+        {
+            sum += lane;
+        }
+        return sum;
+    }
+
+    template <bool Max, typename Cell>
+    BATCH_LOOP Cell extremeBatch(const Cell *cells, size_t count, Cell start)
+    {
+        Cell lanes[LANES];
+        for (size_t j = 0; j < LANES; j++)
+        {
+            lanes[j] = start;
+        }
+        size_t i = 0;
+        for (; i + LANES <= count; i += LANES)
+        {
+            for (size_t j = 0; j < LANES; j++)
+            {
+                Cell x = cells[i + j];
+                lanes[j] = Max ? (x > lanes[j] ? x : lanes[j]) : (x < lanes[j] ? x : lanes[j]);
+            }
+        }
+        Cell result = start;
+        for (; i < count; i++)
+        {
+            Cell x = cells[i];
+            result = Max ? (x > result ? x : result) : (x < result ? x : result);
+        }
+        for (Cell lane : lanes)
+        {
+            result = Max ? (lane > result ? lane : result) : (lane < result ? lane : result);
+        }
+        return result;
+    }
+
+    // comparisons with NaN are false, so NaNs leave the lanes alone
+    template <bool Max>
+    BATCH_LOOP float extremeBatch_float(const float *cells, size_t count, float start)
+    {
+        float lanes[LANES];
+        for (size_t j = 0; j < LANES; j++)
+        {
+            lanes[j] = start;
+        }
+        size_t i = 0;
+        for (; i + LANES <= count; i += LANES)
+        {
+            for (size_t j = 0; j < LANES; j++)
+            {
+                float x = cells[i + j];
+                lanes[j] = Max ? (x > lanes[j] ? x : lanes[j]) : (x < lanes[j] ? x : lanes[j]);
+            }
+        }
+        float result = start;
+        for (; i < count; i++)
+        {
+            float x = cells[i];
+            result = Max ? (x > result ? x : result) : (x < result ? x : result);
+        }
+        for (float lane : lanes)
+        {
+            result = Max ? (lane > result ? lane : result) : (lane < result ? lane : result);
+        }
+        return result;
+    }
+
+    BATCH_LOOP size_t countNumbers_float(const float *cells, size_t count)
+    {
+        size_t numbers = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            numbers += cells[i] == cells[i];
+        }
+        return numbers;
+    }
+
+    // Fold contiguous cells
+    void aggregateBatch(const Aggregate &aggregate, const uint32_t *cells, size_t count, AggregateState &state)
+    {
+        const float *floats = reinterpret_cast<const float *>(cells);
+        const int32_t *ints = reinterpret_cast<const int32_t *>(cells);
+        CellType type = aggregate.type;
+        // a float minimum or maximum has only seen the cells that aren't NaN, and is NULL without any
+        bool leaves_nans_out = type == CellType::Float && (aggregate.op == AggregateOp::Min || aggregate.op == AggregateOp::Max);
+        state.count += leaves_nans_out ? countNumbers_float(floats, count) : count;
+        switch (aggregate.op)
+        {
+        case AggregateOp::Count:
+            return;
+        case AggregateOp::Sum:
+        case AggregateOp::Avg:
+            if (type == CellType::Float)
+            {
+                state.sum_float += sumBatch_float(floats, count);
+            }
+            else if (type == CellType::Int32)
+            {
+                state.sum_int32 = int64_t(uint64_t(state.sum_int32) + uint64_t(sumBatch_int32(ints, count)));
+            }
+            else
+            {
+                state.sum_uint32 += sumBatch_uint32(cells, count);
+            }
+            return;
+        case AggregateOp::Min:
+            if (type == CellType::Float)
+            {
+                state.min_float = extremeBatch_float<false>(floats, count, state.min_float);
+            }
+            else if (type == CellType::Int32)
+            {
+                state.min_int32 = extremeBatch<false>(ints, count, state.min_int32);
+            }
+            else
+            {
+                state.min_uint32 = extremeBatch<false>(cells, count, state.min_uint32);
+            }
+            return;
+        case AggregateOp::Max:
+            if (type == CellType::Float)
+            {
+                state.max_float = extremeBatch_float<true>(floats, count, state.max_float);
+            }
+            else if (type == CellType::Int32)
+            {
+                state.max_int32 = extremeBatch<true>(ints, count, state.max_int32);
+            }
+            else
+            {
+                state.max_uint32 = extremeBatch<true>(cells, count, state.max_uint32);
+            }
+            return;
+        }
+    }
+
+    // Float bits reordered so that unsigned comparison sorts them as numbers (NaNs at the ends)
+    uint32_t floatOrder(uint32_t cell)
+    {
+        return cell & 0x80000000u ? ~cell : cell | 0x80000000u;
+    }
+
+    // Bits of a cell of the type reordered so that unsigned comparison sorts them as values (int32_t: sign bit flipped)
+    uint32_t keyOrder(CellType type, uint32_t cell)
+    {
+        switch (type)
+        {
+        case CellType::Float:
+            return floatOrder(cell);
+        case CellType::Int32:
+            return cell ^ 0x80000000u;
+        default:
+            return cell;
+        }
+    }
+
+    uint64_t hashKey(uint32_t key)
+    {
+        uint64_t h = key * 0x9E3779B97F4A7C15ull;
+        return h ^ (h >> 29);
+    }
+}
+
+std::string Aggregate::name() const
+{
+    const char *names[] = {"count", "sum", "min", "max", "avg"};
+    std::string text = names[int(op)];
+    return text + "(" + (all_rows ? std::string("*") : std::to_string(column)) + ")";
+}
+
+bool ParseAggregate(const std::string &text, CellType type, Aggregate &aggregate)
+{
+    size_t open = text.find('('), close = text.rfind(')');
+    if (open == std::string::npos || close == std::string::npos || close < open)
+    {
+        return false;
+    }
+
+    std::string op = text.substr(0, open), argument = text.substr(open + 1, close - open - 1);
+    op.erase(std::remove_if(op.begin(), op.end(), ::isspace), op.end());
+    argument.erase(std::remove_if(argument.begin(), argument.end(), ::isspace), argument.end());
+    std::transform(op.begin(), op.end(), op.begin(), ::tolower);
+
+    const char *names[] = {"count", "sum", "min", "max", "avg"};
+    const char **name = std::find(names, names + 5, op);
+    if (name == names + 5)
+    {
+        return false;
+    }
+    aggregate.op = AggregateOp(name - names);
+    aggregate.type = type;
+    aggregate.column = 0;
+    aggregate.all_rows = argument == "*";
+    if (aggregate.all_rows)
+    {
+        return aggregate.op == AggregateOp::Count;
+    }
+    if (argument.empty() || !std::all_of(argument.begin(), argument.end(), ::isdigit))
+    {
+        return false;
+    }
+    aggregate.column = std::stoul(argument);
+    return true;
+}
+
+std::string AggregateState::format(const Aggregate &aggregate) const
+{
+    if (aggregate.op == AggregateOp::Count)
+    {
+        return std::to_string(count);
+    }
+    if (count == 0)
+    {
+        return "NULL";
+    }
+
+    std::ostringstream out;
+    if (aggregate.type == CellType::Int32)
+    {
+        switch (aggregate.op)
+        {
+        case AggregateOp::Count:
+            break;
+        case AggregateOp::Sum:
+            out << sum_int32;
+            break;
+        case AggregateOp::Min:
+            out << min_int32;
+            break;
+        case AggregateOp::Max:
+            out << max_int32;
+            break;
+        case AggregateOp::Avg:
+            out << double(sum_int32) / double(count);
+            break;
+        }
+        return out.str();
+    }
+    bool is_float = aggregate.type == CellType::Float;
+    switch (aggregate.op)
+    {
+    case AggregateOp::Count:
+        break;
+    case AggregateOp::Sum:
+        is_float ? out << sum_float : out << sum_uint32;
+        break;
+    case AggregateOp::Min:
+        is_float ? out << min_float : out << min_uint32;
+        break;
+    case AggregateOp::Max:
+        is_float ? out << max_float : out << max_uint32;
+        break;
+    case AggregateOp::Avg:
+        out << (is_float ? sum_float : double(sum_uint32)) / double(count);
+        break;
+    }
+    return out.str();
+}
+
+void AggregateCells(const Aggregate &aggregate, const uint32_t *cells, size_t count, size_t stride, AggregateState &state)
+{
+    if (aggregate.op == AggregateOp::Count)
+    {
+        state.count += count;
+        return;
+    }
+    if (stride == 1)
+    {
+        aggregateBatch(aggregate, cells, count, state);
+        return;
+    }
+
+    // gather a column of a row-major table into batches first
+    uint32_t batch[AGGREGATE_BATCH_SIZE];
+    for (size_t i = 0; i < count; i += AGGREGATE_BATCH_SIZE)
+    {
+        size_t n = std::min(AGGREGATE_BATCH_SIZE, count - i);
+        const uint32_t *source = cells + i * stride;
+        for (size_t j = 0; j < n; j++)
+        {
+            batch[j] = source[j * stride];
+        }
+        aggregateBatch(aggregate, batch, n, state);
+    }
+}
+
+void AggregateRepeated(const Aggregate &aggregate, uint32_t cell, uint64_t times, AggregateState &state)
+{
+    float x = asFloat(cell);
+    if (times == 0 || (aggregate.type == CellType::Float && (aggregate.op == AggregateOp::Min || aggregate.op == AggregateOp::Max) && std::isnan(x)))
+    {
+        return;
+    }
+    state.count += times;
+    switch (aggregate.op)
+    {
+    case AggregateOp::Count:
+        return;
+    case AggregateOp::Sum:
+    case AggregateOp::Avg:
+        if (aggregate.type == CellType::Float)
+        {
+            state.sum_float += double(x) * double(times);
+        }
+        else if (aggregate.type == CellType::Int32)
+        {
+            state.sum_int32 = int64_t(uint64_t(state.sum_int32) + uint64_t(int64_t(int32_t(cell))) * times);
+        }
+        else
+        {
+            state.sum_uint32 += uint64_t(cell) * times;
+        }
+        return;
+    case AggregateOp::Min:
+        state.min_uint32 = std::min(state.min_uint32, cell);
+        state.min_int32 = std::min(state.min_int32, int32_t(cell));
+        state.min_float = x < state.min_float ? x : state.min_float;
+        return;
+    case AggregateOp::Max:
+        state.max_uint32 = std::max(state.max_uint32, cell);
+        state.max_int32 = std::max(state.max_int32, int32_t(cell));
+        state.max_float = x > state.max_float ? x : state.max_float;
+        return;
+    }
+}
+
+void AggregateChunk_uint32(const Aggregate &aggregate, RepresentationKind kind, const uint8_t *data, size_t bytes_used, size_t num_rows,
+                           AggregateState &state, PooledBuffer<uint32_t> &scratch)
+{
+    if (aggregate.op == AggregateOp::Count && !CountNeedsData(BaseRepresentation(kind)))
+    {
+        if (CountColumnValues_uint32(kind, data, bytes_used) != num_rows)
+        {
+            throw "Columns have different row counts";
+        }
+        state.count += num_rows;
+        return;
+    }
+    UncompressChunk(kind, data, bytes_used);
+    if (CountColumnValues_uint32(kind, data, bytes_used) != num_rows)
+    {
+        throw "Columns have different row counts";
+    }
+
+    switch (kind)
+    {
+    case RepresentationKind::RunLengthEncoded:
+    {
+        if (bytes_used % 5 != 0)
+        {
+            throw "Bad number of bytes for run-length-encoded uint32_ts";
+        }
+        for (size_t i = 0; i < bytes_used; i += 5)
+        {
+            AggregateRepeated(aggregate, loadU32(data + i + 1), data[i], state);
+        }
+        return;
+    }
+    case RepresentationKind::Constant:
+    {
+        if (bytes_used != 2 * sizeof(uint32_t))
+        {
+            throw "Bad number of bytes for constant-represented uint32_ts";
+        }
+        AggregateRepeated(aggregate, loadU32(data + sizeof(uint32_t)), loadU32(data), state);
+        return;
+    }
+    case RepresentationKind::DictionaryOneByte:
+    {
+        if (bytes_used < sizeof(uint32_t))
+        {
+            throw "Missing dictionary size";
+        }
+        uint32_t dict_size = loadU32(data);
+        if (dict_size > 256 || bytes_used < sizeof(uint32_t) * (1 + size_t(dict_size)))
+        {
+            throw "Bad dictionary size";
+        }
+        // count every index, then fold each entry once
+        uint64_t counts[256] = {};
+        const uint8_t *indices = data + sizeof(uint32_t) * (1 + size_t(dict_size));
+        size_t count = bytes_used - sizeof(uint32_t) * (1 + size_t(dict_size));
+        for (size_t i = 0; i < count; i++)
+        {
+            counts[indices[i]]++;
+        }
+        for (uint32_t i = dict_size; i < 256; i++)
+        {
+            if (counts[i] != 0)
+            {
+                throw "Dictionary index out of range";
+            }
+        }
+        for (uint32_t i = 0; i < dict_size; i++)
+        {
+            AggregateRepeated(aggregate, loadU32(data + sizeof(uint32_t) * (1 + i)), counts[i], state);
+        }
+        return;
+    }
+    default:
+        scratch.resize(num_rows);
+        DecodeColumnInto_uint32(kind, data, bytes_used, scratch.data(), num_rows);
+        AggregateCells(aggregate, scratch.data(), num_rows, 1, state);
+        return;
+    }
+}
+
+Aggregation::Aggregation() : Aggregation(std::vector<Aggregate>()) {}
+
+Aggregation::Aggregation(const std::vector<Aggregate> &aggregates)
+    : aggregates_(aggregates), grouped_(false), key_column_(0), key_type_(CellType::Uint32), key_low_(0), hash_mask_(0), null_group_(NO_GROUP)
+{
+    addGroup(0);
+}
+
+Aggregation::Aggregation(const std::vector<Aggregate> &aggregates, uint32_t key_column, CellType key_type, uint32_t key_low, uint32_t key_high)
+    : aggregates_(aggregates), grouped_(true), key_column_(key_column), key_type_(key_type), key_low_(key_low), hash_mask_(0), null_group_(NO_GROUP)
+{
+    if (key_low <= key_high && key_high - key_low < DIRECT_INDEX_LIMIT)
+    {
+        slots_.assign(size_t(key_high - key_low) + 1, NO_GROUP);
+    }
+    else
+    {
+        rehash(1024);
+    }
+}
+
+uint32_t Aggregation::addGroup(uint32_t key)
+{
+    keys_.push_back(key);
+    states_.resize(states_.size() + aggregates_.size());
+    return uint32_t(keys_.size() - 1);
+}
+
+uint32_t Aggregation::nullGroup()
+{
+    if (null_group_ == NO_GROUP)
+    {
+        null_group_ = addGroup(0);
+    }
+    return null_group_;
+}
+
+void Aggregation::rehash(size_t num_slots)
+{
+    hash_groups_.assign(num_slots, NO_GROUP);
+    hash_mask_ = num_slots - 1;
+    for (uint32_t group = 0; group < keys_.size(); group++)
+    {
+        if (group == null_group_)
+        {
+            continue;
+        }
+        size_t slot = hashKey(keys_[group]) & hash_mask_;
+        while (hash_groups_[slot] != NO_GROUP)
+        {
+            slot = (slot + 1) & hash_mask_;
+        }
+        hash_groups_[slot] = group;
+    }
+}
+
+uint32_t Aggregation::findHashed(uint32_t key)
+{
+    if (hash_groups_.empty())
+    {
+        // a key outside the direct index's range: every group moves to the hash table
+        slots_.clear();
+        slots_.shrink_to_fit();
+        rehash(std::max<size_t>(1024, size_t(1) << (64 - __builtin_clzll(4 * keys_.size() + 1))));
+    }
+
+    size_t slot = hashKey(key) & hash_mask_;
+    for (;; slot = (slot + 1) & hash_mask_)
+    {
+        uint32_t group = hash_groups_[slot];
+        if (group == NO_GROUP)
+        {
+            break;
+        }
+        if (keys_[group] == key && group != null_group_)
+        {
+            return group;
+        }
+    }
+
+    // at most half full
+    uint32_t group = addGroup(key);
+    if (2 * keys_.size() > hash_groups_.size())
+    {
+        rehash(2 * hash_groups_.size());
+    }
+    else
+    {
+        hash_groups_[slot] = group;
+    }
+    return group;
+}
+
+void Aggregation::findGroups(const uint32_t *keys, size_t count, size_t stride, uint32_t *group_ids)
+{
+    if (!grouped_)
+    {
+        std::fill(group_ids, group_ids + count, 0);
+        return;
+    }
+
+    size_t i = 0;
+    if (!slots_.empty())
+    {
+        uint32_t *slots = slots_.data();
+        uint32_t range = uint32_t(slots_.size());
+        for (; i < count; i++)
+        {
+            uint32_t offset = keys[i * stride] - key_low_;
+            if (offset >= range)
+            {
+                break;
+            }
+            uint32_t group = slots[offset];
+            if (group == NO_GROUP)
+            {
+                group = slots[offset] = addGroup(keys[i * stride]);
+            }
+            group_ids[i] = group;
+        }
+    }
+    for (; i < count; i++)
+    {
+        group_ids[i] = findHashed(keys[i * stride]);
+    }
+}
+
+void Aggregation::accumulate(size_t aggregate, const uint32_t *cells, size_t stride, const uint32_t *group_ids, size_t count)
+{
+    const Aggregate &a = aggregates_[aggregate];
+    AggregateState *states = states_.data() + aggregate;
+    size_t width = aggregates_.size();
+    switch (a.op)
+    {
+    case AggregateOp::Count:
+        for (size_t i = 0; i < count; i++)
+        {
+            states[group_ids[i] * width].count++;
+        }
+        return;
+    case AggregateOp::Sum:
+    case AggregateOp::Avg:
+        if (a.type == CellType::Float)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                AggregateState &state = states[group_ids[i] * width];
+                state.count++;
+                state.sum_float += asFloat(cells[i * stride]);
+            }
+            return;
+        }
+        if (a.type == CellType::Int32)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                AggregateState &state = states[group_ids[i] * width];
+                state.count++;
+                state.sum_int32 = int64_t(uint64_t(state.sum_int32) + uint64_t(int64_t(int32_t(cells[i * stride]))));
+            }
+            return;
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            AggregateState &state = states[group_ids[i] * width];
+            state.count++;
+            state.sum_uint32 += cells[i * stride];
+        }
+        return;
+    case AggregateOp::Min:
+    case AggregateOp::Max:
+        for (size_t i = 0; i < count; i++)
+        {
+            AggregateRepeated(a, cells[i * stride], 1, states[group_ids[i] * width]);
+        }
+        return;
+    }
+}
+
+QueryVector<uint32_t> Aggregation::sortedGroups() const
+{
+    QueryVector<uint32_t> groups(keys_.size());
+    for (uint32_t group = 0; group < groups.size(); group++)
+    {
+        groups[group] = group;
+    }
+    std::sort(groups.begin(), groups.end(), [&](uint32_t a, uint32_t b)
+              {
+                  if (a == null_group_ || b == null_group_)
+                  {
+                      return b == null_group_ && a != null_group_;
+                  }
+                  return keyOrder(key_type_, keys_[a]) < keyOrder(key_type_, keys_[b]); });
+    return groups;
+}
+
+void Aggregation::print(std::ostream &out) const
+{
+    RT_TIME_PHASE(Output);
+    if (grouped_)
+    {
+        out << "column(" << key_column_ << ") ";
+    }
+    for (const Aggregate &aggregate : aggregates_)
+    {
+        out << aggregate.name() << " ";
+    }
+    out << std::endl;
+
+    for (uint32_t group : sortedGroups())
+    {
+        if (grouped_)
+        {
+            if (groupKeyIsNull(group))
+            {
+                out << "NULL ";
+            }
+            else if (key_type_ == CellType::Float)
+            {
+                out << asFloat(keys_[group]) << " ";
+            }
+            else if (key_type_ == CellType::Int32)
+            {
+                out << int32_t(keys_[group]) << " ";
+            }
+            else
+            {
+                out << keys_[group] << " ";
+            }
+        }
+        for (size_t a = 0; a < aggregates_.size(); a++)
+        {
+            out << state(group, a).format(aggregates_[a]) << " ";
+        }
+        out << std::endl;
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef _aggregate_h_
+#define _aggregate_h_
+
+#include "coding.hpp"
+#include "predicate.hpp"
+
+#include <iostream>
+#include <limits>
+#include <string>
+
+// Rows the aggregation loops work through at a time; strided cells are gathered into a batch this size
+const size_t AGGREGATE_BATCH_SIZE = 1024;
+
+// What an aggregate computes
+enum class AggregateOp
+{
+    Count,
+    Sum,
+    Min,
+    Max,
+    Avg,
+};
+
+// One output of an aggregation: op over a column whose cells are read as type. count(*) counts every
+// row; the other aggregates leave NULL cells out, and float minimums and maximums leave NaNs out.
+struct Aggregate
+{
+    AggregateOp op;
+    uint32_t column;
+    CellType type;
+    bool all_rows; // count(*)
+
+    // e.g. "sum(2)" or "count(*)"
+    std::string name() const;
+};
+
+// Parse "op(column)" with op one of count sum min max avg, or "count(*)"
+bool ParseAggregate(const std::string &text, CellType type, Aggregate &aggregate);
+
+// Running state of one aggregate: cells seen, their sum (uint32_t and int32_t sums wrap at 2^64, float
+// sums add up as doubles), minimum and maximum
+struct AggregateState
+{
+    uint64_t count = 0;
+    uint64_t sum_uint32 = 0;
+    int64_t sum_int32 = 0;
+    double sum_float = 0;
+    uint32_t min_uint32 = std::numeric_limits<uint32_t>::max();
+    uint32_t max_uint32 = 0;
+    int32_t min_int32 = std::numeric_limits<int32_t>::max();
+    int32_t max_int32 = std::numeric_limits<int32_t>::min();
+    float min_float = std::numeric_limits<float>::infinity();
+    float max_float = -std::numeric_limits<float>::infinity();
+
+    // The aggregate's result as text; "NULL" when no cell was seen (count gives 0)
+    std::string format(const Aggregate &aggregate) const;
+};
+
+// Fold count plain cells, every stride-th one from cells, into the state
+void AggregateCells(const Aggregate &aggregate, const uint32_t *cells, size_t count, size_t stride, AggregateState &state);
+
+// Fold one cell seen times times (a run) without expanding it
+void AggregateRepeated(const Aggregate &aggregate, uint32_t cell, uint64_t times, AggregateState &state);
+
+// Fold an encoded chunk of num_rows values. Run-length and constant chunks are folded run by run as
+// value x count, dictionary chunks by counting each index and folding every entry once; count only
+// counts the values. Other representations are decoded into scratch first. Throws on malformed input
+// and on a chunk not holding num_rows values.
+void AggregateChunk_uint32(const Aggregate &aggregate, RepresentationKind kind, const uint8_t *data, size_t bytes_used, size_t num_rows,
+                           AggregateState &state, PooledBuffer<uint32_t> &scratch);
+
+// The aggregates over every row, or per group of a key column (keys compare as 32-bit patterns).
+// Keys in a range of at most DIRECT_INDEX_LIMIT values index an array of group ids directly; wider
+// ranges, and keys turning up outside the range given, use an open-addressing hash table. The index, the
+// hash table and the groups' states come from the query memory (see QueryAllocator).
+class Aggregation
+{
+public:
+    static constexpr uint32_t DIRECT_INDEX_LIMIT = 1 << 16;
+    static constexpr uint32_t NO_GROUP = 0xFFFFFFFFu;
+
+    Aggregation();
+
+    // Ungrouped: a single group holding every row
+    explicit Aggregation(const std::vector<Aggregate> &aggregates);
+
+    // Grouped on key_column, whose cells are expected in [key_low, key_high]
+    Aggregation(const std::vector<Aggregate> &aggregates, uint32_t key_column, CellType key_type, uint32_t key_low, uint32_t key_high);
+
+    const std::vector<Aggregate> &aggregates() const { return aggregates_; }
+    bool grouped() const { return grouped_; }
+    uint32_t keyColumn() const { return key_column_; }
+    bool directIndexed() const { return !slots_.empty(); }
+
+    size_t numGroups() const { return keys_.size(); }
+    uint32_t groupKey(uint32_t group) const { return keys_[group]; }
+    bool groupKeyIsNull(uint32_t group) const { return group == null_group_; }
+    AggregateState &state(uint32_t group, size_t aggregate) { return states_[group * aggregates_.size() + aggregate]; }
+    const AggregateState &state(uint32_t group, size_t aggregate) const { return states_[group * aggregates_.size() + aggregate]; }
+
+    // Group id of count keys, every stride-th cell from keys, into group_ids[0 .. count - 1], adding groups for new keys
+    void findGroups(const uint32_t *keys, size_t count, size_t stride, uint32_t *group_ids);
+
+    // Group of the rows with a NULL key
+    uint32_t nullGroup();
+
+    // Fold count cells, every stride-th one from cells, into the states of their groups for one aggregate
+    void accumulate(size_t aggregate, const uint32_t *cells, size_t stride, const uint32_t *group_ids, size_t count);
+
+    // Groups ordered by key, the NULL group last
+    QueryVector<uint32_t> sortedGroups() const;
+
+    // A line of aggregate names (the key column first when grouped), then a line per group
+    void print(std::ostream &out) const;
+
+private:
+    std::vector<Aggregate> aggregates_;
+    bool grouped_;
+    uint32_t key_column_;
+    CellType key_type_;
+    uint32_t key_low_;
+    QueryVector<uint32_t> slots_;       // direct index: group of key key_low_ + i, NO_GROUP if none yet
+    QueryVector<uint32_t> hash_groups_; // hash table: group in each slot, NO_GROUP if empty
+    size_t hash_mask_;
+    QueryVector<uint32_t> keys_;        // key of every group
+    uint32_t null_group_;
+    QueryVector<AggregateState> states_; // aggregates_.size() per group
+
+    uint32_t addGroup(uint32_t key);
+    uint32_t findHashed(uint32_t key);
+    void rehash(size_t num_slots);
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include "batch.hpp"
+
+#include <utility>
+
+ColumnBatch::ColumnBatch()
+    : num_columns_(0), capacity_(0), stride_(0), size_(0), num_selected_(0), has_selection_(false)
+{
+}
+
+ColumnBatch::ColumnBatch(uint32_t num_columns, size_t capacity) : ColumnBatch()
+{
+    reset(num_columns, capacity);
+}
+
+ColumnBatch::ColumnBatch(ColumnBatch &&other) : ColumnBatch()
+{
+    *this = std::move(other);
+}
+
+ColumnBatch &ColumnBatch::operator=(ColumnBatch &&other)
+{
+    if (this != &other)
+    {
+        num_columns_ = std::exchange(other.num_columns_, 0);
+        capacity_ = std::exchange(other.capacity_, 0);
+        stride_ = std::exchange(other.stride_, 0);
+        size_ = std::exchange(other.size_, 0);
+        cells_ = std::move(other.cells_);
+        selection_ = std::move(other.selection_);
+        num_selected_ = std::exchange(other.num_selected_, 0);
+        has_selection_ = std::exchange(other.has_selection_, false);
+    }
+    return *this;
+}
+
+void ColumnBatch::reset(uint32_t num_columns, size_t capacity)
+{
+    const size_t cells_per_line = BATCH_ALIGNMENT / sizeof(uint32_t);
+    size_t stride = (capacity + cells_per_line - 1) / cells_per_line * cells_per_line;
+    // the old cells are of no use, so a bigger buffer is taken instead of growing the old one
+    size_t cells = stride * num_columns;
+    if (cells > cells_.capacity())
+    {
+        cells_.clear();
+    }
+    cells_.resize(cells);
+    if (capacity > selection_.capacity())
+    {
+        selection_.clear();
+    }
+    selection_.resize(capacity);
+    num_columns_ = num_columns;
+    capacity_ = capacity;
+    stride_ = stride;
+    size_ = 0;
+    has_selection_ = false;
+}
+
+void ColumnBatch::setSize(size_t num_rows)
+{
+    size_ = num_rows;
+    has_selection_ = false;
+}
+
+void ColumnBatch::setSelection(size_t num_selected)
+{
+    num_selected_ = num_selected;
+    has_selection_ = true;
+}
+
+void ColumnBatch::select(const SelectionBitmap &bitmap)
+{
+    size_t num_selected = 0;
+    const QueryVector<uint64_t> &words = bitmap.words();
+    for (size_t w = 0; w < words.size(); w++)
+    {
+        for (uint64_t word = words[w]; word != 0; word &= word - 1)
+        {
+            selection_[num_selected++] = uint32_t(w * 64 + __builtin_ctzll(word));
+        }
+    }
+    setSelection(num_selected);
+}
+
+void ColumnBatch::loadRows(const uint32_t *cells, uint32_t row_width, size_t num_rows, const std::vector<uint32_t> &column_indices)
+{
+    // a column at a time: the rows are read once per column, but the writes stay sequential
+    for (size_t k = 0; k < column_indices.size(); k++)
+    {
+        uint32_t *out = column(uint32_t(k));
+        const uint32_t *in = cells + column_indices[k];
+        for (size_t i = 0; i < num_rows; i++)
+        {
+            out[i] = in[i * row_width];
+        }
+    }
+    setSize(num_rows);
+}
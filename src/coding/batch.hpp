@@ -0,0 +1,101 @@
+#ifndef _batch_h_
+#define _batch_h_
+
+#include "predicate.hpp"
+#include "../rt/query_memory.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Rows a batch holds unless it is made bigger, e.g. to take a whole row group
+const size_t BATCH_CAPACITY = 1024;
+
+// Column buffers start on a cache line, so every column is one run of whole lines
+const size_t BATCH_ALIGNMENT = 64;
+
+// A fixed number of rows of some columns, column-major: column k of row i is column(k)[i]. All columns
+// share one 64-byte-aligned buffer taken when the batch is sized (from the current query memory, so a
+// batch must not outlive its query), and a scan that refills the same batch allocates nothing after its
+// first batch.
+//
+// The selection vector lists, in ascending order, the rows still in play after a filter; without one
+// every row 0 .. size() - 1 is. Consumers go through forEachSelected or check hasSelection().
+class ColumnBatch
+{
+public:
+    ColumnBatch();
+    explicit ColumnBatch(uint32_t num_columns, size_t capacity = BATCH_CAPACITY);
+
+    // Moved-from batches are left empty, without a buffer
+    ColumnBatch(ColumnBatch &&other);
+    ColumnBatch &operator=(ColumnBatch &&other);
+    ColumnBatch(const ColumnBatch &) = delete;
+    ColumnBatch &operator=(const ColumnBatch &) = delete;
+
+    // Room for num_columns columns of capacity rows, keeping the buffers when they are big enough.
+    // The batch is empty afterwards.
+    void reset(uint32_t num_columns, size_t capacity = BATCH_CAPACITY);
+
+    uint32_t numColumns() const { return num_columns_; }
+    size_t capacity() const { return capacity_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // Rows held, after the columns were filled in place; drops the selection
+    void setSize(size_t num_rows);
+
+    uint32_t *column(uint32_t k) { return cells_.data() + k * stride_; }
+    const uint32_t *column(uint32_t k) const { return cells_.data() + k * stride_; }
+    const float *column_float(uint32_t k) const { return reinterpret_cast<const float *>(column(k)); }
+
+    // Selection vector
+    bool hasSelection() const { return has_selection_; }
+    size_t numSelected() const { return has_selection_ ? num_selected_ : size_; }
+    const uint32_t *selection() const { return selection_.data(); }
+    // Fill the first num_selected entries of selectionBuffer(), then call setSelection
+    uint32_t *selectionBuffer() { return selection_.data(); }
+    void setSelection(size_t num_selected);
+    void clearSelection() { has_selection_ = false; }
+
+    // Select the rows set in a bitmap of size() rows
+    void select(const SelectionBitmap &bitmap);
+
+    // Call f(row) for every selected row in order
+    template <typename F>
+    void forEachSelected(F f) const
+    {
+        if (!has_selection_)
+        {
+            for (size_t i = 0; i < size_; i++)
+            {
+                f(uint32_t(i));
+            }
+            return;
+        }
+        for (size_t s = 0; s < num_selected_; s++)
+        {
+            f(selection_[s]);
+        }
+    }
+
+    // Fill with num_rows rows of row-major cells, row_width cells each: column k gets the cells of
+    // column column_indices[k]. num_rows must fit.
+    void loadRows(const uint32_t *cells, uint32_t row_width, size_t num_rows, const std::vector<uint32_t> &column_indices);
+
+private:
+    uint32_t num_columns_;
+    size_t capacity_;
+    size_t stride_; // cells from one column to the next, capacity_ rounded up to whole cache lines
+    size_t size_;
+    PooledBuffer<uint32_t> cells_;
+    PooledBuffer<uint32_t> selection_; // capacity_ entries
+    size_t num_selected_;
+    bool has_selection_;
+};
+
+// Receives the batches of a scan along with the table row of each batch's row 0
+typedef std::function<void(uint32_t first_row, const ColumnBatch &batch)> BatchVisitor;
+
+#endif
@@ -0,0 +1,295 @@
+#include "block_codec.hpp"
+#include "../rt/instrumentation.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    const size_t MIN_MATCH = 4;
+    const size_t MAX_OFFSET = 0xFFFF;
+    const uint32_t MAX_HASH_BITS = 16;
+
+    uint32_t loadU32(const uint8_t *data)
+    {
+        return uint32_t(data[0]) | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24);
+    }
+
+    void appendU32(std::vector<uint8_t> &out, uint32_t value)
+    {
+        uint8_t bytes[4] = {uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16), uint8_t(value >> 24)};
+        out.insert(out.end(), bytes, bytes + 4);
+    }
+
+    // The part of a length past what the token holds: bytes of 255, then the rest
+    void appendLength(std::vector<uint8_t> &out, size_t length)
+    {
+        for (; length >= 255; length -= 255)
+        {
+            out.push_back(255);
+        }
+        out.push_back(uint8_t(length));
+    }
+
+    size_t readLength(const uint8_t *&in, const uint8_t *end)
+    {
+        size_t length = 0;
+        uint8_t byte;
+        do
+        {
+            if (in == end)
+            {
+                throw "Truncated LZ block";
+            }
+            byte = *in++;
+            length += byte;
+        } while (byte == 255);
+        return length;
+    }
+
+    void appendSequence(std::vector<uint8_t> &out, const uint8_t *literals, size_t num_literals, size_t offset, size_t match_length)
+    {
+        size_t match_code = match_length == 0 ? 0 : match_length - MIN_MATCH;
+        out.push_back(uint8_t((std::min<size_t>(num_literals, 15) << 4) | std::min<size_t>(match_code, 15)));
+        if (num_literals >= 15)
+        {
+            appendLength(out, num_literals - 15);
+        }
+        out.insert(out.end(), literals, literals + num_literals);
+        if (match_length == 0)
+        {
+            return;
+        }
+        out.push_back(uint8_t(offset));
+        out.push_back(uint8_t(offset >> 8));
+        if (match_code >= 15)
+        {
+            appendLength(out, match_code - 15);
+        }
+    }
+
+    uint32_t hashOf(const uint8_t *data, uint32_t hash_bits)
+    {
+        return (loadU32(data) * 2654435761u) >> (32 - hash_bits);
+    }
+}
+
+const char *BlockCodecName(BlockCodec codec)
+{
+    switch (codec)
+    {
+    case BlockCodec::NoBlockCodec:
+        return "none";
+    case BlockCodec::LzBlockCodec:
+        return "lz";
+    default:
+        return "unknown";
+    }
+}
+
+bool ParseBlockCompression(const std::string &text, BlockCompression &compression)
+{
+    if (text == "none")
+    {
+        compression = {BlockCodec::NoBlockCodec, 0};
+        return true;
+    }
+    if (text == "lz")
+    {
+        compression = {BlockCodec::LzBlockCodec, DEFAULT_BLOCK_LEVEL};
+        return true;
+    }
+    if (text.compare(0, 3, "lz:") != 0 || text.size() == 3 || text.find_first_not_of("0123456789", 3) != std::string::npos)
+    {
+        return false;
+    }
+    unsigned long level = std::stoul(text.substr(3));
+    if (level < 1 || level > MAX_BLOCK_LEVEL)
+    {
+        return false;
+    }
+    compression = {BlockCodec::LzBlockCodec, uint32_t(level)};
+    return true;
+}
+
+void LzCompress(const uint8_t *data, size_t size, uint32_t level, std::vector<uint8_t> &out)
+{
+    // earlier positions with the same hash are chained; a level looks at up to 2^(level - 1) of them
+    uint32_t hash_bits = 10;
+    while (hash_bits < MAX_HASH_BITS && (size_t(1) << hash_bits) < size)
+    {
+        hash_bits++;
+    }
+    size_t window = 1;
+    while (window < std::min(size, MAX_OFFSET + 1))
+    {
+        window <<= 1;
+    }
+    std::vector<int64_t> head(size_t(1) << hash_bits, -1);
+    std::vector<int64_t> previous(window, -1);
+    uint32_t max_attempts = 1u << (std::min(std::max(level, 1u), MAX_BLOCK_LEVEL) - 1);
+
+    auto insert = [&](size_t position)
+    {
+        uint32_t hash = hashOf(data + position, hash_bits);
+        previous[position & (window - 1)] = head[hash];
+        head[hash] = int64_t(position);
+    };
+
+    size_t anchor = 0, position = 0;
+    while (position + MIN_MATCH <= size)
+    {
+        size_t best_length = 0, best_offset = 0;
+        int64_t candidate = head[hashOf(data + position, hash_bits)];
+        for (uint32_t attempt = 0; attempt < max_attempts && candidate >= 0 && position - size_t(candidate) <= MAX_OFFSET; attempt++)
+        {
+            size_t length = 0;
+            while (position + length < size && data[candidate + length] == data[position + length])
+            {
+                length++;
+            }
+            if (length > best_length)
+            {
+                best_length = length;
+                best_offset = position - size_t(candidate);
+                if (position + length == size)
+                {
+                    break;
+                }
+            }
+            // a slot taken over by a later position ends the chain
+            int64_t next = previous[size_t(candidate) & (window - 1)];
+            candidate = next < candidate ? next : -1;
+        }
+
+        if (best_length < MIN_MATCH)
+        {
+            insert(position++);
+            continue;
+        }
+        appendSequence(out, data + anchor, position - anchor, best_offset, best_length);
+        for (size_t end = position + best_length; position < end; position++)
+        {
+            if (position + MIN_MATCH <= size)
+            {
+                insert(position);
+            }
+        }
+        anchor = position;
+    }
+    appendSequence(out, data + anchor, size - anchor, 0, 0);
+}
+
+void LzDecompress(const uint8_t *data, size_t size, uint8_t *out, size_t out_size)
+{
+    const uint8_t *in = data, *end = data + size;
+    size_t written = 0;
+    while (true)
+    {
+        if (in == end)
+        {
+            throw "Truncated LZ block";
+        }
+        uint8_t token = *in++;
+        size_t num_literals = token >> 4;
+        if (num_literals == 15)
+        {
+            num_literals += readLength(in, end);
+        }
+        if (num_literals > size_t(end - in) || num_literals > out_size - written)
+        {
+            throw "LZ literals run past the block";
+        }
+        std::memcpy(out + written, in, num_literals);
+        in += num_literals;
+        written += num_literals;
+        if (in == end)
+        {
+            break;
+        }
+
+        if (end - in < 2)
+        {
+            throw "Truncated LZ match";
+        }
+        size_t offset = size_t(in[0]) | (size_t(in[1]) << 8);
+        in += 2;
+        size_t match_length = (token & 15) + MIN_MATCH;
+        if ((token & 15) == 15)
+        {
+            match_length += readLength(in, end);
+        }
+        if (offset == 0 || offset > written || match_length > out_size - written)
+        {
+            throw "Bad LZ match";
+        }
+        // an overlapping match repeats the bytes it has just written
+        uint8_t *target = out + written;
+        if (offset >= match_length)
+        {
+            std::memcpy(target, target - offset, match_length);
+        }
+        else
+        {
+            for (size_t i = 0; i < match_length; i++)
+            {
+                target[i] = target[i - offset];
+            }
+        }
+        written += match_length;
+    }
+    if (written != out_size)
+    {
+        throw "LZ block holds fewer bytes than expected";
+    }
+}
+
+bool CompressChunk(const BlockCompression &compression, RepresentationKind &kind, std::vector<uint8_t> &chunk)
+{
+    if (compression.codec != BlockCodec::LzBlockCodec || IsBlockCompressed(kind))
+    {
+        return false;
+    }
+    std::vector<uint8_t> compressed;
+    compressed.reserve(chunk.size());
+    compressed.push_back(uint8_t(compression.codec));
+    appendU32(compressed, uint32_t(chunk.size()));
+    LzCompress(chunk.data(), chunk.size(), compression.level, compressed);
+    if (compressed.size() > chunk.size() - chunk.size() / 16)
+    {
+        return false;
+    }
+    chunk.swap(compressed);
+    kind = RepresentationKind(uint8_t(kind) | BLOCK_COMPRESSED);
+    return true;
+}
+
+size_t UncompressedChunkSize(const uint8_t *data, size_t bytes_used)
+{
+    if (bytes_used < BLOCK_HEADER_BYTES)
+    {
+        throw "Truncated block-compressed chunk header";
+    }
+    return loadU32(data + 1);
+}
+
+void UncompressChunk(RepresentationKind &kind, const uint8_t *&data, size_t &bytes_used)
+{
+    if (!IsBlockCompressed(kind))
+    {
+        return;
+    }
+    size_t size = UncompressedChunkSize(data, bytes_used);
+    if (data[0] != BlockCodec::LzBlockCodec)
+    {
+        throw "Unknown block codec";
+    }
+    thread_local std::vector<uint8_t> uncompressed;
+    uncompressed.resize(size);
+    LzDecompress(data + BLOCK_HEADER_BYTES, bytes_used - BLOCK_HEADER_BYTES, uncompressed.data(), size);
+    RT_COUNT(BlockDecompressions);
+
+    kind = BaseRepresentation(kind);
+    data = uncompressed.data();
+    bytes_used = size;
+}
@@ -0,0 +1,78 @@
+#ifndef _block_codec_h_
+#define _block_codec_h_
+
+#include "coding.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Second-stage compression of column chunks: after its representation has encoded a chunk, the chunk's
+// bytes can be compressed once more as a whole with a general-purpose block codec. Such a chunk has
+// BLOCK_COMPRESSED set in its representation byte and starts with a header:
+//   codec: u8, uncompressed_size: u32, then the codec's output
+// Everything that takes a representation and a chunk (DecodeColumnInto_uint32, CountColumnValues_uint32,
+// EvaluatePredicate_uint32, AggregateChunk_uint32, ...) accepts these and uncompresses them first.
+const uint8_t BLOCK_COMPRESSED = 0x80;
+
+// Codec of a block-compressed chunk
+enum BlockCodec : uint8_t
+{
+    NoBlockCodec = 0,
+    // LZ77 in the style of an LZ4 block: sequences of token (literal length << 4 | match length - 4),
+    // literal length extension bytes, literals, match offset (u16), match length extension bytes,
+    // where an extended length adds bytes of 255 and ends at the first one that isn't; the last
+    // sequence has literals only.
+    LzBlockCodec = 1,
+};
+
+// How a column's chunks are compressed. Decoding an LZ chunk costs one pass over its encoded bytes on top
+// of decoding the representation, so columns read in hot loops can be left uncompressed. level 1 to 9
+// trades encoding time for ratio (how many earlier matches the compressor looks at); decoding is as fast
+// at every level.
+struct BlockCompression
+{
+    BlockCodec codec;
+    uint32_t level;
+};
+
+const uint32_t DEFAULT_BLOCK_LEVEL = 3;
+const uint32_t MAX_BLOCK_LEVEL = 9;
+
+// Bytes a chunk's header takes when it is block-compressed
+const size_t BLOCK_HEADER_BYTES = sizeof(uint8_t) + sizeof(uint32_t);
+
+const char *BlockCodecName(BlockCodec codec);
+
+// "none", "lz" or "lz:<level>"
+bool ParseBlockCompression(const std::string &text, BlockCompression &compression);
+
+inline bool IsBlockCompressed(RepresentationKind kind)
+{
+    return kind != RepresentationKind::Adaptive && (uint8_t(kind) & BLOCK_COMPRESSED) != 0;
+}
+
+// The representation a block-compressed chunk is encoded with once uncompressed
+inline RepresentationKind BaseRepresentation(RepresentationKind kind)
+{
+    return IsBlockCompressed(kind) ? RepresentationKind(uint8_t(kind) & ~BLOCK_COMPRESSED) : kind;
+}
+
+// Compress an encoded chunk of representation kind in place, setting BLOCK_COMPRESSED in kind. Chunks
+// that wouldn't come out at least 1/16 smaller are left as they are (false).
+bool CompressChunk(const BlockCompression &compression, RepresentationKind &kind, std::vector<uint8_t> &chunk);
+
+// Uncompress a block-compressed chunk: kind becomes its base representation, and data and bytes_used the
+// uncompressed bytes in a buffer of the calling thread, good until its next call. Other chunks are left
+// alone. Throws on malformed input.
+void UncompressChunk(RepresentationKind &kind, const uint8_t *&data, size_t &bytes_used);
+
+// Uncompressed size of a block-compressed chunk from its header
+size_t UncompressedChunkSize(const uint8_t *data, size_t bytes_used);
+
+// The raw codec on a buffer; LzDecompress throws unless the input decodes to exactly size bytes
+void LzCompress(const uint8_t *data, size_t size, uint32_t level, std::vector<uint8_t> &out);
+void LzDecompress(const uint8_t *data, size_t size, uint8_t *out, size_t out_size);
+
+#endif
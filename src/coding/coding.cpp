@@ -0,0 +1,754 @@
+#include "coding.hpp"
+#include "block_codec.hpp"
+#include "kernels.hpp"
+#include "../rt/instrumentation.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+    void appendU8(std::vector<uint8_t> &out, uint8_t value)
+    {
+        out.push_back(value);
+    }
+
+    void appendU32(std::vector<uint8_t> &out, uint32_t value)
+    {
+        uint8_t bytes[4] = {uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16), uint8_t(value >> 24)};
+        out.insert(out.end(), bytes, bytes + 4);
+    }
+
+    uint32_t loadU32(const uint8_t *data)
+    {
+        return uint32_t(data[0]) | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24);
+    }
+
+    uint32_t bitWidth(uint32_t max_value)
+    {
+        // bit_packing_encoding uses one bit for an all-zero chunk
+        uint32_t bits = 1;
+        while (bits < 32 && (max_value >> bits) != 0)
+        {
+            bits++;
+        }
+        return bits;
+    }
+
+    // Pack one chunk the way bit_packing_encoding does: values never straddle two packed integers
+    void packChunk(const uint32_t *values, size_t count, std::vector<uint8_t> &out)
+    {
+        uint32_t max_value = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            max_value |= values[i];
+        }
+        uint32_t bits = bitWidth(max_value);
+
+        appendU8(out, uint8_t(bits));
+        if (bits == 32)
+        {
+            appendU32(out, uint32_t(count));
+            for (size_t i = 0; i < count; i++)
+            {
+                appendU32(out, values[i]);
+            }
+            return;
+        }
+
+        uint32_t values_per_pack = 32 / bits;
+        uint32_t num_packed = uint32_t((count + values_per_pack - 1) / values_per_pack);
+        appendU32(out, num_packed);
+        for (size_t i = 0; i < count; i += values_per_pack)
+        {
+            uint32_t packed = 0;
+            for (uint32_t k = 0; k < values_per_pack && i + k < count; k++)
+            {
+                packed |= values[i + k] << (k * bits);
+            }
+            appendU32(out, packed);
+        }
+    }
+
+    // Unpack up to count values of one chunk, returns the number of bytes consumed
+    size_t unpackChunk(const uint8_t *data, size_t size, size_t count, uint32_t *out)
+    {
+        if (size < 5)
+        {
+            throw "Truncated bit-packed chunk header";
+        }
+        uint32_t bits = data[0];
+        uint32_t num_packed = loadU32(data + 1);
+        if (bits == 0 || bits > 32)
+        {
+            throw "Bad bit width in bit-packed chunk";
+        }
+        if ((size - 5) / sizeof(uint32_t) < num_packed)
+        {
+            throw "Truncated bit-packed chunk";
+        }
+        const uint8_t *packed = data + 5;
+
+        uint32_t values_per_pack = 32 / bits;
+        if (uint64_t(num_packed) * values_per_pack < count)
+        {
+            throw "Bit-packed chunk holds fewer values than expected";
+        }
+
+        ActiveDecodeKernels().unpack_bits(packed, bits, count, out);
+        return 5 + size_t(num_packed) * sizeof(uint32_t);
+    }
+}
+
+const char *RepresentationKindName(RepresentationKind kind)
+{
+    if (IsBlockCompressed(kind))
+    {
+        switch (BaseRepresentation(kind))
+        {
+        case RepresentationKind::DirectLegacy:
+        case RepresentationKind::Direct:
+            return "Direct+Block";
+        case RepresentationKind::RunLengthEncoded:
+            return "RunLengthEncoded+Block";
+        case RepresentationKind::DictionaryOneByte:
+            return "DictionaryOneByte+Block";
+        case RepresentationKind::OneSByteDeltaEncoded:
+            return "OneSByteDeltaEncoded+Block";
+        case RepresentationKind::Constant:
+            return "Constant+Block";
+        case RepresentationKind::BitPacked:
+            return "BitPacked+Block";
+        default:
+            return "Unknown+Block";
+        }
+    }
+    switch (kind)
+    {
+    case RepresentationKind::DirectLegacy:
+    case RepresentationKind::Direct:
+        return "Direct";
+    case RepresentationKind::RunLengthEncoded:
+        return "RunLengthEncoded";
+    case RepresentationKind::DictionaryOneByte:
+        return "DictionaryOneByte";
+    case RepresentationKind::OneSByteDeltaEncoded:
+        return "OneSByteDeltaEncoded";
+    case RepresentationKind::Constant:
+        return "Constant";
+    case RepresentationKind::BitPacked:
+        return "BitPacked";
+    case RepresentationKind::Adaptive:
+        return "Adaptive";
+    default:
+        return "Unknown";
+    }
+}
+
+bool EncodeColumn_uint32(const uint32_t *values, size_t count, RepresentationKind kind, std::vector<uint8_t> &out)
+{
+    switch (kind)
+    {
+    case RepresentationKind::DirectLegacy:
+    case RepresentationKind::Direct:
+    {
+        size_t start = out.size();
+        out.resize(start + count * sizeof(uint32_t));
+        for (size_t i = 0; i < count; i++)
+        {
+            uint8_t *p = &out[start + 4 * i];
+            p[0] = uint8_t(values[i]);
+            p[1] = uint8_t(values[i] >> 8);
+            p[2] = uint8_t(values[i] >> 16);
+            p[3] = uint8_t(values[i] >> 24);
+        }
+        return true;
+    }
+    case RepresentationKind::RunLengthEncoded:
+    {
+        size_t i = 0;
+        while (i < count)
+        {
+            size_t run = 1;
+            while (i + run < count && values[i + run] == values[i])
+            {
+                run++;
+            }
+            // one-byte counts, as in try_compress
+            for (size_t left = run; left > 0;)
+            {
+                size_t piece = left > 255 ? 255 : left;
+                appendU8(out, uint8_t(piece));
+                appendU32(out, values[i]);
+                left -= piece;
+            }
+            i += run;
+        }
+        return true;
+    }
+    case RepresentationKind::DictionaryOneByte:
+    {
+        std::unordered_map<uint32_t, uint8_t> index_of;
+        std::vector<uint32_t> dictionary;
+        std::vector<uint8_t> indices(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            auto it = index_of.find(values[i]);
+            if (it == index_of.end())
+            {
+                if (dictionary.size() == 256)
+                {
+                    return false;
+                }
+                it = index_of.emplace(values[i], uint8_t(dictionary.size())).first;
+                dictionary.push_back(values[i]);
+            }
+            indices[i] = it->second;
+        }
+        appendU32(out, uint32_t(dictionary.size()));
+        for (uint32_t value : dictionary)
+        {
+            appendU32(out, value);
+        }
+        out.insert(out.end(), indices.begin(), indices.end());
+        return true;
+    }
+    case RepresentationKind::OneSByteDeltaEncoded:
+    {
+        if (count == 0)
+        {
+            return false;
+        }
+        for (size_t i = 1; i < count; i++)
+        {
+            int64_t difference = int64_t(values[i]) - int64_t(values[i - 1]);
+            if (difference < -128 || difference > 127)
+            {
+                return false;
+            }
+        }
+        appendU32(out, values[0]);
+        for (size_t i = 1; i < count; i++)
+        {
+            appendU8(out, uint8_t(int8_t(int64_t(values[i]) - int64_t(values[i - 1]))));
+        }
+        return true;
+    }
+    case RepresentationKind::Constant:
+    {
+        if (count == 0)
+        {
+            return false;
+        }
+        for (size_t i = 1; i < count; i++)
+        {
+            if (values[i] != values[0])
+            {
+                return false;
+            }
+        }
+        appendU32(out, uint32_t(count));
+        appendU32(out, values[0]);
+        return true;
+    }
+    case RepresentationKind::BitPacked:
+    {
+        size_t num_chunks = (count + BIT_PACKING_CHUNK_SIZE - 1) / BIT_PACKING_CHUNK_SIZE;
+        appendU32(out, uint32_t(count));
+        appendU32(out, uint32_t(num_chunks));
+        for (size_t i = 0; i < count; i += BIT_PACKING_CHUNK_SIZE)
+        {
+            size_t chunk = count - i < BIT_PACKING_CHUNK_SIZE ? count - i : BIT_PACKING_CHUNK_SIZE;
+            packChunk(values + i, chunk, out);
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+void DecodeColumn_uint32(RepresentationKind kind, const uint8_t *data, size_t bytes_used, std::vector<uint32_t> &out)
+{
+    UncompressChunk(kind, data, bytes_used);
+    size_t start = out.size();
+    out.resize(start + CountColumnValues_uint32(kind, data, bytes_used));
+    DecodeColumnInto_uint32(kind, data, bytes_used, out.data() + start, out.size() - start);
+}
+
+size_t DecodeColumnInto_uint32(RepresentationKind kind, const uint8_t *data, size_t bytes_used, uint32_t *out, size_t capacity)
+{
+    RT_TIME_PHASE(Decode);
+    UncompressChunk(kind, data, bytes_used);
+    size_t count = 0;
+    switch (kind)
+    {
+    case RepresentationKind::DirectLegacy:
+    case RepresentationKind::Direct:
+    {
+        if (bytes_used % sizeof(uint32_t) != 0)
+        {
+            throw "Bad number of bytes for direct-represented uint32_ts";
+        }
+        count = bytes_used / sizeof(uint32_t);
+        if (count > capacity)
+        {
+            throw "Chunk holds more values than fit";
+        }
+        std::memcpy(out, data, bytes_used);
+        break;
+    }
+    case RepresentationKind::RunLengthEncoded:
+    {
+        if (bytes_used % 5 != 0)
+        {
+            throw "Bad number of bytes for run-length-encoded uint32_ts";
+        }
+        for (size_t i = 0; i < bytes_used; i += 5)
+        {
+            if (data[i] > capacity - count)
+            {
+                throw "Chunk holds more values than fit";
+            }
+            std::fill_n(out + count, data[i], loadU32(data + i + 1));
+            count += data[i];
+        }
+        break;
+    }
+    case RepresentationKind::DictionaryOneByte:
+    {
+        if (bytes_used < sizeof(uint32_t))
+        {
+            throw "Missing dictionary size";
+        }
+        uint32_t dict_size = loadU32(data);
+        if (dict_size > 256 || bytes_used < sizeof(uint32_t) * (1 + size_t(dict_size)))
+        {
+            throw "Bad dictionary size";
+        }
+        uint32_t dictionary[256];
+        for (uint32_t i = 0; i < dict_size; i++)
+        {
+            dictionary[i] = loadU32(data + sizeof(uint32_t) * (1 + i));
+        }
+        const uint8_t *indices = data + sizeof(uint32_t) * (1 + size_t(dict_size));
+        count = bytes_used - sizeof(uint32_t) * (1 + size_t(dict_size));
+        if (count > capacity)
+        {
+            throw "Chunk holds more values than fit";
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            if (indices[i] >= dict_size)
+            {
+                throw "Dictionary index out of range";
+            }
+            out[i] = dictionary[indices[i]];
+        }
+        break;
+    }
+    case RepresentationKind::OneSByteDeltaEncoded:
+    {
+        if (bytes_used < sizeof(uint32_t))
+        {
+            throw "Missing first value of delta-encoded uint32_ts";
+        }
+        size_t num_deltas = bytes_used - sizeof(uint32_t);
+        count = 1 + num_deltas;
+        if (count > capacity)
+        {
+            throw "Chunk holds more values than fit";
+        }
+        ActiveDecodeKernels().decode_deltas(loadU32(data), reinterpret_cast<const int8_t *>(data + sizeof(uint32_t)), num_deltas, out);
+        break;
+    }
+    case RepresentationKind::Constant:
+    {
+        if (bytes_used != 2 * sizeof(uint32_t))
+        {
+            throw "Bad number of bytes for constant-represented uint32_ts";
+        }
+        count = loadU32(data);
+        if (count > capacity)
+        {
+            throw "Chunk holds more values than fit";
+        }
+        std::fill_n(out, count, loadU32(data + sizeof(uint32_t)));
+        break;
+    }
+    case RepresentationKind::BitPacked:
+    {
+        if (bytes_used < 2 * sizeof(uint32_t))
+        {
+            throw "Truncated bit-packed header";
+        }
+        size_t left = loadU32(data);
+        uint32_t num_chunks = loadU32(data + sizeof(uint32_t));
+        if (left > capacity)
+        {
+            throw "Chunk holds more values than fit";
+        }
+        size_t offset = 2 * sizeof(uint32_t);
+        for (uint32_t c = 0; c < num_chunks; c++)
+        {
+            size_t chunk = left < BIT_PACKING_CHUNK_SIZE ? left : BIT_PACKING_CHUNK_SIZE;
+            offset += unpackChunk(data + offset, bytes_used - offset, chunk, out + count);
+            count += chunk;
+            left -= chunk;
+        }
+        if (left != 0 || offset != bytes_used)
+        {
+            throw "Bad number of bytes for bit-packed uint32_ts";
+        }
+        break;
+    }
+    default:
+        throw "Unknown representation kind";
+    }
+    RT_COUNT_DECODED(kind, count);
+    return count;
+}
+
+bool CountNeedsData(RepresentationKind kind)
+{
+    // a block-compressed chunk's count comes from its header at least
+    return IsBlockCompressed(kind) || !(kind == RepresentationKind::DirectLegacy || kind == RepresentationKind::Direct || kind == RepresentationKind::OneSByteDeltaEncoded);
+}
+
+size_t CountColumnValues_uint32(RepresentationKind kind, const uint8_t *data, size_t bytes_used)
+{
+    if (IsBlockCompressed(kind))
+    {
+        // direct and delta chunks are counted from their uncompressed size, the others once uncompressed
+        RepresentationKind base = BaseRepresentation(kind);
+        if (!CountNeedsData(base))
+        {
+            return CountColumnValues_uint32(base, nullptr, UncompressedChunkSize(data, bytes_used));
+        }
+        UncompressChunk(kind, data, bytes_used);
+    }
+    switch (kind)
+    {
+    case RepresentationKind::DirectLegacy:
+    case RepresentationKind::Direct:
+        return bytes_used / sizeof(uint32_t);
+    case RepresentationKind::RunLengthEncoded:
+    {
+        size_t count = 0;
+        for (size_t i = 0; i + 5 <= bytes_used; i += 5)
+        {
+            count += data[i];
+        }
+        return count;
+    }
+    case RepresentationKind::DictionaryOneByte:
+    {
+        if (bytes_used < sizeof(uint32_t))
+        {
+            throw "Missing dictionary size";
+        }
+        size_t dictionary_bytes = sizeof(uint32_t) * (1 + size_t(loadU32(data)));
+        if (bytes_used < dictionary_bytes)
+        {
+            throw "Bad dictionary size";
+        }
+        return bytes_used - dictionary_bytes;
+    }
+    case RepresentationKind::OneSByteDeltaEncoded:
+        return bytes_used < sizeof(uint32_t) ? 0 : 1 + bytes_used - sizeof(uint32_t);
+    case RepresentationKind::Constant:
+    case RepresentationKind::BitPacked:
+        if (bytes_used < sizeof(uint32_t))
+        {
+            throw "Missing value count";
+        }
+        return loadU32(data);
+    default:
+        throw "Unknown representation kind";
+    }
+}
+
+std::vector<EncodingEstimate> EstimateEncodedSizes_uint32(const uint32_t *values, size_t count)
+{
+    std::vector<EncodingEstimate> estimates = {{RepresentationKind::Direct, count * sizeof(uint32_t)}};
+    if (count == 0)
+    {
+        return estimates;
+    }
+
+    // stretches of consecutive values, so runs and deltas show up as they are in the chunk
+    size_t num_windows = count <= ENCODING_SAMPLE_SIZE ? 1 : ENCODING_SAMPLE_WINDOWS;
+    size_t window = count <= ENCODING_SAMPLE_SIZE ? count : ENCODING_SAMPLE_SIZE / ENCODING_SAMPLE_WINDOWS;
+    size_t changes = 0;
+    uint32_t all_bits = 0;
+    bool constant = true, deltas_fit = true;
+
+    // distinct values in an open-addressing set, counted up to one more than a dictionary holds
+    uint32_t slots[1024];
+    bool used[1024] = {};
+    size_t num_distinct = 0;
+
+    for (size_t w = 0; w < num_windows; w++)
+    {
+        const uint32_t *v = values + (num_windows == 1 ? 0 : (count - window) * w / (num_windows - 1));
+        for (size_t i = 0; i < window; i++)
+        {
+            all_bits |= v[i];
+            constant = constant && v[i] == values[0];
+            if (i > 0)
+            {
+                changes += v[i] != v[i - 1];
+                int64_t difference = int64_t(v[i]) - int64_t(v[i - 1]);
+                deltas_fit = deltas_fit && difference >= -128 && difference <= 127;
+            }
+            if (num_distinct <= 256)
+            {
+                size_t slot = (v[i] * 0x9E3779B1u) >> 22;
+                while (used[slot] && slots[slot] != v[i])
+                {
+                    slot = (slot + 1) & 1023;
+                }
+                if (!used[slot])
+                {
+                    used[slot] = true;
+                    slots[slot] = v[i];
+                    num_distinct++;
+                }
+            }
+        }
+    }
+
+    // runs from the rate of changes between sampled neighbours, plus the splits when runs average over 255
+    size_t num_pairs = num_windows * (window - 1);
+    size_t runs = 1 + (num_pairs == 0 ? 0 : size_t(double(changes) / num_pairs * (count - 1)));
+    size_t splits = count / runs > 255 ? count / 255 : 0;
+    estimates.push_back({RepresentationKind::RunLengthEncoded, 5 * (runs + splits)});
+    if (constant)
+    {
+        estimates.push_back({RepresentationKind::Constant, 2 * sizeof(uint32_t)});
+    }
+    if (num_distinct <= 256)
+    {
+        estimates.push_back({RepresentationKind::DictionaryOneByte, sizeof(uint32_t) * (1 + num_distinct) + count});
+    }
+    if (deltas_fit)
+    {
+        estimates.push_back({RepresentationKind::OneSByteDeltaEncoded, sizeof(uint32_t) + count - 1});
+    }
+
+    // every chunk of the bit-packed layout at the sample's bit width
+    uint32_t bits = bitWidth(all_bits);
+    size_t values_per_pack = 32 / bits, packed_bytes = 2 * sizeof(uint32_t);
+    for (size_t start = 0; start < count; start += BIT_PACKING_CHUNK_SIZE)
+    {
+        size_t chunk = std::min<size_t>(BIT_PACKING_CHUNK_SIZE, count - start);
+        packed_bytes += 5 + sizeof(uint32_t) * ((chunk + values_per_pack - 1) / values_per_pack);
+    }
+    estimates.push_back({RepresentationKind::BitPacked, packed_bytes});
+
+    std::stable_sort(estimates.begin(), estimates.end(), [](const EncodingEstimate &a, const EncodingEstimate &b)
+                     { return a.bytes < b.bytes || (a.bytes == b.bytes && DecodeCost(a.kind) < DecodeCost(b.kind)); });
+    return estimates;
+}
+
+uint32_t DecodeCost(RepresentationKind kind)
+{
+    if (IsBlockCompressed(kind))
+    {
+        return DecodeCost(BaseRepresentation(kind)) + 2;
+    }
+    switch (kind)
+    {
+    case RepresentationKind::Constant:
+        return 0;
+    case RepresentationKind::DirectLegacy:
+    case RepresentationKind::Direct:
+    case RepresentationKind::OneSByteDeltaEncoded:
+        return 1;
+    case RepresentationKind::BitPacked:
+        return 2;
+    case RepresentationKind::RunLengthEncoded:
+    case RepresentationKind::DictionaryOneByte:
+        return 3;
+    default:
+        return 4;
+    }
+}
+
+RepresentationKind EncodeColumnAdaptive_uint32(const uint32_t *values, size_t count, double size_tolerance, std::vector<uint8_t> &out)
+{
+    std::vector<EncodingEstimate> candidates = EstimateEncodedSizes_uint32(values, count);
+
+    // the ones within the tolerance first, fastest to decode first; then the rest by size
+    double limit = double(candidates[0].bytes) * (1 + std::max(size_tolerance, 0.0));
+    auto beyond = std::stable_partition(candidates.begin(), candidates.end(), [limit](const EncodingEstimate &candidate)
+                                        { return double(candidate.bytes) <= limit; });
+    std::stable_sort(candidates.begin(), beyond, [](const EncodingEstimate &a, const EncodingEstimate &b)
+                     { return DecodeCost(a.kind) < DecodeCost(b.kind); });
+
+    size_t start = out.size();
+    for (const EncodingEstimate &candidate : candidates)
+    {
+        if (candidate.kind == RepresentationKind::Direct)
+        {
+            break;
+        }
+        if (EncodeColumn_uint32(values, count, candidate.kind, out))
+        {
+            if (out.size() - start <= count * sizeof(uint32_t))
+            {
+                return candidate.kind;
+            }
+            out.resize(start);
+        }
+    }
+    EncodeColumn_uint32(values, count, RepresentationKind::Direct, out);
+    return RepresentationKind::Direct;
+}
+
+bool EncodeBuffer(const std::vector<uint8_t> &data, char method, std::vector<uint8_t> &out)
+{
+    if (data.empty())
+    {
+        return false;
+    }
+
+    // coding.py reads the input as 4-byte little-endian integers for rle and bit
+    std::vector<uint32_t> integers;
+    for (size_t i = 0; i + 4 <= data.size(); i += 4)
+    {
+        integers.push_back(loadU32(&data[i]));
+    }
+
+    switch (method)
+    {
+    case 'C':
+    {
+        for (uint8_t byte : data)
+        {
+            if (byte != data[0])
+            {
+                return false;
+            }
+        }
+        appendU8(out, 'C');
+        appendU32(out, uint32_t(data.size()));
+        appendU8(out, data[0]);
+        return true;
+    }
+    case 'R':
+    {
+        // run_length_encoding zero-pads a trailing partial integer
+        if (data.size() % 4 != 0)
+        {
+            uint32_t value = 0;
+            for (size_t j = 0; j < data.size() % 4; j++)
+            {
+                value |= uint32_t(data[data.size() - data.size() % 4 + j]) << (j * 8);
+            }
+            integers.push_back(value);
+        }
+
+        std::vector<uint8_t> pairs;
+        uint32_t num_pairs = 0;
+        for (size_t i = 0; i < integers.size();)
+        {
+            size_t run = 1;
+            while (i + run < integers.size() && integers[i + run] == integers[i])
+            {
+                run++;
+            }
+            appendU32(pairs, uint32_t(run));
+            appendU32(pairs, integers[i]);
+            num_pairs++;
+            i += run;
+        }
+        appendU8(out, 'R');
+        appendU32(out, uint32_t(data.size()));
+        appendU32(out, num_pairs);
+        out.insert(out.end(), pairs.begin(), pairs.end());
+        return true;
+    }
+    case 'B':
+    {
+        size_t num_chunks = (integers.size() + BIT_PACKING_CHUNK_SIZE - 1) / BIT_PACKING_CHUNK_SIZE;
+        appendU8(out, 'B');
+        appendU32(out, uint32_t(data.size()));
+        appendU32(out, uint32_t(num_chunks));
+        for (size_t i = 0; i < integers.size(); i += BIT_PACKING_CHUNK_SIZE)
+        {
+            size_t chunk = integers.size() - i < BIT_PACKING_CHUNK_SIZE ? integers.size() - i : BIT_PACKING_CHUNK_SIZE;
+            packChunk(integers.data() + i, chunk, out);
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+void DecodeBuffer(const uint8_t *data, size_t size, std::vector<uint8_t> &out)
+{
+    if (size < 5)
+    {
+        throw "Truncated encoded buffer header";
+    }
+    char method = char(data[0]);
+    uint32_t original_length = loadU32(data + 1);
+
+    std::vector<uint32_t> integers;
+    switch (method)
+    {
+    case 'C':
+        if (size < 6)
+        {
+            throw "Missing constant value";
+        }
+        out.insert(out.end(), original_length, data[5]);
+        return;
+    case 'R':
+    {
+        if (size < 9)
+        {
+            throw "Missing number of RLE pairs";
+        }
+        uint32_t num_pairs = loadU32(data + 5);
+        if ((size - 9) / 8 < num_pairs)
+        {
+            throw "Truncated RLE pairs";
+        }
+        for (uint32_t i = 0; i < num_pairs; i++)
+        {
+            integers.insert(integers.end(), loadU32(data + 9 + 8 * i), loadU32(data + 13 + 8 * i));
+        }
+        break;
+    }
+    case 'B':
+    {
+        if (size < 9)
+        {
+            throw "Missing number of bit-packed chunks";
+        }
+        uint32_t num_chunks = loadU32(data + 5);
+        size_t count = original_length / 4;
+        size_t offset = 9;
+        for (uint32_t c = 0; c < num_chunks; c++)
+        {
+            size_t chunk = count < BIT_PACKING_CHUNK_SIZE ? count : BIT_PACKING_CHUNK_SIZE;
+            size_t start = integers.size();
+            integers.resize(start + chunk);
+            offset += unpackChunk(data + offset, size - offset, chunk, integers.data() + start);
+            count -= chunk;
+        }
+        break;
+    }
+    default:
+        throw "Unknown encoding type";
+    }
+
+    size_t start = out.size();
+    out.resize(start + integers.size() * sizeof(uint32_t));
+    std::memcpy(out.data() + start, integers.data(), integers.size() * sizeof(uint32_t));
+    out.resize(start + (original_length < integers.size() * sizeof(uint32_t) ? original_length : integers.size() * sizeof(uint32_t)));
+}
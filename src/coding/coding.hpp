@@ -0,0 +1,89 @@
+#ifndef _coding_h_
+#define _coding_h_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Representation of one column chunk in a row group. The values match REPRESENTATION_KINDS in
+// src/benchmarks/populate_tables.py; Constant and BitPacked are the Encoder schemes from coding.py.
+enum RepresentationKind : uint8_t
+{
+    DirectLegacy = 0, // written by the first C++ row group writer, read as Direct
+    Direct = 1,
+    RunLengthEncoded = 2,
+    DictionaryOneByte = 3,
+    OneSByteDeltaEncoded = 4,
+    Constant = 5,
+    BitPacked = 6,
+    Adaptive = 255, // never stored: asks a writer to pick each chunk's representation (EncodeColumnAdaptive_uint32)
+};
+
+// Number of values packed with one bit width, as INT_CHUNK_SIZE in bit_packing_encoding
+const uint32_t BIT_PACKING_CHUNK_SIZE = 1024;
+
+const char *RepresentationKindName(RepresentationKind kind);
+
+// Encode count values with the given representation and append the bytes to out.
+// Returns false and leaves out untouched when the values can't be represented that way
+// (the cases where try_compress returns None).
+//
+// Chunk layouts (all little-endian):
+//   Direct:               value[count] (4 bytes each)
+//   RunLengthEncoded:     (count: u8, value: 4 bytes)*, runs longer than 255 are split
+//   DictionaryOneByte:    dict_size: u32, value[dict_size], index[count] (u8 each)
+//   OneSByteDeltaEncoded: first value (4 bytes), then difference to the previous value (s8 each)
+//   Constant:             count: u32, value (4 bytes)
+//   BitPacked:            count: u32, num_chunks: u32, then per chunk of up to 1024 values
+//                         bits: u8, num_packed: u32, packed[num_packed] (u32 each)
+bool EncodeColumn_uint32(const uint32_t *values, size_t count, RepresentationKind kind, std::vector<uint8_t> &out);
+
+// Decode a chunk of bytes_used bytes and append the values to out. Throws on malformed input.
+void DecodeColumn_uint32(RepresentationKind kind, const uint8_t *data, size_t bytes_used, std::vector<uint32_t> &out);
+
+// Decode a chunk into a buffer of capacity values (e.g. a ColumnBatch column) and return how many
+// there were. Throws on malformed input and on chunks holding more than capacity values.
+size_t DecodeColumnInto_uint32(RepresentationKind kind, const uint8_t *data, size_t bytes_used, uint32_t *out, size_t capacity);
+
+// Number of values in a chunk without decoding it. Direct and delta chunks are counted from
+// bytes_used alone (data may then be nullptr); the others read their header or walk their runs.
+size_t CountColumnValues_uint32(RepresentationKind kind, const uint8_t *data, size_t bytes_used);
+
+// Whether CountColumnValues_uint32 needs the chunk's bytes for this representation
+bool CountNeedsData(RepresentationKind kind);
+
+// EstimateEncodedSizes_uint32 looks at every value of a chunk of up to ENCODING_SAMPLE_SIZE values, and
+// otherwise at ENCODING_SAMPLE_WINDOWS evenly spaced stretches of consecutive values adding up to that many
+const size_t ENCODING_SAMPLE_SIZE = 4096;
+const size_t ENCODING_SAMPLE_WINDOWS = 16;
+
+// Estimated size of a chunk in one representation
+struct EncodingEstimate
+{
+    RepresentationKind kind;
+    size_t bytes;
+};
+
+// Estimate the chunk size of every representation for count values from statistics of a sample of
+// them: value changes between neighbours (runs), distinct values, whether neighbours differ by a
+// signed byte, and the bit width. Representations the sample rules out are left out; Direct is always
+// there. Ordered smallest first, ties going to the faster representation to decode.
+std::vector<EncodingEstimate> EstimateEncodedSizes_uint32(const uint32_t *values, size_t count);
+
+// Rough cost of decoding one value of a representation, lower is faster (see bench_decode)
+uint32_t DecodeCost(RepresentationKind kind);
+
+// Encode count values in the representation with the smallest estimate or, among those estimated within
+// size_tolerance of it (0.1 = 10% bigger), the fastest to decode, and append the bytes to out. When the
+// sample misled the estimate (the chunk can't be encoded that way, or comes out bigger than Direct) the
+// next candidate is tried. Returns the representation used.
+RepresentationKind EncodeColumnAdaptive_uint32(const uint32_t *values, size_t count, double size_tolerance, std::vector<uint8_t> &out);
+
+// Whole-buffer encodings written by `coding.py encode`: method is 'C' (constant), 'R' (rle) or 'B' (bit).
+// The output starts with the method byte and the original length, exactly like the Python tool.
+bool EncodeBuffer(const std::vector<uint8_t> &data, char method, std::vector<uint8_t> &out);
+
+// Decode a buffer produced by EncodeBuffer or `coding.py encode`. Throws on malformed input.
+void DecodeBuffer(const uint8_t *data, size_t size, std::vector<uint8_t> &out);
+
+#endif
@@ -0,0 +1,259 @@
+#include "kernels.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNELS_X86 1
+#endif
+
+namespace
+{
+    inline uint32_t loadWord(const uint8_t *packed, size_t index)
+    {
+        uint32_t word;
+        std::memcpy(&word, packed + index * sizeof(uint32_t), sizeof(word));
+        return word;
+    }
+
+    // Unpack values [start, count) one at a time
+    void unpackTail(const uint8_t *packed, uint32_t bits, size_t start, size_t count, uint32_t *out)
+    {
+        uint32_t values_per_pack = 32 / bits;
+        uint32_t mask = (1u << bits) - 1;
+        size_t word_index = start / values_per_pack;
+        uint32_t slot = start % values_per_pack;
+        uint32_t word = loadWord(packed, word_index);
+        for (size_t i = start; i < count; i++)
+        {
+            out[i] = (word >> (slot * bits)) & mask;
+            if (++slot == values_per_pack && i + 1 < count)
+            {
+                slot = 0;
+                word = loadWord(packed, ++word_index);
+            }
+        }
+    }
+
+    void unpackBitsScalar(const uint8_t *packed, uint32_t bits, size_t count, uint32_t *out)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        if (bits == 32)
+        {
+            std::memcpy(out, packed, count * sizeof(uint32_t));
+            return;
+        }
+        unpackTail(packed, bits, 0, count, out);
+    }
+
+    void decodeDeltasScalar(uint32_t first, const int8_t *deltas, size_t num_deltas, uint32_t *out)
+    {
+        uint32_t value = first;
+        out[0] = value;
+        for (size_t i = 0; i < num_deltas; i++)
+        {
+            value += uint32_t(int32_t(deltas[i]));
+            out[i + 1] = value;
+        }
+    }
+
+#ifdef KERNELS_X86
+    // Where output lane k of a vector starting at phase p (position within a packed word) comes from:
+    // word (p + k) / values_per_pack relative to the current base word, shifted left so the value
+    // sits in the top bits, then shifted right by 32 - bits.
+    struct UnpackPattern
+    {
+        uint8_t shuffle4[16];   // byte shuffle for 4 lanes (SSSE3)
+        uint32_t multiply4[4];  // left shift as a multiply (SSE4.1 has no variable shift)
+        uint32_t permute8[8];   // word permutation for 8 lanes (AVX2)
+        uint32_t shift8[8];     // left shifts for 8 lanes (AVX2)
+        uint8_t advance4, next4; // base word advance and next phase after 4 lanes
+        uint8_t advance8, next8; // same after 8 lanes
+    };
+
+    struct UnpackPatterns
+    {
+        // first pattern of each bit width, phases 0 .. values_per_pack - 1 follow it
+        size_t offset[32];
+        std::vector<UnpackPattern> patterns;
+
+        UnpackPatterns()
+        {
+            for (uint32_t bits = 1; bits < 32; bits++)
+            {
+                uint32_t values_per_pack = 32 / bits;
+                offset[bits] = patterns.size();
+                for (uint32_t phase = 0; phase < values_per_pack; phase++)
+                {
+                    UnpackPattern pattern;
+                    for (uint32_t k = 0; k < 8; k++)
+                    {
+                        uint32_t word = (phase + k) / values_per_pack;
+                        uint32_t left_shift = 32 - bits - ((phase + k) % values_per_pack) * bits;
+                        if (k < 4)
+                        {
+                            for (uint32_t b = 0; b < 4; b++)
+                            {
+                                pattern.shuffle4[4 * k + b] = uint8_t(4 * word + b);
+                            }
+                            pattern.multiply4[k] = 1u << left_shift;
+                        }
+                        pattern.permute8[k] = word;
+                        pattern.shift8[k] = left_shift;
+                    }
+                    pattern.advance4 = uint8_t((phase + 4) / values_per_pack);
+                    pattern.next4 = uint8_t((phase + 4) % values_per_pack);
+                    pattern.advance8 = uint8_t((phase + 8) / values_per_pack);
+                    pattern.next8 = uint8_t((phase + 8) % values_per_pack);
+                    patterns.push_back(pattern);
+                }
+            }
+        }
+    };
+
+    const UnpackPatterns &unpackPatterns()
+    {
+        static const UnpackPatterns patterns;
+        return patterns;
+    }
+
+    __attribute__((target("sse4.1"))) void unpackBitsSSE4(const uint8_t *packed, uint32_t bits, size_t count, uint32_t *out)
+    {
+        if (bits == 32 || count == 0)
+        {
+            unpackBitsScalar(packed, bits, count, out);
+            return;
+        }
+
+        uint32_t values_per_pack = 32 / bits;
+        size_t num_words = (count + values_per_pack - 1) / values_per_pack;
+        const UnpackPattern *patterns = &unpackPatterns().patterns[unpackPatterns().offset[bits]];
+        const __m128i right_shift = _mm_cvtsi32_si128(32 - bits);
+
+        size_t i = 0, base = 0;
+        uint32_t phase = 0;
+        // a vector needs four readable words from base
+        while (i + 4 <= count && base + 4 <= num_words)
+        {
+            const UnpackPattern &pattern = patterns[phase];
+            __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i *>(packed + base * sizeof(uint32_t)));
+            __m128i lanes = _mm_shuffle_epi8(words, _mm_loadu_si128(reinterpret_cast<const __m128i *>(pattern.shuffle4)));
+            lanes = _mm_mullo_epi32(lanes, _mm_loadu_si128(reinterpret_cast<const __m128i *>(pattern.multiply4)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_srl_epi32(lanes, right_shift));
+            base += pattern.advance4;
+            phase = pattern.next4;
+            i += 4;
+        }
+        if (i < count)
+        {
+            unpackTail(packed, bits, i, count, out);
+        }
+    }
+
+    __attribute__((target("avx2"))) void unpackBitsAVX2(const uint8_t *packed, uint32_t bits, size_t count, uint32_t *out)
+    {
+        if (bits == 32 || count == 0)
+        {
+            unpackBitsScalar(packed, bits, count, out);
+            return;
+        }
+
+        uint32_t values_per_pack = 32 / bits;
+        size_t num_words = (count + values_per_pack - 1) / values_per_pack;
+        const UnpackPattern *patterns = &unpackPatterns().patterns[unpackPatterns().offset[bits]];
+        const __m128i right_shift = _mm_cvtsi32_si128(32 - bits);
+
+        size_t i = 0, base = 0;
+        uint32_t phase = 0;
+        // a vector needs eight readable words from base
+        while (i + 8 <= count && base + 8 <= num_words)
+        {
+            const UnpackPattern &pattern = patterns[phase];
+            __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(packed + base * sizeof(uint32_t)));
+            __m256i lanes = _mm256_permutevar8x32_epi32(words, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pattern.permute8)));
+            lanes = _mm256_sllv_epi32(lanes, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pattern.shift8)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_srl_epi32(lanes, right_shift));
+            base += pattern.advance8;
+            phase = pattern.next8;
+            i += 8;
+        }
+        if (i < count)
+        {
+            unpackTail(packed, bits, i, count, out);
+        }
+    }
+
+    __attribute__((target("sse4.1"))) void decodeDeltasSSE4(uint32_t first, const int8_t *deltas, size_t num_deltas, uint32_t *out)
+    {
+        out[0] = first;
+        __m128i carry = _mm_set1_epi32(int(first));
+        size_t i = 0;
+        for (; i + 4 <= num_deltas; i += 4)
+        {
+            int32_t four;
+            std::memcpy(&four, deltas + i, sizeof(four));
+            __m128i x = _mm_cvtepi8_epi32(_mm_cvtsi32_si128(four));
+            // in-register prefix sum over the 4 lanes
+            x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+            x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+            x = _mm_add_epi32(x, carry);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 1 + i), x);
+            carry = _mm_shuffle_epi32(x, 0xFF);
+        }
+        decodeDeltasScalar(out[i], deltas + i, num_deltas - i, out + i);
+    }
+
+    __attribute__((target("avx2"))) void decodeDeltasAVX2(uint32_t first, const int8_t *deltas, size_t num_deltas, uint32_t *out)
+    {
+        out[0] = first;
+        __m256i carry = _mm256_set1_epi32(int(first));
+        const __m256i last_lane = _mm256_set1_epi32(7);
+        size_t i = 0;
+        for (; i + 8 <= num_deltas; i += 8)
+        {
+            __m256i x = _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(deltas + i)));
+            // prefix sum inside each 128-bit half, then add the low half's total to the high half
+            x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+            x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+            __m256i low_total = _mm256_shuffle_epi32(x, 0xFF);
+            x = _mm256_add_epi32(x, _mm256_permute2x128_si256(low_total, low_total, 0x08));
+            x = _mm256_add_epi32(x, carry);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + 1 + i), x);
+            carry = _mm256_permutevar8x32_epi32(x, last_lane);
+        }
+        decodeDeltasScalar(out[i], deltas + i, num_deltas - i, out + i);
+    }
+#endif
+
+    const DecodeKernels scalar_kernels = {"scalar", unpackBitsScalar, decodeDeltasScalar};
+#ifdef KERNELS_X86
+    const DecodeKernels sse4_kernels = {"sse4.1", unpackBitsSSE4, decodeDeltasSSE4};
+    const DecodeKernels avx2_kernels = {"avx2", unpackBitsAVX2, decodeDeltasAVX2};
+#endif
+}
+
+const DecodeKernels &ActiveDecodeKernels()
+{
+    static const DecodeKernels &active = *AvailableDecodeKernels().back();
+    return active;
+}
+
+std::vector<const DecodeKernels *> AvailableDecodeKernels()
+{
+    std::vector<const DecodeKernels *> kernels = {&scalar_kernels};
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1"))
+    {
+        kernels.push_back(&sse4_kernels);
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        kernels.push_back(&avx2_kernels);
+    }
+#endif
+    return kernels;
+}
@@ -0,0 +1,28 @@
+#ifndef _kernels_h_
+#define _kernels_h_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Decode kernels for the hot representations. Every kernel set produces identical output;
+// the active one is picked once from the CPU features (AVX2, then SSE4.1, then scalar).
+struct DecodeKernels
+{
+    const char *name;
+
+    // Unpack count values of the given bit width (1 to 32) from packed little-endian words laid out
+    // like bit_packing_encoding: 32 / bits values per word, lowest bits first, none straddling two words.
+    void (*unpack_bits)(const uint8_t *packed, uint32_t bits, size_t count, uint32_t *out);
+
+    // Write first followed by the running sum of num_deltas signed byte differences (num_deltas + 1 values).
+    void (*decode_deltas)(uint32_t first, const int8_t *deltas, size_t num_deltas, uint32_t *out);
+};
+
+// Kernel set chosen by runtime CPU dispatch
+const DecodeKernels &ActiveDecodeKernels();
+
+// Every kernel set this CPU can run, scalar first (for benchmarks and tests)
+std::vector<const DecodeKernels *> AvailableDecodeKernels();
+
+#endif
@@ -0,0 +1,518 @@
+#include "predicate.hpp"
+#include "block_codec.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+namespace
+{
+    uint32_t loadU32(const uint8_t *data)
+    {
+        return uint32_t(data[0]) | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24);
+    }
+
+    float asFloat(uint32_t cell)
+    {
+        float value;
+        std::memcpy(&value, &cell, sizeof(value));
+        return value;
+    }
+
+    uint32_t floatBits(float value)
+    {
+        uint32_t cell;
+        std::memcpy(&cell, &value, sizeof(cell));
+        return cell;
+    }
+
+    // Call f with a matcher specialised for the predicate's op and type, so the loops over
+    // cells compile to straight comparisons
+    template <typename F>
+    void withMatcher(const Predicate &predicate, F f)
+    {
+        const std::vector<uint32_t> &v = predicate.values;
+        if (predicate.type == CellType::Uint32)
+        {
+            switch (predicate.op)
+            {
+            case PredicateOp::Equal:
+                return f([a = v[0]](uint32_t cell)
+                         { return cell == a; });
+            case PredicateOp::Less:
+                return f([a = v[0]](uint32_t cell)
+                         { return cell < a; });
+            case PredicateOp::Greater:
+                return f([a = v[0]](uint32_t cell)
+                         { return cell > a; });
+            case PredicateOp::Between:
+                return f([a = v[0], b = v[1]](uint32_t cell)
+                         { return cell >= a && cell <= b; });
+            case PredicateOp::In:
+                break;
+            }
+        }
+        else if (predicate.type == CellType::Int32)
+        {
+            switch (predicate.op)
+            {
+            case PredicateOp::Equal:
+                return f([a = v[0]](uint32_t cell)
+                         { return cell == a; });
+            case PredicateOp::Less:
+                return f([a = int32_t(v[0])](uint32_t cell)
+                         { return int32_t(cell) < a; });
+            case PredicateOp::Greater:
+                return f([a = int32_t(v[0])](uint32_t cell)
+                         { return int32_t(cell) > a; });
+            case PredicateOp::Between:
+                return f([a = int32_t(v[0]), b = int32_t(v[1])](uint32_t cell)
+                         { return int32_t(cell) >= a && int32_t(cell) <= b; });
+            case PredicateOp::In:
+                break;
+            }
+        }
+        else
+        {
+            switch (predicate.op)
+            {
+            case PredicateOp::Equal:
+                return f([a = asFloat(v[0])](uint32_t cell)
+                         { return asFloat(cell) == a; });
+            case PredicateOp::Less:
+                return f([a = asFloat(v[0])](uint32_t cell)
+                         { return asFloat(cell) < a; });
+            case PredicateOp::Greater:
+                return f([a = asFloat(v[0])](uint32_t cell)
+                         { return asFloat(cell) > a; });
+            case PredicateOp::Between:
+                return f([a = asFloat(v[0]), b = asFloat(v[1])](uint32_t cell)
+                         { float x = asFloat(cell); return x >= a && x <= b; });
+            case PredicateOp::In:
+                break;
+            }
+        }
+        f([&predicate](uint32_t cell)
+          { return predicate.matches(cell); });
+    }
+
+    template <typename Cell, typename Match>
+    void selectCells(const Cell *cells, size_t count, size_t stride, size_t first_row, SelectionBitmap &selection, Match match)
+    {
+        if (first_row + count > selection.size())
+        {
+            throw "Rows past the end of the selection";
+        }
+        QueryVector<uint64_t> &words = selection.words();
+        size_t i = 0;
+        // single bits up to a word boundary, then whole words built without branches
+        for (; i < count && (first_row + i) % 64 != 0; i++)
+        {
+            if (match(cells[i * stride]))
+            {
+                selection.set(first_row + i);
+            }
+        }
+        for (; i + 64 <= count; i += 64)
+        {
+            uint64_t word = 0;
+            const Cell *block = cells + i * stride;
+            for (size_t j = 0; j < 64; j++)
+            {
+                word |= uint64_t(match(block[j * stride])) << j;
+            }
+            words[(first_row + i) / 64] |= word;
+        }
+        for (; i < count; i++)
+        {
+            if (match(cells[i * stride]))
+            {
+                selection.set(first_row + i);
+            }
+        }
+    }
+}
+
+bool Predicate::matches(uint32_t cell) const
+{
+    if (type == CellType::Uint32)
+    {
+        switch (op)
+        {
+        case PredicateOp::Equal:
+            return cell == values[0];
+        case PredicateOp::Less:
+            return cell < values[0];
+        case PredicateOp::Greater:
+            return cell > values[0];
+        case PredicateOp::Between:
+            return cell >= values[0] && cell <= values[1];
+        case PredicateOp::In:
+            return std::find(values.begin(), values.end(), cell) != values.end();
+        }
+        return false;
+    }
+    if (type == CellType::Int32)
+    {
+        int32_t x = int32_t(cell);
+        switch (op)
+        {
+        case PredicateOp::Equal:
+            return cell == values[0];
+        case PredicateOp::Less:
+            return x < int32_t(values[0]);
+        case PredicateOp::Greater:
+            return x > int32_t(values[0]);
+        case PredicateOp::Between:
+            return x >= int32_t(values[0]) && x <= int32_t(values[1]);
+        case PredicateOp::In:
+            return std::find(values.begin(), values.end(), cell) != values.end();
+        }
+        return false;
+    }
+
+    float x = asFloat(cell);
+    switch (op)
+    {
+    case PredicateOp::Equal:
+        return x == asFloat(values[0]);
+    case PredicateOp::Less:
+        return x < asFloat(values[0]);
+    case PredicateOp::Greater:
+        return x > asFloat(values[0]);
+    case PredicateOp::Between:
+        return x >= asFloat(values[0]) && x <= asFloat(values[1]);
+    case PredicateOp::In:
+        for (uint32_t value : values)
+        {
+            if (x == asFloat(value))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+    return false;
+}
+
+bool Predicate::bounds_uint32(uint32_t &low, uint32_t &high) const
+{
+    switch (op)
+    {
+    case PredicateOp::Equal:
+        low = high = values[0];
+        return true;
+    case PredicateOp::Less:
+        low = 0;
+        high = values[0] - 1;
+        return values[0] != 0;
+    case PredicateOp::Greater:
+        low = values[0] + 1;
+        high = std::numeric_limits<uint32_t>::max();
+        return values[0] != std::numeric_limits<uint32_t>::max();
+    case PredicateOp::Between:
+        low = values[0];
+        high = values[1];
+        return low <= high;
+    case PredicateOp::In:
+        if (values.empty())
+        {
+            return false;
+        }
+        low = *std::min_element(values.begin(), values.end());
+        high = *std::max_element(values.begin(), values.end());
+        return true;
+    }
+    return false;
+}
+
+bool Predicate::bounds_int32(int32_t &low, int32_t &high) const
+{
+    const int32_t smallest = std::numeric_limits<int32_t>::min(), largest = std::numeric_limits<int32_t>::max();
+    switch (op)
+    {
+    case PredicateOp::Equal:
+        low = high = int32_t(values[0]);
+        return true;
+    case PredicateOp::Less:
+        low = smallest;
+        high = int32_t(values[0]) - (int32_t(values[0]) != smallest);
+        return int32_t(values[0]) != smallest;
+    case PredicateOp::Greater:
+        low = int32_t(values[0]) + (int32_t(values[0]) != largest);
+        high = largest;
+        return int32_t(values[0]) != largest;
+    case PredicateOp::Between:
+        low = int32_t(values[0]);
+        high = int32_t(values[1]);
+        return low <= high;
+    case PredicateOp::In:
+        if (values.empty())
+        {
+            return false;
+        }
+        low = largest;
+        high = smallest;
+        for (uint32_t value : values)
+        {
+            low = std::min(low, int32_t(value));
+            high = std::max(high, int32_t(value));
+        }
+        return true;
+    }
+    return false;
+}
+
+bool Predicate::bounds_float(float &low, float &high) const
+{
+    const float infinity = std::numeric_limits<float>::infinity();
+    switch (op)
+    {
+    case PredicateOp::Equal:
+        low = high = asFloat(values[0]);
+        break;
+    case PredicateOp::Less:
+        low = -infinity;
+        high = asFloat(values[0]);
+        break;
+    case PredicateOp::Greater:
+        low = asFloat(values[0]);
+        high = infinity;
+        break;
+    case PredicateOp::Between:
+        low = asFloat(values[0]);
+        high = asFloat(values[1]);
+        break;
+    case PredicateOp::In:
+        low = infinity;
+        high = -infinity;
+        for (uint32_t value : values)
+        {
+            low = std::min(low, asFloat(value));
+            high = std::max(high, asFloat(value));
+        }
+        break;
+    }
+    // false for NaN bounds too
+    return low <= high;
+}
+
+bool ParsePredicate(const std::string &text, CellType type, Predicate &predicate)
+{
+    std::string normalized = text;
+    std::replace(normalized.begin(), normalized.end(), ',', ' ');
+    std::istringstream stream(normalized);
+
+    std::string op;
+    if (!(stream >> predicate.column >> op))
+    {
+        return false;
+    }
+    std::transform(op.begin(), op.end(), op.begin(), ::tolower);
+
+    predicate.type = type;
+    predicate.values.clear();
+    std::string value;
+    while (stream >> value)
+    {
+        try
+        {
+            if (type == CellType::Int32)
+            {
+                long number = std::stol(value);
+                if (number < std::numeric_limits<int32_t>::min() || number > std::numeric_limits<int32_t>::max())
+                {
+                    return false;
+                }
+                predicate.values.push_back(uint32_t(int32_t(number)));
+            }
+            else
+            {
+                predicate.values.push_back(type == CellType::Uint32 ? uint32_t(std::stoul(value)) : floatBits(std::stof(value)));
+            }
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+    }
+
+    size_t num_values = predicate.values.size();
+    if (op == "=" || op == "==")
+    {
+        predicate.op = PredicateOp::Equal;
+        return num_values == 1;
+    }
+    if (op == "<")
+    {
+        predicate.op = PredicateOp::Less;
+        return num_values == 1;
+    }
+    if (op == ">")
+    {
+        predicate.op = PredicateOp::Greater;
+        return num_values == 1;
+    }
+    if (op == "between")
+    {
+        predicate.op = PredicateOp::Between;
+        return num_values == 2;
+    }
+    if (op == "in")
+    {
+        predicate.op = PredicateOp::In;
+        return num_values >= 1;
+    }
+    return false;
+}
+
+SelectionBitmap::SelectionBitmap(size_t num_rows) : num_rows_(num_rows), words_((num_rows + 63) / 64, 0) {}
+
+void SelectionBitmap::reset(size_t num_rows)
+{
+    num_rows_ = num_rows;
+    words_.assign((num_rows + 63) / 64, 0);
+}
+
+void SelectionBitmap::setRange(size_t begin, size_t end)
+{
+    if (begin >= end)
+    {
+        return;
+    }
+    if (end > num_rows_)
+    {
+        throw "Rows past the end of the selection";
+    }
+    size_t first_word = begin / 64, last_word = (end - 1) / 64;
+    uint64_t first_mask = ~0ull << (begin % 64);
+    uint64_t last_mask = ~0ull >> (63 - (end - 1) % 64);
+    if (first_word == last_word)
+    {
+        words_[first_word] |= first_mask & last_mask;
+        return;
+    }
+    words_[first_word] |= first_mask;
+    std::fill(words_.begin() + first_word + 1, words_.begin() + last_word, ~0ull);
+    words_[last_word] |= last_mask;
+}
+
+void SelectionBitmap::intersect(const SelectionBitmap &other)
+{
+    for (size_t i = 0; i < words_.size(); i++)
+    {
+        words_[i] &= i < other.words_.size() ? other.words_[i] : 0;
+    }
+}
+
+void SelectionBitmap::merge(const SelectionBitmap &other, size_t first_row)
+{
+    if (first_row + other.num_rows_ > num_rows_)
+    {
+        throw "Rows past the end of the selection";
+    }
+    if (first_row % 64 == 0)
+    {
+        for (size_t i = 0; i < other.words_.size(); i++)
+        {
+            words_[first_row / 64 + i] |= other.words_[i];
+        }
+        return;
+    }
+    for (size_t i = 0; i < other.words_.size(); i++)
+    {
+        for (uint64_t word = other.words_[i]; word != 0; word &= word - 1)
+        {
+            set(first_row + i * 64 + __builtin_ctzll(word));
+        }
+    }
+}
+
+size_t SelectionBitmap::count() const
+{
+    size_t selected = 0;
+    for (uint64_t word : words_)
+    {
+        selected += __builtin_popcountll(word);
+    }
+    return selected;
+}
+
+void EvaluatePredicate(const Predicate &predicate, const uint32_t *cells, size_t count, size_t stride, size_t first_row, SelectionBitmap &selection)
+{
+    withMatcher(predicate, [&](auto match)
+                { selectCells(cells, count, stride, first_row, selection, match); });
+}
+
+void EvaluatePredicate_uint32(const Predicate &predicate, RepresentationKind kind, const uint8_t *data, size_t bytes_used,
+                              size_t first_row, size_t num_rows, SelectionBitmap &selection, PooledBuffer<uint32_t> &scratch)
+{
+    UncompressChunk(kind, data, bytes_used);
+    // the runs and the constant's count come from the chunk, so they are checked before any bit is set
+    if (CountColumnValues_uint32(kind, data, bytes_used) != num_rows)
+    {
+        throw "Columns have different row counts";
+    }
+    switch (kind)
+    {
+    case RepresentationKind::RunLengthEncoded:
+    {
+        if (bytes_used % 5 != 0)
+        {
+            throw "Bad number of bytes for run-length-encoded uint32_ts";
+        }
+        size_t row = first_row;
+        for (size_t i = 0; i < bytes_used; i += 5)
+        {
+            if (predicate.matches(loadU32(data + i + 1)))
+            {
+                selection.setRange(row, row + data[i]);
+            }
+            row += data[i];
+        }
+        return;
+    }
+    case RepresentationKind::Constant:
+    {
+        if (bytes_used != 2 * sizeof(uint32_t))
+        {
+            throw "Bad number of bytes for constant-represented uint32_ts";
+        }
+        if (predicate.matches(loadU32(data + sizeof(uint32_t))))
+        {
+            selection.setRange(first_row, first_row + loadU32(data));
+        }
+        return;
+    }
+    case RepresentationKind::DictionaryOneByte:
+    {
+        if (bytes_used < sizeof(uint32_t))
+        {
+            throw "Missing dictionary size";
+        }
+        uint32_t dict_size = loadU32(data);
+        if (dict_size > 256 || bytes_used < sizeof(uint32_t) * (1 + size_t(dict_size)))
+        {
+            throw "Bad dictionary size";
+        }
+        // one evaluation per entry; out-of-range indices select nothing
+        uint8_t entry_matches[256] = {};
+        for (uint32_t i = 0; i < dict_size; i++)
+        {
+            entry_matches[i] = predicate.matches(loadU32(data + sizeof(uint32_t) * (1 + i)));
+        }
+        const uint8_t *indices = data + sizeof(uint32_t) * (1 + size_t(dict_size));
+        size_t count = bytes_used - sizeof(uint32_t) * (1 + size_t(dict_size));
+        selectCells(indices, count, 1, first_row, selection, [&entry_matches](uint8_t index)
+                    { return entry_matches[index] != 0; });
+        return;
+    }
+    default:
+        scratch.resize(num_rows);
+        DecodeColumnInto_uint32(kind, data, bytes_used, scratch.data(), num_rows);
+        EvaluatePredicate(predicate, scratch.data(), num_rows, 1, first_row, selection);
+        return;
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef _predicate_h_
+#define _predicate_h_
+
+#include "coding.hpp"
+#include "../rt/query_memory.hpp"
+
+#include <string>
+
+// Comparison a predicate makes
+enum class PredicateOp
+{
+    Equal,
+    Less,
+    Greater,
+    Between,
+    In,
+};
+
+// How a predicate reads the 32-bit cells it compares
+enum class CellType
+{
+    Uint32,
+    Float,
+    Int32,
+};
+
+// A condition on one column: cell = v, cell < v, cell > v, low <= cell <= high or cell IN (v1, v2, ...).
+// Values are kept as cell bit patterns; as floats, NaN matches nothing.
+struct Predicate
+{
+    uint32_t column;
+    PredicateOp op;
+    CellType type;
+    std::vector<uint32_t> values;
+
+    bool matches(uint32_t cell) const;
+
+    // Smallest range holding every cell that may match, for zone maps; false when nothing can match
+    bool bounds_uint32(uint32_t &low, uint32_t &high) const;
+    bool bounds_int32(int32_t &low, int32_t &high) const;
+    bool bounds_float(float &low, float &high) const;
+};
+
+// Parse "<column> <op> <value> [<value> ...]" with op one of = < > between in, e.g. "2 between 10 20" or "1 in 1,3"
+bool ParsePredicate(const std::string &text, CellType type, Predicate &predicate);
+
+// One bit per row, set for the selected rows; the words come from the query memory (see QueryAllocator)
+class SelectionBitmap
+{
+public:
+    explicit SelectionBitmap(size_t num_rows = 0);
+
+    size_t size() const { return num_rows_; }
+    // Clear and resize to num_rows rows, keeping the words allocated so far
+    void reset(size_t num_rows);
+    bool test(size_t row) const { return (words_[row / 64] >> (row % 64)) & 1; }
+    void set(size_t row) { words_[row / 64] |= 1ull << (row % 64); }
+
+    // Select rows [begin, end); throws when end is past size()
+    void setRange(size_t begin, size_t end);
+
+    // Keep only rows selected in both
+    void intersect(const SelectionBitmap &other);
+
+    // Select the rows selected in other, shifted by first_row; throws when they run past size()
+    void merge(const SelectionBitmap &other, size_t first_row);
+
+    size_t count() const;
+
+    // 64 rows per word, the unused bits of the last word clear
+    QueryVector<uint64_t> &words() { return words_; }
+    const QueryVector<uint64_t> &words() const { return words_; }
+
+private:
+    size_t num_rows_;
+    QueryVector<uint64_t> words_;
+};
+
+// Select the rows first_row, first_row + 1, ... whose cell in an encoded chunk of num_rows values matches.
+// Dictionary chunks evaluate the predicate once per entry and then look up the index bytes, run-length
+// chunks once per run and constant chunks once; the others are decoded into scratch first. Throws on
+// malformed input, on a chunk not holding num_rows values and on rows past the end of the selection.
+void EvaluatePredicate_uint32(const Predicate &predicate, RepresentationKind kind, const uint8_t *data, size_t bytes_used,
+                              size_t first_row, size_t num_rows, SelectionBitmap &selection, PooledBuffer<uint32_t> &scratch);
+
+// Same over count plain cells, every stride-th one from cells (a column of a row-major table); throws on rows past the end of the selection
+void EvaluatePredicate(const Predicate &predicate, const uint32_t *cells, size_t count, size_t stride, size_t first_row, SelectionBitmap &selection);
+
+#endif
@@ -1,107 +1,1540 @@
+#include "columnar_rt.hpp"
+#include "row_group_pipeline.hpp"
+#include "../rt/instrumentation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <limits>
 #include <string>
 #include <fstream>
 #include <vector>
 using std::vector;
 
-enum RepresentationKind : uint8_t
+namespace
 {
-    Direct = 0,
-};
+    const char INDEX_MAGIC[4] = {'R', 'T', 'I', 'X'};
+
+    // Bytes per column and per row group in the index, and of the trailer after it
+    const size_t INDEX_COLUMN_BYTES = sizeof(uint8_t) + 5 * sizeof(uint32_t);
+    const size_t INDEX_GROUP_BYTES = sizeof(uint64_t) + sizeof(uint32_t);
+    const size_t INDEX_TRAILER_BYTES = 2 * sizeof(uint32_t) + sizeof(INDEX_MAGIC);
+
+    template <typename T>
+    void put(std::ostream &file, const T &value)
+    {
+        RT_COUNT_WRITE(sizeof(value));
+        file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    T take(const uint8_t *&data)
+    {
+        T value;
+        std::memcpy(&value, data, sizeof(value));
+        data += sizeof(value);
+        return value;
+    }
+}
 
 // Create a new table with the given column metadata
 bool MakeColumnarRelationalTable(const std::string &file_name, const uint32_t num_columns)
 {
     // We don't need to specify the type of our columns since we support only integers and floats, both 32 bits.
-    std::ofstream file(file_name, std::ios::binary | std::ios::in | std::ios::out);
+    RT_COUNT(FileOpens);
+    std::ofstream file(file_name, std::ios::binary | std::ios::out | std::ios::trunc);
     if (!file.is_open())
     {
         return false;
     }
 
+    // Same header order as create_and_populate_table
     uint32_t num_entries = 0;
-    file.write(reinterpret_cast<const char *>(&num_columns), sizeof(num_columns));
+    RT_COUNT_WRITE(sizeof(num_entries));
     file.write(reinterpret_cast<const char *>(&num_entries), sizeof(num_entries));
+    RT_COUNT_WRITE(sizeof(num_columns));
+    file.write(reinterpret_cast<const char *>(&num_columns), sizeof(num_columns));
     file.close();
     return true;
 }
 
-// The eventual generalization of this will be a WriteRowGroup_uint32 that takes another parameter specifying what
-// encoding to use for each column.
-void WriteRowGroupUncompressed_uint32(std::ofstream &file, const vector<vector<uint32_t>> rows)
+bool ReadColumnarMetadata(std::ifstream &file, TableHeader &header)
 {
-    size_t num_entries = rows.size();
-    size_t num_columns = rows.at(0).size();
-    for (size_t i = 0; i < num_columns; i++)
+    if (!ReadTableHeader(file, header))
+    {
+        return false;
+    }
+    RT_COUNT(Seeks);
+    file.seekg(header.data_offset);
+    return bool(file);
+}
+
+RepresentationKind EncodeColumnChunk_uint32(const vector<uint32_t> &values, RepresentationKind preferred_representation, double size_tolerance, vector<uint8_t> &bytes,
+                                            const BlockCompression &block_compression)
+{
+    RT_TIME_PHASE(Encode);
+    RepresentationKind kind = preferred_representation;
+    if (preferred_representation == RepresentationKind::Adaptive)
+    {
+        kind = EncodeColumnAdaptive_uint32(values.data(), values.size(), size_tolerance, bytes);
+    }
+    else if (!EncodeColumn_uint32(values.data(), values.size(), preferred_representation, bytes))
+    {
+        bytes.clear();
+        EncodeColumn_uint32(values.data(), values.size(), RepresentationKind::Direct, bytes);
+        kind = RepresentationKind::Direct;
+    }
+    CompressChunk(block_compression, kind, bytes);
+    return kind;
+}
+
+void WriteEncodedRowGroup(std::ostream &file, const RowGroupInfo &info, const vector<vector<uint8_t>> &chunks)
+{
+    for (size_t c = 0; c < chunks.size(); c++)
+    {
+        RT_COUNT_WRITE(sizeof(info.representations[c]));
+        file.write(reinterpret_cast<const char *>(&info.representations[c]), sizeof(info.representations[c]));
+        RT_COUNT_WRITE(sizeof(info.bytes_used[c]));
+        file.write(reinterpret_cast<const char *>(&info.bytes_used[c]), sizeof(info.bytes_used[c]));
+    }
+    for (size_t c = 0; c < chunks.size(); c++)
+    {
+        RT_COUNT_WRITE(chunks[c].size());
+        file.write(reinterpret_cast<const char *>(chunks[c].data()), chunks[c].size());
+    }
+}
+
+RowGroupInfo WriteRowGroupColumns_uint32(std::ostream &file, const vector<vector<uint32_t>> &columns, const vector<RepresentationKind> &preferred_representations, double size_tolerance,
+                                         const vector<BlockCompression> &block_compression)
+{
+    size_t num_columns = columns.size();
+    if (preferred_representations.size() != num_columns)
+    {
+        throw "Need one preferred representation per column";
+    }
+    if (!block_compression.empty() && block_compression.size() != num_columns)
     {
-        const RepresentationKind columnRepresentation = RepresentationKind::Direct;
-        // In the generalized version we will need to encode the column's values before we know
-        // how many bytes it takes up - e.g. for run-length encoding.
-        const uint32_t bytes_used = num_entries * sizeof(uint32_t);
-        file.write(reinterpret_cast<const char *>(&columnRepresentation), sizeof(columnRepresentation));
-        file.write(reinterpret_cast<const char *>(&bytes_used), sizeof(bytes_used));
+        throw "Need block compression for every column or none";
     }
-    for (size_t column = 0; column < num_columns; column++)
+
+    RowGroupInfo info = {0, 0, num_columns == 0 ? 0 : uint32_t(columns[0].size()), {}, {}, {}, {}, {}, {}};
+    info.representations.resize(num_columns);
+    info.bytes_used.resize(num_columns);
+    vector<vector<uint8_t>> columnBytes(num_columns);
+    for (size_t c = 0; c < num_columns; c++)
+    {
+        info.representations[c] = EncodeColumnChunk_uint32(columns[c], preferred_representations[c], size_tolerance, columnBytes[c],
+                                                           block_compression.empty() ? BlockCompression{} : block_compression[c]);
+        info.bytes_used[c] = columnBytes[c].size();
+    }
+    ComputeZoneMaps(columns, info);
+
+    WriteEncodedRowGroup(file, info, columnBytes);
+    return info;
+}
+
+void WriteRowGroup_uint32(std::ofstream &file, const vector<vector<uint32_t>> &rows, const vector<RepresentationKind> &preferred_representations, double size_tolerance)
+{
+    size_t num_entries = rows.size();
+    size_t num_columns = rows.at(0).size();
+    vector<vector<uint32_t>> columns(num_columns, vector<uint32_t>(num_entries));
+    for (size_t row = 0; row < num_entries; row++)
     {
-        for (const vector<uint32_t> &row : rows)
+        for (size_t c = 0; c < num_columns; c++)
         {
-            file.write(reinterpret_cast<const char *>(&row[column]), sizeof(row[column]));
+            columns[c][row] = rows[row].at(c);
         }
     }
+    WriteRowGroupColumns_uint32(file, columns, preferred_representations, size_tolerance);
+}
+
+void WriteRowGroupUncompressed_uint32(std::ofstream &file, const vector<vector<uint32_t>> rows)
+{
+    WriteRowGroup_uint32(file, rows, vector<RepresentationKind>(rows.at(0).size(), RepresentationKind::Direct));
 }
 
 vector<vector<uint32_t>> ReadRowGroup_uint32(std::ifstream &file, const uint32_t num_columns)
 {
-    char buffer[4];
-    vector<RepresentationKind> columnRepresentations;
-    vector<uint32_t> bytesUsed;
-    for (uint32_t i = 0; i < num_columns; i++)
+    RowGroupInfo info;
+    if (!ReadRowGroupHeader(file, num_columns, info))
+    {
+        throw "Truncated row group header";
+    }
+
+    // the chunks are contiguous: read them with one call and decode them into one batch
+    size_t group_bytes = 0;
+    for (uint32_t bytes : info.bytes_used)
     {
-        file.read(buffer, sizeof(RepresentationKind));
-        columnRepresentations.push_back(*reinterpret_cast<RepresentationKind *>(&buffer));
-        file.read(buffer, sizeof(uint32_t));
-        bytesUsed.push_back(*reinterpret_cast<uint32_t *>(&buffer));
+        group_bytes += bytes;
+    }
+    PooledBuffer<uint8_t> bytes(group_bytes);
+    RT_COUNT_READ(bytes.size());
+    file.read(reinterpret_cast<char *>(bytes.data()), bytes.size());
+    if (!file)
+    {
+        throw "Truncated column chunk";
     }
 
-    vector<vector<uint32_t>> columnData;
+    size_t num_rows = num_columns == 0 ? 0 : CountColumnValues_uint32(info.representations[0], bytes.data(), info.bytes_used[0]);
+    ColumnBatch columns(num_columns, num_rows);
+    size_t chunk_offset = 0;
     for (uint32_t column = 0; column < num_columns; column++)
     {
-        vector<uint32_t> thisColumn;
-        switch (columnRepresentations[column])
+        if (DecodeColumnInto_uint32(info.representations[column], bytes.data() + chunk_offset, info.bytes_used[column], columns.column(column), num_rows) != num_rows)
         {
-        case RepresentationKind::Direct:
-            if (bytesUsed[column] % sizeof(uint32_t) != 0)
-            {
-                throw "Bad number of bytes for direct-represented uint32_ts";
-            }
-            for (uint32_t i = 0; i < bytesUsed[column]; i += sizeof(uint32_t))
+            throw "Columns have different row counts";
+        }
+        chunk_offset += info.bytes_used[column];
+    }
+
+    vector<vector<uint32_t>> rowData(num_rows, vector<uint32_t>(num_columns));
+    for (size_t row = 0; row < num_rows; row++)
+    {
+        for (uint32_t column = 0; column < num_columns; column++)
+        {
+            rowData[row][column] = columns.column(column)[row];
+        }
+    }
+    return rowData;
+}
+
+uint64_t RowGroupInfo::endOffset() const
+{
+    uint64_t end = dataOffset();
+    for (uint32_t bytes : bytes_used)
+    {
+        end += bytes;
+    }
+    return end;
+}
+
+bool RowGroupInfo::mayContain_uint32(uint32_t column, uint32_t low, uint32_t high) const
+{
+    return !hasZoneMaps() || (min_values[column] <= high && low <= max_values[column]);
+}
+
+bool RowGroupInfo::mayContain_int32(uint32_t column, int32_t low, int32_t high) const
+{
+    int32_t min_value, max_value;
+    return !range_int32(column, min_value, max_value) || (min_value <= high && low <= max_value);
+}
+
+bool RowGroupInfo::range_int32(uint32_t column, int32_t &low, int32_t &high) const
+{
+    if (!hasZoneMaps() || ((min_values[column] ^ max_values[column]) & 0x80000000u) != 0)
+    {
+        return false;
+    }
+    low = int32_t(min_values[column]);
+    high = int32_t(max_values[column]);
+    return true;
+}
+
+bool RowGroupInfo::mayContain_float(uint32_t column, float low, float high) const
+{
+    return !hasZoneMaps() || (min_floats[column] <= high && low <= max_floats[column]);
+}
+
+void ComputeZoneMaps(const vector<vector<uint32_t>> &columns, RowGroupInfo &info)
+{
+    size_t num_columns = columns.size();
+    info.min_values.resize(num_columns);
+    info.max_values.resize(num_columns);
+    info.min_floats.resize(num_columns);
+    info.max_floats.resize(num_columns);
+    for (size_t c = 0; c < num_columns; c++)
+    {
+        ComputeColumnZoneMap(columns[c], c, info);
+    }
+}
+
+void ComputeColumnZoneMap(const vector<uint32_t> &values, size_t column, RowGroupInfo &info)
+{
+    uint32_t min_value = std::numeric_limits<uint32_t>::max(), max_value = 0;
+    float min_float = std::numeric_limits<float>::infinity(), max_float = -std::numeric_limits<float>::infinity();
+    for (uint32_t value : values)
+    {
+        min_value = std::min(min_value, value);
+        max_value = std::max(max_value, value);
+        float f;
+        std::memcpy(&f, &value, sizeof(f));
+        // comparisons with NaN are false, so NaNs leave both alone
+        min_float = f < min_float ? f : min_float;
+        max_float = f > max_float ? f : max_float;
+    }
+    info.min_values[column] = min_value;
+    info.max_values[column] = max_value;
+    info.min_floats[column] = min_float;
+    info.max_floats[column] = max_float;
+}
+
+void WriteColumnarFooter(std::ostream &file, const vector<RowGroupInfo> &row_groups)
+{
+    uint32_t index_bytes = 0;
+    for (const RowGroupInfo &info : row_groups)
+    {
+        if (!info.hasZoneMaps())
+        {
+            throw "Row group without zone maps";
+        }
+        put(file, info.offset);
+        put(file, info.num_rows);
+        for (size_t c = 0; c < info.representations.size(); c++)
+        {
+            put(file, info.representations[c]);
+            put(file, info.bytes_used[c]);
+            put(file, info.min_values[c]);
+            put(file, info.max_values[c]);
+            put(file, info.min_floats[c]);
+            put(file, info.max_floats[c]);
+        }
+        index_bytes += INDEX_GROUP_BYTES + info.representations.size() * INDEX_COLUMN_BYTES;
+    }
+    put(file, uint32_t(row_groups.size()));
+    put(file, index_bytes);
+    RT_COUNT_WRITE(sizeof(INDEX_MAGIC));
+    file.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+}
+
+bool ReadColumnarFooter(std::istream &file, uint64_t file_size, uint64_t data_offset, const uint32_t num_columns, vector<RowGroupInfo> &row_groups)
+{
+    if (file_size < data_offset + INDEX_TRAILER_BYTES)
+    {
+        return false;
+    }
+
+    uint8_t trailer[INDEX_TRAILER_BYTES];
+    RT_COUNT(Seeks);
+    file.seekg(file_size - INDEX_TRAILER_BYTES);
+    RT_COUNT_READ(sizeof(trailer));
+    file.read(reinterpret_cast<char *>(trailer), sizeof(trailer));
+    if (!file || std::memcmp(trailer + 2 * sizeof(uint32_t), INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0)
+    {
+        file.clear();
+        return false;
+    }
+    const uint8_t *cursor = trailer;
+    uint32_t num_row_groups = take<uint32_t>(cursor);
+    uint32_t index_bytes = take<uint32_t>(cursor);
+    size_t group_bytes = INDEX_GROUP_BYTES + size_t(num_columns) * INDEX_COLUMN_BYTES;
+    if (index_bytes != num_row_groups * group_bytes || data_offset + index_bytes + INDEX_TRAILER_BYTES > file_size)
+    {
+        return false;
+    }
+
+    uint64_t index_offset = file_size - INDEX_TRAILER_BYTES - index_bytes;
+    vector<uint8_t> index(index_bytes);
+    RT_COUNT(Seeks);
+    file.seekg(index_offset);
+    RT_COUNT_READ(index.size());
+    file.read(reinterpret_cast<char *>(index.data()), index.size());
+    if (!file)
+    {
+        file.clear();
+        return false;
+    }
+
+    // the groups must follow one another from the header right up to the index
+    vector<RowGroupInfo> groups(num_row_groups);
+    cursor = index.data();
+    uint64_t expected_offset = data_offset;
+    uint32_t first_row = 0;
+    for (RowGroupInfo &info : groups)
+    {
+        info.offset = take<uint64_t>(cursor);
+        info.num_rows = take<uint32_t>(cursor);
+        info.first_row = first_row;
+        first_row += info.num_rows;
+        info.representations.resize(num_columns);
+        info.bytes_used.resize(num_columns);
+        info.min_values.resize(num_columns);
+        info.max_values.resize(num_columns);
+        info.min_floats.resize(num_columns);
+        info.max_floats.resize(num_columns);
+        for (uint32_t c = 0; c < num_columns; c++)
+        {
+            info.representations[c] = take<RepresentationKind>(cursor);
+            info.bytes_used[c] = take<uint32_t>(cursor);
+            info.min_values[c] = take<uint32_t>(cursor);
+            info.max_values[c] = take<uint32_t>(cursor);
+            info.min_floats[c] = take<float>(cursor);
+            info.max_floats[c] = take<float>(cursor);
+        }
+        if (info.offset != expected_offset)
+        {
+            return false;
+        }
+        expected_offset = info.endOffset();
+    }
+    if (expected_offset != index_offset)
+    {
+        return false;
+    }
+
+    row_groups = std::move(groups);
+    return true;
+}
+
+bool ReadRowGroupHeader(std::istream &file, const uint32_t num_columns, RowGroupInfo &info)
+{
+    info.representations.resize(num_columns);
+    info.bytes_used.resize(num_columns);
+    for (uint32_t c = 0; c < num_columns; c++)
+    {
+        RT_COUNT_READ(sizeof(RepresentationKind));
+        file.read(reinterpret_cast<char *>(&info.representations[c]), sizeof(RepresentationKind));
+        RT_COUNT_READ(sizeof(uint32_t));
+        file.read(reinterpret_cast<char *>(&info.bytes_used[c]), sizeof(uint32_t));
+    }
+    return bool(file);
+}
+
+namespace
+{
+    template <typename Buffer>
+    void readColumnChunk(std::istream &file, const RowGroupInfo &info, uint32_t column, Buffer &bytes)
+    {
+        uint64_t offset = info.dataOffset();
+        for (uint32_t c = 0; c < column; c++)
+        {
+            offset += info.bytes_used[c];
+        }
+
+        bytes.resize(info.bytes_used[column]);
+        RT_COUNT(Seeks);
+        file.seekg(offset);
+        RT_COUNT_READ(bytes.size());
+        file.read(reinterpret_cast<char *>(bytes.data()), bytes.size());
+        if (!file)
+        {
+            throw "Truncated column chunk";
+        }
+    }
+}
+
+void ReadColumnChunk(std::istream &file, const RowGroupInfo &info, uint32_t column, vector<uint8_t> &bytes)
+{
+    readColumnChunk(file, info, column, bytes);
+}
+
+void ReadColumnChunk(std::istream &file, const RowGroupInfo &info, uint32_t column, PooledBuffer<uint8_t> &bytes)
+{
+    readColumnChunk(file, info, column, bytes);
+}
+
+bool ZoneMapsExclude(const RowGroupInfo &info, const Predicate &predicate)
+{
+    if (!info.hasZoneMaps())
+    {
+        return false;
+    }
+    if (predicate.type == CellType::Uint32)
+    {
+        uint32_t low, high;
+        return !predicate.bounds_uint32(low, high) || !info.mayContain_uint32(predicate.column, low, high);
+    }
+    if (predicate.type == CellType::Int32)
+    {
+        int32_t low, high;
+        return !predicate.bounds_int32(low, high) || !info.mayContain_int32(predicate.column, low, high);
+    }
+    float low, high;
+    return !predicate.bounds_float(low, high) || !info.mayContain_float(predicate.column, low, high);
+}
+
+void ReadRowGroupColumns_uint32(std::istream &file, const RowGroupInfo &info, const vector<uint32_t> &column_indices, vector<vector<uint32_t>> &columns, vector<uint8_t> &bytes)
+{
+    columns.resize(column_indices.size());
+    for (size_t k = 0; k < column_indices.size(); k++)
+    {
+        uint32_t column = column_indices[k];
+        ReadColumnChunk(file, info, column, bytes);
+
+        columns[k].clear();
+        DecodeColumn_uint32(info.representations[column], bytes.data(), bytes.size(), columns[k]);
+        if (columns[k].size() != info.num_rows)
+        {
+            throw "Columns have different row counts";
+        }
+    }
+}
+
+void ReadRowGroupColumns_uint32(std::istream &file, const RowGroupInfo &info, const vector<uint32_t> &column_indices, ColumnBatch &batch, PooledBuffer<uint8_t> &bytes)
+{
+    if (info.num_rows > batch.capacity() || column_indices.size() > batch.numColumns())
+    {
+        throw "Row group doesn't fit the batch";
+    }
+    for (size_t k = 0; k < column_indices.size(); k++)
+    {
+        uint32_t column = column_indices[k];
+        ReadColumnChunk(file, info, column, bytes);
+        if (DecodeColumnInto_uint32(info.representations[column], bytes.data(), bytes.size(), batch.column(uint32_t(k)), info.num_rows) != info.num_rows)
+        {
+            throw "Columns have different row counts";
+        }
+    }
+    batch.setSize(info.num_rows);
+}
+
+// ColumnarRelationalTable
+
+ColumnarRelationalTable::ColumnarRelationalTable()
+    : num_entries_(0), num_columns_(0), data_offset_(2 * sizeof(uint32_t)), row_group_size_(DEFAULT_ROW_GROUP_SIZE), size_tolerance_(0), has_index_(false), index_dirty_(false), cached_group_(NO_GROUP) {}
+
+ColumnarRelationalTable::ColumnarRelationalTable(const std::string &file_name)
+    : file_name_(file_name), num_entries_(0), num_columns_(0), data_offset_(2 * sizeof(uint32_t)), row_group_size_(DEFAULT_ROW_GROUP_SIZE), size_tolerance_(0), has_index_(false), index_dirty_(false), cached_group_(NO_GROUP)
+{
+    if (!parseMetadata())
+    {
+        std::cerr << "Error: Unable to parse metadata for table " << file_name << std::endl;
+    }
+    representations_.assign(num_columns_, RepresentationKind::Adaptive);
+}
+
+ColumnarRelationalTable::ColumnarRelationalTable(const std::string &file_name, const uint32_t num_columns)
+    : file_name_(file_name), num_entries_(0), num_columns_(num_columns), data_offset_(2 * sizeof(uint32_t)), row_group_size_(DEFAULT_ROW_GROUP_SIZE),
+      representations_(num_columns, RepresentationKind::Adaptive), size_tolerance_(0), has_index_(false), index_dirty_(false), cached_group_(NO_GROUP)
+{
+    RT_COUNT(FileOpens);
+    std::ifstream existing(file_name);
+    if (existing.is_open())
+    {
+        std::cerr << "Error: Table " << file_name << " already exists" << std::endl;
+        parseMetadata();
+        representations_.assign(num_columns_, RepresentationKind::Adaptive);
+        return;
+    }
+
+    if (!MakeColumnarRelationalTable(file_name, num_columns))
+    {
+        std::cerr << "Error: Unable to write metadata for table " << file_name << std::endl;
+    }
+}
+
+ColumnarRelationalTable::ColumnarRelationalTable(ColumnarRelationalTable &&other)
+    : file_name_(std::move(other.file_name_)), num_entries_(other.num_entries_), num_columns_(other.num_columns_),
+      data_offset_(other.data_offset_), schema_(std::move(other.schema_)), row_group_size_(other.row_group_size_), representations_(std::move(other.representations_)), size_tolerance_(other.size_tolerance_),
+      block_compression_(std::move(other.block_compression_)),
+      row_groups_(std::move(other.row_groups_)), buffer_(std::move(other.buffer_)), has_index_(other.has_index_),
+      index_dirty_(other.index_dirty_), cached_group_(other.cached_group_), cached_batch_(std::move(other.cached_batch_))
+{
+    // nothing left for the other table to write
+    other.buffer_.clear();
+    other.index_dirty_ = false;
+}
+
+ColumnarRelationalTable::~ColumnarRelationalTable()
+{
+    flush();
+}
+
+void ColumnarRelationalTable::setRepresentations(const std::vector<RepresentationKind> &representations)
+{
+    if (representations.size() != num_columns_)
+    {
+        std::cerr << "Error: Need one representation per column" << std::endl;
+        return;
+    }
+    representations_ = representations;
+}
+
+void ColumnarRelationalTable::setSizeTolerance(double size_tolerance)
+{
+    size_tolerance_ = size_tolerance;
+}
+
+void ColumnarRelationalTable::setRowGroupSize(uint32_t row_group_size)
+{
+    row_group_size_ = row_group_size == 0 ? 1 : row_group_size;
+}
+
+void ColumnarRelationalTable::setBlockCompression(const std::vector<BlockCompression> &block_compression)
+{
+    if (block_compression.size() != num_columns_)
+    {
+        std::cerr << "Error: Need block compression for every column" << std::endl;
+        return;
+    }
+    block_compression_ = block_compression;
+}
+
+void ColumnarRelationalTable::setBlockCompression(const BlockCompression &block_compression)
+{
+    block_compression_.assign(num_columns_, block_compression);
+}
+
+// uses float, like RelationalTable::printTable
+void ColumnarRelationalTable::printTable() const
+{
+    RT_TIME_PHASE(Output);
+    std::cout << "Table Name: " << file_name_ << std::endl;
+    std::cout << "Number of entries: " << readNumEntries() << std::endl;
+    std::cout << "Number of columns: " << num_columns_ << std::endl;
+
+    for (uint32_t g = 0; g < row_groups_.size(); g++)
+    {
+        const ColumnBatch &batch = readRowGroup(g);
+        for (uint32_t i = 0; i < batch.size(); i++)
+        {
+            for (uint32_t c = 0; c < num_columns_; c++)
             {
-                // TODO this can probably be optimized by reading multiple uint32_ts at a time
-                // and doing thisColumn.insert() for all of them.
-                // Make sure to increase the size of buffer to do that.
-                file.read(buffer, sizeof(uint32_t));
-                thisColumn.push_back(*reinterpret_cast<uint32_t *>(&buffer));
+                std::cout << batch.column_float(c)[i] << " ";
             }
-            break;
-        default:
-            throw "Unknown representation kind";
+            std::cout << std::endl;
         }
-        columnData.push_back(thisColumn);
     }
 
-    vector<vector<uint32_t>> rowData;
-    size_t num_rows = columnData[0].size();
-    for (size_t row = 0; row < num_rows; row++)
+    const float *buffered = reinterpret_cast<const float *>(buffer_.data());
+    for (size_t i = 0; i < buffer_.size(); i++)
+    {
+        std::cout << buffered[i] << " ";
+        if ((i + 1) % num_columns_ == 0)
+        {
+            std::cout << std::endl;
+        }
+    }
+}
+
+void ColumnarRelationalTable::printStats(std::ostream &out) const
+{
+    RT_TIME_PHASE(Output);
+    out << "Table Name: " << file_name_ << std::endl;
+    out << "Number of entries: " << readNumEntries() << " (" << buffer_.size() / std::max<uint32_t>(num_columns_, 1) << " buffered)" << std::endl;
+    out << "Number of row groups: " << row_groups_.size() << (has_index_ ? "" : " (no index)") << std::endl;
+
+    for (uint32_t c = 0; c < num_columns_; c++)
     {
-        vector<uint32_t> entry;
-        for (size_t column = 0; column < num_columns; column++)
+        // row groups per representation, in RepresentationKind order
+        uint32_t groups[256] = {};
+        uint64_t bytes = 0;
+        for (const RowGroupInfo &info : row_groups_)
+        {
+            groups[info.representations[c]]++;
+            bytes += info.bytes_used[c];
+        }
+        out << "Column " << c << ":";
+        for (uint32_t kind = 0; kind < 256; kind++)
         {
-            if (columnData[column].size() != num_rows)
+            if (groups[kind] != 0)
             {
-                throw "Columns have different row counts";
+                out << " " << groups[kind] << " " << RepresentationKindName(RepresentationKind(kind));
             }
-            entry.push_back(columnData[column][row]);
         }
-        rowData.push_back(std::move(entry));
+        double direct_bytes = double(num_entries_) * sizeof(uint32_t);
+        out << ", " << bytes << " bytes";
+        if (bytes != 0)
+        {
+            out << " (" << direct_bytes / bytes << "x smaller than Direct)";
+        }
+        out << std::endl;
     }
-    return rowData;
+
+    for (uint32_t g = 0; g < row_groups_.size(); g++)
+    {
+        out << "Row group " << g << " (" << row_groups_[g].num_rows << " rows):";
+        for (uint32_t c = 0; c < num_columns_; c++)
+        {
+            out << " " << RepresentationKindName(row_groups_[g].representations[c]);
+        }
+        out << std::endl;
+    }
+}
+
+void ColumnarRelationalTable::addRow_uint32_t(const std::vector<uint32_t> &row_data)
+{
+    if (row_data.size() != num_columns_)
+    {
+        std::cerr << "Error: Row data size does not match number of columns" << std::endl;
+        return;
+    }
+
+    appendRows_uint32_t(row_data.data(), 1);
+}
+
+void ColumnarRelationalTable::addRow_float(const std::vector<float> &row_data)
+{
+    if (row_data.size() != num_columns_)
+    {
+        std::cerr << "Error: Row data size does not match number of columns" << std::endl;
+        return;
+    }
+
+    appendRows_float(row_data.data(), 1);
+}
+
+bool ColumnarRelationalTable::appendRows_uint32_t(const uint32_t *rows, size_t num_rows)
+{
+    if (num_columns_ == 0)
+    {
+        return false;
+    }
+
+    while (num_rows > 0)
+    {
+        size_t buffered_rows = buffer_.size() / num_columns_;
+        size_t take = std::min<size_t>(num_rows, row_group_size_ - buffered_rows);
+
+        // whole row groups don't need to go through the buffer
+        if (buffered_rows == 0 && take == row_group_size_)
+        {
+            if (!writeRowGroup(rows, take))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            buffer_.insert(buffer_.end(), rows, rows + take * num_columns_);
+            if (buffered_rows + take == row_group_size_ && !flush())
+            {
+                return false;
+            }
+        }
+        rows += take * num_columns_;
+        num_rows -= take;
+    }
+    return true;
+}
+
+bool ColumnarRelationalTable::appendRows_float(const float *rows, size_t num_rows)
+{
+    return appendRows_uint32_t(reinterpret_cast<const uint32_t *>(rows), num_rows);
+}
+
+bool ColumnarRelationalTable::flush()
+{
+    if (!buffer_.empty())
+    {
+        if (!writeRowGroup(buffer_.data(), buffer_.size() / num_columns_))
+        {
+            return false;
+        }
+        buffer_.clear();
+    }
+    return !index_dirty_ || writeIndex();
+}
+
+std::vector<uint32_t> ColumnarRelationalTable::getRow_uint32_t(uint32_t row_index) const
+{
+    if (row_index >= num_entries_)
+    {
+        size_t buffered_row = row_index - num_entries_;
+        if (buffered_row >= buffer_.size() / std::max<uint32_t>(num_columns_, 1))
+        {
+            std::cerr << "Error: Row " << row_index << " is out of range in " << file_name_ << std::endl;
+            return {};
+        }
+        const uint32_t *row = buffer_.data() + buffered_row * num_columns_;
+        return std::vector<uint32_t>(row, row + num_columns_);
+    }
+
+    uint32_t group = findRowGroup(row_index);
+    const ColumnBatch &batch = readRowGroup(group);
+    if (batch.empty())
+    {
+        return {};
+    }
+    uint32_t i = row_index - row_groups_[group].first_row;
+    std::vector<uint32_t> row_data(num_columns_);
+    for (uint32_t c = 0; c < num_columns_; c++)
+    {
+        row_data[c] = batch.column(c)[i];
+    }
+    return row_data;
+}
+
+std::vector<float> ColumnarRelationalTable::getRow_float(uint32_t row_index) const
+{
+    std::vector<uint32_t> row = getRow_uint32_t(row_index);
+    std::vector<float> row_data(row.size());
+    std::memcpy(row_data.data(), row.data(), row.size() * sizeof(uint32_t));
+    return row_data;
+}
+
+std::vector<uint32_t> ColumnarRelationalTable::getColumn_uint32_t(uint32_t column_index) const
+{
+    std::vector<std::vector<uint32_t>> columns = readColumns_uint32({column_index});
+    return columns.empty() ? std::vector<uint32_t>() : std::move(columns[0]);
+}
+
+std::vector<float> ColumnarRelationalTable::getColumn_float(uint32_t column_index) const
+{
+    std::vector<uint32_t> column = getColumn_uint32_t(column_index);
+    std::vector<float> column_data(column.size());
+    std::memcpy(column_data.data(), column.data(), column.size() * sizeof(uint32_t));
+    return column_data;
+}
+
+bool ColumnarRelationalTable::scanBatches(const std::vector<uint32_t> &column_indices, const BatchVisitor &visit) const
+{
+    return scanRowGroups(column_indices, [](const RowGroupInfo &)
+                         { return true; },
+                         {}, visit);
+}
+
+bool ColumnarRelationalTable::scanBatches(const std::vector<uint32_t> &column_indices, const std::vector<Predicate> &predicates, const BatchVisitor &visit) const
+{
+    for (const Predicate &predicate : predicates)
+    {
+        if (predicate.column >= num_columns_)
+        {
+            std::cerr << "Error: Column " << predicate.column << " is out of range in " << file_name_ << std::endl;
+            return false;
+        }
+    }
+    return scanRowGroups(column_indices, [&predicates](const RowGroupInfo &info)
+                         {
+                             for (const Predicate &predicate : predicates)
+                             {
+                                 if (ZoneMapsExclude(info, predicate))
+                                 {
+                                     return false;
+                                 }
+                             }
+                             return true; },
+                         predicates, visit);
+}
+
+namespace
+{
+    // Adapts a batch scan to a ScanVisitor, copying every batch into arrays kept between batches
+    BatchVisitor copyColumns(std::vector<std::vector<uint32_t>> &columns, const ColumnarRelationalTable::ScanVisitor &visit)
+    {
+        return [&columns, &visit](uint32_t first_row, const ColumnBatch &batch)
+        {
+            columns.resize(batch.numColumns());
+            for (uint32_t k = 0; k < batch.numColumns(); k++)
+            {
+                columns[k].assign(batch.column(k), batch.column(k) + batch.size());
+            }
+            visit(first_row, columns);
+        };
+    }
+}
+
+bool ColumnarRelationalTable::scanColumns(const std::vector<uint32_t> &column_indices, const ScanVisitor &visit) const
+{
+    std::vector<std::vector<uint32_t>> columns;
+    return scanBatches(column_indices, copyColumns(columns, visit));
+}
+
+bool ColumnarRelationalTable::scanColumns(const std::vector<uint32_t> &column_indices, const RangeFilter &filter, const ScanVisitor &visit) const
+{
+    if (filter.column >= num_columns_)
+    {
+        std::cerr << "Error: Column " << filter.column << " is out of range in " << file_name_ << std::endl;
+        return false;
+    }
+    std::vector<std::vector<uint32_t>> columns;
+    return scanRowGroups(column_indices, [&filter](const RowGroupInfo &info)
+                         { return info.mayContain_uint32(filter.column, filter.low, filter.high); },
+                         {}, copyColumns(columns, visit));
+}
+
+size_t ColumnarRelationalTable::batchCapacity() const
+{
+    size_t capacity = std::max(BATCH_CAPACITY, buffer_.size() / std::max<uint32_t>(num_columns_, 1));
+    for (const RowGroupInfo &info : row_groups_)
+    {
+        capacity = std::max<size_t>(capacity, info.num_rows);
+    }
+    return capacity;
+}
+
+bool ColumnarRelationalTable::scanRowGroups(const std::vector<uint32_t> &column_indices, const std::function<bool(const RowGroupInfo &)> &want, const std::vector<Predicate> &predicates,
+                                            const BatchVisitor &visit) const
+{
+    for (uint32_t column : column_indices)
+    {
+        if (column >= num_columns_)
+        {
+            std::cerr << "Error: Column " << column << " is out of range in " << file_name_ << std::endl;
+            return false;
+        }
+    }
+
+    // the chunks of the wanted groups are read a few groups ahead, several reads in flight, while the
+    // groups before them are decoded
+    std::vector<const RowGroupInfo *> groups;
+    for (const RowGroupInfo &info : row_groups_)
+    {
+        if (want(info))
+        {
+            groups.push_back(&info);
+        }
+    }
+    std::vector<uint32_t> read_columns = column_indices;
+    for (const Predicate &predicate : predicates)
+    {
+        read_columns.push_back(predicate.column);
+    }
+
+    // everything the scan works in is allocated before the first group, from the query memory if there is one
+    ColumnBatch batch;
+    SelectionBitmap selection, predicate_selection;
+    PooledBuffer<uint32_t> scratch;
+    RowGroupPrefetcher prefetcher(file_name_, groups, read_columns);
+    if (!prefetcher.isOpen())
+    {
+        std::cerr << "Error: Unable to open file " << file_name_ << std::endl;
+        return false;
+    }
+    try
+    {
+        batch.reset(uint32_t(column_indices.size()), batchCapacity());
+        scratch.reserve(batch.capacity());
+        const RowGroupInfo *next_info;
+        while (prefetcher.next(next_info))
+        {
+            const RowGroupInfo &info = *next_info;
+            if (!predicates.empty())
+            {
+                selection.reset(info.num_rows);
+                selection.setRange(0, info.num_rows);
+                for (const Predicate &predicate : predicates)
+                {
+                    predicate_selection.reset(info.num_rows);
+                    EvaluatePredicate_uint32(predicate, info.representations[predicate.column], prefetcher.chunk(predicate.column), prefetcher.chunkSize(predicate.column), 0,
+                                             info.num_rows, predicate_selection, scratch);
+                    selection.intersect(predicate_selection);
+                }
+                if (selection.count() == 0)
+                {
+                    continue;
+                }
+            }
+            if (info.num_rows > batch.capacity())
+            {
+                throw "Row group doesn't fit the batch";
+            }
+            for (size_t k = 0; k < column_indices.size(); k++)
+            {
+                uint32_t column = column_indices[k];
+                if (DecodeColumnInto_uint32(info.representations[column], prefetcher.chunk(column), prefetcher.chunkSize(column), batch.column(uint32_t(k)), info.num_rows) != info.num_rows)
+                {
+                    throw "Columns have different row counts";
+                }
+            }
+            batch.setSize(info.num_rows);
+            if (!predicates.empty())
+            {
+                batch.select(selection);
+            }
+            visit(info.first_row, batch);
+        }
+    }
+    catch (const char *message)
+    {
+        std::cerr << "Error: " << message << " in " << file_name_ << std::endl;
+        return false;
+    }
+
+    // buffered rows have no zone maps, so they are always visited unless no row matches
+    if (!buffer_.empty())
+    {
+        size_t num_buffered = buffer_.size() / num_columns_;
+        if (!predicates.empty())
+        {
+            selection.reset(num_buffered);
+            selection.setRange(0, num_buffered);
+            for (const Predicate &predicate : predicates)
+            {
+                predicate_selection.reset(num_buffered);
+                EvaluatePredicate(predicate, buffer_.data() + predicate.column, num_buffered, num_columns_, 0, predicate_selection);
+                selection.intersect(predicate_selection);
+            }
+            if (selection.count() == 0)
+            {
+                return true;
+            }
+        }
+        batch.loadRows(buffer_.data(), num_columns_, num_buffered, column_indices);
+        if (!predicates.empty())
+        {
+            batch.select(selection);
+        }
+        visit(num_entries_, batch);
+    }
+    return true;
+}
+
+SelectionBitmap ColumnarRelationalTable::filter(const std::vector<Predicate> &predicates) const
+{
+    RT_TIME_PHASE(Filter);
+    // a scan of no columns: each batch only carries the rows of its group that every predicate selects
+    SelectionBitmap selection(readNumEntries());
+    bool scanned = scanBatches({}, predicates, [&selection](uint32_t first_row, const ColumnBatch &batch)
+                               {
+                                   if (!batch.hasSelection())
+                                   {
+                                       selection.setRange(first_row, first_row + batch.size());
+                                       return;
+                                   }
+                                   batch.forEachSelected([&](uint32_t row)
+                                                         { selection.set(first_row + row); }); });
+    if (!scanned)
+    {
+        return SelectionBitmap(readNumEntries());
+    }
+    return selection;
+}
+
+Aggregation ColumnarRelationalTable::aggregate(const std::vector<Aggregate> &aggregates) const
+{
+    RT_TIME_PHASE(Aggregate);
+    Aggregation aggregation(aggregates);
+    if (!aggregateRowGroups(aggregation))
+    {
+        return Aggregation();
+    }
+    return aggregation;
+}
+
+Aggregation ColumnarRelationalTable::aggregate(const std::vector<Aggregate> &aggregates, uint32_t key_column, CellType key_type) const
+{
+    RT_TIME_PHASE(Aggregate);
+    if (key_column >= num_columns_)
+    {
+        std::cerr << "Error: Column " << key_column << " is out of range in " << file_name_ << std::endl;
+        return Aggregation();
+    }
+
+    // the key range from the zone maps and the buffered rows; unknown without an index, so hashed
+    uint32_t low = std::numeric_limits<uint32_t>::max(), high = 0;
+    for (const RowGroupInfo &info : row_groups_)
+    {
+        if (!info.hasZoneMaps())
+        {
+            low = 0;
+            high = std::numeric_limits<uint32_t>::max();
+            break;
+        }
+        low = std::min(low, info.min_values[key_column]);
+        high = std::max(high, info.max_values[key_column]);
+    }
+    for (size_t i = key_column; i < buffer_.size(); i += num_columns_)
+    {
+        low = std::min(low, buffer_[i]);
+        high = std::max(high, buffer_[i]);
+    }
+
+    Aggregation aggregation(aggregates, key_column, key_type, low, high);
+    if (!aggregateRowGroups(aggregation))
+    {
+        return Aggregation();
+    }
+    return aggregation;
+}
+
+namespace
+{
+    // Whether the zone maps give the minimum or maximum an aggregate asks of a group, which cell it is and
+    // how many rows it stands for: none when a float column holds only NaNs (an empty zone map, minimum above maximum)
+    bool extremeFromZoneMaps(const RowGroupInfo &info, const Aggregate &aggregate, uint32_t &extreme, uint64_t &times)
+    {
+        if (!info.hasZoneMaps() || (aggregate.op != AggregateOp::Min && aggregate.op != AggregateOp::Max))
+        {
+            return false;
+        }
+        bool is_min = aggregate.op == AggregateOp::Min;
+        uint32_t column = aggregate.column;
+        times = info.num_rows;
+        if (aggregate.type == CellType::Float)
+        {
+            float low = info.min_floats[column], high = info.max_floats[column];
+            std::memcpy(&extreme, is_min ? &low : &high, sizeof(extreme));
+            times = low <= high ? info.num_rows : 0;
+            return true;
+        }
+        if (aggregate.type == CellType::Int32)
+        {
+            int32_t low, high;
+            if (!info.range_int32(column, low, high))
+            {
+                return false;
+            }
+            extreme = uint32_t(is_min ? low : high);
+            return true;
+        }
+        extreme = is_min ? info.min_values[column] : info.max_values[column];
+        return true;
+    }
+}
+
+bool ColumnarRelationalTable::aggregateRowGroups(Aggregation &aggregation) const
+{
+    const std::vector<Aggregate> &aggregates = aggregation.aggregates();
+    for (const Aggregate &aggregate : aggregates)
+    {
+        if (!aggregate.all_rows && aggregate.column >= num_columns_)
+        {
+            std::cerr << "Error: Column " << aggregate.column << " is out of range in " << file_name_ << std::endl;
+            return false;
+        }
+    }
+
+    // the chunks are read ahead as in scanRowGroups, but folded encoded rather than decoded into batches;
+    // minimums and maximums of ungrouped columns are left unread when every group's zone maps give them
+    std::vector<uint32_t> read_columns;
+    if (aggregation.grouped())
+    {
+        read_columns.push_back(aggregation.keyColumn());
+    }
+    for (const Aggregate &aggregate : aggregates)
+    {
+        uint32_t extreme;
+        uint64_t times;
+        bool from_zone_maps = !aggregation.grouped() && std::all_of(row_groups_.begin(), row_groups_.end(), [&](const RowGroupInfo &info)
+                                                                    { return extremeFromZoneMaps(info, aggregate, extreme, times); });
+        if (!aggregate.all_rows && aggregate.op != AggregateOp::Count && !from_zone_maps)
+        {
+            read_columns.push_back(aggregate.column);
+        }
+    }
+    std::vector<const RowGroupInfo *> groups;
+    for (const RowGroupInfo &info : row_groups_)
+    {
+        groups.push_back(&info);
+    }
+    RowGroupPrefetcher prefetcher(file_name_, groups, read_columns);
+    if (!prefetcher.isOpen())
+    {
+        std::cerr << "Error: Unable to open file " << file_name_ << std::endl;
+        return false;
+    }
+
+    // keys in batch column 0 and the cells of the chunk decoded last in column 1, decoded in place;
+    // values is scratch for the chunks folded without decoding
+    ColumnBatch batch;
+    PooledBuffer<uint32_t> values;
+    PooledBuffer<uint32_t> group_ids;
+    size_t num_keys = 0;
+    try
+    {
+        batch.reset(2, batchCapacity());
+        group_ids.resize(batch.capacity());
+        const RowGroupInfo *next_info;
+        while (prefetcher.next(next_info))
+        {
+            const RowGroupInfo &info = *next_info;
+            // every row goes to one group when ungrouped or when the key chunk is constant, and the
+            // chunks are then folded as a whole; NO_GROUP when the rows' keys are looked up one by one
+            uint32_t whole_group = 0;
+            if (aggregation.grouped())
+            {
+                uint32_t key_column = aggregation.keyColumn();
+                RepresentationKind key_kind = info.representations[key_column];
+                const uint8_t *key_chunk = prefetcher.chunk(key_column);
+                size_t key_chunk_size = prefetcher.chunkSize(key_column);
+                if (key_kind == RepresentationKind::Constant && key_chunk_size == 2 * sizeof(uint32_t) && info.num_rows != 0)
+                {
+                    const uint8_t *cells = key_chunk;
+                    uint32_t count = take<uint32_t>(cells), key = take<uint32_t>(cells);
+                    if (count != info.num_rows)
+                    {
+                        throw "Columns have different row counts";
+                    }
+                    aggregation.findGroups(&key, 1, 1, &whole_group);
+                }
+                else
+                {
+                    whole_group = Aggregation::NO_GROUP;
+                    num_keys = DecodeColumnInto_uint32(key_kind, key_chunk, key_chunk_size, batch.column(0), batch.capacity());
+                    if (num_keys != info.num_rows)
+                    {
+                        throw "Columns have different row counts";
+                    }
+                    aggregation.findGroups(batch.column(0), num_keys, 1, group_ids.data());
+                }
+            }
+
+            // column of the chunk decoded last into batch column 1 when the keys are looked up, num_columns_ for none
+            uint32_t chunk_column = num_columns_;
+            for (size_t a = 0; a < aggregates.size(); a++)
+            {
+                const Aggregate &aggregate = aggregates[a];
+                if (whole_group == Aggregation::NO_GROUP)
+                {
+                    if (aggregate.op == AggregateOp::Count)
+                    {
+                        aggregation.accumulate(a, batch.column(0), 1, group_ids.data(), num_keys);
+                        continue;
+                    }
+                    if (chunk_column != aggregate.column)
+                    {
+                        if (DecodeColumnInto_uint32(info.representations[aggregate.column], prefetcher.chunk(aggregate.column), prefetcher.chunkSize(aggregate.column),
+                                                    batch.column(1), batch.capacity()) != num_keys)
+                        {
+                            throw "Columns have different row counts";
+                        }
+                        chunk_column = aggregate.column;
+                    }
+                    aggregation.accumulate(a, batch.column(1), 1, group_ids.data(), num_keys);
+                    continue;
+                }
+
+                AggregateState &state = aggregation.state(whole_group, a);
+                if (aggregate.op == AggregateOp::Count)
+                {
+                    state.count += info.num_rows;
+                    continue;
+                }
+                uint32_t extreme;
+                uint64_t times;
+                if (extremeFromZoneMaps(info, aggregate, extreme, times))
+                {
+                    AggregateRepeated(aggregate, extreme, times, state);
+                    continue;
+                }
+                AggregateChunk_uint32(aggregate, info.representations[aggregate.column], prefetcher.chunk(aggregate.column), prefetcher.chunkSize(aggregate.column), info.num_rows, state, values);
+            }
+        }
+    }
+    catch (const char *message)
+    {
+        std::cerr << "Error: " << message << " in " << file_name_ << std::endl;
+        return false;
+    }
+
+    // buffered rows
+    size_t num_buffered = buffer_.size() / num_columns_;
+    if (aggregation.grouped())
+    {
+        group_ids.resize(num_buffered);
+        aggregation.findGroups(buffer_.data() + aggregation.keyColumn(), num_buffered, num_columns_, group_ids.data());
+    }
+    for (size_t a = 0; a < aggregates.size(); a++)
+    {
+        const Aggregate &aggregate = aggregates[a];
+        const uint32_t *cells = buffer_.data() + (aggregate.all_rows ? 0 : aggregate.column);
+        if (aggregation.grouped())
+        {
+            aggregation.accumulate(a, cells, num_columns_, group_ids.data(), num_buffered);
+        }
+        else
+        {
+            AggregateCells(aggregate, cells, num_buffered, num_columns_, aggregation.state(0, a));
+        }
+    }
+    return true;
+}
+
+std::vector<std::vector<uint32_t>> ColumnarRelationalTable::readColumns_uint32(const std::vector<uint32_t> &column_indices) const
+{
+    std::vector<std::vector<uint32_t>> result(column_indices.size());
+    for (std::vector<uint32_t> &column : result)
+    {
+        column.reserve(readNumEntries());
+    }
+    bool scanned = scanBatches(column_indices, [&result](uint32_t, const ColumnBatch &batch)
+                               {
+                                   for (uint32_t k = 0; k < batch.numColumns(); k++)
+                                   {
+                                       result[k].insert(result[k].end(), batch.column(k), batch.column(k) + batch.size());
+                                   } });
+    return scanned ? result : std::vector<std::vector<uint32_t>>();
+}
+
+uint32_t ColumnarRelationalTable::readNumEntries() const
+{
+    return num_entries_ + (num_columns_ == 0 ? 0 : buffer_.size() / num_columns_);
+}
+
+uint32_t ColumnarRelationalTable::readNumColumns() const
+{
+    return num_columns_;
+}
+
+uint32_t ColumnarRelationalTable::numRowGroups() const
+{
+    return row_groups_.size();
+}
+
+bool ColumnarRelationalTable::parseMetadata()
+{
+    RT_COUNT(FileOpens);
+    std::ifstream file(file_name_, std::ios::binary | std::ios::in);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    TableHeader header;
+    if (!ReadColumnarMetadata(file, header))
+    {
+        return false;
+    }
+    uint32_t num_entries = header.num_entries;
+    num_columns_ = header.num_columns;
+    data_offset_ = header.data_offset;
+    schema_ = header.schema;
+
+    // the index is only used when it covers exactly the committed rows
+    RT_COUNT(Seeks);
+    file.seekg(0, std::ios::end);
+    uint64_t file_size = file.tellg();
+    row_groups_.clear();
+    has_index_ = ReadColumnarFooter(file, file_size, data_offset_, num_columns_, row_groups_) &&
+                 (row_groups_.empty() ? 0 : row_groups_.back().first_row + row_groups_.back().num_rows) == num_entries;
+    if (has_index_)
+    {
+        num_entries_ = num_entries;
+        return true;
+    }
+
+    // otherwise walk the row group headers; a group's row count comes from whichever column gives it cheapest
+    row_groups_.clear();
+    uint64_t offset = data_offset_;
+    uint32_t rows_found = 0;
+    std::vector<uint8_t> chunk;
+    while (rows_found < num_entries && num_columns_ > 0)
+    {
+        RowGroupInfo info;
+        RT_COUNT(Seeks);
+        file.seekg(offset);
+        if (!ReadRowGroupHeader(file, num_columns_, info))
+        {
+            break;
+        }
+        info.offset = offset;
+        info.first_row = rows_found;
+
+        uint32_t count_column = 0;
+        for (uint32_t c = 0; c < num_columns_; c++)
+        {
+            if (!CountNeedsData(info.representations[c]))
+            {
+                count_column = c;
+                break;
+            }
+        }
+        uint64_t chunk_offset = info.dataOffset();
+        for (uint32_t c = 0; c < count_column; c++)
+        {
+            chunk_offset += info.bytes_used[c];
+        }
+        chunk.clear();
+        if (CountNeedsData(info.representations[count_column]))
+        {
+            chunk.resize(info.bytes_used[count_column]);
+            RT_COUNT(Seeks);
+            file.seekg(chunk_offset);
+            RT_COUNT_READ(chunk.size());
+            file.read(reinterpret_cast<char *>(chunk.data()), chunk.size());
+            if (!file)
+            {
+                break;
+            }
+        }
+        try
+        {
+            info.num_rows = CountColumnValues_uint32(info.representations[count_column], chunk.data(), info.bytes_used[count_column]);
+        }
+        catch (const char *message)
+        {
+            std::cerr << "Error: " << message << " in " << file_name_ << std::endl;
+            break;
+        }
+        if (info.num_rows == 0)
+        {
+            break;
+        }
+
+        offset = info.endOffset();
+        rows_found += info.num_rows;
+        row_groups_.push_back(std::move(info));
+    }
+
+    // rows the header promises but no complete row group holds are not part of the table
+    num_entries_ = std::min(num_entries, rows_found);
+    return true;
+}
+
+bool ColumnarRelationalTable::writeRowGroup(const uint32_t *rows, size_t num_rows)
+{
+    RT_COUNT(FileOpens);
+    std::fstream file(file_name_, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Unable to open file " << file_name_ << std::endl;
+        return false;
+    }
+
+    vector<vector<uint32_t>> columns(num_columns_, vector<uint32_t>(num_rows));
+    for (size_t row = 0; row < num_rows; row++)
+    {
+        for (uint32_t c = 0; c < num_columns_; c++)
+        {
+            columns[c][row] = rows[row * num_columns_ + c];
+        }
+    }
+
+    // new groups go right after the last complete one
+    uint64_t offset = row_groups_.empty() ? data_offset_ : row_groups_.back().endOffset();
+    RT_COUNT(Seeks);
+    file.seekp(offset);
+    RowGroupInfo info = WriteRowGroupColumns_uint32(file, columns, representations_, size_tolerance_, block_compression_);
+    info.offset = offset;
+    info.first_row = num_entries_;
+
+    uint32_t num_entries = num_entries_ + num_rows;
+    RT_COUNT(HeaderWrites);
+    RT_COUNT(Seeks);
+    file.seekp(0);
+    RT_COUNT_WRITE(sizeof(num_entries));
+    file.write(reinterpret_cast<const char *>(&num_entries), sizeof(num_entries));
+    if (!file)
+    {
+        std::cerr << "Error: Unable to write row group to " << file_name_ << std::endl;
+        return false;
+    }
+
+    file.close();
+
+    // drop the old index (or whatever else was past the last row group)
+    std::error_code error;
+    std::filesystem::resize_file(file_name_, info.endOffset(), error);
+
+    num_entries_ = num_entries;
+    row_groups_.push_back(std::move(info));
+    has_index_ = false;
+    index_dirty_ = true;
+    return true;
+}
+
+bool ColumnarRelationalTable::writeIndex()
+{
+    if (num_columns_ == 0)
+    {
+        return true;
+    }
+
+    RT_COUNT(FileOpens);
+    std::fstream file(file_name_, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Unable to open file " << file_name_ << std::endl;
+        return false;
+    }
+
+    // groups found by walking a file without an index get their zone maps now
+    std::vector<uint32_t> all_columns(num_columns_);
+    for (uint32_t c = 0; c < num_columns_; c++)
+    {
+        all_columns[c] = c;
+    }
+    std::vector<std::vector<uint32_t>> columns;
+    std::vector<uint8_t> bytes;
+    try
+    {
+        for (RowGroupInfo &info : row_groups_)
+        {
+            if (!info.hasZoneMaps())
+            {
+                ReadRowGroupColumns_uint32(file, info, all_columns, columns, bytes);
+                ComputeZoneMaps(columns, info);
+            }
+        }
+    }
+    catch (const char *message)
+    {
+        std::cerr << "Error: " << message << " in " << file_name_ << std::endl;
+        return false;
+    }
+
+    uint64_t index_offset = row_groups_.empty() ? data_offset_ : row_groups_.back().endOffset();
+    RT_COUNT(Seeks);
+    file.seekp(index_offset);
+    WriteColumnarFooter(file, row_groups_);
+    uint64_t file_end = file.tellp();
+    if (!file)
+    {
+        std::cerr << "Error: Unable to write the index of " << file_name_ << std::endl;
+        return false;
+    }
+    file.close();
+
+    std::error_code error;
+    std::filesystem::resize_file(file_name_, file_end, error);
+    has_index_ = true;
+    index_dirty_ = false;
+    return true;
+}
+
+const ColumnBatch &ColumnarRelationalTable::readRowGroup(uint32_t group_index) const
+{
+    if (cached_group_ == group_index)
+    {
+        return cached_batch_;
+    }
+
+    // the batch keeps its buffer from group to group, and from the heap since it outlives queries
+    const RowGroupInfo &info = row_groups_[group_index];
+    cached_group_ = NO_GROUP;
+    {
+        QueryMemoryScope heap(nullptr);
+        cached_batch_.reset(num_columns_, std::max<size_t>(BATCH_CAPACITY, info.num_rows));
+    }
+    RT_COUNT(FileOpens);
+    std::ifstream file(file_name_, std::ios::binary | std::ios::in);
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Unable to open file " << file_name_ << std::endl;
+        return cached_batch_;
+    }
+
+    // the chunks of a group are contiguous, read them with one call
+    PooledBuffer<uint8_t> bytes(info.endOffset() - info.dataOffset());
+    RT_COUNT(Seeks);
+    file.seekg(info.dataOffset());
+    RT_COUNT_READ(bytes.size());
+    file.read(reinterpret_cast<char *>(bytes.data()), bytes.size());
+    if (!file)
+    {
+        std::cerr << "Error: Truncated row group in " << file_name_ << std::endl;
+        return cached_batch_;
+    }
+
+    size_t chunk_offset = 0;
+    try
+    {
+        for (uint32_t c = 0; c < num_columns_; c++)
+        {
+            if (DecodeColumnInto_uint32(info.representations[c], bytes.data() + chunk_offset, info.bytes_used[c], cached_batch_.column(c), info.num_rows) != info.num_rows)
+            {
+                throw "Columns have different row counts";
+            }
+            chunk_offset += info.bytes_used[c];
+        }
+    }
+    catch (const char *message)
+    {
+        std::cerr << "Error: " << message << " in " << file_name_ << std::endl;
+        return cached_batch_;
+    }
+
+    cached_batch_.setSize(info.num_rows);
+    cached_group_ = group_index;
+    return cached_batch_;
+}
+
+uint32_t ColumnarRelationalTable::findRowGroup(uint32_t row_index) const
+{
+    // last group starting at or before the row
+    size_t low = 0, high = row_groups_.size();
+    while (high - low > 1)
+    {
+        size_t middle = (low + high) / 2;
+        if (row_groups_[middle].first_row <= row_index)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
 }
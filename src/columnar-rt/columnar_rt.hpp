@@ -1,6 +1,14 @@
-#ifndef _rt_h_
-#define _rt_h_
+#ifndef _columnar_rt_h_
+#define _columnar_rt_h_
 
+#include "../coding/coding.hpp"
+#include "../coding/block_codec.hpp"
+#include "../coding/predicate.hpp"
+#include "../coding/aggregate.hpp"
+#include "../coding/batch.hpp"
+#include "../rt/schema.hpp"
+
+#include <functional>
 #include <string>
 #include <vector>
 #include <cstdint>
@@ -9,10 +17,116 @@
 
 using namespace std;
 
-// Class representing a relational table
+// Row-group file layout (the one create_and_populate_table in populate_tables.py writes):
+//   num_entries: u32, num_columns: u32
+//   (the schema of a typed table when num_columns has TABLE_SCHEMA_FLAG set, as in a .tbl header, see TableHeader)
+//   per row group: (representation: u8, bytes_used: u32) for every column, then every column's encoded bytes
+//   (a chunk compressed again with a block codec has BLOCK_COMPRESSED set in its representation, see block_codec.hpp)
+// Files written by ColumnarRelationalTable end with an index of the row groups (files without one
+// are indexed by walking the groups):
+//   per row group: offset: u64, num_rows: u32, then for every column
+//                  representation: u8, bytes_used: u32, min: u32, max: u32, min: f32, max: f32
+//   num_row_groups: u32, index_bytes: u32 (everything before it), magic "RTIX"
+
+// Create a new table with the given column metadata
+bool MakeColumnarRelationalTable(const std::string &file_name, const uint32_t num_columns);
+
+// Read the header of a row-group file, schema included; header.data_offset is where the first row group starts
+bool ReadColumnarMetadata(std::ifstream &file, TableHeader &header);
+
+// Write one row group, encoding each column with its preferred representation and falling back
+// to Direct when the column can't be represented that way. Adaptive columns get the representation
+// EncodeColumnAdaptive_uint32 picks with size_tolerance.
+void WriteRowGroup_uint32(std::ofstream &file, const vector<vector<uint32_t>> &rows, const vector<RepresentationKind> &preferred_representations, double size_tolerance = 0);
+void WriteRowGroupUncompressed_uint32(std::ofstream &file, const vector<vector<uint32_t>> rows);
+
+// Read one row group and return its rows
+vector<vector<uint32_t>> ReadRowGroup_uint32(std::ifstream &file, const uint32_t num_columns);
+
+// Where one row group sits in the file and how its columns are stored
+struct RowGroupInfo
+{
+    uint64_t offset;                                  // of the group's column headers
+    uint32_t first_row;
+    uint32_t num_rows;
+    vector<RepresentationKind> representations;
+    vector<uint32_t> bytes_used;
+
+    // Zone maps: per column minimum and maximum of the cells as uint32_t and as float (NaNs left out).
+    // Empty when unknown, e.g. for a file without an index.
+    vector<uint32_t> min_values, max_values;
+    vector<float> min_floats, max_floats;
+
+    bool hasZoneMaps() const { return !min_values.empty(); }
+
+    // Whether a cell of the column may lie in [low, high]; true when there are no zone maps
+    bool mayContain_uint32(uint32_t column, uint32_t low, uint32_t high) const;
+    bool mayContain_int32(uint32_t column, int32_t low, int32_t high) const;
+    bool mayContain_float(uint32_t column, float low, float high) const;
+
+    // The column's cells read as int32_t lie in [low, high]; false when the uint32_t zone map holds cells
+    // of both signs, which leaves the signed range open
+    bool range_int32(uint32_t column, int32_t &low, int32_t &high) const;
+
+    // Offset of the first column chunk, right after the column headers
+    uint64_t dataOffset() const { return offset + representations.size() * (sizeof(RepresentationKind) + sizeof(uint32_t)); }
+    // Offset just past the group
+    uint64_t endOffset() const;
+};
+
+// Read the column headers of the row group at the file's read position (offset, first_row and
+// num_rows are left to the caller). False at the end of the file.
+bool ReadRowGroupHeader(std::istream &file, const uint32_t num_columns, RowGroupInfo &info);
+
+// Read the encoded chunk of one column of a row group into bytes
+void ReadColumnChunk(std::istream &file, const RowGroupInfo &info, uint32_t column, vector<uint8_t> &bytes);
+void ReadColumnChunk(std::istream &file, const RowGroupInfo &info, uint32_t column, PooledBuffer<uint8_t> &bytes);
+
+// Whether the zone maps of a row group rule out every match of the predicate
+bool ZoneMapsExclude(const RowGroupInfo &info, const Predicate &predicate);
+
+// Read and decode only the given columns of a row group, seeking past the other chunks. columns[k]
+// receives column column_indices[k]; its buffer is reused. bytes is scratch space for the chunks.
+void ReadRowGroupColumns_uint32(std::istream &file, const RowGroupInfo &info, const vector<uint32_t> &column_indices, vector<vector<uint32_t>> &columns, vector<uint8_t> &bytes);
+
+// Same into batch column k, decoding in place; the batch must have room for the group's rows and columns
+void ReadRowGroupColumns_uint32(std::istream &file, const RowGroupInfo &info, const vector<uint32_t> &column_indices, ColumnBatch &batch, PooledBuffer<uint8_t> &bytes);
+
+// Fill the zone maps of a row group from its decoded columns
+void ComputeZoneMaps(const vector<vector<uint32_t>> &columns, RowGroupInfo &info);
+
+// Fill the zone map of one column; the zone map vectors must already hold every column
+void ComputeColumnZoneMap(const vector<uint32_t> &values, size_t column, RowGroupInfo &info);
+
+// Write the row group index at the file's write position
+void WriteColumnarFooter(std::ostream &file, const vector<RowGroupInfo> &row_groups);
+
+// Read the index at the end of a file of file_size bytes. False when there is none or it doesn't
+// describe the row groups in front of it.
+bool ReadColumnarFooter(std::istream &file, uint64_t file_size, uint64_t data_offset, const uint32_t num_columns, vector<RowGroupInfo> &row_groups);
+
+// Encode one column chunk into bytes with its preferred representation (see WriteRowGroup_uint32), then
+// compress it with block_compression when that makes it smaller enough (see CompressChunk); returns the
+// representation used
+RepresentationKind EncodeColumnChunk_uint32(const vector<uint32_t> &values, RepresentationKind preferred_representation, double size_tolerance, vector<uint8_t> &bytes,
+                                            const BlockCompression &block_compression = {});
+
+// Write the column headers of a row group, then its encoded chunks
+void WriteEncodedRowGroup(std::ostream &file, const RowGroupInfo &info, const vector<vector<uint8_t>> &chunks);
+
+// Write one row group given column by column; returns the representations actually used and the chunk sizes.
+// block_compression is empty (no block compression) or has an entry per column.
+RowGroupInfo WriteRowGroupColumns_uint32(std::ostream &file, const vector<vector<uint32_t>> &columns, const vector<RepresentationKind> &preferred_representations, double size_tolerance = 0,
+                                         const vector<BlockCompression> &block_compression = {});
+
+// Table stored as row groups, each column of a group encoded on its own (the row-group file layout above,
+// so files made by populate_tables.py open as they are). Appended rows are buffered and written one
+// row group at a time; reads decode whole row groups and keep the last one.
 class ColumnarRelationalTable
 {
 public:
+    static const uint32_t DEFAULT_ROW_GROUP_SIZE = 1024;
+
     ColumnarRelationalTable();
 
     ColumnarRelationalTable(const std::string &file_name);
@@ -20,47 +134,143 @@ public:
     // Create a new table with the given column metadata
     ColumnarRelationalTable(const std::string &file_name, const uint32_t num_columns);
 
+    // Writes the rows still buffered as a last, shorter row group, then the index
+    ~ColumnarRelationalTable();
+
+    ColumnarRelationalTable(const ColumnarRelationalTable &) = delete;
+    ColumnarRelationalTable &operator=(const ColumnarRelationalTable &) = delete;
+    ColumnarRelationalTable(ColumnarRelationalTable &&other);
+
+    // How appended rows are written: the representation of each column (Adaptive when not set, so every
+    // chunk gets the representation estimated smallest; Direct per row group whenever a column can't be
+    // represented the way asked), how much bigger than the smallest an adaptive chunk may be estimated
+    // when it decodes faster, and the rows per row group
+    void setRepresentations(const std::vector<RepresentationKind> &representations);
+    void setSizeTolerance(double size_tolerance);
+    void setRowGroupSize(uint32_t row_group_size);
+
+    // Block compression of the chunks of appended rows, per column or the same for every column (none when
+    // not set). Chunks already written keep theirs.
+    void setBlockCompression(const std::vector<BlockCompression> &block_compression);
+    void setBlockCompression(const BlockCompression &block_compression);
+
+    // Per column: how many row groups use each representation and the bytes its chunks take, then the
+    // representation of every column of every row group
+    void printStats(std::ostream &out) const;
+
+    // Types and names of the columns; empty for an untyped table
+    const TableSchema &schema() const { return schema_; }
+
     // Print the table data
-    // void printTable() const;
+    void printTable() const;
 
     // Add a new row to the table
-    // void addRow_uint32_t(const std::vector<uint32_t> &row_data);
-    // void addRow_float(const std::vector<float> &row_data);
+    void addRow_uint32_t(const std::vector<uint32_t> &row_data);
+    void addRow_float(const std::vector<float> &row_data);
+
+    // Add num_rows rows laid out back to back; every full row group is written right away
+    bool appendRows_uint32_t(const uint32_t *rows, size_t num_rows);
+    bool appendRows_float(const float *rows, size_t num_rows);
+
+    // Write the buffered rows as a row group of their own and bring the index up to date
+    bool flush();
 
     // Retrieve a specific row by index
-    // std::vector<uint32_t> getRow_uint32_t(uint32_t row_index) const;
-    // std::vector<float> getRow_float(uint32_t row_index) const;
+    std::vector<uint32_t> getRow_uint32_t(uint32_t row_index) const;
+    std::vector<float> getRow_float(uint32_t row_index) const;
+
+    // Every value of one column
+    std::vector<uint32_t> getColumn_uint32_t(uint32_t column_index) const;
+    std::vector<float> getColumn_float(uint32_t column_index) const;
 
-    // Perform a join operation with another table and make the new file
-    // ColumnarRelationalTable full_outer_join(const ColumnarRelationalTable &other, const std::string &new_table_file_name) const;
-    // ColumnarRelationalTable inner_join(const ColumnarRelationalTable &other, const std::string &new_table_file_name, const std::vector<uint32_t> col1, const std::vector<uint32_t> col2) const;
+    // Batch scan: call visit once per row group (buffered rows last) with the first row of the group and a
+    // batch of the requested columns in column_indices order. Chunks are decoded straight into one batch,
+    // sized for the biggest group and reused for the whole scan; only the requested chunks are read.
+    bool scanBatches(const std::vector<uint32_t> &column_indices, const BatchVisitor &visit) const;
 
-    // Compress the table data
-    // void compressData();
+    // Filtered batch scan: only rows matching every predicate are selected in the batches. Row groups whose
+    // zone maps rule a predicate out are skipped, the predicates are evaluated on the encoded chunks (see
+    // EvaluatePredicate_uint32), and groups without a match are neither decoded nor visited.
+    bool scanBatches(const std::vector<uint32_t> &column_indices, const std::vector<Predicate> &predicates, const BatchVisitor &visit) const;
 
-    // Decompress the table data
-    // void decompressData();
+    // Projected scan as scanBatches, with the columns copied into arrays that are reused between calls
+    typedef std::function<void(uint32_t first_row, const std::vector<std::vector<uint32_t>> &columns)> ScanVisitor;
+    bool scanColumns(const std::vector<uint32_t> &column_indices, const ScanVisitor &visit) const;
 
-    // Getters
-    // uint32_t readNumEntries() const;
-    // uint32_t readNumColumns() const;
+    // Zone-map filter: only row groups whose cells of the column may lie in [low, high] are scanned.
+    // Visited groups can still hold rows outside the range.
+    struct RangeFilter
+    {
+        uint32_t column;
+        uint32_t low, high;
+    };
+    bool scanColumns(const std::vector<uint32_t> &column_indices, const RangeFilter &filter, const ScanVisitor &visit) const;
+
+    // Rows matching every predicate. Row groups whose zone maps rule a predicate out are skipped, and
+    // predicates are evaluated on the encoded chunks of their columns (see EvaluatePredicate_uint32).
+    SelectionBitmap filter(const std::vector<Predicate> &predicates) const;
+
+    // SUM/MIN/MAX/COUNT/AVG over every row, or per group of key_column's cells (see Aggregation). Chunks are
+    // folded without decoding where their representation allows (see AggregateChunk_uint32), minimums and
+    // maximums come from the zone maps, and groups whose key chunk is constant fold like ungrouped ones.
+    // An empty Aggregation when a column is out of range or the file can't be read.
+    Aggregation aggregate(const std::vector<Aggregate> &aggregates) const;
+    Aggregation aggregate(const std::vector<Aggregate> &aggregates, uint32_t key_column, CellType key_type) const;
+
+    // The requested columns in full, one array each
+    std::vector<std::vector<uint32_t>> readColumns_uint32(const std::vector<uint32_t> &column_indices) const;
+
+    // Getters (rows still buffered count as entries)
+    uint32_t readNumEntries() const;
+    uint32_t readNumColumns() const;
+    uint32_t numRowGroups() const;
+    bool hasIndex() const { return has_index_; }
+    const RowGroupInfo &rowGroup(uint32_t group_index) const { return row_groups_[group_index]; }
 
 protected:
-    // std::string file_name_;                   // File path for the table
-    // uint32_t num_entries_;                    // Number of rows
-    // uint32_t num_columns_;                    // Number of columns
-    // std::vector<std::vector<uint32_t>> data_; // Entry data
+    static const uint32_t NO_GROUP = 0xFFFFFFFFu;
+
+    std::string file_name_;                           // File path for the table
+    uint32_t num_entries_;                            // Rows written in row groups
+    uint32_t num_columns_;                            // Number of columns
+    uint32_t data_offset_;                            // Where the first row group starts, past the header
+    TableSchema schema_;                              // Empty for an untyped table
+    uint32_t row_group_size_;                         // Rows per written row group
+    std::vector<RepresentationKind> representations_; // Preferred representation per column
+    double size_tolerance_;                           // For Adaptive columns
+    std::vector<BlockCompression> block_compression_; // Per column, empty for none
+    std::vector<RowGroupInfo> row_groups_;            // Every row group in file order
+    std::vector<uint32_t> buffer_;                    // Rows not written yet, row-major
+    bool has_index_;                                  // The file ends with an up-to-date index
+    bool index_dirty_;                                // Row groups were written since the index
+
+    mutable uint32_t cached_group_;                   // Row group decoded last, NO_GROUP if none
+    mutable ColumnBatch cached_batch_;                // Its every column
+
+    // Parse metadata and find every row group
+    bool parseMetadata();
+
+    // Encode rows as one row group at the end of the file and commit them in the header
+    bool writeRowGroup(const uint32_t *rows, size_t num_rows);
+
+    // Write the index after the last row group, computing zone maps the groups don't have yet
+    bool writeIndex();
+
+    // Scan the row groups want accepts, selecting the rows that match every predicate
+    bool scanRowGroups(const std::vector<uint32_t> &column_indices, const std::function<bool(const RowGroupInfo &)> &want, const std::vector<Predicate> &predicates,
+                       const BatchVisitor &visit) const;
+
+    // Rows a batch needs to take any row group or the buffered rows
+    size_t batchCapacity() const;
 
-    // // Parse metadata and fill num_entries, num_columns
-    // bool parseMetadata();
+    // Fold every row group and the buffered rows into an aggregation
+    bool aggregateRowGroups(Aggregation &aggregation) const;
 
-    // // Calculate row size from metadata in bytes
-    // uint32_t calculateRowSize() const;
+    // Every column of a row group, decoded; an empty batch when the group can't be read
+    const ColumnBatch &readRowGroup(uint32_t group_index) const;
 
-    // // Setters
-    // bool writeMetadata(uint32_t num_entries, uint32_t num_columns);
-    // bool writeNumEntries(uint32_t num_entries);
-    // bool writeNumColumns(uint32_t num_columns);
+    // Row group holding a written row
+    uint32_t findRowGroup(uint32_t row_index) const;
 };
 
 #endif
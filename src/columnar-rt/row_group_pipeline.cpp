@@ -0,0 +1,424 @@
+#include "row_group_pipeline.hpp"
+#include "../rt/instrumentation.hpp"
+
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+ParallelRowGroupWriter::ParallelRowGroupWriter(std::ostream &file, const std::vector<RepresentationKind> &preferred_representations, double size_tolerance,
+                                               size_t num_threads, size_t max_pending)
+    : file_(file), representations_(preferred_representations), size_tolerance_(size_tolerance), max_pending_(max_pending), num_rows_(0),
+      finishing_(false), failed_(false), pool_(num_threads)
+{
+    if (max_pending_ == 0)
+    {
+        max_pending_ = 2 * pool_.size();
+    }
+    writer_ = std::thread(&ParallelRowGroupWriter::writerLoop, this);
+}
+
+ParallelRowGroupWriter::~ParallelRowGroupWriter()
+{
+    finish();
+}
+
+void ParallelRowGroupWriter::write(std::vector<std::vector<uint32_t>> columns)
+{
+    size_t num_columns = columns.size();
+    if (num_columns != representations_.size())
+    {
+        throw "Need one preferred representation per column";
+    }
+    if (!block_compression_.empty() && block_compression_.size() != num_columns)
+    {
+        throw "Need block compression for every column or none";
+    }
+
+    std::unique_ptr<PendingGroup> group(new PendingGroup());
+    RowGroupInfo &info = group->info;
+    info.offset = 0;
+    info.first_row = num_rows_;
+    info.num_rows = num_columns == 0 ? 0 : uint32_t(columns[0].size());
+    info.representations.resize(num_columns);
+    info.bytes_used.resize(num_columns);
+    info.min_values.resize(num_columns);
+    info.max_values.resize(num_columns);
+    info.min_floats.resize(num_columns);
+    info.max_floats.resize(num_columns);
+    group->columns = std::move(columns);
+    group->chunks.resize(num_columns);
+    group->columns_left = num_columns;
+    num_rows_ += info.num_rows;
+
+    PendingGroup *queued = group.get();
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [this]
+                      { return pending_.size() < max_pending_; });
+        pending_.push_back(std::move(group));
+    }
+    if (num_columns == 0)
+    {
+        changed_.notify_all();
+    }
+    for (size_t c = 0; c < num_columns; c++)
+    {
+        pool_.submit([this, queued, c]
+                     { encodeChunk(queued, c); });
+    }
+}
+
+bool ParallelRowGroupWriter::finish()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finishing_ = true;
+    }
+    changed_.notify_all();
+    if (writer_.joinable())
+    {
+        writer_.join();
+    }
+    return !failed_;
+}
+
+void ParallelRowGroupWriter::encodeChunk(PendingGroup *group, size_t column)
+{
+    bool failed = false;
+    try
+    {
+        std::vector<uint32_t> &values = group->columns[column];
+        group->info.representations[column] = EncodeColumnChunk_uint32(values, representations_[column], size_tolerance_, group->chunks[column],
+                                                                       block_compression_.empty() ? BlockCompression{} : block_compression_[column]);
+        group->info.bytes_used[column] = group->chunks[column].size();
+        ComputeColumnZoneMap(values, column, group->info);
+        std::vector<uint32_t>().swap(values);
+    }
+    catch (const char *message)
+    {
+        std::cerr << "Error: " << message << std::endl;
+        failed = true;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    failed_ = failed_ || failed;
+    if (--group->columns_left == 0)
+    {
+        changed_.notify_all();
+    }
+}
+
+void ParallelRowGroupWriter::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        changed_.wait(lock, [this]
+                      { return (!pending_.empty() && pending_.front()->columns_left == 0) || (pending_.empty() && finishing_); });
+        if (pending_.empty())
+        {
+            return;
+        }
+
+        // only this thread takes groups off the front, so the group stays put while it is written
+        PendingGroup *group = pending_.front().get();
+        bool failed = failed_;
+        lock.unlock();
+        if (!failed)
+        {
+            group->info.offset = uint64_t(file_.tellp());
+            WriteEncodedRowGroup(file_, group->info, group->chunks);
+            failed = !file_;
+        }
+        lock.lock();
+
+        failed_ = failed_ || failed;
+        if (!failed_)
+        {
+            row_groups_.push_back(std::move(group->info));
+        }
+        pending_.pop_front();
+        changed_.notify_all();
+    }
+}
+
+ParallelRowGroupReader::ParallelRowGroupReader(const std::string &file_name, const std::vector<RowGroupInfo> &row_groups, const std::vector<uint32_t> &column_indices,
+                                               size_t num_threads, size_t read_ahead)
+    : row_groups_(row_groups), column_indices_(column_indices), read_ahead_(read_ahead), next_group_(0), read_error_(nullptr), error_(nullptr),
+      pool_(num_threads)
+{
+    if (read_ahead_ == 0)
+    {
+        read_ahead_ = 2 * pool_.size();
+    }
+
+    // unbuffered, so a chunk read doesn't pull in the neighbouring chunks with it
+    file_.rdbuf()->pubsetbuf(nullptr, 0);
+    RT_COUNT(FileOpens);
+    file_.open(file_name, std::ios::binary | std::ios::in);
+    if (!file_.is_open())
+    {
+        read_error_ = "Unable to open file";
+    }
+}
+
+ParallelRowGroupReader::~ParallelRowGroupReader()
+{
+    pool_.wait();
+}
+
+bool ParallelRowGroupReader::next(std::vector<std::vector<uint32_t>> &columns)
+{
+    const RowGroupInfo *info;
+    return next(columns, info);
+}
+
+bool ParallelRowGroupReader::next(std::vector<std::vector<uint32_t>> &columns, const RowGroupInfo *&info)
+{
+    if (error_ != nullptr)
+    {
+        return false;
+    }
+    readAhead();
+    if (decoding_.empty())
+    {
+        // the groups read before a read error are handed out first
+        error_ = read_error_;
+        return false;
+    }
+
+    DecodingGroup *group = decoding_.front().get();
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        decoded_.wait(lock, [group]
+                      { return group->columns_left == 0; });
+    }
+    if (group->error != nullptr)
+    {
+        error_ = group->error;
+        return false;
+    }
+    columns.swap(group->columns);
+    info = group->info;
+    decoding_.pop_front();
+
+    // start reading the groups after it before the caller gets to work on this one
+    readAhead();
+    return true;
+}
+
+void ParallelRowGroupReader::readAhead()
+{
+    while (read_error_ == nullptr && decoding_.size() < read_ahead_ && next_group_ < row_groups_.size())
+    {
+        std::unique_ptr<DecodingGroup> group(new DecodingGroup());
+        group->info = &row_groups_[next_group_++];
+        group->chunks.resize(column_indices_.size());
+        group->columns.resize(column_indices_.size());
+        group->columns_left = column_indices_.size();
+        group->error = nullptr;
+        for (size_t k = 0; k < column_indices_.size(); k++)
+        {
+            if (column_indices_[k] >= group->info->representations.size())
+            {
+                read_error_ = "Column out of range";
+                return;
+            }
+            try
+            {
+                ReadColumnChunk(file_, *group->info, column_indices_[k], group->chunks[k]);
+            }
+            catch (const char *message)
+            {
+                read_error_ = message;
+                return;
+            }
+        }
+
+        DecodingGroup *queued = group.get();
+        decoding_.push_back(std::move(group));
+        for (size_t k = 0; k < column_indices_.size(); k++)
+        {
+            pool_.submit([this, queued, k]
+                         { decodeChunk(queued, k); });
+        }
+    }
+}
+
+void ParallelRowGroupReader::decodeChunk(DecodingGroup *group, size_t k)
+{
+    const char *error = nullptr;
+    try
+    {
+        const RowGroupInfo &info = *group->info;
+        std::vector<uint32_t> &values = group->columns[k];
+        values.reserve(info.num_rows);
+        DecodeColumn_uint32(info.representations[column_indices_[k]], group->chunks[k].data(), group->chunks[k].size(), values);
+        if (values.size() != info.num_rows)
+        {
+            throw "Columns have different row counts";
+        }
+        std::vector<uint8_t>().swap(group->chunks[k]);
+    }
+    catch (const char *message)
+    {
+        error = message;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (error != nullptr)
+    {
+        group->error = error;
+    }
+    if (--group->columns_left == 0)
+    {
+        decoded_.notify_all();
+    }
+}
+
+RowGroupPrefetcher::RowGroupPrefetcher(const std::string &file_name, const std::vector<const RowGroupInfo *> &groups, const std::vector<uint32_t> &columns,
+                                       size_t read_ahead, AsyncReader::Backend backend)
+    : fd_(-1), groups_(groups), columns_(columns), read_ahead_(std::max<size_t>(read_ahead, 1)), slots_(read_ahead_ + 1), next_read_(0), next_out_(0), current_(0)
+{
+    std::sort(columns_.begin(), columns_.end());
+    columns_.erase(std::unique(columns_.begin(), columns_.end()), columns_.end());
+
+    RT_COUNT(FileOpens);
+    fd_ = ::open(file_name.c_str(), O_RDONLY);
+
+    // every slot holds the largest group, so nothing is allocated once the groups come in
+    size_t max_bytes = 0, num_columns = 0;
+    for (const RowGroupInfo *info : groups_)
+    {
+        size_t bytes = 0;
+        for (uint32_t column : columns_)
+        {
+            bytes += info->bytes_used[column];
+        }
+        max_bytes = std::max(max_bytes, bytes);
+        num_columns = std::max(num_columns, info->bytes_used.size());
+    }
+    for (Slot &slot : slots_)
+    {
+        slot.info = nullptr;
+        slot.bytes.reserve(max_bytes);
+        slot.chunk_offsets.resize(num_columns);
+        slot.reads_left = 0;
+        slot.failed = false;
+    }
+
+    // at most one read per column of every group ahead, so the reader always has room for them
+    reader_.reset(new AsyncReader(fd_, read_ahead_ * std::max<size_t>(columns_.size(), 1), backend));
+}
+
+RowGroupPrefetcher::~RowGroupPrefetcher()
+{
+    reader_.reset();
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+    }
+}
+
+bool RowGroupPrefetcher::next(const RowGroupInfo *&info)
+{
+    if (fd_ < 0)
+    {
+        throw "Unable to open file";
+    }
+    if (next_out_ == groups_.size())
+    {
+        return false;
+    }
+
+    // the group handed out before is done with, so its slot can take the next group to read
+    readAhead();
+    size_t index = next_out_ % slots_.size();
+    while (slots_[index].reads_left > 0)
+    {
+        uint64_t tag;
+        bool read_all;
+        if (!reader_->complete(tag, read_all))
+        {
+            break;
+        }
+        slots_[tag].reads_left--;
+        slots_[tag].failed = slots_[tag].failed || !read_all;
+    }
+    if (slots_[index].failed)
+    {
+        throw "Truncated column chunk";
+    }
+    current_ = index;
+    info = slots_[index].info;
+    next_out_++;
+
+    // start reading the groups after it before the caller gets to work on this one
+    readAhead();
+    return true;
+}
+
+void RowGroupPrefetcher::readAhead()
+{
+    while (next_read_ < groups_.size() && next_read_ < next_out_ + read_ahead_)
+    {
+        size_t index = next_read_ % slots_.size();
+        Slot &slot = slots_[index];
+        const RowGroupInfo &info = *groups_[next_read_++];
+        slot.info = &info;
+        slot.reads_left = 0;
+        slot.failed = false;
+        size_t group_bytes = 0;
+        for (uint32_t column : columns_)
+        {
+            group_bytes += info.bytes_used[column];
+        }
+        slot.bytes.resize(group_bytes);
+
+        // chunks lie in column order, so a run of wanted columns is one stretch of the file
+        size_t position = 0, run_position = 0;
+        uint64_t offset = info.dataOffset(), run_offset = 0;
+        bool in_run = false;
+        size_t k = 0;
+        for (uint32_t column = 0; k < columns_.size(); column++)
+        {
+            if (column == columns_[k])
+            {
+                if (!in_run)
+                {
+                    in_run = true;
+                    run_position = position;
+                    run_offset = offset;
+                }
+                slot.chunk_offsets[column] = position;
+                position += info.bytes_used[column];
+                k++;
+            }
+            else if (in_run)
+            {
+                submitRun(index, run_position, position - run_position, run_offset);
+                in_run = false;
+            }
+            offset += info.bytes_used[column];
+        }
+        if (in_run)
+        {
+            submitRun(index, run_position, position - run_position, run_offset);
+        }
+    }
+}
+
+void RowGroupPrefetcher::submitRun(size_t slot, size_t position, size_t size, uint64_t offset)
+{
+    if (size == 0)
+    {
+        return;
+    }
+    if (!reader_->submit(slots_[slot].bytes.data() + position, size, off_t(offset), slot))
+    {
+        slots_[slot].failed = true;
+        return;
+    }
+    slots_[slot].reads_left++;
+}
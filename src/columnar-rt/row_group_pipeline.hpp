@@ -0,0 +1,188 @@
+#ifndef _row_group_pipeline_h_
+#define _row_group_pipeline_h_
+
+#include "columnar_rt.hpp"
+#include "../rt/async_io.hpp"
+#include "../rt/thread_pool.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes row groups the caller fills one after another: a pool of threads encodes the column chunks of
+// every queued group in parallel and a writer thread appends the encoded groups to the file in the
+// order they were queued, so the file is the same as one written group by group.
+class ParallelRowGroupWriter
+{
+public:
+    // Groups go to file from its write position on. 0 threads means one per hardware thread; at most
+    // max_pending groups (0: two per thread) wait to be encoded or written before write() blocks.
+    ParallelRowGroupWriter(std::ostream &file, const std::vector<RepresentationKind> &preferred_representations, double size_tolerance = 0,
+                           size_t num_threads = 0, size_t max_pending = 0);
+
+    // Finishes writing the queued groups
+    ~ParallelRowGroupWriter();
+
+    ParallelRowGroupWriter(const ParallelRowGroupWriter &) = delete;
+    ParallelRowGroupWriter &operator=(const ParallelRowGroupWriter &) = delete;
+
+    size_t numThreads() const { return pool_.size(); }
+
+    // Block compression per column for the chunks (none when not set); set before the first write()
+    void setBlockCompression(const std::vector<BlockCompression> &block_compression) { block_compression_ = block_compression; }
+
+    // Queue a row group given column by column
+    void write(std::vector<std::vector<uint32_t>> columns);
+
+    // Wait until every queued group is written. False when a group couldn't be encoded or written.
+    bool finish();
+
+    // The written groups in file order, offsets included and rows counted from the first queued group
+    const std::vector<RowGroupInfo> &rowGroups() const { return row_groups_; }
+
+private:
+    struct PendingGroup
+    {
+        std::vector<std::vector<uint32_t>> columns; // released once encoded
+        std::vector<std::vector<uint8_t>> chunks;
+        RowGroupInfo info;
+        size_t columns_left;                        // chunks still being encoded
+    };
+
+    std::ostream &file_;
+    std::vector<RepresentationKind> representations_;
+    double size_tolerance_;
+    std::vector<BlockCompression> block_compression_;
+    size_t max_pending_;
+    uint32_t num_rows_;                              // rows queued so far
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<std::unique_ptr<PendingGroup>> pending_; // queued, not written yet, in file order
+    bool finishing_;
+    bool failed_;
+    std::vector<RowGroupInfo> row_groups_;
+
+    ThreadPool pool_;
+    std::thread writer_;
+
+    void encodeChunk(PendingGroup *group, size_t column);
+    void writerLoop();
+};
+
+// Reads the given columns of row groups in order, decoding their chunks on a pool of threads while the
+// caller works on the groups before them. Chunks are read from the file by the caller's thread as
+// groups are consumed, keeping at most read_ahead groups read but not consumed yet.
+class ParallelRowGroupReader
+{
+public:
+    // 0 threads means one per hardware thread, read_ahead 0 two groups per thread
+    ParallelRowGroupReader(const std::string &file_name, const std::vector<RowGroupInfo> &row_groups, const std::vector<uint32_t> &column_indices,
+                           size_t num_threads = 0, size_t read_ahead = 0);
+
+    // Waits for the groups still being decoded
+    ~ParallelRowGroupReader();
+
+    ParallelRowGroupReader(const ParallelRowGroupReader &) = delete;
+    ParallelRowGroupReader &operator=(const ParallelRowGroupReader &) = delete;
+
+    size_t numThreads() const { return pool_.size(); }
+
+    // The columns of the next group in column_indices order (columns' buffers are swapped in, not
+    // copied), with the group's info. False after the last group, or on an error that error() describes;
+    // groups before one that can't be read or decoded are still handed out.
+    bool next(std::vector<std::vector<uint32_t>> &columns, const RowGroupInfo *&info);
+    bool next(std::vector<std::vector<uint32_t>> &columns);
+
+    // Why next() failed; nullptr when it didn't
+    const char *error() const { return error_; }
+
+private:
+    struct DecodingGroup
+    {
+        const RowGroupInfo *info;
+        std::vector<std::vector<uint8_t>> chunks;
+        std::vector<std::vector<uint32_t>> columns;
+        size_t columns_left;                        // chunks still being decoded
+        const char *error;
+    };
+
+    std::ifstream file_;
+    std::vector<RowGroupInfo> row_groups_;
+    std::vector<uint32_t> column_indices_;
+    size_t read_ahead_;
+    size_t next_group_;                              // next group to read
+    const char *read_error_;                         // reading stopped here
+    const char *error_;
+
+    std::mutex mutex_;
+    std::condition_variable decoded_;
+    std::deque<std::unique_ptr<DecodingGroup>> decoding_; // read, not consumed yet, in file order
+
+    ThreadPool pool_;
+
+    // Read groups and queue their chunks for decoding until read_ahead_ are queued
+    void readAhead();
+    void decodeChunk(DecodingGroup *group, size_t k);
+};
+
+// Reads the chunks of some columns of row groups a few groups ahead of the caller through an AsyncReader,
+// keeping every read of those groups in flight at once, and hands the groups out in order as their chunks
+// arrive, so decoding one group overlaps with reading the next. Chunks next to each other in the file
+// (columns next to each other) are read with one read.
+class RowGroupPrefetcher
+{
+public:
+    static const size_t DEFAULT_READ_AHEAD = 4;
+
+    // groups in the order they are wanted; columns in any order, repeats ignored
+    RowGroupPrefetcher(const std::string &file_name, const std::vector<const RowGroupInfo *> &groups, const std::vector<uint32_t> &columns,
+                       size_t read_ahead = DEFAULT_READ_AHEAD, AsyncReader::Backend backend = AsyncReader::Backend::Uring);
+
+    // Waits for the reads in flight
+    ~RowGroupPrefetcher();
+
+    RowGroupPrefetcher(const RowGroupPrefetcher &) = delete;
+    RowGroupPrefetcher &operator=(const RowGroupPrefetcher &) = delete;
+
+    bool isOpen() const { return fd_ >= 0; }
+    AsyncReader::Backend backend() const { return reader_->backend(); }
+
+    // Wait until the chunks of the next group are in; false after the last group. Throws a message when
+    // a chunk can't be read.
+    bool next(const RowGroupInfo *&info);
+
+    // The chunk of a column of the group next() handed out last
+    const uint8_t *chunk(uint32_t column) const { return slots_[current_].bytes.data() + slots_[current_].chunk_offsets[column]; }
+    size_t chunkSize(uint32_t column) const { return slots_[current_].info->bytes_used[column]; }
+
+private:
+    struct Slot
+    {
+        const RowGroupInfo *info;
+        PooledBuffer<uint8_t> bytes;       // the group's chunks of columns_, one after another
+        std::vector<size_t> chunk_offsets; // per column of the table, where its chunk starts in bytes
+        size_t reads_left;
+        bool failed;
+    };
+
+    int fd_;
+    std::vector<const RowGroupInfo *> groups_;
+    std::vector<uint32_t> columns_;        // sorted
+    size_t read_ahead_;
+    std::vector<Slot> slots_;              // group g goes in slot g % slots_.size(), one more than read_ahead_
+    size_t next_read_;                     // next group to read
+    size_t next_out_;                      // next group to hand out
+    size_t current_;                       // slot of the group handed out last
+    std::unique_ptr<AsyncReader> reader_;
+
+    // Start reading groups until read_ahead are read or being read past the one handed out
+    void readAhead();
+    void submitRun(size_t slot, size_t position, size_t size, uint64_t offset);
+};
+
+#endif
@@ -0,0 +1,306 @@
+#include "async_io.hpp"
+#include "instrumentation.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define RT_HAVE_IO_URING 1
+#endif
+#endif
+
+namespace
+{
+    // Threads reading for the fallback; more add little on one file
+    const size_t MAX_READ_THREADS = 4;
+
+#ifdef RT_HAVE_IO_URING
+    int ioUringSetup(unsigned entries, io_uring_params *params)
+    {
+        return int(syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int ioUringEnter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+    {
+        return int(syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0));
+    }
+
+    // The rings are shared with the kernel: their heads and tails are read and written with barriers
+    uint32_t loadAcquire(const uint32_t *word)
+    {
+        return __atomic_load_n(word, __ATOMIC_ACQUIRE);
+    }
+
+    void storeRelease(uint32_t *word, uint32_t value)
+    {
+        __atomic_store_n(word, value, __ATOMIC_RELEASE);
+    }
+#endif
+}
+
+AsyncReader::AsyncReader(int fd, size_t queue_depth, Backend backend)
+    : fd_(fd), requests_(std::max<size_t>(queue_depth, 1)), in_flight_(0), ring_fd_(-1), ring_(nullptr), ring_bytes_(0), entries_(nullptr), entries_bytes_(0),
+      sq_head_(nullptr), sq_tail_(nullptr), sq_mask_(nullptr), sq_array_(nullptr), cq_head_(nullptr), cq_tail_(nullptr), cq_mask_(nullptr), cqes_(nullptr), ring_failed_(false), stopping_(false)
+{
+    for (Request &request : requests_)
+    {
+        request.busy = false;
+    }
+    if (backend == Backend::Uring && setUpRing(requests_.size()))
+    {
+        return;
+    }
+    size_t num_threads = std::min(requests_.size(), MAX_READ_THREADS);
+    for (size_t t = 0; t < num_threads; t++)
+    {
+        workers_.emplace_back(&AsyncReader::workerLoop, this);
+    }
+}
+
+AsyncReader::~AsyncReader()
+{
+    uint64_t tag;
+    bool read_all;
+    while (complete(tag, read_all))
+    {
+    }
+
+#ifdef RT_HAVE_IO_URING
+    if (ring_fd_ >= 0)
+    {
+        munmap(entries_, entries_bytes_);
+        munmap(ring_, ring_bytes_);
+        ::close(ring_fd_);
+    }
+#endif
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    queued_.notify_all();
+    for (std::thread &worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+bool AsyncReader::setUpRing(size_t queue_depth)
+{
+#ifdef RT_HAVE_IO_URING
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int ring_fd = ioUringSetup(unsigned(queue_depth), &params);
+    if (ring_fd < 0)
+    {
+        return false;
+    }
+    // one mapping for both rings (Linux 5.4 on), which every kernel with IORING_OP_READV at hand has but
+    // the very first ones
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0)
+    {
+        ::close(ring_fd);
+        return false;
+    }
+
+    size_t sq_bytes = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    size_t cq_bytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    ring_bytes_ = std::max(sq_bytes, cq_bytes);
+    entries_bytes_ = params.sq_entries * sizeof(io_uring_sqe);
+    ring_ = mmap(nullptr, ring_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    entries_ = ring_ == MAP_FAILED ? MAP_FAILED : mmap(nullptr, entries_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (entries_ == MAP_FAILED)
+    {
+        if (ring_ != MAP_FAILED)
+        {
+            munmap(ring_, ring_bytes_);
+        }
+        ring_ = entries_ = nullptr;
+        ::close(ring_fd);
+        return false;
+    }
+
+    char *ring = static_cast<char *>(ring_);
+    sq_head_ = reinterpret_cast<uint32_t *>(ring + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<uint32_t *>(ring + params.sq_off.tail);
+    sq_mask_ = reinterpret_cast<uint32_t *>(ring + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<uint32_t *>(ring + params.sq_off.array);
+    cq_head_ = reinterpret_cast<uint32_t *>(ring + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<uint32_t *>(ring + params.cq_off.tail);
+    cq_mask_ = reinterpret_cast<uint32_t *>(ring + params.cq_off.ring_mask);
+    cqes_ = ring + params.cq_off.cqes;
+    ring_fd_ = ring_fd;
+    return true;
+#else
+    (void)queue_depth;
+    return false;
+#endif
+}
+
+bool AsyncReader::submit(void *data, size_t size, off_t offset, uint64_t tag)
+{
+    auto free_request = std::find_if(requests_.begin(), requests_.end(), [](const Request &request)
+                                     { return !request.busy; });
+    if (free_request == requests_.end())
+    {
+        return false;
+    }
+    free_request->busy = true;
+    free_request->tag = tag;
+    free_request->data = static_cast<char *>(data);
+    free_request->size = size;
+    free_request->offset = offset;
+    in_flight_++;
+    RT_COUNT_READ(size);
+    startRead(free_request - requests_.begin());
+    return true;
+}
+
+bool AsyncReader::complete(uint64_t &tag, bool &read_all)
+{
+    while (in_flight_ > 0)
+    {
+        size_t index;
+        ssize_t result;
+        nextResult(index, result);
+        Request &request = requests_[index];
+
+        // the rest of a short read is read again, unless the file ends there
+        if (result > 0 && size_t(result) < request.size)
+        {
+            request.data += result;
+            request.size -= result;
+            request.offset += result;
+            startRead(index);
+            continue;
+        }
+        tag = request.tag;
+        read_all = result >= 0 && size_t(result) == request.size;
+        request.busy = false;
+        in_flight_--;
+        return true;
+    }
+    return false;
+}
+
+void AsyncReader::startRead(size_t index)
+{
+    Request &request = requests_[index];
+#ifdef RT_HAVE_IO_URING
+    if (ring_fd_ >= 0 && ring_failed_)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_.push_back({index, -1});
+        return;
+    }
+    if (ring_fd_ >= 0)
+    {
+        request.vector.iov_base = request.data;
+        request.vector.iov_len = request.size;
+
+        // at most queueDepth() reads are in flight, so there is always a free submission entry
+        uint32_t tail = *sq_tail_;
+        uint32_t slot = tail & *sq_mask_;
+        io_uring_sqe *entry = static_cast<io_uring_sqe *>(entries_) + slot;
+        std::memset(entry, 0, sizeof(*entry));
+        entry->opcode = IORING_OP_READV;
+        entry->fd = fd_;
+        entry->off = request.offset;
+        entry->addr = reinterpret_cast<uint64_t>(&request.vector);
+        entry->len = 1;
+        entry->user_data = index;
+        sq_array_[slot] = slot;
+        storeRelease(sq_tail_, tail + 1);
+
+        // an entry the kernel didn't take is submitted again by nextResult
+        while (ioUringEnter(ring_fd_, 1, 0, 0) < 0 && errno == EINTR)
+        {
+        }
+        return;
+    }
+#endif
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(index);
+    }
+    queued_.notify_one();
+}
+
+void AsyncReader::nextResult(size_t &index, ssize_t &result)
+{
+#ifdef RT_HAVE_IO_URING
+    if (ring_fd_ >= 0 && !ring_failed_)
+    {
+        // submitting again whatever the kernel didn't take when it was submitted
+        uint32_t head = *cq_head_;
+        while (head == loadAcquire(cq_tail_) && !ring_failed_)
+        {
+            if (ioUringEnter(ring_fd_, *sq_tail_ - loadAcquire(sq_head_), 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR && errno != EAGAIN)
+            {
+                failRing();
+            }
+        }
+        if (!ring_failed_)
+        {
+            const io_uring_cqe *completion = static_cast<const io_uring_cqe *>(cqes_) + (head & *cq_mask_);
+            index = size_t(completion->user_data);
+            result = completion->res < 0 ? -1 : completion->res;
+            storeRelease(cq_head_, head + 1);
+            return;
+        }
+    }
+#endif
+    std::unique_lock<std::mutex> lock(mutex_);
+    completed_.wait(lock, [this]
+                    { return !done_.empty(); });
+    index = done_.front().first;
+    result = done_.front().second;
+    done_.pop_front();
+}
+
+void AsyncReader::failRing()
+{
+    ring_failed_ = true;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t index = 0; index < requests_.size(); index++)
+    {
+        if (requests_[index].busy)
+        {
+            done_.push_back({index, -1});
+        }
+    }
+}
+
+void AsyncReader::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        queued_.wait(lock, [this]
+                     { return stopping_ || !queue_.empty(); });
+        if (queue_.empty())
+        {
+            return;
+        }
+        size_t index = queue_.front();
+        queue_.pop_front();
+        Request request = requests_[index];
+        lock.unlock();
+
+        ssize_t result;
+        do
+        {
+            result = pread(fd_, request.data, request.size, request.offset);
+        } while (result < 0 && errno == EINTR);
+
+        lock.lock();
+        done_.push_back({index, result});
+        completed_.notify_one();
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef _async_io_h_
+#define _async_io_h_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// Keeps several reads of a file in flight and hands them back as they complete, so a scan can decode one
+// block while the next ones are read. On Linux the reads go through an io_uring set up with raw system
+// calls; where none can be set up (an old kernel, a seccomp filter) a few threads calling pread stand in.
+// A read that comes back short is continued until it has all its bytes or reaches the end of the file.
+// If the ring stops working (io_uring_enter failing other than with EINTR or EAGAIN), the reads in flight
+// and all later ones complete as not read. One thread submits and collects the reads.
+class AsyncReader
+{
+public:
+    static const size_t DEFAULT_QUEUE_DEPTH = 8;
+
+    enum class Backend
+    {
+        Uring,
+        Threads,
+    };
+
+    // Reads of fd, at most queue_depth at a time; Uring falls back to Threads if it can't be set up
+    explicit AsyncReader(int fd, size_t queue_depth = DEFAULT_QUEUE_DEPTH, Backend backend = Backend::Uring);
+
+    // Waits for the reads in flight
+    ~AsyncReader();
+
+    AsyncReader(const AsyncReader &) = delete;
+    AsyncReader &operator=(const AsyncReader &) = delete;
+
+    Backend backend() const { return ring_fd_ >= 0 ? Backend::Uring : Backend::Threads; }
+    size_t queueDepth() const { return requests_.size(); }
+    size_t inFlight() const { return in_flight_; }
+
+    // Start reading size bytes at offset into data, which must stay put until the read completes; tag
+    // comes back with it. False when queueDepth() reads are in flight already.
+    bool submit(void *data, size_t size, off_t offset, uint64_t tag);
+
+    // Wait for a read to complete and give its tag and whether all its bytes were read. False when no
+    // read is in flight.
+    bool complete(uint64_t &tag, bool &read_all);
+
+private:
+    struct Request
+    {
+        bool busy;
+        uint64_t tag;
+        char *data;
+        size_t size;   // bytes still to read
+        off_t offset;
+        iovec vector;  // what the ring reads into
+    };
+
+    int fd_;
+    std::vector<Request> requests_;
+    size_t in_flight_;
+
+    // io_uring: the submission and completion rings and the submission entries, mapped from ring_fd_
+    int ring_fd_;
+    void *ring_;
+    size_t ring_bytes_;
+    void *entries_;
+    size_t entries_bytes_;
+    uint32_t *sq_head_, *sq_tail_, *sq_mask_, *sq_array_;
+    uint32_t *cq_head_, *cq_tail_, *cq_mask_;
+    void *cqes_;
+    bool ring_failed_;  // io_uring_enter failed for good: every read from then on fails
+
+    // Threads: requests by index, queued and completed (with bytes read, or -1)
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable queued_, completed_;
+    std::deque<size_t> queue_;
+    std::deque<std::pair<size_t, ssize_t>> done_;
+    bool stopping_;
+
+    bool setUpRing(size_t queue_depth);
+    void startRead(size_t index);
+    // Give up on the ring: the reads in flight complete as failed (-1)
+    void failRing();
+    // Wait for the next finished read of any request: its index and bytes read, or -1
+    void nextResult(size_t &index, ssize_t &result);
+    void workerLoop();
+};
+
+#endif
@@ -1,5 +1,7 @@
 #include "helper.hpp"
 
+#include <cstdlib>
+
 bool fileExists(const std::string &file_name)
 {
     std::ifstream file(file_name); // Try to open the file in input mode
@@ -42,4 +44,71 @@ std::vector<uint32_t> splitString(const std::string &str)
 
     result.push_back(std::stoi(temp));
     return result;
-}
\ No newline at end of file
+}
+
+namespace
+{
+    template <typename T, typename Parse>
+    bool parseCells(const std::string &line, std::vector<T> &cells, Parse parse)
+    {
+        cells.clear();
+        const char *p = line.c_str();
+        while (true)
+        {
+            while (*p == ' ' || *p == '\t' || *p == '\r')
+            {
+                p++;
+            }
+            if (*p == '\0')
+            {
+                return !cells.empty();
+            }
+
+            char *end;
+            T value = parse(p, &end);
+            if (end == p)
+            {
+                return false;
+            }
+            cells.push_back(value);
+
+            p = end;
+            while (*p == ' ' || *p == '\t' || *p == '\r')
+            {
+                p++;
+            }
+            if (*p == ',')
+            {
+                p++;
+            }
+        }
+    }
+}
+
+bool parseCsvRow(const std::string &line, std::vector<float> &cells)
+{
+    return parseCells(line, cells, [](const char *p, char **end)
+                      { return std::strtof(p, end); });
+}
+
+bool parseCsvRow(const std::string &line, std::vector<uint32_t> &cells)
+{
+    return parseCells(line, cells, [](const char *p, char **end)
+                      { return uint32_t(std::strtoul(p, end, 10)); });
+}
+
+bool parseCsvRow(const std::string &line, const TableSchema &schema, std::vector<uint32_t> &cells)
+{
+    // cells past the last column are read as floats, so the row still fails on its length
+    size_t column = 0;
+    return parseCells(line, cells, [&](const char *p, char **end)
+                      {
+                          uint32_t cell = 0;
+                          ColumnType type = column < schema.numColumns() ? schema.types[column] : ColumnType::Float32;
+                          column++;
+                          if (!ParseCell(p, end, type, cell))
+                          {
+                              *end = const_cast<char *>(p);
+                          }
+                          return cell; });
+}
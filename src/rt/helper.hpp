@@ -1,14 +1,25 @@
 #ifndef _helper_h_
 #define _helper_h_
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <fstream>
 #include <iostream>
 
+#include "schema.hpp"
+
 bool fileExists(const std::string& file_name);
 void createFile(const std::string& file_name);
 bool removeFile(const std::string& file_name);
 std::vector<uint32_t> splitString(const std::string& str);
 
+// Parse a comma or whitespace separated row into cells; false if a cell isn't a number
+bool parseCsvRow(const std::string& line, std::vector<float>& cells);
+bool parseCsvRow(const std::string& line, std::vector<uint32_t>& cells);
+
+// Same for a typed table: each cell is parsed as its column's type into its bit pattern, and
+// out of range integers count as not a number
+bool parseCsvRow(const std::string& line, const TableSchema& schema, std::vector<uint32_t>& cells);
+
 #endif
\ No newline at end of file
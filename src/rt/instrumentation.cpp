@@ -0,0 +1,104 @@
+#include "instrumentation.hpp"
+#include "../coding/coding.hpp"
+
+#include <iomanip>
+
+#include <sys/resource.h>
+
+InstrumentationCounters g_instrumentation;
+
+namespace
+{
+    const char *const COUNTER_NAMES[] = {"file_opens", "file_maps", "seeks", "reads", "bytes_read", "writes", "bytes_written", "header_writes", "handle_reuses", "log_syncs", "block_decompressions"};
+    const char *const PHASE_NAMES[] = {"encode", "decode", "filter", "aggregate", "join", "output"};
+
+    static_assert(sizeof(COUNTER_NAMES) / sizeof(COUNTER_NAMES[0]) == size_t(Counter::NumCounters), "a name per counter");
+    static_assert(sizeof(PHASE_NAMES) / sizeof(PHASE_NAMES[0]) == size_t(Phase::NumPhases), "a name per phase");
+
+    std::string decodedKindName(size_t slot)
+    {
+        // the legacy direct layout shares its name with Direct, but gets its own key here
+        if (slot == size_t(RepresentationKind::DirectLegacy))
+        {
+            return "DirectLegacy";
+        }
+        return slot + 1 < NUM_DECODED_KIND_SLOTS ? RepresentationKindName(RepresentationKind(slot)) : "Other";
+    }
+}
+
+uint64_t PeakMemoryBytes()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+    // kilobytes on Linux
+    return uint64_t(usage.ru_maxrss) * 1024;
+}
+
+void ResetInstrumentation()
+{
+    for (std::atomic<uint64_t> &event : g_instrumentation.events)
+    {
+        event = 0;
+    }
+    for (std::atomic<uint64_t> &rows : g_instrumentation.rows_decoded)
+    {
+        rows = 0;
+    }
+    for (size_t p = 0; p < size_t(Phase::NumPhases); p++)
+    {
+        g_instrumentation.phase_nanoseconds[p] = 0;
+        g_instrumentation.phase_calls[p] = 0;
+    }
+}
+
+void PrintInstrumentation(std::ostream &out)
+{
+    if (!INSTRUMENTATION_ENABLED)
+    {
+        out << "Instrumentation is compiled out (built with INSTRUMENTATION=0)" << std::endl;
+        return;
+    }
+
+    out << "Instrumentation:" << std::endl;
+    for (size_t c = 0; c < size_t(Counter::NumCounters); c++)
+    {
+        out << "  " << std::left << std::setw(24) << COUNTER_NAMES[c] << g_instrumentation.events[c] << std::endl;
+    }
+    for (size_t slot = 0; slot < NUM_DECODED_KIND_SLOTS; slot++)
+    {
+        if (g_instrumentation.rows_decoded[slot] != 0)
+        {
+            out << "  " << std::setw(24) << ("rows_decoded " + decodedKindName(slot)) << g_instrumentation.rows_decoded[slot] << std::endl;
+        }
+    }
+    for (size_t p = 0; p < size_t(Phase::NumPhases); p++)
+    {
+        out << "  " << std::setw(24) << (std::string(PHASE_NAMES[p]) + " seconds") << std::fixed << std::setprecision(6)
+            << g_instrumentation.phase_nanoseconds[p] / 1e9 << " (" << g_instrumentation.phase_calls[p] << " calls)" << std::endl;
+    }
+    out << "  " << std::setw(24) << "peak_memory_bytes" << PeakMemoryBytes() << std::endl;
+}
+
+void WriteInstrumentationJson(std::ostream &out)
+{
+    out << "{\"enabled\": " << (INSTRUMENTATION_ENABLED ? "true" : "false") << ", \"counters\": {";
+    for (size_t c = 0; c < size_t(Counter::NumCounters); c++)
+    {
+        out << (c == 0 ? "" : ", ") << "\"" << COUNTER_NAMES[c] << "\": " << g_instrumentation.events[c];
+    }
+    out << "}, \"rows_decoded\": {";
+    for (size_t slot = 0; slot < NUM_DECODED_KIND_SLOTS; slot++)
+    {
+        out << (slot == 0 ? "" : ", ") << "\"" << decodedKindName(slot) << "\": " << g_instrumentation.rows_decoded[slot];
+    }
+    out << "}, \"phases\": {";
+    for (size_t p = 0; p < size_t(Phase::NumPhases); p++)
+    {
+        out << (p == 0 ? "" : ", ") << "\"" << PHASE_NAMES[p] << "\": {\"seconds\": " << std::fixed << std::setprecision(6)
+            << g_instrumentation.phase_nanoseconds[p] / 1e9 << ", \"calls\": " << g_instrumentation.phase_calls[p] << "}";
+    }
+    out << "}, \"peak_memory_bytes\": " << PeakMemoryBytes() << "}" << std::endl;
+}
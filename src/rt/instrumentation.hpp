@@ -0,0 +1,122 @@
+#ifndef _instrumentation_h_
+#define _instrumentation_h_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+// Process-wide counters and phase timers on the hot paths, reported by rt_program --stats. An update is a
+// relaxed atomic add and a timed phase two clock reads, so they stay on by default; building with
+// -DRT_NO_INSTRUMENTATION (make INSTRUMENTATION=0) turns every RT_ macro below into nothing.
+//
+// Reads and writes count calls on a file (a buffered stream may merge several into one system call, an
+// unbuffered one makes one each); phases nest (a scan's decoding counts as decode as well) and add up the
+// time of every thread in them.
+
+#ifdef RT_NO_INSTRUMENTATION
+const bool INSTRUMENTATION_ENABLED = false;
+#else
+const bool INSTRUMENTATION_ENABLED = true;
+#endif
+
+enum class Counter
+{
+    FileOpens,
+    FileMaps,
+    Seeks,
+    Reads,
+    BytesRead,
+    Writes,
+    BytesWritten,
+    HeaderWrites,        // num_entries/num_columns rewritten in a table header
+    HandleReuses,        // tables opened on a handle already open in the process instead of the file
+    LogSyncs,            // write-ahead log syncs, each covering a group of batches
+    BlockDecompressions, // block-compressed column chunks uncompressed
+    NumCounters,
+};
+
+enum class Phase
+{
+    Encode,
+    Decode,
+    Filter,
+    Aggregate,
+    Join,
+    Output, // printing tables and results
+    NumPhases,
+};
+
+// Slots for rows decoded per representation kind; kinds past the last go to the last slot
+const size_t NUM_DECODED_KIND_SLOTS = 8;
+
+struct InstrumentationCounters
+{
+    std::atomic<uint64_t> events[size_t(Counter::NumCounters)];
+    std::atomic<uint64_t> rows_decoded[NUM_DECODED_KIND_SLOTS];
+    std::atomic<uint64_t> phase_nanoseconds[size_t(Phase::NumPhases)];
+    std::atomic<uint64_t> phase_calls[size_t(Phase::NumPhases)];
+};
+
+extern InstrumentationCounters g_instrumentation;
+
+inline void CountEvent(Counter counter, uint64_t amount)
+{
+    g_instrumentation.events[size_t(counter)].fetch_add(amount, std::memory_order_relaxed);
+}
+
+inline void CountDecodedRows(uint8_t kind, uint64_t rows)
+{
+    size_t slot = kind < NUM_DECODED_KIND_SLOTS ? kind : NUM_DECODED_KIND_SLOTS - 1;
+    g_instrumentation.rows_decoded[slot].fetch_add(rows, std::memory_order_relaxed);
+}
+
+// Adds the time from its construction to its destruction to a phase
+class PhaseTimer
+{
+public:
+    explicit PhaseTimer(Phase phase) : phase_(phase), start_(std::chrono::steady_clock::now()) {}
+    ~PhaseTimer()
+    {
+        uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count();
+        g_instrumentation.phase_nanoseconds[size_t(phase_)].fetch_add(nanoseconds, std::memory_order_relaxed);
+        g_instrumentation.phase_calls[size_t(phase_)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    PhaseTimer(const PhaseTimer &) = delete;
+    PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+private:
+    Phase phase_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Largest resident set of the process so far, in bytes
+uint64_t PeakMemoryBytes();
+
+// Zero every counter and timer
+void ResetInstrumentation();
+
+// Every counter and phase, one per line, or as a JSON object
+void PrintInstrumentation(std::ostream &out);
+void WriteInstrumentationJson(std::ostream &out);
+
+#ifdef RT_NO_INSTRUMENTATION
+#define RT_COUNT(counter) ((void)0)
+#define RT_COUNT_N(counter, amount) ((void)0)
+#define RT_COUNT_READ(bytes) ((void)0)
+#define RT_COUNT_WRITE(bytes) ((void)0)
+#define RT_COUNT_DECODED(kind, rows) ((void)0)
+#define RT_TIME_PHASE(phase) ((void)0)
+#else
+#define RT_COUNT(counter) CountEvent(Counter::counter, 1)
+#define RT_COUNT_N(counter, amount) CountEvent(Counter::counter, (amount))
+#define RT_COUNT_READ(bytes) (CountEvent(Counter::Reads, 1), CountEvent(Counter::BytesRead, (bytes)))
+#define RT_COUNT_WRITE(bytes) (CountEvent(Counter::Writes, 1), CountEvent(Counter::BytesWritten, (bytes)))
+#define RT_COUNT_DECODED(kind, rows) CountDecodedRows(uint8_t(kind), (rows))
+#define RT_PHASE_TIMER_NAME(line) rt_phase_timer_##line
+#define RT_PHASE_TIMER(phase, line) PhaseTimer RT_PHASE_TIMER_NAME(line)(Phase::phase)
+#define RT_TIME_PHASE(phase) RT_PHASE_TIMER(phase, __LINE__)
+#endif
+
+#endif
@@ -0,0 +1,355 @@
+#include "join.hpp"
+#include "thread_pool.hpp"
+#include "../coding/batch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+JoinHashTable::JoinHashTable(const uint32_t *cells, uint32_t row_width, uint32_t num_rows, const std::vector<uint32_t> &key_columns)
+    : cells_(cells), row_width_(row_width), key_columns_(key_columns), row_ids_(nullptr)
+{
+    build(num_rows);
+}
+
+JoinHashTable::JoinHashTable(const uint32_t *cells, uint32_t row_width, const uint32_t *row_ids, size_t num_row_ids, const std::vector<uint32_t> &key_columns)
+    : cells_(cells), row_width_(row_width), key_columns_(key_columns), row_ids_(row_ids)
+{
+    build(num_row_ids);
+}
+
+void JoinHashTable::build(size_t num_entries)
+{
+    // at least two buckets per entry keeps the chains short
+    size_t num_buckets = 1;
+    while (num_buckets < 2 * num_entries)
+    {
+        num_buckets <<= 1;
+    }
+    mask_ = num_buckets - 1;
+    heads_.assign(num_buckets, NONE);
+    next_.resize(num_entries);
+    hashes_.resize(num_entries);
+
+    // insert back to front so every chain lists its rows in table order
+    for (size_t entry = num_entries; entry-- > 0;)
+    {
+        uint32_t row = row_ids_ == nullptr ? uint32_t(entry) : row_ids_[entry];
+        uint64_t hash = HashKey(cells_ + size_t(row) * row_width_, key_columns_);
+        hashes_[entry] = hash;
+        next_[entry] = heads_[hash & mask_];
+        heads_[hash & mask_] = uint32_t(entry);
+    }
+}
+
+namespace
+{
+    // Output rows handed to emit once this many cells are buffered
+    const size_t OUTPUT_BUFFER_CELLS = 1 << 20;
+
+    // Build partitions are sized to stay in L2 with their hash table
+    const size_t PARTITION_TARGET_BYTES = 256 << 10;
+
+    // Collects output rows for one thread and hands them to emit in large batches
+    class JoinOutput
+    {
+    public:
+        JoinOutput(const JoinInput &left, const JoinInput &right, const JoinEmit &emit, std::mutex *emit_mutex)
+            : left_width_(left.width), right_width_(right.width), emit_(emit), emit_mutex_(emit_mutex)
+        {
+            rows_.reserve(OUTPUT_BUFFER_CELLS + left.width + right.width);
+        }
+
+        ~JoinOutput()
+        {
+            flush();
+        }
+
+        // A row id of JOIN_NO_ROW (with a nullptr row) leaves that side's cells zero
+        void add(const uint32_t *left_row, uint32_t left_id, const uint32_t *right_row, uint32_t right_id)
+        {
+            append(left_row, left_width_);
+            append(right_row, right_width_);
+            left_ids_.push_back(left_id);
+            right_ids_.push_back(right_id);
+            if (rows_.size() >= OUTPUT_BUFFER_CELLS)
+            {
+                flush();
+            }
+        }
+
+        void flush()
+        {
+            if (rows_.empty())
+            {
+                return;
+            }
+            if (emit_mutex_ != nullptr)
+            {
+                std::lock_guard<std::mutex> lock(*emit_mutex_);
+                emit_(rows_.data(), left_ids_.size(), left_ids_.data(), right_ids_.data());
+            }
+            else
+            {
+                emit_(rows_.data(), left_ids_.size(), left_ids_.data(), right_ids_.data());
+            }
+            rows_.clear();
+            left_ids_.clear();
+            right_ids_.clear();
+        }
+
+    private:
+        uint32_t left_width_, right_width_;
+        const JoinEmit &emit_;
+        std::mutex *emit_mutex_;
+        std::vector<uint32_t> rows_;
+        std::vector<uint32_t> left_ids_, right_ids_;
+
+        void append(const uint32_t *row, uint32_t width)
+        {
+            if (row == nullptr)
+            {
+                rows_.resize(rows_.size() + width, 0);
+            }
+            else
+            {
+                rows_.insert(rows_.end(), row, row + width);
+            }
+        }
+    };
+
+    // Add a build row and a probe row to the output in left, right order
+    inline void addPair(JoinOutput &output, bool build_left, const uint32_t *build_row, uint32_t build_id, const uint32_t *probe_row, uint32_t probe_id)
+    {
+        if (build_left)
+        {
+            output.add(build_row, build_id, probe_row, probe_id);
+        }
+        else
+        {
+            output.add(probe_row, probe_id, build_row, build_id);
+        }
+    }
+
+    // Call visit(probe_row_index, hash, key_valid) for the given probe rows (all of them when probe_ids is
+    // nullptr) in order, a batch at a time: the key cells of a batch are gathered column by column, hashed
+    // a column at a time, and the buckets of the whole batch prefetched before any of them is probed
+    template <typename F>
+    void forEachProbeRow(const JoinHashTable &hash_table, const JoinInput &probe_side, const uint32_t *probe_ids, size_t num_probe, F visit)
+    {
+        const std::vector<uint32_t> &key_columns = probe_side.key_columns;
+        ColumnBatch keys(uint32_t(key_columns.size()));
+        PooledBuffer<uint32_t> row_ids(keys.capacity());
+        PooledBuffer<uint64_t> hashes(keys.capacity());
+        for (size_t first = 0; first < num_probe; first += keys.capacity())
+        {
+            size_t count = std::min(keys.capacity(), num_probe - first);
+            for (size_t i = 0; i < count; i++)
+            {
+                row_ids[i] = probe_ids == nullptr ? uint32_t(first + i) : probe_ids[first + i];
+            }
+            std::fill(hashes.data(), hashes.data() + count, 0);
+            for (uint32_t k = 0; k < key_columns.size(); k++)
+            {
+                uint32_t *column = keys.column(k);
+                const uint32_t *cells = probe_side.cells + key_columns[k];
+                for (size_t i = 0; i < count; i++)
+                {
+                    column[i] = cells[size_t(row_ids[i]) * probe_side.width];
+                }
+                for (size_t i = 0; i < count; i++)
+                {
+                    hashes[i] = (hashes[i] ^ column[i]) * KEY_HASH_MULTIPLIER;
+                }
+            }
+            keys.setSize(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                hashes[i] = FinishKeyHash(hashes[i]);
+                hash_table.prefetch(hashes[i]);
+            }
+
+            for (size_t i = 0; i < count; i++)
+            {
+                visit(row_ids[i], hashes[i], KeyIsValid(probe_side, row_ids[i]));
+            }
+        }
+    }
+
+    // Probe the given rows (all of them when probe_ids is nullptr) against a built hash table
+    void probe(const JoinHashTable &hash_table, const JoinInput &build, const JoinInput &probe_side, bool build_left,
+               const uint32_t *probe_ids, size_t num_probe, JoinOutput &output)
+    {
+        forEachProbeRow(hash_table, probe_side, probe_ids, num_probe, [&](uint32_t probe_row_index, uint64_t hash, bool key_valid)
+                        {
+                            if (!key_valid)
+                            {
+                                return;
+                            }
+                            const uint32_t *probe_row = probe_side.cells + size_t(probe_row_index) * probe_side.width;
+                            hash_table.forEachMatch(probe_row, probe_side.key_columns, hash, [&](uint32_t build_row_index)
+                                                    {
+                                                        if (KeyIsValid(build, build_row_index))
+                                                        {
+                                                            const uint32_t *build_row = build.cells + size_t(build_row_index) * build.width;
+                                                            addPair(output, build_left, build_row, build_row_index, probe_row, probe_row_index);
+                                                        } }); });
+    }
+
+    // Row ids of one input grouped by partition: partition p is ids[starts[p] .. starts[p + 1])
+    struct Partitioning
+    {
+        std::vector<uint32_t> ids;
+        std::vector<size_t> starts;
+    };
+
+    // Scatter row ids by the top radix_bits bits of their key hash, with every thread handling one range of rows
+    Partitioning partition(const JoinInput &input, uint32_t radix_bits, ThreadPool &pool)
+    {
+        size_t num_partitions = size_t(1) << radix_bits;
+        size_t num_threads = pool.size();
+        size_t rows_per_thread = (input.num_rows + num_threads - 1) / num_threads;
+        PooledBuffer<uint32_t> partition_of(input.num_rows);
+        std::vector<std::vector<size_t>> histograms(num_threads, std::vector<size_t>(num_partitions, 0));
+
+        pool.runOnEach([&](size_t t)
+                       {
+                           size_t begin = std::min<size_t>(t * rows_per_thread, input.num_rows);
+                           size_t end = std::min<size_t>(begin + rows_per_thread, input.num_rows);
+                           for (size_t row = begin; row < end; row++)
+                           {
+                               uint64_t hash = HashKey(input.cells + row * input.width, input.key_columns);
+                               uint32_t p = radix_bits == 0 ? 0 : uint32_t(hash >> (64 - radix_bits));
+                               partition_of[row] = p;
+                               histograms[t][p]++;
+                           } });
+
+        // partition-major offsets, threads in order inside each partition
+        Partitioning result;
+        result.ids.resize(input.num_rows);
+        result.starts.resize(num_partitions + 1);
+        size_t offset = 0;
+        for (size_t p = 0; p < num_partitions; p++)
+        {
+            result.starts[p] = offset;
+            for (size_t t = 0; t < num_threads; t++)
+            {
+                size_t count = histograms[t][p];
+                histograms[t][p] = offset;
+                offset += count;
+            }
+        }
+        result.starts[num_partitions] = offset;
+
+        pool.runOnEach([&](size_t t)
+                       {
+                           size_t begin = std::min<size_t>(t * rows_per_thread, input.num_rows);
+                           size_t end = std::min<size_t>(begin + rows_per_thread, input.num_rows);
+                           std::vector<size_t> &cursor = histograms[t];
+                           for (size_t row = begin; row < end; row++)
+                           {
+                               result.ids[cursor[partition_of[row]]++] = uint32_t(row);
+                           } });
+        return result;
+    }
+}
+
+void HashJoin(const JoinInput &left, const JoinInput &right, const JoinEmit &emit)
+{
+    bool build_left = left.num_rows <= right.num_rows;
+    const JoinInput &build = build_left ? left : right;
+    const JoinInput &probe_side = build_left ? right : left;
+
+    JoinHashTable hash_table(build.cells, build.width, build.num_rows, build.key_columns);
+    JoinOutput output(left, right, emit, nullptr);
+    probe(hash_table, build, probe_side, build_left, nullptr, probe_side.num_rows, output);
+}
+
+void PartitionedHashJoin(const JoinInput &left, const JoinInput &right, size_t num_threads, const JoinEmit &emit)
+{
+    bool build_left = left.num_rows <= right.num_rows;
+    const JoinInput &build = build_left ? left : right;
+    const JoinInput &probe_side = build_left ? right : left;
+
+    // enough partitions for cache-sized builds and a few partitions per thread to balance skew
+    ThreadPool pool(num_threads);
+    size_t build_bytes = size_t(build.num_rows) * (build.width * sizeof(uint32_t) + 4 * sizeof(uint32_t));
+    uint32_t radix_bits = 0;
+    while (radix_bits < 14 && ((size_t(1) << radix_bits) * PARTITION_TARGET_BYTES < build_bytes || (size_t(1) << radix_bits) < 4 * pool.size()))
+    {
+        radix_bits++;
+    }
+
+    Partitioning build_partitions = partition(build, radix_bits, pool);
+    Partitioning probe_partitions = partition(probe_side, radix_bits, pool);
+
+    size_t num_partitions = size_t(1) << radix_bits;
+    std::atomic<size_t> next_partition(0);
+    std::mutex emit_mutex;
+    pool.runOnEach([&](size_t)
+                   {
+                       JoinOutput output(left, right, emit, &emit_mutex);
+                       for (size_t p = next_partition++; p < num_partitions; p = next_partition++)
+                       {
+                           const uint32_t *probe_ids = probe_partitions.ids.data() + probe_partitions.starts[p];
+                           size_t num_probe = probe_partitions.starts[p + 1] - probe_partitions.starts[p];
+                           size_t num_build = build_partitions.starts[p + 1] - build_partitions.starts[p];
+                           if (num_probe == 0 || num_build == 0)
+                           {
+                               continue;
+                           }
+
+                           JoinHashTable hash_table(build.cells, build.width, build_partitions.ids.data() + build_partitions.starts[p], num_build, build.key_columns);
+                           probe(hash_table, build, probe_side, build_left, probe_ids, num_probe, output);
+                       } });
+}
+
+void HashFullOuterJoin(const JoinInput &left, const JoinInput &right, const JoinEmit &emit)
+{
+    bool build_left = left.num_rows <= right.num_rows;
+    const JoinInput &build = build_left ? left : right;
+    const JoinInput &probe_side = build_left ? right : left;
+
+    JoinHashTable hash_table(build.cells, build.width, build.num_rows, build.key_columns);
+    JoinOutput output(left, right, emit, nullptr);
+
+    // one bit per build row, set once the row has matched
+    PooledBuffer<uint64_t> matched;
+    matched.assign((size_t(build.num_rows) + 63) / 64, 0);
+    forEachProbeRow(hash_table, probe_side, nullptr, probe_side.num_rows, [&](uint32_t probe_row_index, uint64_t hash, bool key_valid)
+                    {
+                        const uint32_t *probe_row = probe_side.cells + size_t(probe_row_index) * probe_side.width;
+                        bool found = false;
+                        if (key_valid)
+                        {
+                            hash_table.forEachMatch(probe_row, probe_side.key_columns, hash, [&](uint32_t build_row_index)
+                                                    {
+                                                        if (KeyIsValid(build, build_row_index))
+                                                        {
+                                                            const uint32_t *build_row = build.cells + size_t(build_row_index) * build.width;
+                                                            addPair(output, build_left, build_row, build_row_index, probe_row, probe_row_index);
+                                                            matched[build_row_index / 64] |= 1ull << (build_row_index % 64);
+                                                            found = true;
+                                                        } });
+                        }
+                        if (!found)
+                        {
+                            addPair(output, build_left, nullptr, JOIN_NO_ROW, probe_row, probe_row_index);
+                        } });
+
+    // unmatched build rows, skipping fully matched words
+    for (size_t word = 0; word < matched.size(); word++)
+    {
+        uint64_t unmatched = ~matched[word];
+        if (word == matched.size() - 1 && build.num_rows % 64 != 0)
+        {
+            unmatched &= (1ull << (build.num_rows % 64)) - 1;
+        }
+        while (unmatched != 0)
+        {
+            uint32_t build_row_index = uint32_t(word * 64 + __builtin_ctzll(unmatched));
+            unmatched &= unmatched - 1;
+            addPair(output, build_left, build.cells + size_t(build_row_index) * build.width, build_row_index, nullptr, JOIN_NO_ROW);
+        }
+    }
+}
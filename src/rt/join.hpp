@@ -0,0 +1,143 @@
+#ifndef _join_h_
+#define _join_h_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "validity.hpp"
+#include "query_memory.hpp"
+
+// Key hashes fold in one key cell at a time, h = (h ^ cell) * KEY_HASH_MULTIPLIER from h = 0, then
+// finish with FinishKeyHash; a batch of keys can so be hashed a column at a time
+const uint64_t KEY_HASH_MULTIPLIER = 0x9E3779B97F4A7C15ull;
+
+inline uint64_t FinishKeyHash(uint64_t h)
+{
+    return h ^ (h >> 29);
+}
+
+// Hash of the key cells of one row
+inline uint64_t HashKey(const uint32_t *row, const std::vector<uint32_t> &key_columns)
+{
+    uint64_t h = 0;
+    for (uint32_t column : key_columns)
+    {
+        h = (h ^ row[column]) * KEY_HASH_MULTIPLIER;
+    }
+    return FinishKeyHash(h);
+}
+
+// Whether the key cells of two rows are equal (cells compare as 32-bit patterns)
+inline bool KeysEqual(const uint32_t *left, const std::vector<uint32_t> &left_key_columns, const uint32_t *right, const std::vector<uint32_t> &right_key_columns)
+{
+    for (size_t k = 0; k < left_key_columns.size(); k++)
+    {
+        if (left[left_key_columns[k]] != right[right_key_columns[k]])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Chained hash table over the key columns of row-major cells, built with one scan of the build side.
+// Rows are referenced by index, the cells themselves stay where they are (e.g. in a mapped table).
+class JoinHashTable
+{
+public:
+    // Index rows 0 .. num_rows - 1 of cells, each row_width cells long
+    JoinHashTable(const uint32_t *cells, uint32_t row_width, uint32_t num_rows, const std::vector<uint32_t> &key_columns);
+
+    // Index only the given rows; row_ids must outlive the table
+    JoinHashTable(const uint32_t *cells, uint32_t row_width, const uint32_t *row_ids, size_t num_row_ids, const std::vector<uint32_t> &key_columns);
+
+    // Call match(build_row_index) for every indexed row whose key equals the probe row's key
+    template <typename F>
+    void forEachMatch(const uint32_t *probe_row, const std::vector<uint32_t> &probe_key_columns, F match) const
+    {
+        forEachMatch(probe_row, probe_key_columns, HashKey(probe_row, probe_key_columns), match);
+    }
+
+    // Same with the probe row's HashKey already computed
+    template <typename F>
+    void forEachMatch(const uint32_t *probe_row, const std::vector<uint32_t> &probe_key_columns, uint64_t hash, F match) const
+    {
+        for (uint32_t entry = heads_[hash & mask_]; entry != NONE; entry = next_[entry])
+        {
+            uint32_t row = row_ids_ == nullptr ? entry : row_ids_[entry];
+            if (hashes_[entry] == hash && KeysEqual(cells_ + size_t(row) * row_width_, key_columns_, probe_row, probe_key_columns))
+            {
+                match(row);
+            }
+        }
+    }
+
+    size_t size() const { return next_.size(); }
+
+    // Start loading the bucket a hash falls in, ahead of probing it
+    void prefetch(uint64_t hash) const { __builtin_prefetch(&heads_[hash & mask_]); }
+
+private:
+    static constexpr uint32_t NONE = 0xFFFFFFFFu;
+
+    const uint32_t *cells_;
+    uint32_t row_width_;
+    std::vector<uint32_t> key_columns_;
+    const uint32_t *row_ids_;       // nullptr when every row is indexed
+    uint64_t mask_;
+    PooledBuffer<uint32_t> heads_;  // first entry of each bucket
+    PooledBuffer<uint32_t> next_;   // next entry in the same bucket
+    PooledBuffer<uint64_t> hashes_; // full hash per entry, checked before comparing keys
+
+    void build(size_t num_entries);
+};
+
+// Row-major cells of one join input
+struct JoinInput
+{
+    const uint32_t *cells;
+    uint32_t width;
+    uint32_t num_rows;
+    std::vector<uint32_t> key_columns;
+    const ValidityBitmap *validity = nullptr; // nullptr when the input has no NULLs
+};
+
+// Rows with a NULL key cell never match anything
+inline bool KeyIsValid(const JoinInput &input, uint32_t row)
+{
+    if (input.validity == nullptr)
+    {
+        return true;
+    }
+    for (uint32_t column : input.key_columns)
+    {
+        if (!input.validity->isValid(row, column))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Row id reported for the missing side of an outer join output row (its cells are NULL and written as 0)
+const uint32_t JOIN_NO_ROW = 0xFFFFFFFFu;
+
+// Receives batches of output rows, each the left row followed by the right row, along with the
+// input rows they came from. Never called by two threads at once.
+typedef std::function<void(const uint32_t *rows, size_t num_rows, const uint32_t *left_ids, const uint32_t *right_ids)> JoinEmit;
+
+// Equi-join building on the smaller input and streaming the larger one past it
+void HashJoin(const JoinInput &left, const JoinInput &right, const JoinEmit &emit);
+
+// Radix-partitioned equi-join: both inputs are split by key hash into cache-sized partitions
+// which num_threads threads then build and probe independently, each into its own output buffer
+void PartitionedHashJoin(const JoinInput &left, const JoinInput &right, size_t num_threads, const JoinEmit &emit);
+
+// Full outer equi-join: matches as in HashJoin, then every row of either input that matched nothing
+// paired with JOIN_NO_ROW. Build rows that found a match are tracked in a bitset, so the unmatched
+// ones come from one pass over it rather than another scan of the table.
+void HashFullOuterJoin(const JoinInput &left, const JoinInput &right, const JoinEmit &emit);
+
+#endif
@@ -0,0 +1,130 @@
+#include "mapped_file.hpp"
+#include "instrumentation.hpp"
+
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    // Address space reserved for a mapping at least; only mapped pages cost memory
+    const size_t MIN_RESERVATION = size_t(1) << 30;
+}
+
+MappedFile::MappedFile() : fd_(-1), data_(nullptr), size_(0), capacity_(0) {}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string &file_name)
+{
+    close();
+
+    RT_COUNT(FileOpens);
+    fd_ = ::open(file_name.c_str(), O_RDONLY);
+    if (fd_ < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fstat(fd_, &st) != 0 || !map(st.st_size))
+    {
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (capacity_ != 0)
+    {
+        munmap(const_cast<uint8_t *>(data_.load()), capacity_);
+        capacity_ = 0;
+    }
+    for (const std::pair<void *, size_t> &reservation : retired_)
+    {
+        munmap(reservation.first, reservation.second);
+    }
+    retired_.clear();
+    data_ = nullptr;
+    size_ = 0;
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool MappedFile::refresh()
+{
+    if (fd_ < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd_, &st) != 0)
+    {
+        return false;
+    }
+    if (size_t(st.st_size) <= size())
+    {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_t(st.st_size) <= size() || map(st.st_size);
+}
+
+bool MappedFile::map(size_t size)
+{
+    if (size == 0)
+    {
+        return false;
+    }
+
+    // a file past the reservation moves to a new one twice its size; the old one stays for old pointers
+    uint8_t *base = const_cast<uint8_t *>(data_.load());
+    size_t capacity = capacity_;
+    if (size > capacity)
+    {
+        size_t page = size_t(sysconf(_SC_PAGESIZE));
+        capacity = (std::max(MIN_RESERVATION, 2 * size) + page - 1) / page * page;
+        void *reserved = mmap(nullptr, capacity, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (reserved == MAP_FAILED)
+        {
+            return false;
+        }
+        base = static_cast<uint8_t *>(reserved);
+    }
+
+    // replaces the pages mapped before in one step, so readers never see a hole
+    RT_COUNT(FileMaps);
+    if (mmap(base, size, PROT_READ, MAP_SHARED | MAP_FIXED, fd_, 0) == MAP_FAILED)
+    {
+        if (capacity != capacity_)
+        {
+            munmap(base, capacity);
+        }
+        return false;
+    }
+    if (capacity != capacity_ && capacity_ != 0)
+    {
+        retired_.push_back({const_cast<uint8_t *>(data_.load()), capacity_});
+    }
+    capacity_ = capacity;
+    // the new base before the new size: whoever sees the size sees the mapping covering it
+    data_.store(base, std::memory_order_release);
+    size_.store(size, std::memory_order_release);
+    return true;
+}
@@ -0,0 +1,48 @@
+#ifndef _mapped_file_h_
+#define _mapped_file_h_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Read-only memory mapping of a whole file. The mapping sits at the start of a reserved stretch of
+// address space and grows in place as the file grows, so pointers into it stay valid until close(),
+// whoever refreshes it and from whichever thread. Should the file outgrow the reservation, it moves to
+// a bigger one and the old one is kept mapped until close() as well.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // Map the file, replacing any previous mapping
+    bool open(const std::string &file_name);
+    void close();
+
+    // Map the rest of the file if it grew since it was mapped; pointers taken before stay valid
+    bool refresh();
+
+    // Read size() before data() when another thread may refresh: the data() seen then covers that size
+    bool isOpen() const { return data_.load(std::memory_order_acquire) != nullptr; }
+    const uint8_t *data() const { return data_.load(std::memory_order_acquire); }
+    size_t size() const { return size_.load(std::memory_order_acquire); }
+
+private:
+    int fd_;
+    std::atomic<const uint8_t *> data_;
+    std::atomic<size_t> size_;
+    size_t capacity_;                                 // bytes reserved at data_
+    std::vector<std::pair<void *, size_t>> retired_;  // reservations the file outgrew, kept for old pointers
+    std::mutex mutex_;                                // serializes refreshes
+
+    bool map(size_t size);
+};
+
+#endif
@@ -0,0 +1,167 @@
+#include "query_memory.hpp"
+
+#include <new>
+
+namespace
+{
+    thread_local QueryMemory *current_query_memory = nullptr;
+
+    // Requests above this get a block of their own instead of a share of the current one
+    const size_t DEDICATED_BLOCK_BYTES = QueryMemory::BLOCK_SIZE / 4;
+
+    size_t sizeClassOf(size_t bytes, size_t &capacity)
+    {
+        size_t size_class = 0;
+        capacity = QueryMemory::BUFFER_ALIGNMENT;
+        while (capacity < bytes)
+        {
+            capacity <<= 1;
+            size_class++;
+        }
+        return size_class;
+    }
+}
+
+QueryMemory::QueryMemory(size_t limit)
+    : limit_(limit), reserved_(0), peak_(0), exceeded_(false), cursor_(nullptr), end_(nullptr)
+{
+}
+
+QueryMemory::~QueryMemory()
+{
+    release();
+}
+
+void *QueryMemory::allocate(size_t bytes, size_t alignment)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return allocateLocked(bytes, alignment);
+}
+
+void *QueryMemory::takeBuffer(size_t bytes, size_t &capacity)
+{
+    size_t size_class = sizeClassOf(bytes, capacity);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (size_class < free_buffers_.size() && !free_buffers_[size_class].empty())
+    {
+        void *buffer = free_buffers_[size_class].back();
+        free_buffers_[size_class].pop_back();
+        return buffer;
+    }
+    return allocateLocked(capacity, BUFFER_ALIGNMENT);
+}
+
+void QueryMemory::giveBack(void *buffer, size_t capacity)
+{
+    size_t size_class = sizeClassOf(capacity, capacity);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (size_class >= free_buffers_.size())
+    {
+        free_buffers_.resize(size_class + 1);
+    }
+    free_buffers_[size_class].push_back(buffer);
+}
+
+void QueryMemory::release()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const Block &block : blocks_)
+    {
+        ::operator delete[](block.data, std::align_val_t(BUFFER_ALIGNMENT));
+    }
+    blocks_.clear();
+    free_buffers_.clear();
+    cursor_ = end_ = nullptr;
+    reserved_ = 0;
+}
+
+size_t QueryMemory::reserved() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return reserved_;
+}
+
+size_t QueryMemory::peak() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return peak_;
+}
+
+bool QueryMemory::exceeded() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return exceeded_;
+}
+
+void *QueryMemory::allocateLocked(size_t bytes, size_t alignment)
+{
+    if (alignment > BUFFER_ALIGNMENT)
+    {
+        throw "Query memory alignment above 64 bytes";
+    }
+    if (bytes > DEDICATED_BLOCK_BYTES)
+    {
+        return newBlock(bytes);
+    }
+
+    uintptr_t aligned = (reinterpret_cast<uintptr_t>(cursor_) + alignment - 1) & ~uintptr_t(alignment - 1);
+    if (cursor_ == nullptr || aligned + bytes > reinterpret_cast<uintptr_t>(end_))
+    {
+        // the rest of the old block is given up
+        cursor_ = newBlock(BLOCK_SIZE);
+        end_ = cursor_ + BLOCK_SIZE;
+        aligned = reinterpret_cast<uintptr_t>(cursor_);
+    }
+    cursor_ = reinterpret_cast<uint8_t *>(aligned + bytes);
+    return reinterpret_cast<void *>(aligned);
+}
+
+uint8_t *QueryMemory::newBlock(size_t bytes)
+{
+    if (limit_ != 0 && reserved_ + bytes > limit_)
+    {
+        exceeded_ = true;
+        throw "Query memory limit exceeded";
+    }
+    uint8_t *data = static_cast<uint8_t *>(::operator new[](bytes, std::align_val_t(BUFFER_ALIGNMENT)));
+    blocks_.push_back({data, bytes});
+    reserved_ += bytes;
+    peak_ = std::max(peak_, reserved_);
+    return data;
+}
+
+QueryMemory *CurrentQueryMemory()
+{
+    return current_query_memory;
+}
+
+QueryMemoryScope::QueryMemoryScope(QueryMemory *memory) : previous_(current_query_memory)
+{
+    current_query_memory = memory;
+}
+
+QueryMemoryScope::~QueryMemoryScope()
+{
+    current_query_memory = previous_;
+}
+
+void *AcquireBuffer(size_t bytes, QueryMemory *&owner, size_t &capacity)
+{
+    owner = current_query_memory;
+    if (owner != nullptr)
+    {
+        return owner->takeBuffer(bytes, capacity);
+    }
+    capacity = bytes;
+    return ::operator new[](bytes, std::align_val_t(QueryMemory::BUFFER_ALIGNMENT));
+}
+
+void ReleaseBuffer(void *buffer, QueryMemory *owner, size_t capacity)
+{
+    if (owner != nullptr)
+    {
+        owner->giveBack(buffer, capacity);
+        return;
+    }
+    ::operator delete[](buffer, std::align_val_t(QueryMemory::BUFFER_ALIGNMENT));
+}
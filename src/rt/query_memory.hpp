@@ -0,0 +1,253 @@
+#ifndef _query_memory_h_
+#define _query_memory_h_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Memory of one query: an arena of large blocks that operators carve their scratch space out of, with
+// buffers handed back during the query kept per size class and reused by the next request of that size.
+// Everything goes back to the system at once when the query finishes (release() or the destructor), so
+// nothing handed out may be used after that. Blocks count against an optional limit; going over it throws
+// "Query memory limit exceeded", like the decode errors. Safe to use from several threads.
+class QueryMemory
+{
+public:
+    // Blocks are this big unless a single request needs more
+    static const size_t BLOCK_SIZE = 256 << 10;
+
+    // Every buffer starts on a cache line
+    static const size_t BUFFER_ALIGNMENT = 64;
+
+    // limit in bytes, 0 for none
+    explicit QueryMemory(size_t limit = 0);
+    ~QueryMemory();
+
+    QueryMemory(const QueryMemory &) = delete;
+    QueryMemory &operator=(const QueryMemory &) = delete;
+
+    // Bytes that stay allocated until the query finishes
+    void *allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+    // A buffer of at least bytes bytes from the pool; capacity receives its actual size (a power of two)
+    void *takeBuffer(size_t bytes, size_t &capacity);
+
+    // Hand a buffer from takeBuffer back to the pool for reuse
+    void giveBack(void *buffer, size_t capacity);
+
+    // Free every block; the limit stays and so does the peak
+    void release();
+
+    size_t limit() const { return limit_; }
+
+    // Bytes in blocks now and at most so far
+    size_t reserved() const;
+    size_t peak() const;
+
+    // Whether a request was refused for going over the limit
+    bool exceeded() const;
+
+private:
+    struct Block
+    {
+        uint8_t *data;
+        size_t size;
+    };
+
+    mutable std::mutex mutex_;
+    size_t limit_;
+    size_t reserved_;
+    size_t peak_;
+    bool exceeded_;
+    std::vector<Block> blocks_;
+    uint8_t *cursor_; // free space of the last small-request block
+    uint8_t *end_;
+    std::vector<std::vector<void *>> free_buffers_; // by size class, BUFFER_ALIGNMENT << class bytes
+
+    void *allocateLocked(size_t bytes, size_t alignment);
+    uint8_t *newBlock(size_t bytes);
+};
+
+// Memory of the query the calling thread works on, nullptr outside of one. ThreadPool tasks run with the
+// memory of the thread that submitted them.
+QueryMemory *CurrentQueryMemory();
+
+// Makes memory the current query memory of this thread until the scope ends
+class QueryMemoryScope
+{
+public:
+    explicit QueryMemoryScope(QueryMemory *memory);
+    ~QueryMemoryScope();
+
+    QueryMemoryScope(const QueryMemoryScope &) = delete;
+    QueryMemoryScope &operator=(const QueryMemoryScope &) = delete;
+
+private:
+    QueryMemory *previous_;
+};
+
+// Buffers for PooledBuffer: from the current query's pool (owner set to it), or from the heap outside of a query
+void *AcquireBuffer(size_t bytes, QueryMemory *&owner, size_t &capacity);
+void ReleaseBuffer(void *buffer, QueryMemory *owner, size_t capacity);
+
+// Growable array of plain values drawn from the current query memory (the heap outside of a query), 64-byte
+// aligned. Growing keeps the values; new elements are left uninitialized. The buffer goes back to the memory
+// it came from, so it must not outlive the query.
+template <typename T>
+class PooledBuffer
+{
+    static_assert(std::is_trivially_copyable<T>::value, "PooledBuffer holds plain values");
+
+public:
+    PooledBuffer() : owner_(nullptr), data_(nullptr), size_(0), capacity_bytes_(0) {}
+
+    explicit PooledBuffer(size_t size) : PooledBuffer() { resize(size); }
+
+    ~PooledBuffer() { clear(); }
+
+    PooledBuffer(PooledBuffer &&other) : PooledBuffer() { swap(other); }
+
+    PooledBuffer &operator=(PooledBuffer &&other)
+    {
+        PooledBuffer(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    PooledBuffer(const PooledBuffer &) = delete;
+    PooledBuffer &operator=(const PooledBuffer &) = delete;
+
+    T *data() { return data_; }
+    const T *data() const { return data_; }
+    T &operator[](size_t i) { return data_[i]; }
+    const T &operator[](size_t i) const { return data_[i]; }
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_bytes_ / sizeof(T); }
+    bool empty() const { return size_ == 0; }
+
+    void resize(size_t size)
+    {
+        reserve(size);
+        size_ = size;
+    }
+
+    void assign(size_t size, T value)
+    {
+        resize(size);
+        std::fill(data_, data_ + size, value);
+    }
+
+    void reserve(size_t size)
+    {
+        if (size <= capacity())
+        {
+            return;
+        }
+        QueryMemory *owner;
+        size_t capacity_bytes;
+        T *data = static_cast<T *>(AcquireBuffer(size * sizeof(T), owner, capacity_bytes));
+        if (size_ != 0)
+        {
+            std::memcpy(static_cast<void *>(data), data_, size_ * sizeof(T));
+        }
+        size_t kept = size_;
+        clear();
+        owner_ = owner;
+        data_ = data;
+        size_ = kept;
+        capacity_bytes_ = capacity_bytes;
+    }
+
+    // Give the buffer back
+    void clear()
+    {
+        if (data_ != nullptr)
+        {
+            ReleaseBuffer(data_, owner_, capacity_bytes_);
+        }
+        owner_ = nullptr;
+        data_ = nullptr;
+        size_ = 0;
+        capacity_bytes_ = 0;
+    }
+
+    void swap(PooledBuffer &other)
+    {
+        std::swap(owner_, other.owner_);
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(capacity_bytes_, other.capacity_bytes_);
+    }
+
+private:
+    QueryMemory *owner_;
+    T *data_;
+    size_t size_;
+    size_t capacity_bytes_;
+};
+
+// Allocator for standard containers whose elements aren't plain values or that need to stay copyable (a
+// hash table, a bitmap handed back to the caller): draws from the query memory current when the container
+// is made (the heap outside of a query) through the same pool as PooledBuffer, so it counts against the
+// limit. A copy draws from the memory current where it is made; moving and swapping take the memory along.
+template <typename T>
+class QueryAllocator
+{
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    QueryAllocator() : memory_(CurrentQueryMemory()) {}
+
+    template <typename U>
+    QueryAllocator(const QueryAllocator<U> &other) : memory_(other.memory()) {}
+
+    T *allocate(size_t n)
+    {
+        if (memory_ == nullptr)
+        {
+            return static_cast<T *>(::operator new(n * sizeof(T)));
+        }
+        size_t capacity;
+        return static_cast<T *>(memory_->takeBuffer(n * sizeof(T), capacity));
+    }
+
+    void deallocate(T *data, size_t n)
+    {
+        if (memory_ == nullptr)
+        {
+            ::operator delete(data);
+            return;
+        }
+        memory_->giveBack(data, n * sizeof(T));
+    }
+
+    QueryAllocator select_on_container_copy_construction() const { return QueryAllocator(); }
+
+    QueryMemory *memory() const { return memory_; }
+
+private:
+    QueryMemory *memory_;
+};
+
+template <typename T, typename U>
+bool operator==(const QueryAllocator<T> &a, const QueryAllocator<U> &b)
+{
+    return a.memory() == b.memory();
+}
+
+template <typename T, typename U>
+bool operator!=(const QueryAllocator<T> &a, const QueryAllocator<U> &b)
+{
+    return a.memory() != b.memory();
+}
+
+template <typename T>
+using QueryVector = std::vector<T, QueryAllocator<T>>;
+
+#endif
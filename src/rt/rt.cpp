@@ -1,15 +1,117 @@
 #include "rt.hpp"
 #include "helper.hpp"
-
+#include "table_writer.hpp"
+#include "join.hpp"
+#include "instrumentation.hpp"
+#include "async_io.hpp"
+#include "../columnar-rt/columnar_rt.hpp"
+#include "../columnar-rt/row_group_pipeline.hpp"
+
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 // RelationalTable
 
+// Block size for each side of a cross join, so a left and a right block share L2
+const size_t CROSS_JOIN_BLOCK_BYTES = 128 << 10;
+
+namespace
+{
+    // Whether every column's type fits the 32-bit cells of a table; the 64-bit tags can't be stored yet
+    bool fitsCells(const TableSchema &schema, const std::string &file_name)
+    {
+        for (uint32_t c = 0; c < schema.numColumns(); c++)
+        {
+            if (!WithCellType(schema.types[c], [](auto) {}))
+            {
+                std::cerr << "Error: Column " << c << " of table " << file_name << " is " << ColumnTypeName(schema.types[c])
+                          << ", but table cells are 32 bits" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Mark the cells of output row `row` that are NULL: all of a side whose row id is JOIN_NO_ROW,
+    // otherwise whatever was NULL in that input row
+    void markJoinNulls(TableWriter &writer, uint32_t row, const ValidityBitmap *validity, uint32_t first_column, uint32_t width, uint32_t row_id)
+    {
+        if (row_id == JOIN_NO_ROW)
+        {
+            for (uint32_t c = 0; c < width; c++)
+            {
+                writer.setNull(row, first_column + c);
+            }
+            return;
+        }
+        if (validity == nullptr || validity->blockValid(row_id / 64))
+        {
+            return;
+        }
+        for (uint32_t c = 0; c < width; c++)
+        {
+            if (!validity->isValid(row_id, c))
+            {
+                writer.setNull(row, first_column + c);
+            }
+        }
+    }
+
+    // Call run(begin, end) for every stretch [begin, end) of rows first .. first + count - 1 (counted
+    // from first) whose cells of the column are valid, joining whole valid 64-row blocks into one stretch.
+    // first must be a multiple of 64.
+    template <typename F>
+    void forValidRuns(const ValidityBitmap *validity, uint32_t column, uint32_t first, uint32_t count, F run)
+    {
+        if (validity == nullptr)
+        {
+            run(0u, count);
+            return;
+        }
+        uint32_t begin = 0, end = 0;
+        auto add = [&](uint32_t b, uint32_t e)
+        {
+            if (b != end)
+            {
+                if (begin != end)
+                {
+                    run(begin, end);
+                }
+                begin = b;
+            }
+            end = e;
+        };
+        for (uint32_t b = 0; b < count; b += 64)
+        {
+            uint32_t n = std::min<uint32_t>(64, count - b);
+            uint64_t mask = n == 64 ? ValidityBitmap::ALL_VALID : (1ull << n) - 1;
+            uint64_t word = validity->word((first + b) / 64, column) & mask;
+            if (word == mask)
+            {
+                add(b, b + n);
+                continue;
+            }
+            for (; word != 0; word &= word - 1)
+            {
+                uint32_t i = b + __builtin_ctzll(word);
+                add(i, i + 1);
+            }
+        }
+        if (begin != end)
+        {
+            run(begin, end);
+        }
+    }
+}
 
-RelationalTable::RelationalTable() {}
+RelationalTable::RelationalTable() : data_offset_(2 * sizeof(uint32_t)) {}
 
-RelationalTable::RelationalTable(const std::string &file_name) : file_name_(file_name)
+RelationalTable::RelationalTable(const std::string &file_name) : file_name_(file_name), data_offset_(2 * sizeof(uint32_t))
 {
     if (!parseMetadata())
     {
@@ -17,16 +119,32 @@ RelationalTable::RelationalTable(const std::string &file_name) : file_name_(file
     }
 }
 
-RelationalTable::RelationalTable(const std::string &file_name, const uint32_t num_columns) : file_name_(file_name), num_columns_(num_columns)
+RelationalTable::RelationalTable(const std::string &file_name, const uint32_t num_columns) : RelationalTable(file_name, num_columns, TableSchema())
+{
+}
+
+RelationalTable::RelationalTable(const std::string &file_name, const TableSchema &schema) : RelationalTable(file_name, schema.numColumns(), schema)
+{
+}
+
+RelationalTable::RelationalTable(const std::string &file_name, uint32_t num_columns, const TableSchema &schema)
+    : file_name_(file_name), num_columns_(num_columns), data_offset_(2 * sizeof(uint32_t))
 {
     if (fileExists(file_name))
     {
         std::cerr << "Error: Table " << file_name << " already exists" << std::endl;
         return;
     }
+    if (!fitsCells(schema, file_name))
+    {
+        return;
+    }
 
     createFile(file_name);
+    // a NULL bitmap left over from an earlier table of the same name
+    removeFile(ValidityBitmap::fileNameFor(file_name));
 
+    schema_ = schema;
     if (!writeMetadata(0, num_columns))
     {
         std::cerr << "Error: Unable to write metadata for table " << file_name << std::endl;
@@ -34,44 +152,70 @@ RelationalTable::RelationalTable(const std::string &file_name, const uint32_t nu
 
     this->num_entries_ = 0;
     this->num_columns_ = num_columns;
+    handle_ = OpenTableHandle(file_name);
 }
 
 // uses float--we don't really need uint32_t
 void RelationalTable::printTable() const
 {
-    std::ifstream file(file_name_, std::ios::binary | std::ios::in);
-    if (!file.is_open())
+    RT_TIME_PHASE(Output);
+    // map the file once instead of reopening it for every row
+    std::shared_ptr<MappedFile> mapping = mapping_;
+    if (!mapping)
     {
-        std::cerr << "Error: Unable to open file " << file_name_ << std::endl;
-        return;
+        mapping = std::make_shared<MappedFile>();
+        if (!mapping->open(file_name_))
+        {
+            std::cerr << "Error: Unable to open file " << file_name_ << std::endl;
+            return;
+        }
     }
 
     std::cout << "Table Name: " << file_name_ << std::endl;
     std::cout << "Number of entries: " << num_entries_ << std::endl;
     std::cout << "Number of columns: " << num_columns_ << std::endl;
+    if (!schema_.empty())
+    {
+        std::cout << "Schema: " << schema_.toString() << std::endl;
+    }
 
     // calculate the size of a row in bytes
     uint32_t row_size = calculateRowSize();
+    size_t data_size = mapping->size() - std::min<size_t>(mapping->size(), data_offset_);
+    uint32_t num_rows = std::min<size_t>(num_entries_, row_size == 0 ? 0 : data_size / row_size);
 
-    // loop through each row and print the data
-    for (int i = 0; i < num_entries_; i++)
+    // one printer per column for its type, picked here instead of for every cell
+    std::vector<void (*)(std::ostream &, uint32_t)> printers(num_columns_, &PrintCell<float>);
+    for (uint32_t c = 0; c < schema_.numColumns(); c++)
     {
-        // calculate the offset to the row_index
-        uint32_t offset = sizeof(num_entries_) + sizeof(num_columns_) + i * row_size;
-
-        // seek to the offset
-        file.seekg(offset);
+        WithCellType(schema_.types[c], [&](auto traits)
+                     { printers[c] = &PrintCell<typename decltype(traits)::value_type>; });
+    }
 
-        // read the row data
-        for (float item : this->getRow_float(i))
+    // loop through each row and print the data
+    const uint32_t *cells = reinterpret_cast<const uint32_t *>(mapping->data() + data_offset_);
+    const ValidityBitmap *validity = validity_.get();
+    bool check_nulls = false;
+    for (uint32_t i = 0; i < num_rows; i++)
+    {
+        // NULL checks only in blocks of 64 rows that have a NULL somewhere
+        if (i % 64 == 0)
         {
-            std::cout << item << " ";
+            check_nulls = validity != nullptr && !validity->blockValid(i / 64);
+        }
+        for (uint32_t c = 0; c < num_columns_; c++)
+        {
+            if (check_nulls && !validity->isValid(i, c))
+            {
+                std::cout << "NULL ";
+                continue;
+            }
+            printers[c](std::cout, cells[size_t(i) * num_columns_ + c]);
+            std::cout << " ";
         }
 
         std::cout << std::endl;
     }
-
-    file.close();
 }
 
 void RelationalTable::addRow_uint32_t(const std::vector<uint32_t> &row_data)
@@ -82,242 +226,811 @@ void RelationalTable::addRow_uint32_t(const std::vector<uint32_t> &row_data)
         return;
     }
 
-    std::ofstream file(other.file_name_, std::ios::binary | std::ios::app);
-    if (!file.is_open())
+    appendRows_uint32_t(row_data.data(), 1);
+}
+
+void RelationalTable::addRow_float(const std::vector<float> &row_data)
+{
+    if (row_data.size() != num_columns_)
     {
-        std::cerr << "Error: Unable to open file " << other.file_name_ << std::endl;
+        std::cerr << "Error: Row data size does not match number of columns" << std::endl;
         return;
     }
 
-    // loop through row_data and write each entry to the file
-    // for (const auto& entry : row_data) {
-    //     file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
-    // }
+    appendRows_float(row_data.data(), 1);
+}
 
-    // write the entire row_data vector to the file
-    file.write(reinterpret_cast<const char *>(row_data.data()), row_data.size() * sizeof(row_data[0]));
+bool RelationalTable::appendRows_uint32_t(const uint32_t *rows, size_t num_rows)
+{
+    TableWriter writer(file_name_);
+    if (!writer.isOpen() || writer.numColumns() != num_columns_)
+    {
+        return false;
+    }
 
-    file.close();
-    this->num_entries_++;
-    writeNumEntries(num_entries_);
+    bool written = writer.appendRows_uint32_t(rows, num_rows) && writer.close();
+    this->num_entries_ = writer.numEntries();
+    return written;
 }
 
-void RelationalTable::addRow_float(const std::vector<float> &row_data)
+bool RelationalTable::appendRows_float(const float *rows, size_t num_rows)
 {
-    if (row_data.size() != num_columns_)
+    return appendRows_uint32_t(reinterpret_cast<const uint32_t *>(rows), num_rows);
+}
+
+std::vector<uint32_t> RelationalTable::getRow_uint32_t(uint32_t row_index) const
+{
+    if (mapping_)
     {
-        std::cerr << "Error: Row data size does not match number of columns" << std::endl;
-        return;
+        RowView<uint32_t> row = viewRow_uint32_t(row_index);
+        return std::vector<uint32_t>(row.begin(), row.end());
     }
 
-    std::ofstream file(file_name_, std::ios::binary | std::ios::app);
-    if (!file.is_open())
+    std::vector<uint32_t> row_data(num_columns_);
+    if (!readRow(row_index, row_data.data()))
     {
-        std::cerr << "Error: Unable to open file " << file_name_ << std::endl;
-        return;
+        return {};
     }
+    return row_data;
+}
 
-    // write the entire row_data vector to the file
-    file.write(reinterpret_cast<const char *>(row_data.data()), row_data.size() * sizeof(row_data[0]));
+std::vector<float> RelationalTable::getRow_float(uint32_t row_index) const
+{
+    if (mapping_)
+    {
+        RowView<float> row = viewRow_float(row_index);
+        return std::vector<float>(row.begin(), row.end());
+    }
 
-    file.close();
-    this->num_entries_++;
-    writeNumEntries(num_entries_);
+    std::vector<float> row_data(num_columns_);
+    if (!readRow(row_index, row_data.data()))
+    {
+        return {};
+    }
+    return row_data;
 }
 
-std::vector<uint32_t> RelationalTable::getRow_uint32_t(uint32_t row_index) const
+bool RelationalTable::readRow(uint32_t row_index, void *cells) const
 {
-    std::ifstream file(file_name_, std::ios::binary | std::ios::in);
-    if (!file.is_open())
+    if (!handle_)
     {
         std::cerr << "Error: Unable to open file " << file_name_ << std::endl;
-        return {};
+        return false;
+    }
+
+    if (row_index >= readNumEntries())
+    {
+        std::cerr << "Error: Row " << row_index << " is past the end of " << file_name_ << std::endl;
+        return false;
     }
 
     // calculate the size of a row in bytes
     uint32_t row_size = calculateRowSize();
     // calculate the offset to the row_index
-    uint32_t offset = sizeof(num_entries_) + sizeof(num_columns_) + row_index * row_size;
+    off_t offset = data_offset_ + off_t(row_index) * row_size;
 
-    // seek to the offset
-    file.seekg(offset);
+    // read the row data through the table's descriptor; a committed row is always all there
+    RT_COUNT_READ(row_size);
+    if (pread(handle_->fd(), cells, row_size, offset) != ssize_t(row_size))
+    {
+        std::cerr << "Error: Unable to read row " << row_index << " of " << file_name_ << std::endl;
+        return false;
+    }
+    return true;
+}
 
-    // read the row data
-    std::vector<uint32_t> row_data(num_columns_);
-    file.read(reinterpret_cast<char *>(row_data.data()), row_data.size() * sizeof(row_data[0]));
+bool RelationalTable::mapFile()
+{
+    std::shared_ptr<MappedFile> mapping = std::make_shared<MappedFile>();
+    if (!mapping->open(file_name_))
+    {
+        std::cerr << "Error: Unable to map file " << file_name_ << std::endl;
+        return false;
+    }
+    mapping_ = mapping;
+    loadValidity();
+    return true;
+}
 
-    file.close();
-    return row_data;
+bool RelationalTable::isMapped() const
+{
+    return mapping_ != nullptr;
 }
 
-std::vector<float> RelationalTable::getRow_float(uint32_t row_index) const
+const uint8_t *RelationalTable::mappedRow(uint32_t row_index) const
 {
-    std::ifstream file(file_name_, std::ios::binary | std::ios::in);
-    if (!file.is_open())
+    if (!mapping_)
     {
-        std::cerr << "Error: Unable to open file " << file_name_ << std::endl;
-        return {};
+        return nullptr;
     }
 
-    // calculate the size of a row in bytes
     uint32_t row_size = calculateRowSize();
-    // calculate the offset to the row_index
-    uint32_t offset = sizeof(num_entries_) + sizeof(num_columns_) + row_index * row_size;
+    size_t offset = data_offset_ + size_t(row_index) * row_size;
 
-    // seek to the offset
-    file.seekg(offset);
+    // the row must be committed in the header and inside the mapping; if not, the file may have grown
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        uint32_t mapped_entries = LoadCommittedCount(mapping_->data());
+        if (row_index < mapped_entries && offset + row_size <= mapping_->size())
+        {
+            return mapping_->data() + offset;
+        }
+        if (attempt == 0 && !mapping_->refresh())
+        {
+            break;
+        }
+    }
+    return nullptr;
+}
 
-    // read the row data
-    std::vector<float> row_data(num_columns_);
-    file.read(reinterpret_cast<char *>(row_data.data()), row_data.size() * sizeof(row_data[0]));
+const uint32_t *RelationalTable::mappedCells(uint32_t &num_rows) const
+{
+    num_rows = 0;
+    if (!mapping_ || !mapping_->refresh())
+    {
+        return nullptr;
+    }
 
-    file.close();
-    return row_data;
+    // a snapshot: rows appended after this aren't part of the scan
+    size_t mapped_size = mapping_->size();
+    const uint8_t *data = mapping_->data();
+    uint32_t mapped_entries = LoadCommittedCount(data);
+    size_t data_size = mapped_size - std::min<size_t>(mapped_size, data_offset_);
+    num_rows = num_columns_ == 0 ? 0 : std::min<size_t>(mapped_entries, data_size / calculateRowSize());
+    return reinterpret_cast<const uint32_t *>(data + data_offset_);
 }
 
-// Perform a join operation with another table and make the new file
-RelationalTable RelationalTable::full_outer_join(const RelationalTable &other, const std::string &new_table_file_name) const 
+RowView<uint32_t> RelationalTable::viewRow_uint32_t(uint32_t row_index) const
 {
-    // Left Table Open
-    RelationalTable table_left = *this;
-    RelationalTable table_right = other;
+    const uint8_t *row = mappedRow(row_index);
+    if (row == nullptr)
+    {
+        std::cerr << "Error: Row " << row_index << " is not mapped in " << file_name_ << std::endl;
+        return {nullptr, 0};
+    }
+    return {reinterpret_cast<const uint32_t *>(row), num_columns_};
+}
 
-    // Get the number of columns for the new table
-    uint32_t num_columns_new = table_left.num_columns_ + table_right.num_columns_;
+RowView<float> RelationalTable::viewRow_float(uint32_t row_index) const
+{
+    const uint8_t *row = mappedRow(row_index);
+    if (row == nullptr)
+    {
+        std::cerr << "Error: Row " << row_index << " is not mapped in " << file_name_ << std::endl;
+        return {nullptr, 0};
+    }
+    return {reinterpret_cast<const float *>(row), num_columns_};
+}
 
-    // New Table Open
-    RelationalTable table_new(new_table_file_name, num_columns_new);
+ColumnView<uint32_t> RelationalTable::viewColumn_uint32_t(uint32_t column_index) const
+{
+    uint32_t num_rows;
+    const uint32_t *cells = mappedCells(num_rows);
+    if (cells == nullptr || column_index >= num_columns_)
+    {
+        std::cerr << "Error: Column " << column_index << " is not mapped in " << file_name_ << std::endl;
+        return {nullptr, 0, 0};
+    }
+    return {cells + column_index, num_rows, num_columns_};
+}
+
+ColumnView<float> RelationalTable::viewColumn_float(uint32_t column_index) const
+{
+    ColumnView<uint32_t> column = viewColumn_uint32_t(column_index);
+    return {reinterpret_cast<const float *>(column.data_), column.size_, column.stride_};
+}
+
+ColumnView<int32_t> RelationalTable::viewColumn_int32_t(uint32_t column_index) const
+{
+    ColumnView<uint32_t> column = viewColumn_uint32_t(column_index);
+    return {reinterpret_cast<const int32_t *>(column.data_), column.size_, column.stride_};
+}
 
-    // Left Table Open
-    std::ifstream file_left(file_name_, std::ios::binary | std::ios::in);
-    if (!file_left.is_open())
+SelectionBitmap RelationalTable::filter(const std::vector<Predicate> &predicates) const
+{
+    RT_TIME_PHASE(Filter);
+    // read through a mapping, a copy so the caller's table stays as it is
+    RelationalTable table = *this;
+    if (!table.mapFile())
     {
-        std::cerr << "Error: Unable to open file " << file_name_ << std::endl;
-        return RelationalTable();
+        return SelectionBitmap();
     }
+    uint32_t num_rows;
+    const uint32_t *cells = table.mappedCells(num_rows);
 
-    // Right Table Open
-    std::ifstream file_right(other.file_name_, std::ios::binary | std::ios::in);
-    if (!file_right.is_open())
+    SelectionBitmap selection(num_rows);
+    selection.setRange(0, num_rows);
+    for (const Predicate &predicate : predicates)
     {
-        std::cerr << "Error: Unable to open file " << other.file_name_ << std::endl;
-        return RelationalTable();
+        if (predicate.column >= num_columns_)
+        {
+            std::cerr << "Error: Column " << predicate.column << " is out of range in " << file_name_ << std::endl;
+            return SelectionBitmap(num_rows);
+        }
+
+        SelectionBitmap predicate_selection(num_rows);
+        EvaluatePredicate(predicate, cells + predicate.column, num_rows, num_columns_, 0, predicate_selection);
+        if (table.validity_)
+        {
+            QueryVector<uint64_t> &words = predicate_selection.words();
+            for (size_t block = 0; block < words.size(); block++)
+            {
+                words[block] &= table.validity_->word(block, predicate.column);
+            }
+        }
+        selection.intersect(predicate_selection);
+    }
+    return selection;
+}
+
+bool RelationalTable::scanBatches(const std::vector<uint32_t> &column_indices, const BatchVisitor &visit) const
+{
+    return scanBatches(column_indices, {}, visit);
+}
+
+bool RelationalTable::scanBatches(const std::vector<uint32_t> &column_indices, const std::vector<Predicate> &predicates, const BatchVisitor &visit) const
+{
+    for (uint32_t column : column_indices)
+    {
+        if (column >= num_columns_)
+        {
+            std::cerr << "Error: Column " << column << " is out of range in " << file_name_ << std::endl;
+            return false;
+        }
+    }
+    for (const Predicate &predicate : predicates)
+    {
+        if (predicate.column >= num_columns_)
+        {
+            std::cerr << "Error: Column " << predicate.column << " is out of range in " << file_name_ << std::endl;
+            return false;
+        }
     }
 
-    // Every entry, join left and right and add rows
-    for (uint32_t entry_left = 0; entry_left < table_left.num_entries_; entry_left++)
+    // read through a mapping, a copy so the caller's table stays as it is
+    RelationalTable table = *this;
+    if (!table.mapFile())
+    {
+        return false;
+    }
+    uint32_t num_rows;
+    const uint32_t *cells = table.mappedCells(num_rows);
+    const ValidityBitmap *validity = table.validity_.get();
+
+    // batches start on a 64-row block, so a validity word lines up with a selection word
+    static_assert(BATCH_CAPACITY % 64 == 0, "batches start on a validity block");
+    ColumnBatch batch(uint32_t(column_indices.size()));
+    SelectionBitmap selection, predicate_selection;
+    for (uint32_t first = 0; first < num_rows; first += BATCH_CAPACITY)
     {
-        for (uint32_t entry_right = 0; entry_right < table_right.num_entries_; entry_right++)
+        uint32_t count = std::min<uint32_t>(BATCH_CAPACITY, num_rows - first);
+        const uint32_t *rows = cells + size_t(first) * num_columns_;
+        if (!predicates.empty())
         {
-            // Get the row data for the left table
-            std::vector<float> row_data_left = table_left.getRow_float(entry_left);
+            selection.reset(count);
+            selection.setRange(0, count);
+            for (const Predicate &predicate : predicates)
+            {
+                predicate_selection.reset(count);
+                EvaluatePredicate(predicate, rows + predicate.column, count, num_columns_, 0, predicate_selection);
+                if (validity != nullptr)
+                {
+                    QueryVector<uint64_t> &words = predicate_selection.words();
+                    for (size_t w = 0; w < words.size(); w++)
+                    {
+                        words[w] &= validity->word(first / 64 + w, predicate.column);
+                    }
+                }
+                selection.intersect(predicate_selection);
+            }
+            if (selection.count() == 0)
+            {
+                continue;
+            }
+        }
+        batch.loadRows(rows, num_columns_, count, column_indices);
+        if (!predicates.empty())
+        {
+            batch.select(selection);
+        }
+        visit(first, batch);
+    }
+    return true;
+}
+
+Aggregation RelationalTable::aggregate(const std::vector<Aggregate> &aggregates) const
+{
+    RT_TIME_PHASE(Aggregate);
+    Aggregation aggregation(aggregates);
+    if (!aggregateRows(aggregation))
+    {
+        return Aggregation();
+    }
+    return aggregation;
+}
+
+Aggregation RelationalTable::aggregate(const std::vector<Aggregate> &aggregates, uint32_t key_column, CellType key_type) const
+{
+    RT_TIME_PHASE(Aggregate);
+    if (key_column >= num_columns_)
+    {
+        std::cerr << "Error: Column " << key_column << " is out of range in " << file_name_ << std::endl;
+        return Aggregation();
+    }
+    RelationalTable table = *this;
+    if (!table.mapFile())
+    {
+        return Aggregation();
+    }
 
-            // Get the row data for the right table
-            std::vector<float> row_data_right = table_right.getRow_float(entry_right);
+    // one pass over the keys for their range, which decides between direct indexing and hashing
+    uint32_t num_rows;
+    const uint32_t *cells = table.mappedCells(num_rows);
+    Aggregate low = {AggregateOp::Min, key_column, CellType::Uint32, false}, high = {AggregateOp::Max, key_column, CellType::Uint32, false};
+    AggregateState low_state, high_state;
+    AggregateCells(low, cells + key_column, num_rows, num_columns_, low_state);
+    AggregateCells(high, cells + key_column, num_rows, num_columns_, high_state);
 
-            // Combine the row data
-            std::vector<float> row_data_new = row_data_left;
-            row_data_new.insert(row_data_new.end(), row_data_right.begin(), row_data_right.end());
+    Aggregation aggregation(aggregates, key_column, key_type, low_state.min_uint32, high_state.max_uint32);
+    if (!table.aggregateRows(aggregation))
+    {
+        return Aggregation();
+    }
+    return aggregation;
+}
 
-            // Add the row to the new table
-            table_new.addRow_float(row_data_new);
+bool RelationalTable::aggregateRows(Aggregation &aggregation) const
+{
+    const std::vector<Aggregate> &aggregates = aggregation.aggregates();
+    for (const Aggregate &aggregate : aggregates)
+    {
+        if (!aggregate.all_rows && aggregate.column >= num_columns_)
+        {
+            std::cerr << "Error: Column " << aggregate.column << " is out of range in " << file_name_ << std::endl;
+            return false;
         }
     }
 
-    return RelationalTable(new_table_file_name);
+    // read through a mapping, a copy so the caller's table stays as it is
+    RelationalTable table = *this;
+    if (!table.mapFile())
+    {
+        return false;
+    }
+    uint32_t num_rows;
+    const uint32_t *cells = table.mappedCells(num_rows);
+    const ValidityBitmap *validity = table.validity_.get();
+
+    // the key and aggregated columns are copied out of a batch of rows at a time, so every aggregate
+    // works through contiguous cells; count(*) alone still gets a column to count
+    std::vector<uint32_t> columns;
+    auto slotOf = [&columns](uint32_t column)
+    {
+        size_t slot = std::find(columns.begin(), columns.end(), column) - columns.begin();
+        if (slot == columns.size())
+        {
+            columns.push_back(column);
+        }
+        return uint32_t(slot);
+    };
+    uint32_t key_slot = aggregation.grouped() ? slotOf(aggregation.keyColumn()) : 0;
+    std::vector<uint32_t> slots(aggregates.size());
+    for (size_t a = 0; a < aggregates.size(); a++)
+    {
+        slots[a] = slotOf(aggregates[a].all_rows ? 0 : aggregates[a].column);
+    }
+
+    ColumnBatch batch(uint32_t(columns.size()));
+    PooledBuffer<uint32_t> group_ids(batch.capacity());
+    for (uint32_t first = 0; first < num_rows; first += BATCH_CAPACITY)
+    {
+        uint32_t count = std::min<uint32_t>(BATCH_CAPACITY, num_rows - first);
+        batch.loadRows(cells + size_t(first) * num_columns_, num_columns_, count, columns);
+        if (aggregation.grouped())
+        {
+            const uint32_t *keys = batch.column(key_slot);
+            std::fill(group_ids.data(), group_ids.data() + count, Aggregation::NO_GROUP);
+            forValidRuns(validity, aggregation.keyColumn(), first, count, [&](uint32_t begin, uint32_t end)
+                         { aggregation.findGroups(keys + begin, end - begin, 1, group_ids.data() + begin); });
+            if (validity != nullptr)
+            {
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    if (group_ids[i] == Aggregation::NO_GROUP)
+                    {
+                        group_ids[i] = aggregation.nullGroup();
+                    }
+                }
+            }
+        }
+
+        for (size_t a = 0; a < aggregates.size(); a++)
+        {
+            const Aggregate &aggregate = aggregates[a];
+            const uint32_t *cells_of_batch = batch.column(slots[a]);
+            forValidRuns(aggregate.all_rows ? nullptr : validity, aggregate.all_rows ? 0 : aggregate.column, first, count, [&](uint32_t begin, uint32_t end)
+                         {
+                             if (aggregation.grouped())
+                             {
+                                 aggregation.accumulate(a, cells_of_batch + begin, 1, group_ids.data() + begin, end - begin);
+                             }
+                             else
+                             {
+                                 AggregateCells(aggregate, cells_of_batch + begin, end - begin, 1, aggregation.state(0, a));
+                             } });
+        }
+    }
+    return true;
+}
+
+bool RelationalTable::isNull(uint32_t row_index, uint32_t column_index) const
+{
+    return validity_ && !validity_->isValid(row_index, column_index);
+}
+
+bool RelationalTable::hasNulls() const
+{
+    return validity_ != nullptr;
+}
+
+void RelationalTable::loadValidity()
+{
+    std::shared_ptr<ValidityBitmap> validity = std::make_shared<ValidityBitmap>();
+    if (validity->load(file_name_, num_columns_))
+    {
+        validity_ = validity;
+    }
+    else
+    {
+        validity_.reset();
+    }
 }
 
-RelationalTable RelationalTable::inner_join(const RelationalTable &other, const std::string &new_table_file_name, const std::vector<uint32_t> col1, const std::vector<uint32_t> col2) const
+RelationalTable RelationalTable::full_outer_join(const RelationalTable &other, const std::string &new_table_file_name, const std::vector<uint32_t> col1, const std::vector<uint32_t> col2) const
 {
-    // Left Table Open
+    return hashJoin(other, new_table_file_name, col1, col2, 1, true);
+}
+
+RelationalTable RelationalTable::cross_join(const RelationalTable &other, const std::string &new_table_file_name, size_t memory_budget) const
+{
+    RT_TIME_PHASE(Join);
+    // Both sides are read through mappings, copies so the callers' tables stay as they are
     RelationalTable table_left = *this;
     RelationalTable table_right = other;
+    if (!table_left.mapFile() || !table_right.mapFile())
+    {
+        return RelationalTable();
+    }
 
-    // Get the number of columns for the new table
-    uint32_t num_columns_new = table_left.num_columns_ + table_right.num_columns_;
+    uint32_t num_rows_left, num_rows_right;
+    const uint32_t *cells_left = table_left.mappedCells(num_rows_left);
+    const uint32_t *cells_right = table_right.mappedCells(num_rows_right);
+    uint32_t width_left = table_left.num_columns_;
+    uint32_t width_right = table_right.num_columns_;
+    if (width_left == 0 || width_right == 0)
+    {
+        std::cerr << "Error: Cannot join a table without columns" << std::endl;
+        return RelationalTable();
+    }
 
-    // New Table Open
-    RelationalTable table_new(new_table_file_name, num_columns_new);
+    // Get the number of columns for the new table
+    uint32_t num_columns_new = width_left + width_right;
 
-    // Left Table Open
-    std::ifstream file_left(file_name_, std::ios::binary | std::ios::in);
-    if (!file_left.is_open())
+    // New Table Open, our own buffer is the only one
+    RelationalTable table_new(new_table_file_name, num_columns_new, table_left.schema_.concat(table_right.schema_));
+    TableWriter writer(new_table_file_name, 0);
+    if (!writer.isOpen() || writer.numColumns() != num_columns_new)
     {
-        std::cerr << "Error: Unable to open file " << file_name_ << std::endl;
+        std::cerr << "Error: Unable to write join output to " << new_table_file_name << std::endl;
         return RelationalTable();
     }
 
-    // Right Table Open
-    std::ifstream file_right(other.file_name_, std::ios::binary | std::ios::in);
-    if (!file_right.is_open())
+    // Blocks of both sides fit in L2 together; the output buffer takes half the budget
+    size_t block_bytes = std::min<size_t>(CROSS_JOIN_BLOCK_BYTES, memory_budget / 4);
+    size_t left_block_rows = std::max<size_t>(1, block_bytes / (width_left * sizeof(uint32_t)));
+    size_t right_block_rows = std::max<size_t>(1, block_bytes / (width_right * sizeof(uint32_t)));
+    size_t output_rows = std::max<size_t>(1, memory_budget / 2 / (num_columns_new * sizeof(uint32_t)));
+
+    // NULLs of the inputs carry over to the output rows made from them
+    const ValidityBitmap *validity_left = table_left.validity_.get();
+    const ValidityBitmap *validity_right = table_right.validity_.get();
+    bool has_nulls = validity_left != nullptr || validity_right != nullptr;
+
+    std::vector<uint32_t> output(output_rows * num_columns_new);
+    size_t buffered = 0;
+    uint32_t row_new_index = 0;
+    for (size_t left_block = 0; left_block < num_rows_left; left_block += left_block_rows)
     {
-        std::cerr << "Error: Unable to open file " << other.file_name_ << std::endl;
-        return RelationalTable();
+        size_t left_end = std::min<size_t>(left_block + left_block_rows, num_rows_left);
+        for (size_t right_block = 0; right_block < num_rows_right; right_block += right_block_rows)
+        {
+            size_t right_end = std::min<size_t>(right_block + right_block_rows, num_rows_right);
+            for (size_t l = left_block; l < left_end; l++)
+            {
+                const uint32_t *row_left = cells_left + l * width_left;
+                for (size_t r = right_block; r < right_end; r++)
+                {
+                    uint32_t *row_new = &output[buffered * num_columns_new];
+                    std::memcpy(row_new, row_left, width_left * sizeof(uint32_t));
+                    std::memcpy(row_new + width_left, cells_right + r * width_right, width_right * sizeof(uint32_t));
+                    if (has_nulls)
+                    {
+                        markJoinNulls(writer, row_new_index, validity_left, 0, width_left, uint32_t(l));
+                        markJoinNulls(writer, row_new_index, validity_right, width_left, width_right, uint32_t(r));
+                    }
+                    row_new_index++;
+                    if (++buffered == output_rows)
+                    {
+                        writer.appendRows_uint32_t(output.data(), buffered);
+                        buffered = 0;
+                    }
+                }
+            }
+        }
     }
+    writer.appendRows_uint32_t(output.data(), buffered);
+    writer.close();
+
+    return RelationalTable(new_table_file_name);
+}
+
+RelationalTable RelationalTable::inner_join(const RelationalTable &other, const std::string &new_table_file_name, const std::vector<uint32_t> col1, const std::vector<uint32_t> col2, uint32_t num_threads) const
+{
+    return hashJoin(other, new_table_file_name, col1, col2, num_threads, false);
+}
 
-    // Every entry, join left and right and add rows if the columns match
-    for (uint32_t entry_left : col1)
+RelationalTable RelationalTable::hashJoin(const RelationalTable &other, const std::string &new_table_file_name, const std::vector<uint32_t> &col1, const std::vector<uint32_t> &col2, uint32_t num_threads, bool full_outer) const
+{
+    RT_TIME_PHASE(Join);
+    if (col1.empty() || col1.size() != col2.size())
     {
-        for (uint32_t entry_right : col2)
+        std::cerr << "Error: Need the same number of key columns on both sides" << std::endl;
+        return RelationalTable();
+    }
+    for (size_t k = 0; k < col1.size(); k++)
+    {
+        if (col1[k] >= num_columns_ || col2[k] >= other.num_columns_)
         {
-            // Get the row data for the left table
-            std::vector<float> row_data_left = table_left.getRow_float(entry_left);
+            std::cerr << "Error: Key column out of range" << std::endl;
+            return RelationalTable();
+        }
+    }
 
-            // Get the row data for the right table
-            std::vector<float> row_data_right = table_right.getRow_float(entry_right);
+    // Both sides are read through mappings, copies so the callers' tables stay as they are
+    RelationalTable table_left = *this;
+    RelationalTable table_right = other;
+    if (!table_left.mapFile() || !table_right.mapFile())
+    {
+        return RelationalTable();
+    }
+
+    uint32_t num_rows_left, num_rows_right;
+    const uint32_t *cells_left = table_left.mappedCells(num_rows_left);
+    const uint32_t *cells_right = table_right.mappedCells(num_rows_right);
+
+    // Get the number of columns for the new table
+    uint32_t num_columns_new = table_left.num_columns_ + table_right.num_columns_;
+
+    // New Table Open
+    RelationalTable table_new(new_table_file_name, num_columns_new, table_left.schema_.concat(table_right.schema_));
+    TableWriter writer(new_table_file_name);
+    if (!writer.isOpen() || writer.numColumns() != num_columns_new)
+    {
+        std::cerr << "Error: Unable to write join output to " << new_table_file_name << std::endl;
+        return RelationalTable();
+    }
 
-            // Combine the row data
-            std::vector<float> row_data_new = row_data_left;
-            row_data_new.insert(row_data_new.end(), row_data_right.begin(), row_data_right.end());
+    JoinInput left = {cells_left, table_left.num_columns_, num_rows_left, col1, table_left.validity_.get()};
+    JoinInput right = {cells_right, table_right.num_columns_, num_rows_right, col2, table_right.validity_.get()};
+    bool has_nulls = full_outer || left.validity != nullptr || right.validity != nullptr;
+    JoinEmit emit = [&](const uint32_t *rows, size_t num_rows, const uint32_t *left_ids, const uint32_t *right_ids)
+    {
+        uint32_t first_row = writer.numEntries();
+        writer.appendRows_uint32_t(rows, num_rows);
+        for (size_t i = 0; has_nulls && i < num_rows; i++)
+        {
+            markJoinNulls(writer, first_row + i, left.validity, 0, left.width, left_ids[i]);
+            markJoinNulls(writer, first_row + i, right.validity, left.width, right.width, right_ids[i]);
+        }
+    };
 
-            // Add the row to the new table
-            table_new.addRow_float(row_data_new);
+    // Build on the smaller side with one scan, then stream the larger side past it
+    try
+    {
+        if (full_outer)
+        {
+            HashFullOuterJoin(left, right, emit);
+        }
+        else if (num_threads <= 1)
+        {
+            HashJoin(left, right, emit);
+        }
+        else
+        {
+            PartitionedHashJoin(left, right, num_threads, emit);
         }
     }
+    catch (const char *message)
+    {
+        // e.g. the query memory limit; the rows written so far stay in the output
+        std::cerr << "Error: " << message << " while joining into " << new_table_file_name << std::endl;
+        writer.close();
+        return RelationalTable();
+    }
+    writer.close();
 
     return RelationalTable(new_table_file_name);
 }
 
-uint32_t RelationalTable::readNumEntries() const
+bool RelationalTable::compressData(const std::string &compressed_file_name, const std::vector<RepresentationKind> &preferred_representations, uint32_t row_group_size, double size_tolerance, uint32_t num_threads,
+                                   const std::vector<BlockCompression> &block_compression) const
 {
-    std::ifstream file(file_name_, std::ios::binary | std::ios::in);
-    if (!file.is_open())
+    if (preferred_representations.size() != num_columns_ || row_group_size == 0)
     {
-        return 0;
+        std::cerr << "Error: Need one representation per column and a non-zero row group size" << std::endl;
+        return false;
+    }
+    if (!block_compression.empty() && block_compression.size() != num_columns_)
+    {
+        std::cerr << "Error: Need block compression for every column or none" << std::endl;
+        return false;
     }
 
-    uint32_t num_entries;
-    file.read(reinterpret_cast<char *>(&num_entries), sizeof(num_entries));
-    file.close();
-    return num_entries;
+    if (!handle_)
+    {
+        std::cerr << "Error: Unable to open file " << file_name_ << std::endl;
+        return false;
+    }
+
+    RT_COUNT(FileOpens);
+    std::ofstream compressed_file(compressed_file_name, std::ios::binary | std::ios::out | std::ios::trunc);
+    if (!compressed_file.is_open())
+    {
+        std::cerr << "Error: Unable to open file " << compressed_file_name << std::endl;
+        return false;
+    }
+
+    // the same header as the table's, so a typed table keeps its column types and names
+    std::vector<uint8_t> header = EncodeTableHeader(num_entries_, num_columns_, schema_);
+    RT_COUNT_WRITE(header.size());
+    compressed_file.write(reinterpret_cast<const char *>(header.data()), header.size());
+
+    // the groups are read a few ahead through an AsyncReader, this thread transposes each one as it
+    // arrives and the writer encodes and writes the ones before
+    ParallelRowGroupWriter writer(compressed_file, preferred_representations, size_tolerance, num_threads);
+    writer.setBlockCompression(block_compression);
+    const size_t READ_AHEAD = 4;
+    std::vector<std::vector<uint32_t>> group_rows(READ_AHEAD); // outlives the reader, which waits for its reads
+    AsyncReader reader(handle_->fd(), READ_AHEAD);
+    std::vector<char> arrived(READ_AHEAD, 0), read_all(READ_AHEAD, 0);
+    size_t row_size = calculateRowSize();
+    uint32_t num_groups = num_entries_ / row_group_size + (num_entries_ % row_group_size != 0);
+    uint32_t next_read = 0;
+    for (uint32_t group = 0; group < num_groups; group++)
+    {
+        for (; next_read < num_groups && next_read < group + READ_AHEAD; next_read++)
+        {
+            size_t slot = next_read % READ_AHEAD;
+            uint64_t group_start = uint64_t(next_read) * row_group_size;
+            group_rows[slot].resize(std::min<uint64_t>(num_entries_ - group_start, row_group_size) * num_columns_);
+            arrived[slot] = 0;
+            reader.submit(group_rows[slot].data(), group_rows[slot].size() * sizeof(uint32_t), off_t(data_offset_ + group_start * row_size), slot);
+        }
+        size_t slot = group % READ_AHEAD;
+        while (!arrived[slot])
+        {
+            uint64_t tag;
+            bool complete;
+            reader.complete(tag, complete);
+            arrived[tag] = 1;
+            read_all[tag] = complete;
+        }
+        if (!read_all[slot])
+        {
+            std::cerr << "Error: Table " << file_name_ << " is shorter than its header says" << std::endl;
+            writer.finish();
+            return false;
+        }
+
+        const std::vector<uint32_t> &rows = group_rows[slot];
+        uint32_t group_size = uint32_t(rows.size() / num_columns_);
+        std::vector<std::vector<uint32_t>> columns(num_columns_, std::vector<uint32_t>(group_size));
+        for (uint32_t row = 0; row < group_size; row++)
+        {
+            for (uint32_t c = 0; c < num_columns_; c++)
+            {
+                columns[c][row] = rows[size_t(row) * num_columns_ + c];
+            }
+        }
+        writer.write(std::move(columns));
+    }
+
+    return writer.finish() && bool(compressed_file);
 }
 
-uint32_t RelationalTable::readNumColumns() const
+RelationalTable RelationalTable::decompressData(const std::string &compressed_file_name, const std::string &new_table_file_name, uint32_t num_threads)
 {
-    std::ifstream file(file_name_, std::ios::binary | std::ios::in);
-    if (!file.is_open())
+    // finds the row groups from the index, or by walking a file without one
+    ColumnarRelationalTable compressed(compressed_file_name);
+    uint32_t num_columns = compressed.readNumColumns();
+    if (num_columns == 0)
     {
-        return 0;
+        std::cerr << "Error: Unable to parse metadata for table " << compressed_file_name << std::endl;
+        return RelationalTable();
     }
 
-    uint32_t num_columns;
-    file.seekg(sizeof(num_entries_));
-    file.read(reinterpret_cast<char *>(&num_columns), sizeof(num_columns));
-    file.close();
-    return num_columns;
+    std::vector<RowGroupInfo> row_groups;
+    for (uint32_t g = 0; g < compressed.numRowGroups(); g++)
+    {
+        row_groups.push_back(compressed.rowGroup(g));
+    }
+    std::vector<uint32_t> all_columns(num_columns);
+    for (uint32_t c = 0; c < num_columns; c++)
+    {
+        all_columns[c] = c;
+    }
+
+    RelationalTable table_new(new_table_file_name, num_columns, compressed.schema());
+
+    TableWriter writer(new_table_file_name);
+    if (!writer.isOpen())
+    {
+        return RelationalTable();
+    }
+
+    // groups are decoded in parallel ahead of this thread, which turns them back into rows
+    ParallelRowGroupReader reader(compressed_file_name, row_groups, all_columns, num_threads);
+    std::vector<std::vector<uint32_t>> columns;
+    std::vector<uint32_t> rows;
+    while (reader.next(columns))
+    {
+        size_t num_rows = columns[0].size();
+        rows.resize(num_rows * num_columns);
+        for (uint32_t c = 0; c < num_columns; c++)
+        {
+            for (size_t row = 0; row < num_rows; row++)
+            {
+                rows[row * num_columns + c] = columns[c][row];
+            }
+        }
+        writer.appendRows_uint32_t(rows.data(), num_rows);
+    }
+    if (reader.error() != nullptr)
+    {
+        std::cerr << "Error: " << reader.error() << " in " << compressed_file_name << std::endl;
+    }
+    writer.close();
+
+    return RelationalTable(new_table_file_name);
+}
+
+uint32_t RelationalTable::readNumEntries() const
+{
+    // the handle rereads the count only when the file changed
+    return handle_ ? handle_->numEntries() : 0;
+}
+
+uint32_t RelationalTable::readNumColumns() const
+{
+    return handle_ ? handle_->numColumns() : 0;
 }
 
 bool RelationalTable::parseMetadata()
 {
-    std::ifstream file(file_name_, std::ios::binary | std::ios::in);
-    if (!file.is_open())
+    num_entries_ = num_columns_ = 0;
+    // a table already open in the process shares its descriptor and header
+    handle_ = OpenTableHandle(file_name_);
+    if (!handle_ || !fitsCells(handle_->schema(), file_name_))
     {
+        handle_.reset();
         return false;
     }
 
-    file.read(reinterpret_cast<char *>(&num_entries_), sizeof(num_entries_));
-    file.read(reinterpret_cast<char *>(&num_columns_), sizeof(num_columns_));
-    file.close();
+    num_entries_ = handle_->numEntries();
+    num_columns_ = handle_->numColumns();
+    data_offset_ = handle_->dataOffset();
+    schema_ = handle_->schema();
+    loadValidity();
     return true;
 }
 
@@ -329,27 +1042,36 @@ uint32_t RelationalTable::calculateRowSize() const
 
 bool RelationalTable::writeMetadata(uint32_t num_entries, uint32_t num_columns)
 {
+    RT_COUNT(FileOpens);
     std::ofstream file(file_name_, std::ios::binary | std::ios::in | std::ios::out);
     if (!file.is_open())
     {
         return false;
     }
 
-    file.write(reinterpret_cast<const char *>(&num_entries), sizeof(num_entries));
-    file.write(reinterpret_cast<const char *>(&num_columns), sizeof(num_columns));
+    // the schema, if any, goes right after the two counts
+    std::vector<uint8_t> header = EncodeTableHeader(num_entries, num_columns, schema_);
+    RT_COUNT(HeaderWrites);
+    RT_COUNT_WRITE(header.size());
+    file.write(reinterpret_cast<const char *>(header.data()), header.size());
     file.close();
+    data_offset_ = header.size();
     return true;
 }
 
 bool RelationalTable::writeNumEntries(uint32_t num_entries)
 {
+    RT_COUNT(FileOpens);
     std::ofstream file(file_name_, std::ios::binary | std::ios::in | std::ios::out);
     if (!file.is_open())
     {
         return false;
     }
 
+    RT_COUNT(HeaderWrites);
+    RT_COUNT(Seeks);
     file.seekp(0);
+    RT_COUNT_WRITE(sizeof(num_entries));
     file.write(reinterpret_cast<const char *>(&num_entries), sizeof(num_entries));
     file.close();
     return true;
@@ -357,13 +1079,19 @@ bool RelationalTable::writeNumEntries(uint32_t num_entries)
 
 bool RelationalTable::writeNumColumns(uint32_t num_columns)
 {
+    RT_COUNT(FileOpens);
     std::ofstream file(file_name_, std::ios::binary | std::ios::in | std::ios::out);
     if (!file.is_open())
     {
         return false;
     }
 
+    RT_COUNT(HeaderWrites);
+    RT_COUNT(Seeks);
     file.seekp(sizeof(num_entries_));
+    // a schema after the header stays flagged
+    num_columns |= schema_.empty() ? 0 : TABLE_SCHEMA_FLAG;
+    RT_COUNT_WRITE(sizeof(num_columns));
     file.write(reinterpret_cast<const char *>(&num_columns), sizeof(num_columns));
     file.close();
     return true;
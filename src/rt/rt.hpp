@@ -2,15 +2,55 @@
 #define _rt_h_
 
 #include "helper.hpp"
+#include "mapped_file.hpp"
+#include "validity.hpp"
+#include "schema.hpp"
+#include "table_handle.hpp"
+#include "../coding/coding.hpp"
+#include "../coding/block_codec.hpp"
+#include "../coding/predicate.hpp"
+#include "../coding/aggregate.hpp"
+#include "../coding/batch.hpp"
 
 #include <string>
 #include <vector>
 #include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <memory>
 
 using namespace std;
 
+// Memory a join may use for its blocks and output buffer unless told otherwise
+const size_t DEFAULT_JOIN_MEMORY_BUDGET = 64 << 20;
+
+// A row of a mapped table, pointing straight into the mapping
+template <typename T>
+struct RowView
+{
+    const T *data_;
+    uint32_t size_;
+
+    const T *begin() const { return data_; }
+    const T *end() const { return data_ + size_; }
+    const T &operator[](uint32_t column) const { return data_[column]; }
+    uint32_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+};
+
+// A column of a mapped table: every stride_-th cell starting at the column's first cell
+template <typename T>
+struct ColumnView
+{
+    const T *data_;
+    uint32_t size_;
+    uint32_t stride_;
+
+    const T &operator[](uint32_t row) const { return data_[size_t(row) * stride_]; }
+    uint32_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+};
+
 // Class representing a relational table
 class RelationalTable
 {
@@ -22,43 +62,131 @@ public:
     // Create a new table with the given column metadata
     RelationalTable(const std::string &file_name, const uint32_t num_columns);
 
-    // Print the table data
+    // Create a new table whose header records the type and name of every column (32-bit types only)
+    RelationalTable(const std::string &file_name, const TableSchema &schema);
+
+    // Print the table data, each column as its type (as floats when the table is untyped)
     void printTable() const;
 
     // Add a new row to the table
     void addRow_uint32_t(const std::vector<uint32_t> &row_data);
     void addRow_float(const std::vector<float> &row_data);
 
+    // Add num_rows rows laid out back to back with one write and one header update
+    // (use a TableWriter to keep appending across calls)
+    bool appendRows_uint32_t(const uint32_t *rows, size_t num_rows);
+    bool appendRows_float(const float *rows, size_t num_rows);
+
     // Retrieve a specific row by index
     std::vector<uint32_t> getRow_uint32_t(uint32_t row_index) const;
     std::vector<float> getRow_float(uint32_t row_index) const;
 
-    // Perform a join operation with another table and make the new file
-    RelationalTable full_outer_join(const RelationalTable &other, const std::string &new_table_file_name) const;
-    RelationalTable inner_join(const RelationalTable &other, const std::string &new_table_file_name, const std::vector<uint32_t> col1, const std::vector<uint32_t> col2) const;
-
-    // Compress the table data
-    void compressData();
-
-    // Decompress the table data
-    void decompressData();
-
-    // Getters
+    // Map the table file once; getRow_* then copy out of the mapping instead of opening the file
+    bool mapFile();
+    bool isMapped() const;
+
+    // Zero-copy views into the mapping (mapFile() first). Rows appended since the file was
+    // mapped are picked up by growing the mapping in place; views taken before stay valid for as long
+    // as the mapping (until mapFile() is called again or the last copy of the table goes).
+    RowView<uint32_t> viewRow_uint32_t(uint32_t row_index) const;
+    RowView<float> viewRow_float(uint32_t row_index) const;
+    ColumnView<uint32_t> viewColumn_uint32_t(uint32_t column_index) const;
+    ColumnView<float> viewColumn_float(uint32_t column_index) const;
+    ColumnView<int32_t> viewColumn_int32_t(uint32_t column_index) const;
+
+    // Rows matching every predicate; NULL cells match nothing
+    SelectionBitmap filter(const std::vector<Predicate> &predicates) const;
+
+    // Batch scan through a mapping: call visit for every BATCH_CAPACITY rows with the requested columns
+    // in column_indices order, copied out of the rows into one reused batch. NULL cells read as 0.
+    bool scanBatches(const std::vector<uint32_t> &column_indices, const BatchVisitor &visit) const;
+
+    // Filtered batch scan: only the rows matching every predicate are selected in the batches (NULL cells
+    // match nothing), and batches without a match aren't visited
+    bool scanBatches(const std::vector<uint32_t> &column_indices, const std::vector<Predicate> &predicates, const BatchVisitor &visit) const;
+
+    // SUM/MIN/MAX/COUNT/AVG over every row, or per group of key_column's cells (see Aggregation). NULL cells
+    // are left out and NULL keys form a group of their own. An empty Aggregation when a column is out of range.
+    Aggregation aggregate(const std::vector<Aggregate> &aggregates) const;
+    Aggregation aggregate(const std::vector<Aggregate> &aggregates, uint32_t key_column, CellType key_type) const;
+
+    // Whether a cell is NULL; only tables with a validity sidecar (e.g. outer join output) have any.
+    // NULL cells are stored as 0.
+    bool isNull(uint32_t row_index, uint32_t column_index) const;
+    bool hasNulls() const;
+
+    // Full outer equi-join on key columns (as in inner_join): matching rows are paired, and every row of
+    // either table without a match is kept with the other table's columns NULL. NULL keys match nothing.
+    RelationalTable full_outer_join(const RelationalTable &other, const std::string &new_table_file_name, const std::vector<uint32_t> col1, const std::vector<uint32_t> col2) const;
+
+    // Cartesian product: every left row followed by every right row. Block nested loop over
+    // cache-sized blocks of both tables, with output collected in a buffer of about half the memory budget.
+    RelationalTable cross_join(const RelationalTable &other, const std::string &new_table_file_name, size_t memory_budget = DEFAULT_JOIN_MEMORY_BUDGET) const;
+
+    // Equi-join on key columns: left column col1[k] must equal right column col2[k] for every k.
+    // Hash join that builds on the smaller table; output rows are the left row followed by the right row.
+    // With more than one thread both tables are radix-partitioned and the partitions joined in parallel,
+    // which leaves the output rows in no particular order.
+    RelationalTable inner_join(const RelationalTable &other, const std::string &new_table_file_name, const std::vector<uint32_t> col1, const std::vector<uint32_t> col2, uint32_t num_threads = 1) const;
+
+    // Compress the table data into a row-group file (the populate_tables.py layout, with the schema of a
+    // typed table in its header), encoding each
+    // column with its preferred representation and falling back to Direct per row group. Adaptive
+    // columns get whichever representation WriteRowGroup_uint32 picks with size_tolerance. Chunks are
+    // encoded on num_threads threads (0: one per hardware thread) while the next groups are read.
+    // block_compression, when not empty, has an entry per column saying how its chunks are compressed
+    // after encoding (see block_codec.hpp).
+    bool compressData(const std::string &compressed_file_name, const std::vector<RepresentationKind> &preferred_representations, uint32_t row_group_size = 1024, double size_tolerance = 0, uint32_t num_threads = 1,
+                      const std::vector<BlockCompression> &block_compression = {}) const;
+
+    // Decompress a row-group file into a new table, typed as the file is, decoding row groups ahead on
+    // num_threads threads
+    static RelationalTable decompressData(const std::string &compressed_file_name, const std::string &new_table_file_name, uint32_t num_threads = 1);
+
+    // Getters; the number of entries includes rows appended since the table was opened, by any writer
     uint32_t readNumEntries() const;
     uint32_t readNumColumns() const;
 
+    // Column types and names from the header, empty for an untyped table
+    const TableSchema &schema() const { return schema_; }
+
 protected:
     std::string file_name_;                   // File path for the table
     uint32_t num_entries_;                    // Number of rows
     uint32_t num_columns_;                    // Number of columns
-    std::vector<std::vector<uint32_t>> data_; // Entry data
+    uint32_t data_offset_;                    // Where the rows start, after the header (and schema)
+    TableSchema schema_;                      // Column types and names, empty when the table has none
+    std::shared_ptr<TableHandle> handle_;     // Open file and header, shared by every table of the file in the process
+    std::shared_ptr<MappedFile> mapping_;     // Set in mmap read mode, shared by copies of the table
+    std::shared_ptr<ValidityBitmap> validity_; // NULL bitmap, nullptr when the table has no sidecar
 
-    // Parse metadata and fill num_entries, num_columns
+    // Create a table of num_columns columns, typed when the schema isn't empty
+    RelationalTable(const std::string &file_name, uint32_t num_columns, const TableSchema &schema);
+
+    // Parse metadata and fill num_entries, num_columns, the schema and where the rows start
     bool parseMetadata();
 
+    // (Re)load the validity sidecar, if there is one
+    void loadValidity();
+
+    // Fold every row into an aggregation, a batch of rows at a time
+    bool aggregateRows(Aggregation &aggregation) const;
+
+    // Hash join both tables into a new one; the full outer join also keeps unmatched rows
+    RelationalTable hashJoin(const RelationalTable &other, const std::string &new_table_file_name, const std::vector<uint32_t> &col1, const std::vector<uint32_t> &col2, uint32_t num_threads, bool full_outer) const;
+
+    // Read a row into cells through the table's descriptor
+    bool readRow(uint32_t row_index, void *cells) const;
+
     // Calculate row size from metadata in bytes
     uint32_t calculateRowSize() const;
 
+    // First cell of the mapping and the number of complete committed rows in it (nullptr if not mapped)
+    const uint32_t *mappedCells(uint32_t &num_rows) const;
+
+    // Pointer to a row in the mapping, remapping once if the file grew past it; nullptr if out of range
+    const uint8_t *mappedRow(uint32_t row_index) const;
+
     // Setters
     bool writeMetadata(uint32_t num_entries, uint32_t num_columns);
     bool writeNumEntries(uint32_t num_entries);
@@ -1,26 +1,298 @@
 #include "rt.hpp"
+#include "table_writer.hpp"
+#include "table_log.hpp"
+#include "instrumentation.hpp"
+#include "query_memory.hpp"
+#include "../columnar-rt/columnar_rt.hpp"
 
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+    // Where the instrumentation report goes at exit: empty for nowhere, "-" for stderr as text,
+    // anything else is a file for the report as JSON
+    std::string stats_output;
+
+    void reportStats()
+    {
+        if (stats_output == "-")
+        {
+            PrintInstrumentation(std::cerr);
+            return;
+        }
+        std::ofstream file(stats_output, std::ios::out | std::ios::trunc);
+        if (!file.is_open())
+        {
+            std::cerr << "Error: Unable to open file " << stats_output << std::endl;
+            return;
+        }
+        WriteInstrumentationJson(file);
+    }
+
+    // "#,#,#,..." with auto for a representation the writer picks; a lone auto stands for every column
+    bool parseRepresentations(const std::string &text, std::vector<RepresentationKind> &representations)
+    {
+        representations.clear();
+        std::string item;
+        std::istringstream stream(text);
+        while (std::getline(stream, item, ','))
+        {
+            if (item == "auto")
+            {
+                representations.push_back(RepresentationKind::Adaptive);
+                continue;
+            }
+            try
+            {
+                representations.push_back(static_cast<RepresentationKind>(std::stoi(item)));
+            }
+            catch (const std::exception &)
+            {
+                return false;
+            }
+        }
+        return !representations.empty();
+    }
+
+    std::vector<RepresentationKind> representationsFor(const std::vector<RepresentationKind> &representations, uint32_t num_columns)
+    {
+        if (representations.size() == 1 && representations[0] == RepresentationKind::Adaptive)
+        {
+            return std::vector<RepresentationKind>(num_columns, RepresentationKind::Adaptive);
+        }
+        return representations;
+    }
+
+    // "none|lz|lz:<level>,..." per column; a lone one stands for every column
+    bool parseBlockCompression(const std::string &text, std::vector<BlockCompression> &block_compression)
+    {
+        block_compression.clear();
+        std::string item;
+        std::istringstream stream(text);
+        while (std::getline(stream, item, ','))
+        {
+            BlockCompression compression;
+            if (!ParseBlockCompression(item, compression))
+            {
+                return false;
+            }
+            block_compression.push_back(compression);
+        }
+        return !block_compression.empty();
+    }
+
+    std::vector<BlockCompression> blockCompressionFor(const std::vector<BlockCompression> &block_compression, uint32_t num_columns)
+    {
+        if (block_compression.size() == 1)
+        {
+            return std::vector<BlockCompression>(num_columns, block_compression[0]);
+        }
+        return block_compression;
+    }
+
+    // How filter and aggregate read a column: as its type in a typed table, as fallback in an untyped one
+    bool cellTypeFor(const TableSchema &schema, uint32_t column, CellType fallback, CellType &type)
+    {
+        type = fallback;
+        if (column >= schema.numColumns())
+        {
+            return true;
+        }
+        switch (schema.types[column])
+        {
+        case ColumnType::Uint32:
+            type = CellType::Uint32;
+            return true;
+        case ColumnType::Int32:
+            type = CellType::Int32;
+            return true;
+        case ColumnType::Float32:
+            type = CellType::Float;
+            return true;
+        default:
+            std::cerr << "Error: Column " << column << " is " << ColumnTypeName(schema.types[column]) << ", which filter and aggregate don't read yet\n";
+            return false;
+        }
+    }
+
+    // The items of an added row, each parsed as its column's type
+    bool parseTypedRow(char **items, int num_items, const TableSchema &schema, const std::string &filename, std::vector<uint32_t> &cells)
+    {
+        cells.resize(num_items);
+        for (int i = 0; i < num_items; i++)
+        {
+            char *end;
+            if (i >= int(schema.numColumns()) || !ParseCell(items[i], &end, schema.types[i], cells[i]) || *end != '\0')
+            {
+                std::cerr << "Error: Unable to parse " << items[i] << " as column " << i << " of " << filename << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Rows bulk-add logs at a time, each batch with one write and one sync of the log
+    const size_t LOG_BATCH_ROWS = 4096;
+}
+
+// Errors thrown out of a command (e.g. going over the memory limit) end the program with a message
 int main(int argc, char *argv[])
+try
 {
+    // Options can go anywhere; they are taken out so the positional arguments keep their places
+    bool columnar = false;
+    uint32_t row_group_size = ColumnarRelationalTable::DEFAULT_ROW_GROUP_SIZE;
+    std::vector<RepresentationKind> representations;
+    double size_tolerance = 0;
+    std::vector<BlockCompression> block_compression;
+    size_t memory_limit = 0;
+    bool use_log = false;
+    uint32_t log_sync_ms = 0;
+    TableSchema schema;
+    std::vector<char *> args;
+    for (int i = 0; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--format" && i + 1 < argc)
+        {
+            std::string format = argv[++i];
+            if (format != "row" && format != "columnar")
+            {
+                std::cerr << "Error: Unknown format " << format << " (use row or columnar)\n";
+                return 1;
+            }
+            columnar = format == "columnar";
+        }
+        else if (arg == "--row-group-size" && i + 1 < argc)
+        {
+            row_group_size = std::stoi(argv[++i]);
+        }
+        else if (arg == "--representations" && i + 1 < argc)
+        {
+            if (!parseRepresentations(argv[++i], representations))
+            {
+                std::cerr << "Error: Unable to parse representations " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--size-tolerance" && i + 1 < argc)
+        {
+            size_tolerance = std::stod(argv[++i]);
+        }
+        else if (arg == "--block-compression" && i + 1 < argc)
+        {
+            if (!parseBlockCompression(argv[++i], block_compression))
+            {
+                std::cerr << "Error: Unable to parse block compression " << argv[i] << " (use \"none|lz|lz:<level>,...\" with levels 1 to 9)\n";
+                return 1;
+            }
+        }
+        else if (arg == "--memory-limit" && i + 1 < argc)
+        {
+            memory_limit = size_t(std::stoul(argv[++i])) << 20;
+        }
+        else if (arg == "--schema" && i + 1 < argc)
+        {
+            if (!ParseSchema(argv[++i], schema))
+            {
+                std::cerr << "Error: Unable to parse schema " << argv[i] << " (use \"[name:]type,...\" with types u32 i32 f32)\n";
+                return 1;
+            }
+        }
+        else if (arg == "--wal")
+        {
+            use_log = true;
+        }
+        else if (arg == "--wal-sync-ms" && i + 1 < argc)
+        {
+            use_log = true;
+            log_sync_ms = std::stoul(argv[++i]);
+        }
+        else if (arg == "--stats")
+        {
+            stats_output = "-";
+        }
+        else if (arg == "--stats-json" && i + 1 < argc)
+        {
+            stats_output = argv[++i];
+        }
+        else
+        {
+            args.push_back(argv[i]);
+        }
+    }
+    argc = args.size();
+    argv = args.data();
+    if (!stats_output.empty())
+    {
+        std::atexit(reportStats);
+    }
+
     if (argc < 3)
     {
-        std::cerr << "Usage: " << argv[0] << " <create/read/add/outerjoin/innerjoin> <filename> [num_columns]\n";
+        std::cerr << "Usage: " << argv[0] << " <create/read/add/bulk-add/fullouterjoin/crossjoin/innerjoin/hashjoin/filter/aggregate/stats/compress/decompress> <filename> [num_columns] [--format row|columnar]\n";
+        std::cerr << "Columnar tables also take --row-group-size <rows>, --representations <\"#,#,#,...\"|auto> and --size-tolerance <fraction> when rows are added\n";
+        std::cerr << "Columnar adds and compress take --block-compression <\"none|lz|lz:<level>,...\"> to compress chunks again after encoding (one entry for every column)\n";
+        std::cerr << "--stats prints counters and phase timings at exit, --stats-json <file> writes them as JSON\n";
+        std::cerr << "--memory-limit <MiB> caps the scratch memory of the command\n";
+        std::cerr << "create takes --schema <\"[name:]type,...\"> (types u32 i32 f32) in place of num_columns for a typed table\n";
+        std::cerr << "add and bulk-add take --wal to append through the table's write-ahead log, synced with every batch, or --wal-sync-ms <ms> to sync it every <ms> milliseconds\n";
         return 1;
     }
 
+    // scans, joins and aggregates take their batches and scratch space from here, all freed at exit
+    QueryMemory memory(memory_limit);
+    QueryMemoryScope memory_scope(&memory);
+
     std::string command = argv[1];
     std::string filename = argv[2];
 
+    if (columnar && command != "create" && command != "read" && command != "add" && command != "bulk-add" && command != "filter" && command != "aggregate" && command != "stats")
+    {
+        std::cerr << "Error: " << command << " is not supported for columnar tables\n";
+        return 1;
+    }
+    if (use_log && (columnar || (command != "add" && command != "bulk-add")))
+    {
+        std::cerr << "Error: --wal is for add and bulk-add on row tables\n";
+        return 1;
+    }
+
+    // rows a logged append left in the table's log when it was cut short go to the table before anything
+    // reads or appends (opening a TableLog recovers by itself)
+    if (!columnar && command != "create" && !use_log && !RecoverTableLog(filename))
+    {
+        return 1;
+    }
+
     if (command == "create")
     {
-        if (argc < 4)
+        if (argc < 4 && schema.empty())
         {
-            std::cerr << "Usage: ./rt_program create <filename.tbl> <num_col>\n";
+            std::cerr << "Usage: ./rt_program create <filename.tbl> <num_col|--schema \"[name:]type,...\">\n";
             return 1;
         }
 
-        int num_columns = std::stoi(argv[3]); // Convert the number of columns from string to int
-        RelationalTable table(filename, num_columns);
+        int num_columns = argc < 4 ? schema.numColumns() : std::stoi(argv[3]); // Convert the number of columns from string to int
+        if (!schema.empty() && (columnar || uint32_t(num_columns) != schema.numColumns()))
+        {
+            std::cerr << "Error: " << (columnar ? "Columnar tables don't take a schema" : "The schema doesn't have num_col columns") << std::endl;
+            return 1;
+        }
+        if (columnar)
+        {
+            ColumnarRelationalTable table(filename, num_columns);
+        }
+        else if (!schema.empty())
+        {
+            RelationalTable table(filename, schema);
+        }
+        else
+        {
+            RelationalTable table(filename, num_columns);
+        }
         std::cout << "Table " << filename << " created with " << num_columns << " columns.\n";
     }
     else if (command == "read")
@@ -30,8 +302,16 @@ int main(int argc, char *argv[])
             std::cerr << "Usage: ./rt_program read <filename.tbl>\n";
             return 1;
         }
-        RelationalTable table(filename);
-        table.printTable();
+        if (columnar)
+        {
+            ColumnarRelationalTable table(filename);
+            table.printTable();
+        }
+        else
+        {
+            RelationalTable table(filename);
+            table.printTable();
+        }
     }
     else if (command == "add")
     {
@@ -41,33 +321,236 @@ int main(int argc, char *argv[])
             return 1;
         }
 
-        RelationalTable table(filename);
         std::vector<float> row_data;
         for (int i = 3; i < argc; i++)
         {
             row_data.push_back(std::stof(argv[i]));
         }
 
-        table.addRow_float(row_data);
+        if (columnar)
+        {
+            // a row group of its own
+            ColumnarRelationalTable table(filename);
+            if (!representations.empty())
+            {
+                table.setRepresentations(representationsFor(representations, table.readNumColumns()));
+            }
+            table.setSizeTolerance(size_tolerance);
+            if (!block_compression.empty())
+            {
+                table.setBlockCompression(blockCompressionFor(block_compression, table.readNumColumns()));
+            }
+            table.addRow_float(row_data);
+        }
+        else if (use_log)
+        {
+            // in the table once the log is closed, and on disk from when the append returns
+            TableLog log(filename, log_sync_ms);
+            if (!log.isOpen())
+            {
+                return 1;
+            }
+            std::vector<uint32_t> cells(row_data.size());
+            std::memcpy(cells.data(), row_data.data(), cells.size() * sizeof(uint32_t));
+            if (!log.schema().empty() && !parseTypedRow(argv + 3, argc - 3, log.schema(), filename, cells))
+            {
+                return 1;
+            }
+            if (cells.size() != log.numColumns())
+            {
+                std::cerr << "Error: The row has " << cells.size() << " items, table has " << log.numColumns() << " columns\n";
+                return 1;
+            }
+            if (!log.appendRows_uint32_t(cells.data(), 1) || !log.close())
+            {
+                return 1;
+            }
+        }
+        else
+        {
+            RelationalTable table(filename);
+            if (table.schema().empty())
+            {
+                table.addRow_float(row_data);
+            }
+            else
+            {
+                // each item as its column's type
+                std::vector<uint32_t> cells;
+                if (!parseTypedRow(argv + 3, argc - 3, table.schema(), filename, cells))
+                {
+                    return 1;
+                }
+                table.addRow_uint32_t(cells);
+            }
+        }
         std::cout << "Row added to table " << filename << ".\n";
     }
+    else if (command == "bulk-add")
+    {
+        // rows come from a CSV file, or stdin when no file (or "-") is given
+        std::string source = argc > 3 ? argv[3] : "-";
+        bool as_uint32 = argc > 4 && std::string(argv[4]) == "--uint32";
+        if (source == "--uint32")
+        {
+            source = "-";
+            as_uint32 = true;
+        }
+
+        std::ifstream csv_file;
+        if (source != "-")
+        {
+            csv_file.open(source);
+            if (!csv_file.is_open())
+            {
+                std::cerr << "Error: Unable to open file " << source << std::endl;
+                return 1;
+            }
+        }
+        std::istream &input = source == "-" ? std::cin : csv_file;
+        std::ios::sync_with_stdio(false);
+
+        // columnar tables buffer rows into row groups themselves
+        std::unique_ptr<TableWriter> writer;
+        std::unique_ptr<TableLog> log;
+        std::unique_ptr<ColumnarRelationalTable> columnar_table;
+        if (columnar)
+        {
+            columnar_table.reset(new ColumnarRelationalTable(filename));
+            columnar_table->setRowGroupSize(row_group_size);
+            if (!representations.empty())
+            {
+                columnar_table->setRepresentations(representationsFor(representations, columnar_table->readNumColumns()));
+            }
+            columnar_table->setSizeTolerance(size_tolerance);
+            if (!block_compression.empty())
+            {
+                columnar_table->setBlockCompression(blockCompressionFor(block_compression, columnar_table->readNumColumns()));
+            }
+        }
+        else if (use_log)
+        {
+            log.reset(new TableLog(filename, log_sync_ms));
+            if (!log->isOpen())
+            {
+                return 1;
+            }
+        }
+        else
+        {
+            writer.reset(new TableWriter(filename));
+            if (!writer->isOpen())
+            {
+                return 1;
+            }
+        }
+        uint32_t num_columns = columnar ? columnar_table->readNumColumns() : log ? log->numColumns() : writer->numColumns();
+        // a typed table's cells are parsed as their columns' types, whatever --uint32 says
+        TableSchema table_schema = columnar ? TableSchema() : log ? log->schema() : writer->schema();
+        as_uint32 = as_uint32 || !table_schema.empty();
+
+        std::string line;
+        std::vector<float> float_cells;
+        std::vector<uint32_t> uint32_cells;
+        uint32_t line_number = 0, skipped = 0, added = 0;
+        std::vector<uint32_t> log_batch;
+        auto logBatch = [&]
+        {
+            bool logged = log->appendRows_uint32_t(log_batch.data(), log_batch.size() / num_columns);
+            log_batch.clear();
+            return logged;
+        };
+        while (std::getline(input, line))
+        {
+            line_number++;
+            bool parsed;
+            if (!table_schema.empty())
+            {
+                parsed = parseCsvRow(line, table_schema, uint32_cells);
+            }
+            else
+            {
+                parsed = as_uint32 ? parseCsvRow(line, uint32_cells) : parseCsvRow(line, float_cells);
+            }
+            if (!parsed)
+            {
+                // header lines and blank lines
+                skipped++;
+                continue;
+            }
+
+            size_t num_cells = as_uint32 ? uint32_cells.size() : float_cells.size();
+            if (num_cells != num_columns)
+            {
+                std::cerr << "Error: Line " << line_number << " has " << num_cells << " cells, table has " << num_columns << " columns\n";
+                return 1;
+            }
+
+            bool appended;
+            if (columnar)
+            {
+                appended = as_uint32 ? columnar_table->appendRows_uint32_t(uint32_cells.data(), 1) : columnar_table->appendRows_float(float_cells.data(), 1);
+            }
+            else if (log)
+            {
+                // cells as their 32-bit patterns, logged LOG_BATCH_ROWS rows at a time
+                size_t end = log_batch.size();
+                log_batch.resize(end + num_columns);
+                std::memcpy(&log_batch[end], as_uint32 ? static_cast<const void *>(uint32_cells.data()) : float_cells.data(), num_columns * sizeof(uint32_t));
+                appended = log_batch.size() < LOG_BATCH_ROWS * num_columns || logBatch();
+            }
+            else
+            {
+                appended = as_uint32 ? writer->appendRow_uint32_t(uint32_cells.data()) : writer->appendRow_float(float_cells.data());
+            }
+            if (!appended)
+            {
+                return 1;
+            }
+            added++;
+        }
+
+        if (columnar ? !columnar_table->flush() : log ? !logBatch() || !log->close() : !writer->close())
+        {
+            return 1;
+        }
+        std::cout << added << " rows added to table " << filename << " (" << skipped << " lines skipped).\n";
+    }
     else if (command == "fullouterjoin")
+    {
+        if (argc < 7)
+        {
+            std::cerr << "Usage: ./rt_program fullouterjoin <new_filename.tbl> <table1.tbl> <\"key_col,...\"> <table2.tbl> <\"key_col,...\">\n";
+            return 1;
+        }
+
+        RelationalTable table1(argv[3]);
+        RelationalTable table2(argv[5]);
+
+        std::vector<uint32_t> col1 = splitString(argv[4]);
+        std::vector<uint32_t> col2 = splitString(argv[6]);
+
+        RelationalTable new_table = table1.full_outer_join(table2, filename, col1, col2);
+        new_table.printTable();
+    }
+    else if (command == "crossjoin")
     {
         if (argc < 5)
         {
-            std::cerr << "Usage: ./rt_program fullouterjoin <new_filename.tbl> <table1.tbl> <table2.tbl>\n";
+            std::cerr << "Usage: ./rt_program crossjoin <new_filename.tbl> <table1.tbl> <table2.tbl> [memory_budget_mb]\n";
             return 1;
         }
-        
+
         RelationalTable table1(argv[3]);
         RelationalTable table2(argv[4]);
+        size_t memory_budget = argc > 5 ? size_t(std::stoul(argv[5])) << 20 : DEFAULT_JOIN_MEMORY_BUDGET;
 
-        RelationalTable new_table = table1.full_outer_join(table2, filename);
-        new_table.printTable();
+        RelationalTable new_table = table1.cross_join(table2, filename, memory_budget);
+        std::cout << "Table " << filename << " created with " << new_table.readNumEntries() << " rows.\n";
     }
     else if (command == "innerjoin")
     {
-        if (argc < 6)       
+        if (argc < 7)
         {
             std::cerr << "Usage: ./rt_program innerjoin <new_filename.tbl> <table1.tbl> <\"#,#,#,...\"> <table2.tbl> <\"#,#,#\">\n";
             return 1;
@@ -83,11 +566,202 @@ int main(int argc, char *argv[])
         RelationalTable new_table = table1.inner_join(table2, filename, col1, col2);
         new_table.printTable();
     }
+    else if (command == "hashjoin")
+    {
+        if (argc < 7)
+        {
+            std::cerr << "Usage: ./rt_program hashjoin <new_filename.tbl> <table1.tbl> <\"key_col,...\"> <table2.tbl> <\"key_col,...\"> [num_threads]\n";
+            return 1;
+        }
+
+        RelationalTable table1(argv[3]);
+        RelationalTable table2(argv[5]);
+        std::vector<uint32_t> col1 = splitString(argv[4]);
+        std::vector<uint32_t> col2 = splitString(argv[6]);
+        uint32_t num_threads = argc > 7 ? std::stoi(argv[7]) : 1;
+
+        // same join as innerjoin, but only report the size since the output can be large
+        RelationalTable new_table = table1.inner_join(table2, filename, col1, col2, num_threads);
+        std::cout << "Table " << filename << " created with " << new_table.readNumEntries() << " rows.\n";
+    }
+    else if (command == "filter")
+    {
+        if (argc < 4)
+        {
+            std::cerr << "Usage: ./rt_program filter <filename.tbl> <\"column op value...\"> [<\"column op value...\"> ...] [--uint32]\n";
+            std::cerr << "Ops: = < > between in, e.g. \"2 between 10 20\" or \"1 in 1,3\"; cells compare as floats unless --uint32 is given or the table is typed\n";
+            return 1;
+        }
+
+        std::vector<std::string> texts(argv + 3, argv + argc);
+        CellType type = CellType::Float;
+        if (texts.back() == "--uint32")
+        {
+            type = CellType::Uint32;
+            texts.pop_back();
+        }
+        TableSchema table_schema = columnar ? TableSchema() : RelationalTable(filename).schema();
+        std::vector<Predicate> predicates(texts.size());
+        for (size_t i = 0; i < texts.size(); i++)
+        {
+            // in a typed table parsed again once the column, and so its type, is known (floats take any number)
+            CellType column_type;
+            if (!ParsePredicate(texts[i], table_schema.empty() ? type : CellType::Float, predicates[i]))
+            {
+                std::cerr << "Error: Unable to parse predicate \"" << texts[i] << "\"\n";
+                return 1;
+            }
+            if (!cellTypeFor(table_schema, predicates[i].column, type, column_type))
+            {
+                return 1;
+            }
+            if (!ParsePredicate(texts[i], column_type, predicates[i]))
+            {
+                std::cerr << "Error: Unable to parse predicate \"" << texts[i] << "\" for column " << predicates[i].column << std::endl;
+                return 1;
+            }
+        }
+
+        SelectionBitmap selection;
+        if (columnar)
+        {
+            selection = ColumnarRelationalTable(filename).filter(predicates);
+        }
+        else
+        {
+            selection = RelationalTable(filename).filter(predicates);
+        }
+        std::cout << selection.count() << " of " << selection.size() << " rows match.\n";
+    }
+    else if (command == "aggregate")
+    {
+        if (argc < 4)
+        {
+            std::cerr << "Usage: ./rt_program aggregate <filename.tbl> <\"op(column)\"> [<\"op(column)\"> ...] [--group-by <column>] [--uint32]\n";
+            std::cerr << "Ops: count sum min max avg, and count(*); cells are read as floats unless --uint32 is given or the table is typed\n";
+            return 1;
+        }
+
+        CellType type = CellType::Float;
+        bool grouped = false;
+        uint32_t key_column = 0;
+        std::vector<std::string> texts;
+        for (int i = 3; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "--uint32")
+            {
+                type = CellType::Uint32;
+            }
+            else if (arg == "--group-by" && i + 1 < argc)
+            {
+                grouped = true;
+                key_column = std::stoi(argv[++i]);
+            }
+            else
+            {
+                texts.push_back(arg);
+            }
+        }
+        TableSchema table_schema = columnar ? TableSchema() : RelationalTable(filename).schema();
+        std::vector<Aggregate> aggregates(texts.size());
+        for (size_t i = 0; i < texts.size(); i++)
+        {
+            if (!ParseAggregate(texts[i], type, aggregates[i]))
+            {
+                std::cerr << "Error: Unable to parse aggregate \"" << texts[i] << "\"\n";
+                return 1;
+            }
+            if (!aggregates[i].all_rows && !cellTypeFor(table_schema, aggregates[i].column, type, aggregates[i].type))
+            {
+                return 1;
+            }
+        }
+        CellType key_type = type;
+        if (grouped && !cellTypeFor(table_schema, key_column, type, key_type))
+        {
+            return 1;
+        }
+
+        Aggregation aggregation;
+        if (columnar)
+        {
+            ColumnarRelationalTable table(filename);
+            aggregation = grouped ? table.aggregate(aggregates, key_column, type) : table.aggregate(aggregates);
+        }
+        else
+        {
+            RelationalTable table(filename);
+            aggregation = grouped ? table.aggregate(aggregates, key_column, key_type) : table.aggregate(aggregates);
+        }
+        if (aggregation.aggregates().empty())
+        {
+            return 1;
+        }
+        aggregation.print(std::cout);
+    }
+    else if (command == "stats")
+    {
+        if (!columnar)
+        {
+            std::cerr << "Error: stats is only supported for columnar tables (--format columnar)\n";
+            return 1;
+        }
+        ColumnarRelationalTable(filename).printStats(std::cout);
+    }
+    else if (command == "compress")
+    {
+        if (argc < 5)
+        {
+            std::cerr << "Usage: ./rt_program compress <new_filename.tbl> <table.tbl> <\"#,#,#,...\"|auto> [row_group_size] [num_threads] [--size-tolerance <fraction>] [--block-compression <\"none|lz|lz:<level>,...\">]\n";
+            std::cerr << "Representations: 1 direct, 2 run-length, 3 one-byte dictionary, 4 one-byte delta, 5 constant, 6 bit-packed, auto picked per row group\n";
+            return 1;
+        }
+
+        RelationalTable table(argv[3]);
+        if (!parseRepresentations(argv[4], representations))
+        {
+            std::cerr << "Error: Unable to parse representations " << argv[4] << std::endl;
+            return 1;
+        }
+        uint32_t row_group_size = argc > 5 ? std::stoi(argv[5]) : 1024;
+        uint32_t num_threads = argc > 6 ? std::stoi(argv[6]) : 1;
+
+        if (!table.compressData(filename, representationsFor(representations, table.readNumColumns()), row_group_size, size_tolerance, num_threads,
+                                blockCompressionFor(block_compression, table.readNumColumns())))
+        {
+            return 1;
+        }
+        std::cout << "Table " << argv[3] << " compressed into " << filename << ".\n";
+    }
+    else if (command == "decompress")
+    {
+        if (argc < 4)
+        {
+            std::cerr << "Usage: ./rt_program decompress <new_filename.tbl> <compressed.tbl> [num_threads]\n";
+            return 1;
+        }
+        uint32_t num_threads = argc > 4 ? std::stoi(argv[4]) : 1;
+
+        RelationalTable new_table = RelationalTable::decompressData(argv[3], filename, num_threads);
+        new_table.printTable();
+    }
     else
     {
-        std::cerr << "Invalid command. Use 'create', 'read', 'add', 'fullouterjoin', or 'innerjoin'.\n";
+        std::cerr << "Invalid command. Use 'create', 'read', 'add', 'bulk-add', 'fullouterjoin', 'crossjoin', 'innerjoin', 'hashjoin', 'filter', 'aggregate', 'stats', 'compress', or 'decompress'.\n";
         return 1;
     }
 
+    // operators that stop on an error report it themselves, the exit status has to show it as well
+    if (memory.exceeded())
+    {
+        std::cerr << "Error: The command needed more than the memory limit of " << (memory_limit >> 20) << " MiB\n";
+        return 1;
+    }
     return 0;
+}
+catch (const char *message)
+{
+    std::cerr << "Error: " << message << std::endl;
+    return 1;
 }
\ No newline at end of file
@@ -0,0 +1,216 @@
+#include "schema.hpp"
+#include "instrumentation.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+
+#include <unistd.h>
+
+namespace
+{
+    const ColumnType ALL_COLUMN_TYPES[] = {ColumnType::Uint32, ColumnType::Int32, ColumnType::Float32, ColumnType::Uint64, ColumnType::Int64, ColumnType::Float64};
+
+    bool readAt(int fd, void *data, size_t size, off_t offset)
+    {
+        RT_COUNT_READ(size);
+        return pread(fd, data, size, offset) == ssize_t(size);
+    }
+
+    // The header through read_at(data, size, offset), which reads exactly size bytes or fails
+    template <typename ReadAt>
+    bool readTableHeader(ReadAt read_at, TableHeader &header)
+    {
+        header = TableHeader();
+        uint32_t fields[2];
+        if (!read_at(fields, sizeof(fields), 0))
+        {
+            return false;
+        }
+        header.num_entries = fields[0];
+        header.num_columns = fields[1] & ~TABLE_SCHEMA_FLAG;
+        if ((fields[1] & TABLE_SCHEMA_FLAG) == 0)
+        {
+            return true;
+        }
+
+        // schema size and version, then the columns
+        uint32_t schema_fields[2];
+        if (!read_at(schema_fields, sizeof(schema_fields), sizeof(fields)) || schema_fields[1] != TABLE_SCHEMA_VERSION)
+        {
+            return false;
+        }
+        std::vector<uint8_t> bytes(schema_fields[0]);
+        if (!read_at(bytes.data(), bytes.size(), sizeof(fields) + sizeof(schema_fields)))
+        {
+            return false;
+        }
+        size_t offset = 0;
+        for (uint32_t c = 0; c < header.num_columns; c++)
+        {
+            if (offset + 2 > bytes.size() || bytes[offset] > uint8_t(ColumnType::Float64) || offset + 2 + bytes[offset + 1] > bytes.size())
+            {
+                return false;
+            }
+            header.schema.types.push_back(ColumnType(bytes[offset]));
+            header.schema.names.emplace_back(reinterpret_cast<const char *>(&bytes[offset + 2]), bytes[offset + 1]);
+            offset += 2 + bytes[offset + 1];
+        }
+        header.data_offset = sizeof(fields) + sizeof(schema_fields) + bytes.size();
+        return header.data_offset % sizeof(uint32_t) == 0;
+    }
+}
+
+const char *ColumnTypeName(ColumnType type)
+{
+    switch (type)
+    {
+    case ColumnType::Uint32:
+        return ColumnTraits<ColumnType::Uint32>::name;
+    case ColumnType::Int32:
+        return ColumnTraits<ColumnType::Int32>::name;
+    case ColumnType::Float32:
+        return ColumnTraits<ColumnType::Float32>::name;
+    case ColumnType::Uint64:
+        return ColumnTraits<ColumnType::Uint64>::name;
+    case ColumnType::Int64:
+        return ColumnTraits<ColumnType::Int64>::name;
+    case ColumnType::Float64:
+        return ColumnTraits<ColumnType::Float64>::name;
+    }
+    return "?";
+}
+
+bool ParseColumnType(const std::string &text, ColumnType &type)
+{
+    for (ColumnType candidate : ALL_COLUMN_TYPES)
+    {
+        if (text == ColumnTypeName(candidate))
+        {
+            type = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+TableSchema TableSchema::concat(const TableSchema &other) const
+{
+    if (empty() || other.empty())
+    {
+        return TableSchema();
+    }
+    TableSchema schema = *this;
+    schema.types.insert(schema.types.end(), other.types.begin(), other.types.end());
+    schema.names.insert(schema.names.end(), other.names.begin(), other.names.end());
+    return schema;
+}
+
+std::string TableSchema::toString() const
+{
+    std::string text;
+    for (uint32_t c = 0; c < numColumns(); c++)
+    {
+        if (c > 0)
+        {
+            text += ",";
+        }
+        if (!names[c].empty())
+        {
+            text += names[c] + ":";
+        }
+        text += ColumnTypeName(types[c]);
+    }
+    return text;
+}
+
+bool ParseSchema(const std::string &text, TableSchema &schema)
+{
+    schema = TableSchema();
+    std::string item;
+    std::istringstream stream(text);
+    while (std::getline(stream, item, ','))
+    {
+        size_t colon = item.rfind(':');
+        std::string name = colon == std::string::npos ? "" : item.substr(0, colon);
+        ColumnType type;
+        if (!ParseColumnType(item.substr(colon == std::string::npos ? 0 : colon + 1), type) || name.size() > 255 || name.find(':') != std::string::npos)
+        {
+            return false;
+        }
+        schema.types.push_back(type);
+        schema.names.push_back(name);
+    }
+    return !schema.empty();
+}
+
+bool ReadTableHeader(int fd, TableHeader &header)
+{
+    return readTableHeader([fd](void *data, size_t size, off_t offset)
+                           { return readAt(fd, data, size, offset); },
+                           header);
+}
+
+bool ReadTableHeader(std::istream &file, TableHeader &header)
+{
+    return readTableHeader([&file](void *data, size_t size, off_t offset)
+                           {
+                               RT_COUNT(Seeks);
+                               file.seekg(offset);
+                               RT_COUNT_READ(size);
+                               file.read(static_cast<char *>(data), size);
+                               return bool(file); },
+                           header);
+}
+
+std::vector<uint8_t> EncodeTableHeader(uint32_t num_entries, uint32_t num_columns, const TableSchema &schema)
+{
+    std::vector<uint8_t> columns;
+    for (uint32_t c = 0; c < schema.numColumns(); c++)
+    {
+        columns.push_back(uint8_t(schema.types[c]));
+        columns.push_back(uint8_t(schema.names[c].size()));
+        columns.insert(columns.end(), schema.names[c].begin(), schema.names[c].end());
+    }
+    columns.resize((columns.size() + 3) / 4 * 4, 0);
+
+    uint32_t fields[4] = {num_entries, num_columns, uint32_t(columns.size()), TABLE_SCHEMA_VERSION};
+    if (!schema.empty())
+    {
+        fields[1] |= TABLE_SCHEMA_FLAG;
+    }
+    const uint8_t *field_bytes = reinterpret_cast<const uint8_t *>(fields);
+    std::vector<uint8_t> header(field_bytes, field_bytes + (schema.empty() ? 2 : 4) * sizeof(uint32_t));
+    header.insert(header.end(), columns.begin(), columns.end());
+    return header;
+}
+
+bool ParseCell(const char *text, char **end, ColumnType type, uint32_t &cell)
+{
+    errno = 0;
+    switch (type)
+    {
+    case ColumnType::Uint32:
+    {
+        long long value = std::strtoll(text, end, 10);
+        cell = uint32_t(value);
+        return *end != text && errno == 0 && value >= 0 && value <= std::numeric_limits<uint32_t>::max();
+    }
+    case ColumnType::Int32:
+    {
+        long long value = std::strtoll(text, end, 10);
+        cell = uint32_t(int32_t(value));
+        return *end != text && errno == 0 && value >= std::numeric_limits<int32_t>::min() && value <= std::numeric_limits<int32_t>::max();
+    }
+    case ColumnType::Float32:
+    {
+        float value = std::strtof(text, end);
+        std::memcpy(&cell, &value, sizeof(cell));
+        return *end != text;
+    }
+    default:
+        *end = const_cast<char *>(text);
+        return false;
+    }
+}
@@ -0,0 +1,163 @@
+#ifndef _schema_h_
+#define _schema_h_
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Type of the values a column holds; the tag is what the .tbl header stores
+enum class ColumnType : uint8_t
+{
+    Uint32 = 0,
+    Int32 = 1,
+    Float32 = 2,
+    Uint64 = 3,
+    Int64 = 4,
+    Float64 = 5,
+};
+
+// Set in the num_columns field of a .tbl header when a schema follows it; older files never have it
+const uint32_t TABLE_SCHEMA_FLAG = 0x80000000u;
+const uint32_t TABLE_SCHEMA_VERSION = 1;
+
+// Value type and name of each column type
+template <ColumnType Type>
+struct ColumnTraits;
+
+template <>
+struct ColumnTraits<ColumnType::Uint32>
+{
+    using value_type = uint32_t;
+    static constexpr const char *name = "u32";
+};
+
+template <>
+struct ColumnTraits<ColumnType::Int32>
+{
+    using value_type = int32_t;
+    static constexpr const char *name = "i32";
+};
+
+template <>
+struct ColumnTraits<ColumnType::Float32>
+{
+    using value_type = float;
+    static constexpr const char *name = "f32";
+};
+
+template <>
+struct ColumnTraits<ColumnType::Uint64>
+{
+    using value_type = uint64_t;
+    static constexpr const char *name = "u64";
+};
+
+template <>
+struct ColumnTraits<ColumnType::Int64>
+{
+    using value_type = int64_t;
+    static constexpr const char *name = "i64";
+};
+
+template <>
+struct ColumnTraits<ColumnType::Float64>
+{
+    using value_type = double;
+    static constexpr const char *name = "f64";
+};
+
+// Call f with the ColumnTraits of a type that fits a 32-bit cell, so per-type code is picked once and not
+// per cell; false without calling f for the 64-bit types
+template <typename F>
+bool WithCellType(ColumnType type, F f)
+{
+    switch (type)
+    {
+    case ColumnType::Uint32:
+        f(ColumnTraits<ColumnType::Uint32>());
+        return true;
+    case ColumnType::Int32:
+        f(ColumnTraits<ColumnType::Int32>());
+        return true;
+    case ColumnType::Float32:
+        f(ColumnTraits<ColumnType::Float32>());
+        return true;
+    default:
+        return false;
+    }
+}
+
+// A 32-bit cell read as a value of type T (its bit pattern)
+template <typename T>
+T CellAs(uint32_t cell)
+{
+    static_assert(sizeof(T) == sizeof(uint32_t), "cells are 32 bits");
+    T value;
+    std::memcpy(&value, &cell, sizeof(value));
+    return value;
+}
+
+const char *ColumnTypeName(ColumnType type);
+bool ParseColumnType(const std::string &text, ColumnType &type);
+
+// Per-column types and names of a table. An empty schema is an untyped table from before schemas,
+// whose cells are read as floats unless told otherwise.
+struct TableSchema
+{
+    std::vector<ColumnType> types;
+    std::vector<std::string> names; // one per column, empty for a column without a name
+
+    bool empty() const { return types.empty(); }
+    uint32_t numColumns() const { return types.size(); }
+
+    // Schema of the rows of a join: this table's columns followed by other's; untyped unless both are typed
+    TableSchema concat(const TableSchema &other) const;
+
+    // e.g. "id:u32,qty:i32,f32"
+    std::string toString() const;
+};
+
+// Parse "[name:]type,[name:]type,..." with type one of u32 i32 f32 u64 i64 f64; names are at most
+// 255 bytes and hold neither ':' nor ','
+bool ParseSchema(const std::string &text, TableSchema &schema);
+
+// Header at the start of a .tbl file: num_entries and num_columns (4 bytes each), and when num_columns
+// has TABLE_SCHEMA_FLAG set the schema: its size in bytes (4 bytes, counting what follows the version),
+// the version (4 bytes), then per column the type tag (1 byte), the name length (1 byte) and the name,
+// padded with zeros to a multiple of 4 bytes so the cells stay aligned. Rows start at data_offset.
+struct TableHeader
+{
+    uint32_t num_entries = 0;
+    uint32_t num_columns = 0; // without the flag
+    uint32_t data_offset = 2 * sizeof(uint32_t);
+    TableSchema schema;
+};
+
+// The committed row count at the start of a mapped table, loaded once: every row below it was written
+// before a writer stored it, so the count is a consistent snapshot to read rows up to
+inline uint32_t LoadCommittedCount(const uint8_t *header)
+{
+    return __atomic_load_n(reinterpret_cast<const uint32_t *>(header), __ATOMIC_ACQUIRE);
+}
+
+// Read the header of an open table; false if it is cut short or its schema can't be read
+bool ReadTableHeader(int fd, TableHeader &header);
+bool ReadTableHeader(std::istream &file, TableHeader &header);
+
+// The bytes of a header; an empty schema gives the 8-byte header of an untyped table
+std::vector<uint8_t> EncodeTableHeader(uint32_t num_entries, uint32_t num_columns, const TableSchema &schema);
+
+// Parse a cell written as a number of the given 32-bit type into its bit pattern; end as with strtol
+bool ParseCell(const char *text, char **end, ColumnType type, uint32_t &cell);
+
+// Print a cell as a value of type T
+template <typename T>
+void PrintCell(std::ostream &out, uint32_t cell)
+{
+    out << CellAs<T>(cell);
+}
+
+#endif
@@ -0,0 +1,101 @@
+#include "table_handle.hpp"
+#include "instrumentation.hpp"
+
+#include <map>
+#include <mutex>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    std::mutex registry_mutex;
+    std::map<std::pair<dev_t, ino_t>, std::weak_ptr<TableHandle>> registry;
+}
+
+TableHandle::TableHandle(const std::string &file_name, int fd, dev_t device, ino_t inode)
+    : file_name_(file_name), fd_(fd), device_(device), inode_(inode), header_page_(nullptr)
+{
+}
+
+TableHandle::~TableHandle()
+{
+    if (header_page_)
+    {
+        munmap(const_cast<uint8_t *>(header_page_), sizeof(uint32_t));
+    }
+    ::close(fd_);
+}
+
+bool TableHandle::truncatedTo(off_t size) const
+{
+    // the count itself can't be loaded from a file cut shorter than it
+    return size < off_t(sizeof(uint32_t)) || size < off_t(dataOffset()) + off_t(numEntries()) * numColumns() * off_t(sizeof(uint32_t));
+}
+
+std::shared_ptr<TableHandle> OpenTableHandle(const std::string &file_name)
+{
+    struct stat st;
+    if (stat(file_name.c_str(), &st) != 0)
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto found = registry.find({st.st_dev, st.st_ino});
+    if (found != registry.end())
+    {
+        std::shared_ptr<TableHandle> handle = found->second.lock();
+        if (handle && !handle->truncatedTo(st.st_size))
+        {
+            RT_COUNT(HandleReuses);
+            return handle;
+        }
+        registry.erase(found);
+    }
+
+    RT_COUNT(FileOpens);
+    int fd = ::open(file_name.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+    // the file opened, in case the name was pointed elsewhere since the stat
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return nullptr;
+    }
+    std::shared_ptr<TableHandle> handle(new TableHandle(file_name, fd, st.st_dev, st.st_ino));
+    if (!ReadTableHeader(fd, handle->header_))
+    {
+        return nullptr;
+    }
+    void *header_page = mmap(nullptr, sizeof(uint32_t), PROT_READ, MAP_SHARED, fd, 0);
+    if (header_page == MAP_FAILED)
+    {
+        return nullptr;
+    }
+    handle->header_page_ = static_cast<const uint8_t *>(header_page);
+
+    // drop the entries of handles no longer in use while here
+    for (auto entry = registry.begin(); entry != registry.end();)
+    {
+        entry = entry->second.expired() ? registry.erase(entry) : std::next(entry);
+    }
+    registry[{st.st_dev, st.st_ino}] = handle;
+    return handle;
+}
+
+size_t NumOpenTableHandles()
+{
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    size_t open = 0;
+    for (const auto &entry : registry)
+    {
+        open += !entry.second.expired();
+    }
+    return open;
+}
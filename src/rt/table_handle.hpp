@@ -0,0 +1,60 @@
+#ifndef _table_handle_h_
+#define _table_handle_h_
+
+#include "schema.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <sys/types.h>
+
+// An open .tbl file shared by every table of it in the process: one read-only descriptor, and the header
+// read once when the file is first opened. Number of columns, schema and where the rows start never change;
+// the row count does, and is read from a shared mapping of the header page, where every TableWriter, in this
+// process or another, stores what it commits. Get handles from OpenTableHandle.
+class TableHandle
+{
+public:
+    ~TableHandle();
+
+    TableHandle(const TableHandle &) = delete;
+    TableHandle &operator=(const TableHandle &) = delete;
+
+    int fd() const { return fd_; }
+    const std::string &fileName() const { return file_name_; }
+    uint32_t numColumns() const { return header_.num_columns; }
+    uint32_t dataOffset() const { return header_.data_offset; }
+    const TableSchema &schema() const { return header_.schema; }
+    dev_t device() const { return device_; }
+    ino_t inode() const { return inode_; }
+
+    // Committed rows: an acquire load of the count in the header, so the rows below it are all written
+    uint32_t numEntries() const { return LoadCommittedCount(header_page_); }
+
+private:
+    friend std::shared_ptr<TableHandle> OpenTableHandle(const std::string &file_name);
+
+    TableHandle(const std::string &file_name, int fd, dev_t device, ino_t inode);
+
+    std::string file_name_;
+    int fd_;
+    dev_t device_;
+    ino_t inode_;
+    TableHeader header_;
+    const uint8_t *header_page_;    // read-only shared mapping of the count at the start of the file
+
+    // Whether a file of size bytes is too short for the rows committed, i.e. was truncated and written again
+    bool truncatedTo(off_t size) const;
+};
+
+// The handle of a table file, opening it (and reading its header) only if no handle of the same file, by
+// device and inode, is still in use; nullptr if the file can't be opened or its header read. A file
+// replaced under the same name (removed and created again) gets a new handle, while tables holding the old
+// one keep reading the old file. Safe to call from several threads.
+std::shared_ptr<TableHandle> OpenTableHandle(const std::string &file_name);
+
+// Handles currently in use
+size_t NumOpenTableHandles();
+
+#endif
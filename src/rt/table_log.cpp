@@ -0,0 +1,503 @@
+#include "table_log.hpp"
+#include "instrumentation.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    // Log header: magic, version, number of columns, 0. Each entry: magic, first row, number of rows and a
+    // CRC-32 of the three and the rows, then the rows.
+    const uint32_t LOG_MAGIC = 0x4C415752; // "RWAL"
+    const uint32_t LOG_VERSION = 1;
+    const uint32_t ENTRY_MAGIC = 0x59544E45; // "ENTY"
+    const size_t LOG_HEADER_BYTES = 4 * sizeof(uint32_t);
+    const size_t ENTRY_HEADER_BYTES = 4 * sizeof(uint32_t);
+
+    uint32_t crc32(uint32_t crc, const void *data, size_t size)
+    {
+        static const std::vector<uint32_t> table = []
+        {
+            std::vector<uint32_t> entries(256);
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t entry = i;
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    entry = (entry >> 1) ^ (entry & 1 ? 0xEDB88320u : 0);
+                }
+                entries[i] = entry;
+            }
+            return entries;
+        }();
+
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++)
+        {
+            crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    uint32_t entryChecksum(const uint32_t *fields, const uint32_t *cells, size_t num_cells)
+    {
+        return crc32(crc32(0, fields, 3 * sizeof(uint32_t)), cells, num_cells * sizeof(uint32_t));
+    }
+
+    void encodeEntry(uint32_t first_row, const std::vector<uint32_t> &cells, uint32_t num_columns, std::vector<uint8_t> &bytes)
+    {
+        uint32_t fields[4] = {ENTRY_MAGIC, first_row, uint32_t(cells.size() / num_columns), 0};
+        fields[3] = entryChecksum(fields, cells.data(), cells.size());
+        const uint8_t *field_bytes = reinterpret_cast<const uint8_t *>(fields);
+        const uint8_t *cell_bytes = reinterpret_cast<const uint8_t *>(cells.data());
+        bytes.insert(bytes.end(), field_bytes, field_bytes + sizeof(fields));
+        bytes.insert(bytes.end(), cell_bytes, cell_bytes + cells.size() * sizeof(uint32_t));
+    }
+
+    bool readAt(int fd, void *data, size_t size, off_t offset)
+    {
+        RT_COUNT_READ(size);
+        return pread(fd, data, size, offset) == ssize_t(size);
+    }
+
+    // pwrite the whole buffer, retrying short writes
+    bool writeAll(int fd, const void *data, size_t size, off_t offset)
+    {
+        const char *bytes = static_cast<const char *>(data);
+        while (size > 0)
+        {
+            ssize_t written = pwrite(fd, bytes, size, offset);
+            RT_COUNT_WRITE(written > 0 ? written : 0);
+            if (written <= 0)
+            {
+                return false;
+            }
+            bytes += written;
+            size -= written;
+            offset += written;
+        }
+        return true;
+    }
+
+    // Open and lock a log, creating it if asked; -1 if it doesn't exist or can't be opened, or if another
+    // TableLog holds it (in_use)
+    int openLog(const std::string &file_name, bool create, bool &in_use)
+    {
+        in_use = false;
+        while (true)
+        {
+            RT_COUNT(FileOpens);
+            int fd = ::open(file_name.c_str(), O_RDWR | (create ? O_CREAT : 0), 0644);
+            if (fd < 0)
+            {
+                return -1;
+            }
+            if (flock(fd, LOCK_EX | LOCK_NB) != 0)
+            {
+                ::close(fd);
+                in_use = true;
+                return -1;
+            }
+            // the TableLog that held it until now removed it when it was done; the name may be a new log
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_nlink > 0)
+            {
+                return fd;
+            }
+            ::close(fd);
+            if (!create)
+            {
+                return -1;
+            }
+        }
+    }
+
+    // Append the complete entries of a log that the table is missing through writer, stopping at the first
+    // entry that is cut short, fails its checksum or doesn't follow on from the one before (a torn tail, or
+    // what was left past it from before the log was last emptied). False if the log isn't one of this table.
+    bool replayLog(int fd, const std::string &file_name, TableWriter &writer)
+    {
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            std::cerr << "Error: Unable to read log " << file_name << std::endl;
+            return false;
+        }
+        // a log cut short before its header is complete holds nothing yet
+        size_t size = st.st_size;
+        if (size < LOG_HEADER_BYTES)
+        {
+            return true;
+        }
+        uint32_t header[4];
+        uint32_t num_columns = writer.numColumns();
+        if (!readAt(fd, header, sizeof(header), 0) || header[0] != LOG_MAGIC || header[1] != LOG_VERSION || header[2] != num_columns)
+        {
+            std::cerr << "Error: " << file_name << " is not a log of a table with " << num_columns << " columns" << std::endl;
+            return false;
+        }
+
+        std::vector<uint32_t> cells;
+        uint64_t next_row = 0;
+        for (size_t offset = LOG_HEADER_BYTES; offset + ENTRY_HEADER_BYTES <= size;)
+        {
+            uint32_t fields[4];
+            if (!readAt(fd, fields, sizeof(fields), offset) || fields[0] != ENTRY_MAGIC || (offset > LOG_HEADER_BYTES && fields[1] != next_row))
+            {
+                break;
+            }
+            size_t num_cells = size_t(fields[2]) * num_columns;
+            if (offset + ENTRY_HEADER_BYTES + num_cells * sizeof(uint32_t) > size)
+            {
+                break;
+            }
+            cells.resize(num_cells);
+            if (!readAt(fd, cells.data(), num_cells * sizeof(uint32_t), offset + ENTRY_HEADER_BYTES) || entryChecksum(fields, cells.data(), num_cells) != fields[3])
+            {
+                break;
+            }
+            offset += ENTRY_HEADER_BYTES + num_cells * sizeof(uint32_t);
+            next_row = uint64_t(fields[1]) + fields[2];
+
+            // entries the table already has (all of it, or the rows up to where it ends) are skipped
+            uint32_t table_rows = writer.numEntries();
+            if (fields[1] > table_rows)
+            {
+                std::cerr << "Error: " << file_name << " has rows from " << fields[1] << " on, but its table ends at " << table_rows << std::endl;
+                return false;
+            }
+            uint32_t skip = std::min<uint64_t>(fields[2], table_rows - fields[1]);
+            if (skip < fields[2] && !writer.appendRows_uint32_t(cells.data() + size_t(skip) * num_columns, fields[2] - skip))
+            {
+                return false;
+            }
+        }
+        return writer.flush();
+    }
+}
+
+std::string TableLog::fileNameFor(const std::string &table_file_name)
+{
+    return table_file_name + ".wal";
+}
+
+TableLog::TableLog(const std::string &table_file_name, uint32_t sync_interval_ms)
+    : table_file_name_(table_file_name), file_name_(fileNameFor(table_file_name)), fd_(-1), sync_interval_ms_(sync_interval_ms), writer_(table_file_name), log_end_(0),
+      next_row_(0), logged_(0), written_(0), synced_(0), applied_(0), sync_requested_(false), stopping_(false), logging_done_(false), failed_(false)
+{
+    if (!writer_.isOpen())
+    {
+        return;
+    }
+    bool in_use;
+    int fd = openLog(file_name_, true, in_use);
+    if (fd < 0)
+    {
+        std::cerr << "Error: " << (in_use ? "Log " + file_name_ + " is in use" : "Unable to open log " + file_name_) << std::endl;
+        return;
+    }
+
+    // the table is synced with every batch applied, so the log can be emptied once the table has caught up
+    writer_.setSyncCommits(true);
+    if (!replayLog(fd, file_name_, writer_))
+    {
+        ::close(fd);
+        return;
+    }
+    uint32_t header[4] = {LOG_MAGIC, LOG_VERSION, writer_.numColumns(), 0};
+    if (ftruncate(fd, 0) != 0 || !writeAll(fd, header, sizeof(header), 0) || fdatasync(fd) != 0)
+    {
+        std::cerr << "Error: Unable to write log " << file_name_ << std::endl;
+        ::close(fd);
+        return;
+    }
+
+    fd_ = fd;
+    log_end_ = LOG_HEADER_BYTES;
+    next_row_ = writer_.numEntries();
+    log_thread_ = std::thread(&TableLog::logLoop, this);
+    apply_thread_ = std::thread(&TableLog::applyLoop, this);
+}
+
+TableLog::~TableLog()
+{
+    close();
+}
+
+bool TableLog::appendRows_uint32_t(const uint32_t *rows, size_t num_rows)
+{
+    return log(rows, num_rows);
+}
+
+bool TableLog::appendRows_float(const float *rows, size_t num_rows)
+{
+    return log(rows, num_rows);
+}
+
+bool TableLog::log(const void *rows, size_t num_rows)
+{
+    if (fd_ < 0)
+    {
+        return false;
+    }
+    if (num_rows == 0)
+    {
+        return true;
+    }
+
+    // cells are logged as their 32-bit patterns, whatever their type
+    Entry entry;
+    entry.cells.resize(num_rows * numColumns());
+    std::memcpy(entry.cells.data(), rows, entry.cells.size() * sizeof(uint32_t));
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (failed_)
+    {
+        return false;
+    }
+    if (num_rows > std::numeric_limits<uint32_t>::max() - next_row_)
+    {
+        std::cerr << "Error: Too many rows for table " << table_file_name_ << std::endl;
+        return false;
+    }
+    entry.sequence = ++logged_;
+    entry.first_row = next_row_;
+    next_row_ += num_rows;
+    uint64_t sequence = entry.sequence;
+    pending_.push_back(std::move(entry));
+    work_.notify_one();
+
+    // durable, or written and soon durable, as the sync interval says
+    uint64_t &done = sync_interval_ms_ == 0 ? synced_ : written_;
+    progress_.wait(lock, [&]
+                   { return failed_ || done >= sequence; });
+    return done >= sequence;
+}
+
+bool TableLog::sync()
+{
+    if (fd_ < 0)
+    {
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t sequence = logged_;
+    sync_requested_ = true;
+    work_.notify_one();
+    progress_.wait(lock, [&]
+                   { return failed_ || synced_ >= sequence; });
+    return synced_ >= sequence;
+}
+
+bool TableLog::waitApplied()
+{
+    if (fd_ < 0)
+    {
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t sequence = logged_;
+    progress_.wait(lock, [&]
+                   { return failed_ || applied_ >= sequence; });
+    return applied_ >= sequence;
+}
+
+void TableLog::logLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        // batches to write, or written ones whose sync is due
+        while (pending_.empty() && !stopping_ && !sync_requested_)
+        {
+            if (synced_ == written_)
+            {
+                work_.wait(lock);
+            }
+            else if (std::chrono::steady_clock::now() >= sync_due_)
+            {
+                break;
+            }
+            else
+            {
+                work_.wait_until(lock, sync_due_);
+            }
+        }
+        if (stopping_ && pending_.empty() && synced_ == written_)
+        {
+            break;
+        }
+
+        // a log grown large waits for the table to catch up, then starts over; so does one the table has
+        // caught up with anyway
+        if (log_end_ >= CHECKPOINT_BYTES)
+        {
+            progress_.wait(lock, [this]
+                           { return failed_ || applied_ == written_; });
+        }
+        if (failed_)
+        {
+            break;
+        }
+        bool start_over = applied_ == written_ && log_end_ > LOG_HEADER_BYTES;
+        bool sync_now = sync_interval_ms_ == 0 || stopping_ || sync_requested_ || (synced_ < written_ && std::chrono::steady_clock::now() >= sync_due_);
+        bool was_synced = synced_ == written_;
+        uint64_t group_end = logged_;
+        std::deque<Entry> group;
+        group.swap(pending_);
+        sync_requested_ = false;
+        lock.unlock();
+
+        // the whole group in one write and one sync
+        std::vector<uint8_t> bytes;
+        for (const Entry &entry : group)
+        {
+            encodeEntry(entry.first_row, entry.cells, writer_.numColumns(), bytes);
+        }
+        bool done = true;
+        if (start_over)
+        {
+            done = ftruncate(fd_, LOG_HEADER_BYTES) == 0;
+            log_end_ = LOG_HEADER_BYTES;
+        }
+        done = done && writeAll(fd_, bytes.data(), bytes.size(), log_end_);
+        log_end_ += bytes.size();
+        if (done && sync_now)
+        {
+            RT_COUNT(LogSyncs);
+            done = fdatasync(fd_) == 0;
+        }
+
+        lock.lock();
+        if (!done)
+        {
+            std::cerr << "Error: Unable to write log " << file_name_ << std::endl;
+            failed_ = true;
+            break;
+        }
+        written_ = group_end;
+        if (sync_now)
+        {
+            synced_ = written_;
+        }
+        else if (was_synced && !group.empty())
+        {
+            sync_due_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(sync_interval_ms_);
+        }
+        for (Entry &entry : group)
+        {
+            to_apply_.push_back(std::move(entry));
+        }
+        apply_ready_.notify_one();
+        progress_.notify_all();
+    }
+    logging_done_ = true;
+    apply_ready_.notify_one();
+    progress_.notify_all();
+}
+
+void TableLog::applyLoop()
+{
+    uint32_t num_columns = writer_.numColumns();
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        apply_ready_.wait(lock, [this]
+                          { return !to_apply_.empty() || logging_done_; });
+        if (to_apply_.empty() || failed_)
+        {
+            break;
+        }
+        std::deque<Entry> group;
+        group.swap(to_apply_);
+        lock.unlock();
+
+        // the table is synced once per group, with the flush
+        bool done = true;
+        for (const Entry &entry : group)
+        {
+            done = done && writer_.appendRows_uint32_t(entry.cells.data(), entry.cells.size() / num_columns);
+        }
+        done = done && writer_.flush();
+        // rows appended to the table around the log would leave its entries pointing at the wrong rows
+        bool followed = writer_.numEntries() == group.back().first_row + group.back().cells.size() / num_columns;
+
+        lock.lock();
+        if (!done || !followed)
+        {
+            if (done)
+            {
+                std::cerr << "Error: Rows were appended to " << table_file_name_ << " around its log" << std::endl;
+            }
+            failed_ = true;
+            progress_.notify_all();
+            break;
+        }
+        applied_ = group.back().sequence;
+        progress_.notify_all();
+    }
+}
+
+bool TableLog::close()
+{
+    if (fd_ < 0)
+    {
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        work_.notify_one();
+    }
+    log_thread_.join();
+    apply_thread_.join();
+
+    // everything logged is in the table and synced, so the log has nothing left to recover
+    bool closed = !failed_ && writer_.close();
+    if (closed && unlink(file_name_.c_str()) != 0)
+    {
+        std::cerr << "Error: Unable to remove log " << file_name_ << std::endl;
+        closed = false;
+    }
+    ::close(fd_);
+    fd_ = -1;
+    return closed;
+}
+
+bool RecoverTableLog(const std::string &table_file_name)
+{
+    std::string file_name = TableLog::fileNameFor(table_file_name);
+    struct stat st;
+    if (stat(file_name.c_str(), &st) != 0)
+    {
+        return true;
+    }
+
+    // a log that is open is being applied by its TableLog, and one removed since the stat has been
+    bool in_use;
+    int fd = openLog(file_name, false, in_use);
+    if (fd < 0)
+    {
+        return in_use || stat(file_name.c_str(), &st) != 0;
+    }
+
+    TableWriter writer(table_file_name);
+    writer.setSyncCommits(true);
+    bool recovered = writer.isOpen() && replayLog(fd, file_name, writer) && writer.close();
+    if (recovered && unlink(file_name.c_str()) != 0)
+    {
+        std::cerr << "Error: Unable to remove log " << file_name << std::endl;
+        recovered = false;
+    }
+    ::close(fd);
+    return recovered;
+}
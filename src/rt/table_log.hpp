@@ -0,0 +1,110 @@
+#ifndef _table_log_h_
+#define _table_log_h_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "table_writer.hpp"
+
+// Write-ahead log of appends to a .tbl file, kept next to it as <table>.wal. A batch of rows goes to the log
+// as one checksummed entry and is appended to the table by a background thread afterwards. Batches logged
+// from several threads while the log is busy go out together, with one write and one sync (group commit).
+//
+// With a sync interval of 0 an append returns once its batch is synced to disk; otherwise it returns once
+// the batch is written, and the log is synced at most that many milliseconds later, so a crash loses at most
+// that long of appends. Each entry records the table row its batch starts at, which makes replaying it
+// idempotent: recovery appends what the table is missing and cuts off a torn or corrupt tail. The log is
+// emptied whenever the table has caught up with it and removed on close. One TableLog owns a log at a time,
+// and while it is open the table should be appended to only through it.
+class TableLog
+{
+public:
+    // Once the log is this large, new batches wait for the table to catch up so it can start over
+    static const size_t CHECKPOINT_BYTES = 64 << 20;
+
+    static std::string fileNameFor(const std::string &table_file_name);
+
+    // Open the log of an existing table, recovering what a previous one left behind first
+    explicit TableLog(const std::string &table_file_name, uint32_t sync_interval_ms = 0);
+
+    // Closes the log
+    ~TableLog();
+
+    TableLog(const TableLog &) = delete;
+    TableLog &operator=(const TableLog &) = delete;
+
+    bool isOpen() const { return fd_ >= 0; }
+    uint32_t numColumns() const { return writer_.numColumns(); }
+    // Column types and names of the table (only while isOpen())
+    const TableSchema &schema() const { return writer_.schema(); }
+
+    // Log num_rows rows of numColumns() cells laid out back to back. Safe to call from several threads;
+    // false once the log or the table can't be written.
+    bool appendRows_uint32_t(const uint32_t *rows, size_t num_rows);
+    bool appendRows_float(const float *rows, size_t num_rows);
+
+    // Block until every batch logged so far is synced to disk
+    bool sync();
+
+    // Block until every batch logged so far is in the table
+    bool waitApplied();
+
+    // Log and sync what is pending, apply everything to the table and remove the log
+    bool close();
+
+private:
+    struct Entry
+    {
+        uint64_t sequence;           // batches are numbered from 1 in the order they are logged
+        uint32_t first_row;          // table row the batch starts at
+        std::vector<uint32_t> cells; // row-major
+    };
+
+    std::string table_file_name_;
+    std::string file_name_;
+    int fd_;
+    uint32_t sync_interval_ms_;
+    TableWriter writer_;    // used by the apply thread once the log is open
+    size_t log_end_;        // where the next entry goes; only the log thread touches it once open
+
+    std::mutex mutex_;      // guards everything below
+    std::condition_variable work_;        // wakes the log thread
+    std::condition_variable apply_ready_; // wakes the apply thread
+    std::condition_variable progress_;    // batches were written, synced or applied, or something failed
+    uint32_t next_row_;     // table row the next batch starts at
+    uint64_t logged_;       // sequence of the last batch handed in, written, synced and applied
+    uint64_t written_;
+    uint64_t synced_;
+    uint64_t applied_;
+    std::chrono::steady_clock::time_point sync_due_; // when written but unsynced batches must be synced
+    std::deque<Entry> pending_;  // not written yet
+    std::deque<Entry> to_apply_; // written, not in the table yet
+    bool sync_requested_;
+    bool stopping_;
+    bool logging_done_;
+    bool failed_;
+    std::thread log_thread_;
+    std::thread apply_thread_;
+
+    bool log(const void *rows, size_t num_rows);
+
+    // Write batches to the log as they come and sync it as the interval says
+    void logLoop();
+
+    // Append written batches to the table
+    void applyLoop();
+};
+
+// Bring a table up to date with its log, if it has one and no TableLog has it open: append the complete
+// entries the table is missing, then remove the log. False (keeping the log) if it can't be read or doesn't
+// fit the table.
+bool RecoverTableLog(const std::string &table_file_name);
+
+#endif
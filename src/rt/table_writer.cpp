@@ -0,0 +1,271 @@
+#include "table_writer.hpp"
+#include "instrumentation.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace
+{
+    // pwrite the whole buffer, retrying short writes
+    bool writeAll(int fd, const void *data, size_t size, off_t offset)
+    {
+        const char *bytes = static_cast<const char *>(data);
+        while (size > 0)
+        {
+            ssize_t written = pwrite(fd, bytes, size, offset);
+            RT_COUNT_WRITE(written > 0 ? written : 0);
+            if (written <= 0)
+            {
+                return false;
+            }
+            bytes += written;
+            size -= written;
+            offset += written;
+        }
+        return true;
+    }
+
+    const uint64_t NO_DIRTY_BLOCK = ~0ull;
+}
+
+TableWriter::TableWriter(const std::string &file_name, size_t buffer_bytes)
+    : file_name_(file_name), fd_(-1), num_columns_(0), num_entries_(0), data_offset_(0), committed_count_(nullptr), sync_commits_(false), buffer_rows_(1), first_dirty_block_(NO_DIRTY_BLOCK)
+{
+    RT_COUNT(FileOpens);
+    fd_ = ::open(file_name.c_str(), O_RDWR);
+    if (fd_ < 0)
+    {
+        std::cerr << "Error: Unable to open file " << file_name << std::endl;
+        return;
+    }
+
+    // the header comes from the table's handle, which also learns of every commit
+    handle_ = OpenTableHandle(file_name);
+    if (!handle_)
+    {
+        std::cerr << "Error: Unable to parse metadata for table " << file_name << std::endl;
+        ::close(fd_);
+        fd_ = -1;
+        return;
+    }
+    num_entries_ = handle_->numEntries();
+    num_columns_ = handle_->numColumns();
+    data_offset_ = handle_->dataOffset();
+
+    // the row count is published with an atomic store into the shared header page
+    void *header = mmap(nullptr, sizeof(uint32_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (header == MAP_FAILED)
+    {
+        std::cerr << "Error: Unable to map the header of " << file_name << std::endl;
+        ::close(fd_);
+        fd_ = -1;
+        return;
+    }
+    committed_count_ = static_cast<uint32_t *>(header);
+
+    size_t row_size = num_columns_ * sizeof(uint32_t);
+    if (row_size > 0 && buffer_bytes / row_size > 1)
+    {
+        buffer_rows_ = buffer_bytes / row_size;
+    }
+    buffer_.reserve(buffer_rows_ * num_columns_);
+    validity_.load(file_name_, num_columns_);
+}
+
+TableWriter::~TableWriter()
+{
+    close();
+}
+
+uint32_t TableWriter::numEntries() const
+{
+    return num_entries_ + (num_columns_ == 0 ? 0 : buffer_.size() / num_columns_);
+}
+
+bool TableWriter::appendRow_uint32_t(const uint32_t *row)
+{
+    return appendRows_uint32_t(row, 1);
+}
+
+bool TableWriter::appendRow_float(const float *row)
+{
+    return appendRows_float(row, 1);
+}
+
+bool TableWriter::appendRows_uint32_t(const uint32_t *rows, size_t num_rows)
+{
+    if (fd_ < 0 || num_columns_ == 0)
+    {
+        return false;
+    }
+
+    // a batch at least as large as the buffer goes straight to the file
+    if (buffer_.empty() && num_rows >= buffer_rows_)
+    {
+        return commit(rows, num_rows);
+    }
+
+    while (num_rows > 0)
+    {
+        size_t buffered_rows = buffer_.size() / num_columns_;
+        size_t take = std::min(num_rows, buffer_rows_ - buffered_rows);
+        buffer_.insert(buffer_.end(), rows, rows + take * num_columns_);
+        rows += take * num_columns_;
+        num_rows -= take;
+
+        if (buffered_rows + take == buffer_rows_ && !flush())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TableWriter::appendRows_float(const float *rows, size_t num_rows)
+{
+    // cells are stored as their 32-bit patterns either way
+    static_assert(sizeof(float) == sizeof(uint32_t), "cells are 32 bits");
+    return appendRows_uint32_t(reinterpret_cast<const uint32_t *>(rows), num_rows);
+}
+
+void TableWriter::setNull(uint32_t row, uint32_t column)
+{
+    if (column >= num_columns_)
+    {
+        return;
+    }
+    validity_.setNull(row, column);
+    first_dirty_block_ = std::min<uint64_t>(first_dirty_block_, row / 64);
+}
+
+bool TableWriter::flush()
+{
+    if (fd_ < 0)
+    {
+        return false;
+    }
+
+    if (!commit(buffer_.data(), num_columns_ == 0 ? 0 : buffer_.size() / num_columns_))
+    {
+        return false;
+    }
+    buffer_.clear();
+    return true;
+}
+
+bool TableWriter::commit(const uint32_t *rows, size_t num_rows)
+{
+    // one writer at a time, in any process; readers never take the lock
+    if (flock(fd_, LOCK_EX) != 0)
+    {
+        std::cerr << "Error: Unable to lock " << file_name_ << " for writing" << std::endl;
+        return false;
+    }
+    bool committed = catchUp() && (num_rows == 0 ? writeValidity() : writeRows(rows, num_rows));
+    flock(fd_, LOCK_UN);
+    return committed;
+}
+
+bool TableWriter::catchUp()
+{
+    uint32_t committed = __atomic_load_n(committed_count_, __ATOMIC_ACQUIRE);
+    if (committed == num_entries_)
+    {
+        return true;
+    }
+
+    // another writer committed rows since: its NULL marks come from the sidecar, and ours move along with
+    // the rows not yet committed, which now go after its rows
+    std::vector<std::pair<uint64_t, uint32_t>> marks;
+    for (uint64_t block = first_dirty_block_; block < validity_.numBlocks(); block++)
+    {
+        for (uint32_t c = 0; c < num_columns_; c++)
+        {
+            for (uint64_t nulls = ~validity_.word(block, c); nulls != 0; nulls &= nulls - 1)
+            {
+                uint64_t row = block * 64 + __builtin_ctzll(nulls);
+                marks.push_back({row < num_entries_ ? row : row + (committed - num_entries_), c});
+            }
+        }
+    }
+    validity_.load(file_name_, num_columns_);
+    first_dirty_block_ = NO_DIRTY_BLOCK;
+    for (const std::pair<uint64_t, uint32_t> &mark : marks)
+    {
+        setNull(mark.first, mark.second);
+    }
+    num_entries_ = committed;
+    return true;
+}
+
+bool TableWriter::writeRows(const uint32_t *rows, size_t num_rows)
+{
+    // rows go right after the committed ones, so anything a crashed writer left past them is overwritten
+    size_t row_size = num_columns_ * sizeof(uint32_t);
+    off_t offset = data_offset_ + off_t(num_entries_) * row_size;
+    if (!writeAll(fd_, rows, num_rows * row_size, offset))
+    {
+        std::cerr << "Error: Unable to write rows to " << file_name_ << std::endl;
+        return false;
+    }
+
+    // NULL marks go out before the header commits the rows they belong to
+    if (!writeValidity())
+    {
+        return false;
+    }
+    if (sync_commits_ && fdatasync(fd_) != 0)
+    {
+        std::cerr << "Error: Unable to sync rows of " << file_name_ << std::endl;
+        return false;
+    }
+
+    // readers see the rows from the moment the new count is stored, and never a count in between
+    uint32_t num_entries = num_entries_ + num_rows;
+    RT_COUNT(HeaderWrites);
+    __atomic_store_n(committed_count_, num_entries, __ATOMIC_RELEASE);
+    if (sync_commits_ && fdatasync(fd_) != 0)
+    {
+        std::cerr << "Error: Unable to sync the header of " << file_name_ << std::endl;
+        return false;
+    }
+
+    num_entries_ = num_entries;
+    return true;
+}
+
+bool TableWriter::writeValidity()
+{
+    if (first_dirty_block_ == NO_DIRTY_BLOCK)
+    {
+        return true;
+    }
+    if (!validity_.writeFrom(file_name_, first_dirty_block_))
+    {
+        std::cerr << "Error: Unable to write NULL bitmap of " << file_name_ << std::endl;
+        return false;
+    }
+    first_dirty_block_ = NO_DIRTY_BLOCK;
+    return true;
+}
+
+bool TableWriter::close()
+{
+    if (fd_ < 0)
+    {
+        return true;
+    }
+
+    bool flushed = flush();
+    munmap(committed_count_, sizeof(uint32_t));
+    committed_count_ = nullptr;
+    ::close(fd_);
+    fd_ = -1;
+    return flushed;
+}
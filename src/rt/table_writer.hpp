@@ -0,0 +1,92 @@
+#ifndef _table_writer_h_
+#define _table_writer_h_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "validity.hpp"
+#include "table_handle.hpp"
+
+// Buffered appender for a .tbl file. Rows are collected in memory and written with one
+// sequential write per flush, followed by a single num_entries header update. Batches at
+// least as large as the buffer skip it.
+//
+// Any number of readers can scan a table while it is appended to. A flush holds an advisory lock on
+// the file (flock) so writers in this and other processes commit one at a time, writes its rows past
+// the committed ones and then publishes the new count with one atomic store to the header; readers
+// take the count once, without locking, and see every row below it complete. A writer that finds
+// rows committed by another since its last flush puts its own after them.
+class TableWriter
+{
+public:
+    static const size_t DEFAULT_BUFFER_BYTES = 4 << 20;
+
+    // Open an existing table for appending
+    TableWriter(const std::string &file_name, size_t buffer_bytes = DEFAULT_BUFFER_BYTES);
+
+    // Flushes whatever is still buffered
+    ~TableWriter();
+
+    TableWriter(const TableWriter &) = delete;
+    TableWriter &operator=(const TableWriter &) = delete;
+
+    bool isOpen() const { return fd_ >= 0; }
+    uint32_t numColumns() const { return num_columns_; }
+    // Column types and names of the table (only while isOpen())
+    const TableSchema &schema() const { return handle_->schema(); }
+
+    // Rows committed to the file plus rows still buffered
+    uint32_t numEntries() const;
+
+    // Append one row of numColumns() cells, or num_rows rows laid out back to back
+    bool appendRow_uint32_t(const uint32_t *row);
+    bool appendRow_float(const float *row);
+    bool appendRows_uint32_t(const uint32_t *rows, size_t num_rows);
+    bool appendRows_float(const float *rows, size_t num_rows);
+
+    // Mark a cell of an appended row NULL (row counts from the start of the table). Marks reach
+    // the table's validity sidecar with the next flush, and move with their rows when another
+    // writer commits first.
+    void setNull(uint32_t row, uint32_t column);
+
+    // Sync the rows to disk before publishing their count, and the count after (off by default)
+    void setSyncCommits(bool sync) { sync_commits_ = sync; }
+
+    // Write the buffered rows and then the new row count
+    bool flush();
+
+    // Flush and close the file
+    bool close();
+
+private:
+    std::string file_name_;
+    int fd_;
+    uint32_t num_columns_;
+    uint32_t num_entries_;          // rows committed in the header
+    uint32_t data_offset_;          // where the rows start, after the header and any schema
+    std::shared_ptr<TableHandle> handle_; // header and committed row count shared with the table's readers
+    uint32_t *committed_count_;     // num_entries in the shared mapping of the header
+    bool sync_commits_;
+    size_t buffer_rows_;            // rows the buffer holds before it is flushed
+    std::vector<uint32_t> buffer_;  // buffered cells, row-major
+    ValidityBitmap validity_;       // loaded from the sidecar, if the table has one
+    uint64_t first_dirty_block_;    // first validity block changed since the last flush
+
+    // Under the file lock: catch up with other writers, then write and commit num_rows rows (or
+    // just the NULL marks when there are none)
+    bool commit(const uint32_t *rows, size_t num_rows);
+
+    // Take over rows another writer committed since the last flush
+    bool catchUp();
+
+    // Write rows after the committed ones, then commit them in the header
+    bool writeRows(const uint32_t *rows, size_t num_rows);
+
+    // Write the validity blocks changed since the last call
+    bool writeValidity();
+};
+
+#endif
@@ -0,0 +1,115 @@
+#include "thread_pool.hpp"
+#include "query_memory.hpp"
+
+#include <utility>
+
+ThreadPool::ThreadPool(size_t num_threads) : pending_(0), stopping_(false), error_(nullptr)
+{
+    if (num_threads == 0)
+    {
+        num_threads = std::thread::hardware_concurrency();
+    }
+    if (num_threads == 0)
+    {
+        num_threads = 1;
+    }
+
+    for (size_t i = 0; i < num_threads; i++)
+    {
+        workers_.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    waitIdle();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    task_ready_.notify_all();
+    for (std::thread &worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    QueryMemory *memory = CurrentQueryMemory();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push([memory, task = std::move(task)]
+                    {
+                        QueryMemoryScope scope(memory);
+                        task(); });
+        pending_++;
+    }
+    task_ready_.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    waitIdle();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (error_ != nullptr)
+    {
+        throw std::exchange(error_, nullptr);
+    }
+}
+
+void ThreadPool::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    all_done_.wait(lock, [this]
+                   { return pending_ == 0; });
+}
+
+void ThreadPool::runOnEach(const std::function<void(size_t)> &task)
+{
+    for (size_t i = 0; i < workers_.size(); i++)
+    {
+        submit([&task, i]
+               { task(i); });
+    }
+    wait();
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            task_ready_.wait(lock, [this]
+                             { return stopping_ || !tasks_.empty(); });
+            if (tasks_.empty())
+            {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop();
+        }
+
+        const char *error = nullptr;
+        try
+        {
+            task();
+        }
+        catch (const char *message)
+        {
+            error = message;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (error_ == nullptr)
+        {
+            error_ = error;
+        }
+        if (--pending_ == 0)
+        {
+            all_done_.notify_all();
+        }
+    }
+}
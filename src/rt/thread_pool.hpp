@@ -0,0 +1,50 @@
+#ifndef _thread_pool_h_
+#define _thread_pool_h_
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running submitted tasks in submission order. A task runs with the query
+// memory (CurrentQueryMemory) of the thread that submitted it.
+class ThreadPool
+{
+public:
+    // 0 threads means one per hardware thread
+    explicit ThreadPool(size_t num_threads = 0);
+
+    // Waits for the queued tasks, then joins the workers
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    size_t size() const { return workers_.size(); }
+
+    void submit(std::function<void()> task);
+
+    // Block until every submitted task has finished. Rethrows the first message a task threw since the last wait.
+    void wait();
+
+    // Run task(i) for every i below size() in parallel and wait for all of them
+    void runOnEach(const std::function<void(size_t)> &task);
+
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable task_ready_;
+    std::condition_variable all_done_;
+    size_t pending_; // queued plus running
+    bool stopping_;
+    const char *error_; // first message thrown by a task, nullptr if none
+
+    void waitIdle();
+    void workerLoop();
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "validity.hpp"
+#include "instrumentation.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+#include <sys/stat.h>
+
+std::string ValidityBitmap::fileNameFor(const std::string &table_file_name)
+{
+    return table_file_name + ".nulls";
+}
+
+ValidityBitmap::ValidityBitmap(uint32_t num_columns) : num_columns_(num_columns) {}
+
+bool ValidityBitmap::load(const std::string &table_file_name, uint32_t num_columns)
+{
+    num_columns_ = num_columns;
+    words_.clear();
+
+    // most tables have no sidecar, which a stat finds out without opening anything
+    struct stat st;
+    if (num_columns == 0 || stat(fileNameFor(table_file_name).c_str(), &st) != 0)
+    {
+        return false;
+    }
+    RT_COUNT(FileOpens);
+    std::ifstream file(fileNameFor(table_file_name), std::ios::binary | std::ios::in | std::ios::ate);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    // a partially written last block counts as missing, i.e. valid
+    size_t block_bytes = size_t(num_columns) * sizeof(uint64_t);
+    size_t num_blocks = size_t(file.tellg()) / block_bytes;
+    words_.resize(num_blocks * num_columns);
+    RT_COUNT(Seeks);
+    file.seekg(0);
+    RT_COUNT_READ(num_blocks * block_bytes);
+    file.read(reinterpret_cast<char *>(words_.data()), num_blocks * block_bytes);
+    return bool(file);
+}
+
+bool ValidityBitmap::writeFrom(const std::string &table_file_name, uint64_t first_block) const
+{
+    std::string file_name = fileNameFor(table_file_name);
+    RT_COUNT(FileOpens);
+    std::fstream file(file_name, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file.is_open())
+    {
+        RT_COUNT(FileOpens);
+        file.open(file_name, std::ios::binary | std::ios::out | std::ios::trunc);
+    }
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    if (first_block >= numBlocks())
+    {
+        return true;
+    }
+    // blocks missing from the file go out as well, or the hole before first_block would read back as NULLs
+    file.seekp(0, std::ios::end);
+    first_block = std::min<uint64_t>(first_block, uint64_t(file.tellp()) / (num_columns_ * sizeof(uint64_t)));
+    size_t first_word = first_block * num_columns_;
+    RT_COUNT(Seeks);
+    file.seekp(first_word * sizeof(uint64_t));
+    RT_COUNT_WRITE((words_.size() - first_word) * sizeof(uint64_t));
+    file.write(reinterpret_cast<const char *>(words_.data() + first_word), (words_.size() - first_word) * sizeof(uint64_t));
+    return bool(file);
+}
+
+bool ValidityBitmap::blockValid(uint64_t block) const
+{
+    if (block >= numBlocks())
+    {
+        return true;
+    }
+    uint64_t all = ALL_VALID;
+    for (uint32_t c = 0; c < num_columns_; c++)
+    {
+        all &= words_[block * num_columns_ + c];
+    }
+    return all == ALL_VALID;
+}
+
+void ValidityBitmap::setNull(uint64_t row, uint32_t column)
+{
+    uint64_t block = row / 64;
+    if (block >= numBlocks())
+    {
+        words_.resize((block + 1) * num_columns_, ALL_VALID);
+    }
+    words_[block * num_columns_ + column] &= ~(1ull << (row % 64));
+}
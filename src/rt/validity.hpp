@@ -0,0 +1,52 @@
+#ifndef _validity_h_
+#define _validity_h_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per-column validity bits of a table, kept in a sidecar file next to it (<table>.nulls).
+// Rows are grouped in blocks of 64 and a block stores one 64-bit word per column, with bit i set
+// when row 64 * block + i holds a value. Rows past the end of the sidecar are valid, so a table
+// without NULLs never gets one and scans can skip the checks a whole word at a time.
+class ValidityBitmap
+{
+public:
+    static constexpr uint64_t ALL_VALID = ~0ull;
+
+    static std::string fileNameFor(const std::string &table_file_name);
+
+    explicit ValidityBitmap(uint32_t num_columns = 0);
+
+    // Read the sidecar of a table; false (and every row valid) when there is none
+    bool load(const std::string &table_file_name, uint32_t num_columns);
+
+    // Write blocks first_block onwards to the table's sidecar
+    bool writeFrom(const std::string &table_file_name, uint64_t first_block) const;
+
+    bool empty() const { return words_.empty(); }
+    uint64_t numBlocks() const { return num_columns_ == 0 ? 0 : words_.size() / num_columns_; }
+
+    // Validity of rows 64 * block .. 64 * block + 63 of a column
+    uint64_t word(uint64_t block, uint32_t column) const
+    {
+        return block < numBlocks() ? words_[block * num_columns_ + column] : ALL_VALID;
+    }
+
+    bool isValid(uint64_t row, uint32_t column) const
+    {
+        return (word(row / 64, column) >> (row % 64)) & 1;
+    }
+
+    // Whether every cell of the 64-row block is valid
+    bool blockValid(uint64_t block) const;
+
+    void setNull(uint64_t row, uint32_t column);
+
+private:
+    uint32_t num_columns_;
+    std::vector<uint64_t> words_; // block-major, num_columns_ words per block
+};
+
+#endif
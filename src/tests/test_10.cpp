@@ -0,0 +1,37 @@
+#include "../rt/rt.hpp"
+#include "../rt/helper.hpp"
+#include "../rt/table_writer.hpp"
+
+int main()
+{
+    removeFile("table14.tbl");
+    RelationalTable a("table14.tbl", 2);
+
+    // Small buffer so the rows go out over several flushes
+    {
+        TableWriter writer("table14.tbl", 1000);
+        for (uint32_t i = 0; i < 5000; i++)
+        {
+            uint32_t row[2] = {i, i * i};
+            writer.appendRow_uint32_t(row);
+        }
+        std::cout << writer.numEntries() << std::endl;
+    }
+
+    uint32_t rows[6] = {1, 2, 3, 4, 5, 6};
+    RelationalTable b("table14.tbl");
+    b.appendRows_uint32_t(rows, 3);
+    b.addRow_uint32_t({7, 8});
+
+    RelationalTable c("table14.tbl");
+    std::cout << c.readNumEntries() << " " << c.readNumColumns() << std::endl;
+    for (uint32_t i : {0u, 1u, 4999u, 5000u, 5003u})
+    {
+        for (uint32_t item : c.getRow_uint32_t(i))
+        {
+            std::cout << item << " ";
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
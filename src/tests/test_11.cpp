@@ -0,0 +1,67 @@
+#include "../rt/rt.hpp"
+#include "../rt/helper.hpp"
+
+#include <algorithm>
+
+int main()
+{
+    // users(id, is_active, gender) and purchases(user_id, item_id, gender)
+    removeFile("table15.tbl");
+    removeFile("table16.tbl");
+    removeFile("table17.tbl");
+    removeFile("table18.tbl");
+    removeFile("table19.tbl");
+
+    RelationalTable users("table15.tbl", 3);
+    for (uint32_t id = 0; id < 10; id++)
+    {
+        users.addRow_uint32_t({id, id % 3 != 0, 1 + id % 2});
+    }
+
+    RelationalTable purchases("table16.tbl", 3);
+    std::vector<uint32_t> rows;
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        rows.insert(rows.end(), {(i * 7) % 12, 1000 + i, 1 + i % 2});
+    }
+    purchases.appendRows_uint32_t(rows.data(), 100);
+
+    // user ids 10 and 11 have no user, so those purchases drop out
+    RelationalTable joined = users.inner_join(purchases, "table17.tbl", {0}, {0});
+    uint32_t mismatches = 0;
+    for (uint32_t i = 0; i < joined.readNumEntries(); i++)
+    {
+        std::vector<uint32_t> row = joined.getRow_uint32_t(i);
+        mismatches += row[0] != row[3];
+    }
+    std::cout << joined.readNumEntries() << " rows, " << mismatches << " key mismatches" << std::endl;
+
+    // two key columns, build side on the right this time
+    RelationalTable joined2 = purchases.inner_join(users, "table18.tbl", {0, 2}, {0, 2});
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        for (uint32_t item : joined2.getRow_uint32_t(i))
+        {
+            std::cout << item << " ";
+        }
+        std::cout << std::endl;
+    }
+    std::cout << joined2.readNumEntries() << " rows" << std::endl;
+
+    // the partitioned join finds the same rows, in some order
+    RelationalTable joined3 = purchases.inner_join(users, "table19.tbl", {0, 2}, {0, 2}, 4);
+    std::vector<std::vector<uint32_t>> serial_rows, parallel_rows;
+    for (uint32_t i = 0; i < joined2.readNumEntries(); i++)
+    {
+        serial_rows.push_back(joined2.getRow_uint32_t(i));
+    }
+    for (uint32_t i = 0; i < joined3.readNumEntries(); i++)
+    {
+        parallel_rows.push_back(joined3.getRow_uint32_t(i));
+    }
+    std::sort(serial_rows.begin(), serial_rows.end());
+    std::sort(parallel_rows.begin(), parallel_rows.end());
+    std::cout << "parallel join matches: " << (serial_rows == parallel_rows) << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include "../rt/rt.hpp"
+#include "../rt/helper.hpp"
+
+int main()
+{
+    // users(id, is_active) and purchases(user_id, item_id)
+    removeFile("table20.tbl");
+    removeFile("table21.tbl");
+    removeFile("table22.tbl");
+    removeFile("table23.tbl");
+
+    RelationalTable users("table20.tbl", 2);
+    for (uint32_t id = 0; id < 6; id++)
+    {
+        users.addRow_uint32_t({id, id % 2});
+    }
+
+    // user 4 and 5 bought nothing, user 7 does not exist
+    RelationalTable purchases("table21.tbl", 2);
+    std::vector<uint32_t> rows = {0, 100, 1, 101, 1, 102, 2, 103, 3, 104, 7, 105};
+    purchases.appendRows_uint32_t(rows.data(), rows.size() / 2);
+
+    RelationalTable joined = users.full_outer_join(purchases, "table22.tbl", {0}, {0});
+
+    uint32_t left_only = 0, right_only = 0;
+    for (uint32_t i = 0; i < joined.readNumEntries(); i++)
+    {
+        std::vector<uint32_t> row = joined.getRow_uint32_t(i);
+        for (uint32_t c = 0; c < row.size(); c++)
+        {
+            if (joined.isNull(i, c))
+            {
+                std::cout << "NULL ";
+            }
+            else
+            {
+                std::cout << row[c] << " ";
+            }
+        }
+        std::cout << std::endl;
+        left_only += joined.isNull(i, 2) && joined.isNull(i, 3) && !joined.isNull(i, 0);
+        right_only += joined.isNull(i, 0) && joined.isNull(i, 1) && !joined.isNull(i, 2);
+    }
+    std::cout << joined.readNumEntries() << " rows, " << left_only << " users without purchases, " << right_only << " purchases without user" << std::endl;
+
+    // joining the output again: NULL keys match nothing and NULL cells carry over
+    RelationalTable joined2 = joined.full_outer_join(users, "table23.tbl", {2}, {0});
+    uint32_t nulls = 0;
+    for (uint32_t i = 0; i < joined2.readNumEntries(); i++)
+    {
+        for (uint32_t c = 0; c < 6; c++)
+        {
+            nulls += joined2.isNull(i, c);
+        }
+    }
+    std::cout << joined2.readNumEntries() << " rows, " << nulls << " NULL cells" << std::endl;
+
+    // a table made without NULLs has no bitmap
+    std::cout << (users.hasNulls() ? "users has NULLs" : "users has no NULLs") << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include "../columnar-rt/columnar_rt.hpp"
+#include "../rt/helper.hpp"
+
+int main()
+{
+    // purchases(user_id, item_id, gender) as a columnar table with small row groups
+    removeFile("table24.tbl");
+
+    uint32_t mismatches = 0;
+    {
+        ColumnarRelationalTable purchases("table24.tbl", 3);
+        purchases.setRowGroupSize(100);
+        purchases.setRepresentations({RepresentationKind::OneSByteDeltaEncoded, RepresentationKind::BitPacked, RepresentationKind::DictionaryOneByte});
+
+        std::vector<uint32_t> rows;
+        for (uint32_t i = 0; i < 250; i++)
+        {
+            rows.insert(rows.end(), {i / 4, 1000 + (i * 37) % 500, 1 + i % 2});
+        }
+        purchases.appendRows_uint32_t(rows.data(), 200);
+        for (uint32_t i = 200; i < 250; i++)
+        {
+            purchases.addRow_uint32_t({rows[3 * i], rows[3 * i + 1], rows[3 * i + 2]});
+        }
+
+        // the last 50 rows are still buffered and readable
+        std::cout << purchases.readNumEntries() << " rows, " << purchases.numRowGroups() << " row groups written" << std::endl;
+        for (uint32_t i = 0; i < 250; i++)
+        {
+            std::vector<uint32_t> row = purchases.getRow_uint32_t(i);
+            mismatches += row != std::vector<uint32_t>(rows.begin() + 3 * i, rows.begin() + 3 * i + 3);
+        }
+    }
+
+    // reopen: the buffered rows became a shorter last row group
+    ColumnarRelationalTable purchases("table24.tbl");
+    std::cout << purchases.readNumEntries() << " rows, " << purchases.numRowGroups() << " row groups" << std::endl;
+    for (uint32_t g = 0; g < purchases.numRowGroups(); g++)
+    {
+        const RowGroupInfo &info = purchases.rowGroup(g);
+        std::cout << "group " << g << ": " << info.num_rows << " rows,";
+        for (RepresentationKind kind : info.representations)
+        {
+            std::cout << " " << RepresentationKindName(kind);
+        }
+        std::cout << std::endl;
+    }
+
+    std::vector<uint32_t> user_ids = purchases.getColumn_uint32_t(0);
+    for (uint32_t i = 0; i < user_ids.size(); i++)
+    {
+        mismatches += user_ids[i] != i / 4;
+    }
+    std::cout << user_ids.size() << " user ids, " << mismatches << " mismatches" << std::endl;
+
+    // appending after reopening continues after the last row group
+    purchases.addRow_uint32_t({62, 1499, 1});
+    purchases.flush();
+    ColumnarRelationalTable reopened("table24.tbl");
+    std::vector<uint32_t> last = reopened.getRow_uint32_t(250);
+    std::cout << reopened.readNumEntries() << " rows, last " << last[0] << " " << last[1] << " " << last[2] << std::endl;
+
+    return mismatches == 0 ? 0 : 1;
+}
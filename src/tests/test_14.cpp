@@ -0,0 +1,50 @@
+#include "../columnar-rt/columnar_rt.hpp"
+#include "../rt/helper.hpp"
+
+int main()
+{
+    // a wide table where the scan wants 2 of 20 columns
+    removeFile("table25.tbl");
+
+    const uint32_t num_columns = 20;
+    ColumnarRelationalTable wide("table25.tbl", num_columns);
+    wide.setRowGroupSize(512);
+    std::vector<RepresentationKind> representations(num_columns, RepresentationKind::BitPacked);
+    representations[3] = RepresentationKind::RunLengthEncoded;
+    wide.setRepresentations(representations);
+
+    std::vector<uint32_t> rows;
+    for (uint32_t i = 0; i < 3000; i++)
+    {
+        for (uint32_t c = 0; c < num_columns; c++)
+        {
+            rows.push_back(c == 3 ? i / 100 : (i * (c + 1)) % 1000);
+        }
+    }
+    wide.appendRows_uint32_t(rows.data(), 3000);
+
+    // column-major buffers, one per requested column, group by group (the last one still buffered)
+    uint32_t groups = 0, rows_seen = 0, mismatches = 0;
+    wide.scanColumns({17, 3}, [&](uint32_t first_row, const std::vector<std::vector<uint32_t>> &columns)
+                     {
+                         groups++;
+                         for (uint32_t i = 0; i < columns[0].size(); i++)
+                         {
+                             uint32_t row = first_row + i;
+                             mismatches += columns[0][i] != (row * 18) % 1000;
+                             mismatches += columns[1][i] != row / 100;
+                         }
+                         rows_seen += columns[0].size(); });
+    std::cout << groups << " groups, " << rows_seen << " rows, " << mismatches << " mismatches" << std::endl;
+
+    wide.flush();
+    ColumnarRelationalTable reopened("table25.tbl");
+    std::vector<std::vector<uint32_t>> columns = reopened.readColumns_uint32({0, 19});
+    for (uint32_t i = 0; i < columns[1].size(); i++)
+    {
+        mismatches += columns[0][i] != i % 1000 || columns[1][i] != (i * 20) % 1000;
+    }
+    std::cout << columns[0].size() << " and " << columns[1].size() << " values, " << mismatches << " mismatches" << std::endl;
+
+    return mismatches == 0 ? 0 : 1;
+}
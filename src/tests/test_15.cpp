@@ -0,0 +1,73 @@
+#include "../columnar-rt/columnar_rt.hpp"
+#include "../rt/helper.hpp"
+
+int main()
+{
+    // users(id, is_active) sorted by id, 10 row groups of 1000
+    removeFile("table26.tbl");
+    removeFile("table27.tbl");
+
+    {
+        ColumnarRelationalTable users("table26.tbl", 2);
+        users.setRowGroupSize(1000);
+        users.setRepresentations({RepresentationKind::OneSByteDeltaEncoded, RepresentationKind::BitPacked});
+        std::vector<uint32_t> rows;
+        for (uint32_t id = 0; id < 10000; id++)
+        {
+            rows.insert(rows.end(), {id, id % 7 != 0});
+        }
+        users.appendRows_uint32_t(rows.data(), 10000);
+    }
+
+    ColumnarRelationalTable users("table26.tbl");
+    std::cout << users.readNumEntries() << " rows, " << users.numRowGroups() << " row groups, " << (users.hasIndex() ? "indexed" : "not indexed") << std::endl;
+    const RowGroupInfo &group = users.rowGroup(3);
+    std::cout << "group 3: rows " << group.first_row << "+" << group.num_rows << ", ids " << group.min_values[0] << " to " << group.max_values[0] << std::endl;
+
+    // id BETWEEN 2500 AND 3200 touches groups 2 and 3
+    uint32_t groups = 0, matches = 0;
+    users.scanColumns({0, 1}, {0, 2500, 3200}, [&](uint32_t, const std::vector<std::vector<uint32_t>> &columns)
+                      {
+                          groups++;
+                          for (uint32_t id : columns[0])
+                          {
+                              matches += id >= 2500 && id <= 3200;
+                          } });
+    std::cout << "BETWEEN: " << groups << " row groups scanned, " << matches << " rows match" << std::endl;
+
+    // point lookup
+    groups = 0;
+    users.scanColumns({1}, {0, 7777, 7777}, [&](uint32_t, const std::vector<std::vector<uint32_t>> &)
+                      { groups++; });
+    std::cout << "id = 7777: " << groups << " row group scanned" << std::endl;
+
+    // a file without an index (as populate_tables.py writes them) is walked instead, and gets
+    // an index once rows are appended to it
+    std::ofstream file("table27.tbl", std::ios::binary | std::ios::out | std::ios::trunc);
+    uint32_t header[2] = {2000, 2};
+    file.write(reinterpret_cast<const char *>(header), sizeof(header));
+    for (uint32_t g = 0; g < 2; g++)
+    {
+        std::vector<std::vector<uint32_t>> rows;
+        for (uint32_t id = g * 1000; id < (g + 1) * 1000; id++)
+        {
+            rows.push_back({id, 1});
+        }
+        WriteRowGroupUncompressed_uint32(file, rows);
+    }
+    file.close();
+
+    {
+        ColumnarRelationalTable legacy("table27.tbl");
+        std::cout << legacy.readNumEntries() << " rows, " << legacy.numRowGroups() << " row groups, " << (legacy.hasIndex() ? "indexed" : "not indexed") << std::endl;
+        legacy.addRow_uint32_t({2000, 0});
+    }
+    ColumnarRelationalTable legacy("table27.tbl");
+    groups = 0;
+    legacy.scanColumns({0}, {0, 1500, 1500}, [&](uint32_t, const std::vector<std::vector<uint32_t>> &)
+                       { groups++; });
+    std::cout << legacy.readNumEntries() << " rows, " << legacy.numRowGroups() << " row groups, " << (legacy.hasIndex() ? "indexed" : "not indexed")
+              << ", id = 1500: " << groups << " row group scanned" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,124 @@
+#include "../rt/rt.hpp"
+#include "../rt/helper.hpp"
+#include "../columnar-rt/columnar_rt.hpp"
+
+#include <cstring>
+
+namespace
+{
+    uint32_t floatBits(float value)
+    {
+        uint32_t cell;
+        std::memcpy(&cell, &value, sizeof(cell));
+        return cell;
+    }
+}
+
+int main()
+{
+    // users(id, is_active, gender, score) in both formats; every predicate is checked against matches() row by row
+    removeFile("table28.tbl");
+    removeFile("table29.tbl");
+
+    const uint32_t num_rows = 5000;
+    std::vector<uint32_t> rows;
+    for (uint32_t id = 0; id < num_rows; id++)
+    {
+        rows.insert(rows.end(), {id, (id / 300) % 2, 1 + (id * 7) % 3, floatBits(float(id % 100) / 4)});
+    }
+
+    RelationalTable row_table("table28.tbl", 4);
+    row_table.appendRows_uint32_t(rows.data(), num_rows);
+
+    ColumnarRelationalTable columnar_table("table29.tbl", 4);
+    columnar_table.setRowGroupSize(1000);
+    columnar_table.setRepresentations({RepresentationKind::OneSByteDeltaEncoded, RepresentationKind::RunLengthEncoded,
+                                       RepresentationKind::DictionaryOneByte, RepresentationKind::Direct});
+    columnar_table.appendRows_uint32_t(rows.data(), num_rows - 10);
+    columnar_table.flush();
+    // then a small group where is_active is constant, and the last rows stay buffered
+    columnar_table.setRepresentations(std::vector<RepresentationKind>(4, RepresentationKind::Constant));
+    columnar_table.appendRows_uint32_t(rows.data() + 4 * (num_rows - 10), 5);
+    columnar_table.flush();
+    columnar_table.appendRows_uint32_t(rows.data() + 4 * (num_rows - 5), 5);
+    std::cout << "last row group: " << RepresentationKindName(columnar_table.rowGroup(columnar_table.numRowGroups() - 1).representations[1]) << std::endl;
+
+    const char *texts[] = {"1 = 1", "2 in 1,3", "0 between 1200 2400", "0 < 10", "0 > 4990", "2 = 2"};
+    uint32_t failures = 0;
+    for (const char *text : texts)
+    {
+        Predicate predicate;
+        ParsePredicate(text, CellType::Uint32, predicate);
+        SelectionBitmap row_selection = row_table.filter({predicate});
+        SelectionBitmap columnar_selection = columnar_table.filter({predicate});
+        size_t expected = 0;
+        for (uint32_t row = 0; row < num_rows; row++)
+        {
+            bool match = predicate.matches(rows[4 * row + predicate.column]);
+            expected += match;
+            failures += row_selection.test(row) != match || columnar_selection.test(row) != match;
+        }
+        std::cout << text << ": " << expected << " rows, " << row_selection.count() << " row-major, " << columnar_selection.count() << " columnar" << std::endl;
+    }
+
+    // float column and a conjunction
+    Predicate score, active;
+    ParsePredicate("3 between 2.5 5", CellType::Float, score);
+    ParsePredicate("1 = 1", CellType::Uint32, active);
+    SelectionBitmap row_selection = row_table.filter({score, active});
+    SelectionBitmap columnar_selection = columnar_table.filter({score, active});
+    size_t expected = 0;
+    for (uint32_t row = 0; row < num_rows; row++)
+    {
+        bool match = score.matches(rows[4 * row + 3]) && active.matches(rows[4 * row + 1]);
+        expected += match;
+        failures += row_selection.test(row) != match || columnar_selection.test(row) != match;
+    }
+    std::cout << "score between 2.5 and 5 and is_active: " << expected << " rows, " << row_selection.count() << " row-major, " << columnar_selection.count() << " columnar" << std::endl;
+
+    // a group of 10 rows whose constant column claims a million is refused rather than selected past the bitmap
+    removeFile("table71.tbl");
+    {
+        std::ofstream file("table71.tbl", std::ios::binary);
+        uint32_t header[2] = {10, 2};
+        file.write(reinterpret_cast<const char *>(header), sizeof(header));
+        RowGroupInfo info;
+        info.representations = {RepresentationKind::Direct, RepresentationKind::Constant};
+        std::vector<std::vector<uint8_t>> chunks(2);
+        for (uint32_t id = 0; id < 10; id++)
+        {
+            chunks[0].insert(chunks[0].end(), {uint8_t(id), 0, 0, 0});
+        }
+        chunks[1] = {0x40, 0x42, 0x0F, 0, 5, 0, 0, 0};
+        info.bytes_used = {uint32_t(chunks[0].size()), uint32_t(chunks[1].size())};
+        WriteEncodedRowGroup(file, info, chunks);
+    }
+    Predicate equals5;
+    ParsePredicate("1 = 5", CellType::Uint32, equals5);
+    SelectionBitmap crafted_selection = ColumnarRelationalTable("table71.tbl").filter({equals5});
+    std::cout << "mismatched row counts: " << crafted_selection.count() << " rows" << std::endl;
+    failures += crafted_selection.count() != 0;
+    // and so are aggregates over it, grouped or not
+    Aggregate crafted_sum, crafted_count;
+    ParseAggregate("sum(1)", CellType::Uint32, crafted_sum);
+    ParseAggregate("count(1)", CellType::Uint32, crafted_count);
+    ColumnarRelationalTable crafted("table71.tbl");
+    failures += !crafted.aggregate({crafted_count, crafted_sum}).aggregates().empty();
+    failures += !crafted.aggregate({crafted_count, crafted_sum}, 0, CellType::Uint32).aggregates().empty();
+    failures += !crafted.aggregate({crafted_count}, 1, CellType::Uint32).aggregates().empty();
+
+    SelectionBitmap small(100);
+    bool refused = false;
+    try
+    {
+        small.setRange(90, 101);
+    }
+    catch (const char *)
+    {
+        refused = true;
+    }
+    failures += !refused;
+    std::cout << failures << " failures" << std::endl;
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+#include "../rt/rt.hpp"
+#include "../rt/helper.hpp"
+#include "../rt/table_writer.hpp"
+#include "../columnar-rt/columnar_rt.hpp"
+
+#include <cstring>
+#include <limits>
+#include <map>
+
+namespace
+{
+    uint32_t floatBits(float value)
+    {
+        uint32_t cell;
+        std::memcpy(&cell, &value, sizeof(cell));
+        return cell;
+    }
+
+    const uint32_t NUM_COLUMNS = 4;
+    const int64_t NULL_KEY = -1;
+
+    // Every aggregate worked out row by row, per key (NULL_KEY for NULL keys) or under key 0 when ungrouped
+    std::map<int64_t, std::vector<AggregateState>> expected(const std::vector<uint32_t> &rows, const std::vector<Aggregate> &aggregates,
+                                                            int key_column, const std::vector<bool> &nulls)
+    {
+        std::map<int64_t, std::vector<AggregateState>> groups;
+        for (size_t row = 0; row < rows.size() / NUM_COLUMNS; row++)
+        {
+            const uint32_t *cells = &rows[row * NUM_COLUMNS];
+            int64_t key = 0;
+            if (key_column >= 0)
+            {
+                key = nulls[row * NUM_COLUMNS + key_column] ? NULL_KEY : cells[key_column];
+            }
+            std::vector<AggregateState> &states = groups[key];
+            states.resize(aggregates.size());
+            for (size_t a = 0; a < aggregates.size(); a++)
+            {
+                const Aggregate &aggregate = aggregates[a];
+                if (!aggregate.all_rows && nulls[row * NUM_COLUMNS + aggregate.column])
+                {
+                    continue;
+                }
+                AggregateState &state = states[a];
+                uint32_t cell = cells[aggregate.all_rows ? 0 : aggregate.column];
+                float x;
+                std::memcpy(&x, &cell, sizeof(x));
+                state.count++;
+                state.sum_uint32 += cell;
+                state.sum_float += x;
+                state.min_uint32 = std::min(state.min_uint32, cell);
+                state.max_uint32 = std::max(state.max_uint32, cell);
+                state.min_float = std::min(state.min_float, x);
+                state.max_float = std::max(state.max_float, x);
+            }
+        }
+        return groups;
+    }
+
+    uint32_t compare(const char *what, const Aggregation &aggregation, const std::map<int64_t, std::vector<AggregateState>> &groups)
+    {
+        uint32_t failures = aggregation.numGroups() != groups.size();
+        for (uint32_t group = 0; group < aggregation.numGroups(); group++)
+        {
+            int64_t key = aggregation.groupKeyIsNull(group) ? NULL_KEY : aggregation.grouped() ? aggregation.groupKey(group) : 0;
+            auto it = groups.find(key);
+            if (it == groups.end())
+            {
+                failures++;
+                continue;
+            }
+            for (size_t a = 0; a < aggregation.aggregates().size(); a++)
+            {
+                const Aggregate &aggregate = aggregation.aggregates()[a];
+                if (aggregation.state(group, a).format(aggregate) != it->second[a].format(aggregate))
+                {
+                    std::cout << what << " key " << key << " " << aggregate.name() << ": " << aggregation.state(group, a).format(aggregate)
+                              << " instead of " << it->second[a].format(aggregate) << std::endl;
+                    failures++;
+                }
+            }
+        }
+        std::cout << what << ": " << aggregation.numGroups() << " groups" << (aggregation.directIndexed() ? " (direct-indexed)" : "")
+                  << ", " << failures << " failures" << std::endl;
+        return failures;
+    }
+}
+
+int main()
+{
+    // sales(id, region, price, customer): region has 5 values, customer spreads over 100000
+    removeFile("table30.tbl");
+    removeFile("table30.tbl.nulls");
+    removeFile("table31.tbl");
+
+    const uint32_t num_rows = 20000;
+    std::vector<uint32_t> rows;
+    for (uint32_t id = 0; id < num_rows; id++)
+    {
+        rows.insert(rows.end(), {id, 1 + id % 5, floatBits(float(id % 100) / 4), (id * 2654435761u) % 100000});
+    }
+
+    std::vector<Aggregate> aggregates;
+    for (const char *text : {"count(*)", "count(2)", "sum(0)", "min(0)", "max(0)", "avg(0)"})
+    {
+        aggregates.emplace_back();
+        ParseAggregate(text, CellType::Uint32, aggregates.back());
+    }
+    for (const char *text : {"sum(2)", "min(2)", "max(2)", "avg(2)"})
+    {
+        aggregates.emplace_back();
+        ParseAggregate(text, CellType::Float, aggregates.back());
+    }
+
+    // row-major, with some prices and regions NULL
+    std::vector<bool> nulls(rows.size(), false);
+    {
+        RelationalTable create("table30.tbl", NUM_COLUMNS);
+        TableWriter writer("table30.tbl");
+        writer.appendRows_uint32_t(rows.data(), num_rows);
+        for (uint32_t id = 0; id < num_rows; id++)
+        {
+            if (id % 97 == 0)
+            {
+                writer.setNull(id, 2);
+                nulls[id * NUM_COLUMNS + 2] = true;
+            }
+            if (id % 211 == 0)
+            {
+                writer.setNull(id, 1);
+                nulls[id * NUM_COLUMNS + 1] = true;
+            }
+        }
+    }
+    // NULL cells are stored as 0
+    std::vector<uint32_t> stored = rows;
+    for (size_t i = 0; i < stored.size(); i++)
+    {
+        stored[i] = nulls[i] ? 0 : stored[i];
+    }
+
+    uint32_t failures = 0;
+    RelationalTable row_table("table30.tbl");
+    failures += compare("row-major", row_table.aggregate(aggregates), expected(stored, aggregates, -1, nulls));
+    failures += compare("row-major by region", row_table.aggregate(aggregates, 1, CellType::Uint32), expected(stored, aggregates, 1, nulls));
+    failures += compare("row-major by customer", row_table.aggregate(aggregates, 3, CellType::Uint32), expected(stored, aggregates, 3, nulls));
+    failures += compare("row-major by price", row_table.aggregate(aggregates, 2, CellType::Float), expected(stored, aggregates, 2, nulls));
+
+    // columnar: ids delta-encoded, regions run-length encoded after sorting, prices in a dictionary;
+    // then a group with a constant region and a few buffered rows
+    std::vector<uint32_t> sorted;
+    for (uint32_t region = 1; region <= 5; region++)
+    {
+        for (uint32_t row = 0; row < num_rows; row++)
+        {
+            if (rows[row * NUM_COLUMNS + 1] == region)
+            {
+                sorted.insert(sorted.end(), &rows[row * NUM_COLUMNS], &rows[row * NUM_COLUMNS] + NUM_COLUMNS);
+            }
+        }
+    }
+    for (uint32_t id = num_rows; id < num_rows + 50; id++)
+    {
+        sorted.insert(sorted.end(), {id, 3, floatBits(float(id % 7)), id});
+    }
+    for (uint32_t id = num_rows + 50; id < num_rows + 57; id++)
+    {
+        sorted.insert(sorted.end(), {id, 9, floatBits(0.5f), id % 3});
+    }
+    uint32_t num_sorted = sorted.size() / NUM_COLUMNS;
+
+    ColumnarRelationalTable columnar_table("table31.tbl", NUM_COLUMNS);
+    columnar_table.setRowGroupSize(1000);
+    columnar_table.setRepresentations({RepresentationKind::OneSByteDeltaEncoded, RepresentationKind::RunLengthEncoded,
+                                       RepresentationKind::DictionaryOneByte, RepresentationKind::Direct});
+    columnar_table.appendRows_uint32_t(sorted.data(), num_rows);
+    columnar_table.flush();
+    columnar_table.setRepresentations(std::vector<RepresentationKind>(NUM_COLUMNS, RepresentationKind::Constant));
+    columnar_table.appendRows_uint32_t(sorted.data() + num_rows * NUM_COLUMNS, 50);
+    columnar_table.flush();
+    columnar_table.appendRows_uint32_t(sorted.data() + (num_rows + 50) * NUM_COLUMNS, 7);
+    std::cout << "constant group: region " << RepresentationKindName(columnar_table.rowGroup(columnar_table.numRowGroups() - 1).representations[1])
+              << ", id " << RepresentationKindName(columnar_table.rowGroup(columnar_table.numRowGroups() - 1).representations[0]) << std::endl;
+
+    std::vector<bool> no_nulls(sorted.size(), false);
+    failures += compare("columnar", columnar_table.aggregate(aggregates), expected(sorted, aggregates, -1, no_nulls));
+    failures += compare("columnar by region", columnar_table.aggregate(aggregates, 1, CellType::Uint32), expected(sorted, aggregates, 1, no_nulls));
+    failures += compare("columnar by customer", columnar_table.aggregate(aggregates, 3, CellType::Uint32), expected(sorted, aggregates, 3, no_nulls));
+    std::cout << num_sorted << " columnar rows" << std::endl;
+
+    // float minimums and maximums leave NaNs out: NaNs only are NULL, in both formats and from zone maps
+    removeFile("table72.tbl");
+    removeFile("table73.tbl");
+    float nan = std::numeric_limits<float>::quiet_NaN();
+    std::vector<uint32_t> nan_rows = {floatBits(nan), 0, floatBits(nan), 0, floatBits(nan), 1, floatBits(1.5f), 1};
+    Aggregate low, high;
+    ParseAggregate("min(0)", CellType::Float, low);
+    ParseAggregate("max(0)", CellType::Float, high);
+    RelationalTable nan_table("table72.tbl", 2);
+    nan_table.appendRows_uint32_t(nan_rows.data(), 2);
+    ColumnarRelationalTable nan_columnar("table73.tbl", 2);
+    nan_columnar.appendRows_uint32_t(nan_rows.data(), 2);
+    nan_columnar.flush();
+    for (const Aggregation &only_nans : {nan_table.aggregate({low, high}), nan_columnar.aggregate({low, high})})
+    {
+        std::cout << "NaNs only: " << only_nans.state(0, 0).format(low) << " " << only_nans.state(0, 1).format(high) << std::endl;
+        failures += only_nans.state(0, 0).format(low) != "NULL" || only_nans.state(0, 1).format(high) != "NULL";
+    }
+    nan_table.appendRows_uint32_t(nan_rows.data() + 4, 2);
+    nan_columnar.appendRows_uint32_t(nan_rows.data() + 4, 2);
+    nan_columnar.flush();
+    failures += nan_columnar.aggregate({low, high}).state(0, 0).format(low) != "1.5";
+    for (const Aggregation &by_key : {nan_table.aggregate({low, high}, 1, CellType::Uint32), nan_columnar.aggregate({low, high}, 1, CellType::Uint32)})
+    {
+        QueryVector<uint32_t> groups = by_key.sortedGroups();
+        failures += groups.size() != 2 || by_key.state(groups[0], 0).format(low) != "NULL" || by_key.state(groups[0], 1).format(high) != "NULL";
+        failures += by_key.state(groups[1], 0).format(low) != "1.5" || by_key.state(groups[1], 1).format(high) != "1.5";
+    }
+
+    std::cout << failures << " failures" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+#include "../rt/helper.hpp"
+#include "../columnar-rt/columnar_rt.hpp"
+
+#include <random>
+
+namespace
+{
+    size_t encodedSize(const std::vector<uint32_t> &values, RepresentationKind kind)
+    {
+        std::vector<uint8_t> bytes;
+        return EncodeColumn_uint32(values.data(), values.size(), kind, bytes) ? bytes.size() : SIZE_MAX;
+    }
+}
+
+int main()
+{
+    // events(id, kind, status, sensor, hash, flag): every column suits a different representation
+    removeFile("table32.tbl");
+
+    const uint32_t num_rows = 8192;
+    std::mt19937 random(7);
+    std::vector<uint32_t> rows;
+    for (uint32_t id = 0; id < num_rows; id++)
+    {
+        rows.insert(rows.end(), {1000000 + id, (id / 700) % 3, 1000 + 100 * uint32_t(random() % 40), uint32_t(random() % 200), uint32_t(random()), 1});
+    }
+
+    ColumnarRelationalTable table("table32.tbl", 6);
+    table.setRowGroupSize(2048);
+    table.appendRows_uint32_t(rows.data(), num_rows);
+    table.flush();
+    table.printStats(std::cout);
+
+    // each chunk is no more than 5% bigger than the smallest representation that fits it, and reads back as written
+    uint32_t failures = 0;
+    const RepresentationKind kinds[] = {RepresentationKind::Direct, RepresentationKind::RunLengthEncoded, RepresentationKind::DictionaryOneByte,
+                                        RepresentationKind::OneSByteDeltaEncoded, RepresentationKind::Constant, RepresentationKind::BitPacked};
+    std::vector<std::vector<uint32_t>> columns = table.readColumns_uint32({0, 1, 2, 3, 4, 5});
+    for (uint32_t g = 0; g < table.numRowGroups(); g++)
+    {
+        const RowGroupInfo &info = table.rowGroup(g);
+        for (uint32_t c = 0; c < 6; c++)
+        {
+            std::vector<uint32_t> values(info.num_rows);
+            for (uint32_t i = 0; i < info.num_rows; i++)
+            {
+                values[i] = rows[(info.first_row + i) * 6 + c];
+                failures += columns[c][info.first_row + i] != values[i];
+            }
+            size_t best = SIZE_MAX;
+            for (RepresentationKind kind : kinds)
+            {
+                best = std::min(best, encodedSize(values, kind));
+            }
+            if (info.bytes_used[c] > best * 1.05)
+            {
+                std::cout << "row group " << g << " column " << c << ": " << RepresentationKindName(info.representations[c]) << " takes "
+                          << info.bytes_used[c] << " bytes, the smallest " << best << std::endl;
+                failures++;
+            }
+        }
+    }
+
+    // values 0..3: bit-packing is smallest, but within a generous tolerance delta encoding decodes faster
+    std::vector<uint32_t> small(4096);
+    for (uint32_t &value : small)
+    {
+        value = random() % 4;
+    }
+    std::vector<uint8_t> bytes;
+    RepresentationKind tight = EncodeColumnAdaptive_uint32(small.data(), small.size(), 0, bytes);
+    bytes.clear();
+    RepresentationKind loose = EncodeColumnAdaptive_uint32(small.data(), small.size(), 10, bytes);
+    std::cout << "values 0..3: " << RepresentationKindName(tight) << ", with tolerance 10: " << RepresentationKindName(loose) << std::endl;
+    failures += tight != RepresentationKind::BitPacked || loose != RepresentationKind::OneSByteDeltaEncoded;
+
+    // a long chunk is estimated from a sample: runs of 100 and a few distinct values
+    std::vector<uint32_t> runs(200000);
+    for (uint32_t i = 0; i < runs.size(); i++)
+    {
+        runs[i] = (i / 100) % 7;
+    }
+    for (const EncodingEstimate &estimate : EstimateEncodedSizes_uint32(runs.data(), runs.size()))
+    {
+        size_t actual = encodedSize(runs, estimate.kind);
+        std::cout << RepresentationKindName(estimate.kind) << ": estimated " << estimate.bytes << ", actual " << actual << std::endl;
+        failures += estimate.bytes < actual * 0.8 || estimate.bytes > actual * 1.25;
+    }
+
+    std::cout << failures << " failures" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
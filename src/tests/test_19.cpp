@@ -0,0 +1,89 @@
+#include "../rt/rt.hpp"
+#include "../rt/helper.hpp"
+#include "../rt/table_writer.hpp"
+#include "../columnar-rt/row_group_pipeline.hpp"
+
+#include <filesystem>
+#include <random>
+
+namespace
+{
+    std::vector<uint8_t> fileBytes(const std::string &file_name)
+    {
+        std::ifstream file(file_name, std::ios::binary | std::ios::in);
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+}
+
+int main()
+{
+    // orders(id, customer, status, amount): 50000 rows in groups of 1000, every column adaptive
+    removeFile("table33.tbl");
+    removeFile("table33_1.tbl");
+    removeFile("table33_4.tbl");
+    removeFile("table34.tbl");
+
+    const uint32_t num_rows = 50000;
+    std::mt19937 random(3);
+    std::vector<uint32_t> rows;
+    for (uint32_t id = 0; id < num_rows; id++)
+    {
+        rows.insert(rows.end(), {id, uint32_t(random() % 5000), (id / 1000) % 4, uint32_t(random())});
+    }
+    {
+        RelationalTable create("table33.tbl", 4);
+        TableWriter writer("table33.tbl");
+        writer.appendRows_uint32_t(rows.data(), num_rows);
+    }
+
+    // one thread and four write the same file
+    uint32_t failures = 0;
+    RelationalTable orders("table33.tbl");
+    std::vector<RepresentationKind> adaptive(4, RepresentationKind::Adaptive);
+    failures += !orders.compressData("table33_1.tbl", adaptive, 1000, 0, 1);
+    failures += !orders.compressData("table33_4.tbl", adaptive, 1000, 0, 4);
+    bool same = fileBytes("table33_1.tbl") == fileBytes("table33_4.tbl");
+    std::cout << "1 and 4 threads write " << (same ? "the same file" : "different files") << std::endl;
+    failures += !same;
+
+    // decoded three threads at a time, with at most two groups read ahead
+    ColumnarRelationalTable compressed("table33_4.tbl");
+    std::vector<RowGroupInfo> row_groups;
+    for (uint32_t g = 0; g < compressed.numRowGroups(); g++)
+    {
+        row_groups.push_back(compressed.rowGroup(g));
+    }
+    ParallelRowGroupReader reader("table33_4.tbl", row_groups, {3, 0}, 3, 2);
+    std::vector<std::vector<uint32_t>> columns;
+    const RowGroupInfo *info;
+    uint32_t groups = 0, wrong = 0;
+    while (reader.next(columns, info))
+    {
+        for (uint32_t i = 0; i < info->num_rows; i++)
+        {
+            wrong += columns[0][i] != rows[(info->first_row + i) * 4 + 3] || columns[1][i] != info->first_row + i;
+        }
+        groups++;
+    }
+    std::cout << groups << " row groups read back, " << wrong << " wrong values" << std::endl;
+    failures += groups != 50 || wrong != 0 || reader.error() != nullptr;
+
+    RelationalTable decompressed = RelationalTable::decompressData("table33_4.tbl", "table34.tbl", 4);
+    same = fileBytes("table33.tbl") == fileBytes("table34.tbl");
+    std::cout << "decompressed on 4 threads: " << (same ? "same as the original" : "differs from the original") << std::endl;
+    failures += !same;
+
+    // a truncated file fails at the group it ends in
+    std::filesystem::resize_file("table33_4.tbl", row_groups[10].offset + 10);
+    ParallelRowGroupReader truncated("table33_4.tbl", row_groups, {0, 1, 2, 3}, 2, 4);
+    groups = 0;
+    while (truncated.next(columns))
+    {
+        groups++;
+    }
+    std::cout << "truncated: " << groups << " row groups, then " << (truncated.error() ? truncated.error() : "no error") << std::endl;
+    failures += groups != 10 || truncated.error() == nullptr;
+
+    std::cout << failures << " failures" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+#include "../rt/rt.hpp"
+#include "../rt/helper.hpp"
+#include "../rt/instrumentation.hpp"
+#include "../columnar-rt/columnar_rt.hpp"
+
+int main()
+{
+    if (!INSTRUMENTATION_ENABLED)
+    {
+        std::cout << "instrumentation compiled out, nothing to check" << std::endl;
+        return 0;
+    }
+
+    // events(id, hour): 10000 rows in groups of 1000, id stored directly and hour run-length encoded
+    removeFile("table35.tbl");
+    removeFile("table35_c.tbl");
+    removeFile("table35_r.tbl");
+
+    const uint32_t num_rows = 10000;
+    const std::vector<RepresentationKind> representations = {RepresentationKind::Direct, RepresentationKind::RunLengthEncoded};
+    std::vector<uint32_t> rows;
+    for (uint32_t id = 0; id < num_rows; id++)
+    {
+        rows.insert(rows.end(), {id, id / 500});
+    }
+    uint32_t failures = 0;
+    {
+        ColumnarRelationalTable create("table35.tbl", 2);
+        create.setRepresentations(representations);
+        create.setRowGroupSize(1000);
+        failures += !create.appendRows_uint32_t(rows.data(), num_rows) || !create.flush();
+    }
+
+    // a full scan reads and decodes every chunk once
+    ColumnarRelationalTable compressed("table35.tbl");
+    uint64_t chunk_bytes = 0;
+    for (uint32_t g = 0; g < compressed.numRowGroups(); g++)
+    {
+        chunk_bytes += compressed.rowGroup(g).bytes_used[0] + compressed.rowGroup(g).bytes_used[1];
+    }
+    ResetInstrumentation();
+    uint64_t sum = 0;
+    compressed.scanColumns({0, 1}, [&sum](uint32_t, const std::vector<std::vector<uint32_t>> &columns)
+                           {
+                               for (uint32_t hour : columns[1])
+                               {
+                                   sum += hour;
+                               }
+                           });
+    uint64_t direct = g_instrumentation.rows_decoded[size_t(RepresentationKind::Direct)];
+    uint64_t rle = g_instrumentation.rows_decoded[size_t(RepresentationKind::RunLengthEncoded)];
+    uint64_t bytes_read = g_instrumentation.events[size_t(Counter::BytesRead)];
+    uint64_t decodes = g_instrumentation.phase_calls[size_t(Phase::Decode)];
+    std::cout << "scan: " << direct << " direct rows, " << rle << " run-length rows, " << decodes << " chunks decoded, "
+              << bytes_read << " bytes read for " << chunk_bytes << " bytes of chunks" << std::endl;
+    failures += sum != 500 * 190 || direct != num_rows || rle != num_rows || decodes != 20 || bytes_read < chunk_bytes;
+    failures += g_instrumentation.events[size_t(Counter::Writes)] != 0;
+
+    // a filter the zone maps narrow to one group reads a tenth of the chunks
+    ResetInstrumentation();
+    Predicate first_group{0, PredicateOp::Between, CellType::Uint32, {100, 200}};
+    size_t matches = compressed.filter({first_group}).count();
+    uint64_t filter_bytes = g_instrumentation.events[size_t(Counter::BytesRead)];
+    std::cout << "filter: " << matches << " matches, " << filter_bytes << " bytes read, "
+              << g_instrumentation.phase_calls[size_t(Phase::Filter)] << " filter calls" << std::endl;
+    failures += matches != 101 || filter_bytes == 0 || filter_bytes > chunk_bytes / 5 || g_instrumentation.phase_calls[size_t(Phase::Filter)] != 1;
+
+    // so are writes, here of the row-major copy and of compressing it again
+    ResetInstrumentation();
+    RelationalTable::decompressData("table35.tbl", "table35_r.tbl");
+    RelationalTable events("table35_r.tbl");
+    failures += !events.compressData("table35_c.tbl", representations, 1000);
+    uint64_t bytes_written = g_instrumentation.events[size_t(Counter::BytesWritten)];
+    std::cout << "decompress and compress: " << g_instrumentation.phase_calls[size_t(Phase::Encode)] << " chunks encoded, " << bytes_written
+              << " bytes written" << std::endl;
+    failures += g_instrumentation.phase_calls[size_t(Phase::Encode)] != 20 || bytes_written < chunk_bytes + num_rows * 2 * sizeof(uint32_t);
+
+    std::cout << failures << " failures" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+#include "../rt/rt.hpp"
+#include "../rt/helper.hpp"
+#include "../rt/table_writer.hpp"
+#include "../coding/batch.hpp"
+#include "../columnar-rt/columnar_rt.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// every allocation of the program is counted, so a scan can be checked for allocating per batch
+namespace
+{
+    std::atomic<size_t> allocations(0);
+}
+
+void *operator new(size_t size)
+{
+    allocations++;
+    if (void *p = std::malloc(size == 0 ? 1 : size))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// GCC can't tell that the operator new above is the malloc these pointers came from
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+namespace
+{
+    bool aligned(const void *p)
+    {
+        return reinterpret_cast<uintptr_t>(p) % BATCH_ALIGNMENT == 0;
+    }
+
+    // Rows of a batch in play, as table rows
+    std::vector<uint32_t> selectedRows(uint32_t first_row, const ColumnBatch &batch)
+    {
+        std::vector<uint32_t> rows;
+        batch.forEachSelected([&](uint32_t i)
+                              { rows.push_back(first_row + i); });
+        return rows;
+    }
+
+    std::vector<uint32_t> setRows(const SelectionBitmap &selection)
+    {
+        std::vector<uint32_t> rows;
+        for (uint32_t row = 0; row < selection.size(); row++)
+        {
+            if (selection.test(row))
+            {
+                rows.push_back(row);
+            }
+        }
+        return rows;
+    }
+}
+
+int main()
+{
+    uint32_t failures = 0;
+
+    // every column starts on a cache line, and a smaller reset keeps the buffer
+    ColumnBatch batch(3, 1000);
+    bool columns_aligned = aligned(batch.column(0)) && aligned(batch.column(1)) && aligned(batch.column(2));
+    const uint32_t *buffer = batch.column(0);
+    batch.reset(2, 700);
+    std::cout << "batch: columns " << (columns_aligned ? "aligned" : "not aligned") << ", buffer " << (batch.column(0) == buffer ? "kept" : "reallocated")
+              << " on a smaller reset" << std::endl;
+    failures += !columns_aligned || batch.column(0) != buffer || batch.capacity() != 700 || !aligned(batch.column(1));
+
+    const uint32_t rows_in[] = {1, 10, 2, 20, 3, 30};
+    batch.loadRows(rows_in, 2, 3, {1, 0});
+    SelectionBitmap odd(3);
+    odd.set(0);
+    odd.set(2);
+    batch.select(odd);
+    failures += batch.size() != 3 || batch.column(0)[2] != 30 || batch.column(1)[1] != 2 || batch.numSelected() != 2 || batch.selection()[1] != 2;
+
+    // sensors(id, zone, reading): 20000 rows, in groups of 1000 when columnar, zone 7 NULL every 100th row
+    removeFile("table36.tbl");
+    removeFile("table36.tbl.nulls");
+    removeFile("table37.tbl");
+    const uint32_t num_rows = 20000;
+    std::vector<uint32_t> rows;
+    for (uint32_t id = 0; id < num_rows; id++)
+    {
+        rows.insert(rows.end(), {id, id / 2000, (id * 37) % 1000});
+    }
+    {
+        RelationalTable create("table36.tbl", 3);
+        TableWriter writer("table36.tbl");
+        writer.appendRows_uint32_t(rows.data(), num_rows);
+        for (uint32_t id = 14000; id < 16000; id += 100)
+        {
+            writer.setNull(id, 1);
+        }
+    }
+    {
+        ColumnarRelationalTable create("table37.tbl", 3);
+        create.setRepresentations({RepresentationKind::Direct, RepresentationKind::RunLengthEncoded, RepresentationKind::Adaptive});
+        create.setRowGroupSize(1000);
+        create.appendRows_uint32_t(rows.data(), num_rows - 500);
+        create.flush();
+        create.appendRows_uint32_t(rows.data() + size_t(num_rows - 500) * 3, 500);
+
+        // a full scan hands every row over once, allocating nothing after its first batch
+        uint64_t sum = 0;
+        uint32_t batches = 0, seen = 0;
+        size_t allocations_after_first = 0;
+        create.scanBatches({2, 0}, [&](uint32_t first_row, const ColumnBatch &columns)
+                           {
+                               if (batches++ == 0)
+                               {
+                                   allocations_after_first = allocations;
+                               }
+                               for (size_t i = 0; i < columns.size(); i++)
+                               {
+                                   sum += columns.column(0)[i];
+                                   seen += columns.column(1)[i] == first_row + i;
+                               } });
+        allocations_after_first = allocations - allocations_after_first;
+        uint64_t expected_sum = 0;
+        for (uint32_t id = 0; id < num_rows; id++)
+        {
+            expected_sum += (id * 37) % 1000;
+        }
+        std::cout << "columnar scan: " << batches << " batches, " << seen << " rows in place, "
+                  << allocations_after_first << " allocations after the first batch" << std::endl;
+        failures += batches != 21 || seen != num_rows || sum != expected_sum || allocations_after_first != 0;
+
+        // a filtered scan selects the rows filter() finds and skips groups without any
+        std::vector<Predicate> predicates;
+        Predicate zone, reading;
+        ParsePredicate("1 in 3,9", CellType::Uint32, zone);
+        ParsePredicate("2 < 100", CellType::Uint32, reading);
+        predicates = {zone, reading};
+        std::vector<uint32_t> selected;
+        batches = 0;
+        create.scanBatches({0}, predicates, [&](uint32_t first_row, const ColumnBatch &columns)
+                           {
+                               batches++;
+                               for (uint32_t row : selectedRows(first_row, columns))
+                               {
+                                   selected.push_back(row);
+                               } });
+        std::vector<uint32_t> filtered = setRows(create.filter(predicates));
+        std::cout << "columnar filtered scan: " << selected.size() << " rows in " << batches << " batches, filter finds " << filtered.size() << std::endl;
+        failures += selected != filtered || batches != 5 || selected.empty();
+    }
+
+    // the row-major engine: NULL zones match nothing, and the batches line up with the rows
+    RelationalTable sensors("table36.tbl");
+    Predicate zone7;
+    ParsePredicate("1 = 7", CellType::Uint32, zone7);
+    std::vector<uint32_t> selected;
+    uint32_t batches = 0, wrong = 0;
+    sensors.scanBatches({0, 2}, {zone7}, [&](uint32_t first_row, const ColumnBatch &columns)
+                        {
+                            batches++;
+                            columns.forEachSelected([&](uint32_t i)
+                                                    {
+                                                        selected.push_back(first_row + i);
+                                                        wrong += columns.column(0)[i] != first_row + i || columns.column(1)[i] != (first_row + i) * 37 % 1000;
+                                                    }); });
+    std::vector<uint32_t> filtered = setRows(sensors.filter({zone7}));
+    std::cout << "row-major filtered scan: " << selected.size() << " rows in " << batches << " batches, filter finds " << filtered.size()
+              << ", " << wrong << " wrong cells" << std::endl;
+    failures += selected != filtered || selected.size() != 1980 || wrong != 0;
+
+    // aggregates through batches still leave NULL cells out
+    Aggregate sum_reading;
+    ParseAggregate("sum(2)", CellType::Uint32, sum_reading);
+    Aggregate count_zone;
+    ParseAggregate("count(1)", CellType::Uint32, count_zone);
+    Aggregation totals = sensors.aggregate({sum_reading, count_zone});
+    std::cout << "aggregate: " << totals.state(0, 1).count << " zone cells counted" << std::endl;
+    failures += totals.numGroups() != 1 || totals.state(0, 1).count != num_rows - 20;
+
+    std::cout << failures << " failures" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
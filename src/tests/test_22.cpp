@@ -0,0 +1,214 @@
+#include "../rt/rt.hpp"
+#include "../rt/helper.hpp"
+#include "../rt/table_writer.hpp"
+#include "../rt/query_memory.hpp"
+#include "../rt/thread_pool.hpp"
+#include "../coding/batch.hpp"
+#include "../columnar-rt/columnar_rt.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <random>
+
+namespace
+{
+    bool aligned(const void *p, size_t alignment)
+    {
+        return reinterpret_cast<uintptr_t>(p) % alignment == 0;
+    }
+
+    bool limitExceeded(const std::function<void()> &f)
+    {
+        try
+        {
+            f();
+        }
+        catch (const char *message)
+        {
+            return std::strcmp(message, "Query memory limit exceeded") == 0;
+        }
+        return false;
+    }
+}
+
+int main()
+{
+    uint32_t failures = 0;
+
+    // the arena hands out aligned space, and a buffer given back is the next one of its size
+    {
+        QueryMemory memory;
+        void *a = memory.allocate(3);
+        void *b = memory.allocate(16, 16);
+        size_t capacity;
+        void *buffer = memory.takeBuffer(1000, capacity);
+        memory.giveBack(buffer, capacity);
+        size_t again_capacity;
+        void *again = memory.takeBuffer(700, again_capacity);
+        std::cout << "arena: " << capacity << " byte buffer " << (again == buffer ? "reused" : "not reused") << ", "
+                  << memory.reserved() << " bytes reserved" << std::endl;
+        failures += !aligned(b, 16) || a == b || capacity != 1024 || !aligned(buffer, 64) || again != buffer || again_capacity != 1024;
+        failures += memory.reserved() != QueryMemory::BLOCK_SIZE;
+        memory.release();
+        failures += memory.reserved() != 0 || memory.peak() != QueryMemory::BLOCK_SIZE;
+    }
+
+    // buffers come from the current query memory, from the heap outside of one, and keep their values growing
+    {
+        QueryMemory memory;
+        PooledBuffer<uint32_t> outside(100);
+        failures += memory.reserved() != 0;
+        {
+            QueryMemoryScope scope(&memory);
+            PooledBuffer<uint32_t> values(10);
+            for (uint32_t i = 0; i < 10; i++)
+            {
+                values[i] = i * 7;
+            }
+            values.resize(50000);
+            bool kept = values[9] == 63 && aligned(values.data(), 64);
+            std::cout << "pooled buffer: values " << (kept ? "kept" : "lost") << " growing, " << memory.reserved() << " bytes reserved" << std::endl;
+            failures += !kept || memory.reserved() < 50000 * sizeof(uint32_t);
+        }
+        failures += CurrentQueryMemory() != nullptr;
+    }
+
+    // going over the limit throws, and is remembered
+    {
+        QueryMemory memory(1 << 20);
+        QueryMemoryScope scope(&memory);
+        PooledBuffer<uint8_t> fits(512 << 10);
+        bool thrown = limitExceeded([]
+                                    { PooledBuffer<uint8_t> too_big(1 << 20); });
+        std::cout << "limit: " << (thrown ? "exceeded" : "not exceeded") << " asking for 1 MiB more" << std::endl;
+        failures += !thrown || !memory.exceeded() || memory.reserved() > memory.limit();
+    }
+
+    // pool tasks run with the submitting thread's query memory, and their errors come back from wait()
+    {
+        QueryMemory memory;
+        ThreadPool pool(2);
+        std::atomic<uint32_t> same(0);
+        {
+            QueryMemoryScope scope(&memory);
+            pool.runOnEach([&](size_t)
+                           { same += CurrentQueryMemory() == &memory; });
+        }
+        pool.submit([]
+                    { throw "task failed"; });
+        bool rethrown = false;
+        try
+        {
+            pool.wait();
+        }
+        catch (const char *message)
+        {
+            rethrown = std::strcmp(message, "task failed") == 0;
+        }
+        std::cout << "thread pool: " << same << " of 2 tasks in the query, error " << (rethrown ? "rethrown" : "lost") << std::endl;
+        failures += same != 2 || !rethrown;
+    }
+
+    // a second scan of a columnar table runs entirely on buffers the first one gave back
+    removeFile("table38.tbl");
+    removeFile("table39.tbl");
+    removeFile("table40.tbl");
+    removeFile("table41.tbl");
+    removeFile("table42.tbl");
+    removeFile("table43.tbl");
+    const uint32_t num_rows = 50000;
+    std::mt19937 random(5);
+    std::vector<uint32_t> rows;
+    for (uint32_t id = 0; id < num_rows; id++)
+    {
+        rows.insert(rows.end(), {id, uint32_t(random() % 1000), uint32_t(random() % 20000)});
+    }
+    {
+        ColumnarRelationalTable create("table38.tbl", 3);
+        create.setRowGroupSize(4096);
+        create.appendRows_uint32_t(rows.data(), num_rows);
+    }
+    {
+        QueryMemory memory;
+        QueryMemoryScope scope(&memory);
+        ColumnarRelationalTable table("table38.tbl");
+        Predicate low;
+        ParsePredicate("1 < 100", CellType::Uint32, low);
+        uint64_t sums[2] = {0, 0};
+        size_t reserved[2];
+        for (int scan = 0; scan < 2; scan++)
+        {
+            table.scanBatches({2}, {low}, [&](uint32_t, const ColumnBatch &batch)
+                               { batch.forEachSelected([&](uint32_t i)
+                                                       { sums[scan] += batch.column(0)[i]; }); });
+            reserved[scan] = memory.reserved();
+        }
+        std::cout << "columnar scans: " << reserved[0] << " then " << reserved[1] << " bytes reserved" << std::endl;
+        failures += sums[0] != sums[1] || sums[0] == 0 || reserved[0] != reserved[1];
+
+        // aggregates decode through the same pool
+        Aggregate total;
+        ParseAggregate("sum(2)", CellType::Uint32, total);
+        Aggregation aggregation = table.aggregate({total});
+        uint64_t expected = 0;
+        for (uint32_t id = 0; id < num_rows; id++)
+        {
+            expected += rows[size_t(id) * 3 + 2];
+        }
+        failures += aggregation.state(0, 0).sum_uint32 != expected;
+    }
+
+    // so do the groups of a grouped aggregate and the selections of a filter: one group per id doesn't fit in 1 MiB
+    {
+        Aggregate count;
+        ParseAggregate("count(1)", CellType::Uint32, count);
+        QueryMemory memory(1 << 20);
+        QueryMemoryScope scope(&memory);
+        Aggregation by_id = ColumnarRelationalTable("table38.tbl").aggregate({count}, 0, CellType::Uint32);
+        std::cout << "grouped aggregate: " << (memory.exceeded() ? "stopped" : "not stopped") << " at 1 MiB" << std::endl;
+        failures += !memory.exceeded() || by_id.grouped();
+    }
+    {
+        QueryMemory memory;
+        QueryMemoryScope scope(&memory);
+        Predicate all;
+        ParsePredicate("0 < 50000", CellType::Uint32, all);
+        failures += ColumnarRelationalTable("table38.tbl").filter({all}).count() != num_rows || memory.reserved() == 0;
+    }
+
+    // a join too big for its limit stops with an error instead of growing; under a big enough one it runs as before
+    {
+        RelationalTable create_left("table39.tbl", 3);
+        RelationalTable create_right("table40.tbl", 2);
+        TableWriter left("table39.tbl");
+        left.appendRows_uint32_t(rows.data(), num_rows);
+        TableWriter right("table40.tbl");
+        for (uint32_t id = 0; id < num_rows; id += 2)
+        {
+            uint32_t row[2] = {id, id * 3};
+            right.appendRow_uint32_t(row);
+        }
+    }
+    RelationalTable users("table39.tbl");
+    RelationalTable orders("table40.tbl");
+    uint32_t unlimited = users.inner_join(orders, "table41.tbl", {0}, {0}, 2).readNumEntries();
+    bool stopped;
+    {
+        QueryMemory memory(256 << 10);
+        QueryMemoryScope scope(&memory);
+        RelationalTable joined = users.inner_join(orders, "table42.tbl", {0}, {0}, 2);
+        stopped = memory.exceeded() && joined.readNumEntries() == 0;
+    }
+    uint32_t limited;
+    {
+        QueryMemory memory(64 << 20);
+        QueryMemoryScope scope(&memory);
+        limited = users.inner_join(orders, "table43.tbl", {0}, {0}, 2).readNumEntries();
+        failures += memory.exceeded();
+    }
+    std::cout << "join: " << (stopped ? "stopped" : "not stopped") << " at 256 KiB, " << limited << " rows at 64 MiB, " << unlimited << " without a limit" << std::endl;
+    failures += !stopped || limited != num_rows / 2 || unlimited != num_rows / 2;
+
+    std::cout << failures << " failures" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
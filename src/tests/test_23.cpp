@@ -0,0 +1,164 @@
+#include "../rt/rt.hpp"
+#include "../rt/helper.hpp"
+#include "../rt/schema.hpp"
+#include "../rt/table_writer.hpp"
+#include "../columnar-rt/columnar_rt.hpp"
+
+#include <sstream>
+
+namespace
+{
+    size_t fileSize(const std::string &file_name)
+    {
+        std::ifstream file(file_name, std::ios::binary | std::ios::ate);
+        return file.tellg();
+    }
+
+    std::string printed(const RelationalTable &table)
+    {
+        std::ostringstream out;
+        std::streambuf *previous = std::cout.rdbuf(out.rdbuf());
+        table.printTable();
+        std::cout.rdbuf(previous);
+        return out.str();
+    }
+}
+
+int main()
+{
+    uint32_t failures = 0;
+
+    // schemas parse from and print back to text, and bad ones are refused
+    TableSchema schema;
+    bool parsed = ParseSchema("id:u32,delta:i32,price:f32", schema);
+    TableSchema unnamed, wrong;
+    failures += !parsed || schema.numColumns() != 3 || schema.names[1] != "delta" || schema.types[2] != ColumnType::Float32;
+    failures += !ParseSchema("u32,f64", unnamed) || unnamed.names[0] != "" || unnamed.types[1] != ColumnType::Float64;
+    failures += ParseSchema("id:u16", wrong) || ParseSchema("", wrong) || ParseSchema("a:b:u32", wrong);
+    std::cout << "schema: " << schema.toString() << std::endl;
+    failures += schema.toString() != "id:u32,delta:i32,price:f32";
+
+    // cells parse as their type, and integers out of range don't
+    char *end;
+    uint32_t cell;
+    failures += !ParseCell("-7", &end, ColumnType::Int32, cell) || CellAs<int32_t>(cell) != -7;
+    failures += !ParseCell("4000000000", &end, ColumnType::Uint32, cell) || cell != 4000000000u;
+    failures += ParseCell("-1", &end, ColumnType::Uint32, cell) || ParseCell("3000000000", &end, ColumnType::Int32, cell);
+    failures += !ParseCell("2.5", &end, ColumnType::Float32, cell) || CellAs<float>(cell) != 2.5f;
+    failures += ParseCell("1", &end, ColumnType::Uint64, cell);
+    std::vector<uint32_t> cells;
+    failures += !parseCsvRow("3, -2, 0.25", schema, cells) || cells.size() != 3 || CellAs<int32_t>(cells[1]) != -2 || CellAs<float>(cells[2]) != 0.25f;
+    failures += parseCsvRow("id,delta,price", schema, cells);
+
+    removeFile("table44.tbl");
+    removeFile("table45.tbl");
+    removeFile("table46.tbl");
+    removeFile("table47.tbl");
+    removeFile("table48.tbl");
+    removeFile("table49.tbl");
+    removeFile("table50.tbl");
+    removeFile("table51.tbl");
+
+    // an untyped table keeps the old 8-byte header; a typed one puts its schema after it, rows still aligned
+    {
+        RelationalTable untyped("table44.tbl", 3);
+        RelationalTable typed("table45.tbl", schema);
+        size_t typed_header = fileSize("table45.tbl");
+        std::cout << "headers: " << fileSize("table44.tbl") << " bytes untyped, " << typed_header << " bytes typed" << std::endl;
+        failures += fileSize("table44.tbl") != 8 || typed_header % 4 != 0 || typed_header != 16 + 20;
+        failures += !untyped.schema().empty() || typed.readNumColumns() != 3;
+    }
+
+    // rows go after the schema and read back through every path
+    const uint32_t num_rows = 1000;
+    {
+        TableWriter writer("table45.tbl");
+        failures += writer.schema().toString() != schema.toString();
+        for (uint32_t id = 0; id < num_rows; id++)
+        {
+            int32_t delta = int32_t(id) - 500;
+            float price = id * 0.5f;
+            uint32_t row[3] = {id, uint32_t(delta), 0};
+            std::memcpy(&row[2], &price, sizeof(price));
+            writer.appendRow_uint32_t(row);
+        }
+    }
+    RelationalTable items("table45.tbl");
+    failures += items.readNumEntries() != num_rows || items.schema().toString() != schema.toString();
+    std::vector<uint32_t> row = items.getRow_uint32_t(10);
+    failures += row.size() != 3 || row[0] != 10 || CellAs<int32_t>(row[1]) != -490;
+    items.mapFile();
+    ColumnView<int32_t> deltas = items.viewColumn_int32_t(1);
+    ColumnView<float> prices = items.viewColumn_float(2);
+    std::cout << "typed table: delta " << deltas[3] << " and price " << prices[7] << " through the mapping" << std::endl;
+    failures += deltas.size() != num_rows || deltas[3] != -497 || prices[7] != 3.5f || items.viewRow_uint32_t(999)[0] != 999;
+
+    // each column prints as its type
+    items.addRow_uint32_t({4000000000u, uint32_t(-1), 0});
+    std::string text = printed(RelationalTable("table45.tbl"));
+    bool typed_output = text.find("Schema: id:u32,delta:i32,price:f32") != std::string::npos && text.find("\n12 -488 6 \n") != std::string::npos &&
+                        text.find("\n4000000000 -1 0 \n") != std::string::npos;
+    std::cout << "print: " << (typed_output ? "typed" : "untyped") << std::endl;
+    failures += !typed_output;
+
+    // scans and filters start at the rows, past the schema
+    Predicate negative;
+    ParsePredicate("0 < 100", CellType::Uint32, negative);
+    failures += RelationalTable("table45.tbl").filter({negative}).count() != 100;
+
+    // signed columns compare, sum and sort as int32_t
+    Predicate below_zero, out_of_range;
+    failures += !ParsePredicate("1 < 0", CellType::Int32, below_zero) || ParsePredicate("1 < 3000000000", CellType::Int32, out_of_range);
+    failures += RelationalTable("table45.tbl").filter({below_zero}).count() != 501;
+    std::vector<Aggregate> signed_aggregates(3);
+    ParseAggregate("min(1)", CellType::Int32, signed_aggregates[0]);
+    ParseAggregate("max(1)", CellType::Int32, signed_aggregates[1]);
+    ParseAggregate("sum(1)", CellType::Int32, signed_aggregates[2]);
+    std::ostringstream signed_output;
+    RelationalTable("table45.tbl").aggregate(signed_aggregates).print(signed_output);
+    std::cout << "signed aggregates: " << signed_output.str().substr(signed_output.str().find('\n') + 1);
+    failures += signed_output.str().find("\n-500 499 -501 \n") == std::string::npos;
+
+    // a join of typed tables is typed, with a join against an untyped table it isn't
+    {
+        TableSchema tag_schema;
+        ParseSchema("item:u32,tag:f32", tag_schema);
+        RelationalTable tags("table46.tbl", tag_schema);
+        TableWriter writer("table46.tbl");
+        for (uint32_t id = 0; id < num_rows; id += 10)
+        {
+            float tag = id;
+            uint32_t tag_row[2] = {id, 0};
+            std::memcpy(&tag_row[1], &tag, sizeof(tag));
+            writer.appendRow_uint32_t(tag_row);
+        }
+    }
+    RelationalTable joined = items.inner_join(RelationalTable("table46.tbl"), "table47.tbl", {0}, {0});
+    RelationalTable untyped_joined = items.inner_join(RelationalTable("table44.tbl"), "table48.tbl", {0}, {0});
+    std::cout << "join: " << joined.readNumEntries() << " rows, schema " << joined.schema().toString() << std::endl;
+    failures += joined.readNumEntries() != num_rows / 10 || joined.schema().toString() != "id:u32,delta:i32,price:f32,item:u32,tag:f32";
+    failures += !untyped_joined.schema().empty() || untyped_joined.readNumColumns() != 6;
+    std::vector<uint32_t> joined_row = joined.getRow_uint32_t(5);
+    failures += joined_row.size() != 5 || joined_row[0] != joined_row[3] || CellAs<int32_t>(joined_row[1]) != int32_t(joined_row[0]) - 500;
+
+    // compressing reads the rows past the schema and keeps it, so the table comes back typed
+    items.compressData("table49.tbl", {RepresentationKind::Direct, RepresentationKind::Direct, RepresentationKind::Direct});
+    failures += ColumnarRelationalTable("table49.tbl").schema().toString() != schema.toString() || ColumnarRelationalTable("table49.tbl").readNumEntries() != num_rows + 1;
+    RelationalTable restored = RelationalTable::decompressData("table49.tbl", "table50.tbl");
+    failures += restored.readNumEntries() != num_rows + 1 || restored.getRow_uint32_t(999) != items.getRow_uint32_t(999);
+    std::string restored_text = printed(restored);
+    std::ostringstream restored_output;
+    restored.aggregate(signed_aggregates).print(restored_output);
+    std::cout << "round trip: schema " << restored.schema().toString() << std::endl;
+    failures += restored.schema().toString() != schema.toString() || restored_text.find("\n12 -488 6 \n") == std::string::npos || restored_text.find("\n4000000000 -1 0 \n") == std::string::npos;
+    failures += restored_output.str() != signed_output.str() || restored.filter({below_zero}).count() != 501;
+
+    // 64-bit columns don't fit the 32-bit cells, so no table is made for them
+    TableSchema wide;
+    ParseSchema("id:u32,total:u64", wide);
+    RelationalTable too_wide("table51.tbl", wide);
+    failures += fileExists("table51.tbl");
+
+    std::cout << failures << " failures" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+#include "../rt/rt.hpp"
+#include "../rt/helper.hpp"
+#include "../rt/table_handle.hpp"
+#include "../rt/table_writer.hpp"
+#include "../rt/instrumentation.hpp"
+
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+    uint64_t fileOpens()
+    {
+        return g_instrumentation.events[size_t(Counter::FileOpens)];
+    }
+
+    // Append rows the way another process would, without this process's handles hearing of it
+    bool appendBehindTheBack(const std::string &file_name, const std::vector<uint32_t> &rows, uint32_t num_columns)
+    {
+        int fd = ::open(file_name.c_str(), O_RDWR);
+        uint32_t header[2];
+        bool done = fd >= 0 && pread(fd, header, sizeof(header), 0) == sizeof(header);
+        off_t offset = sizeof(header) + off_t(header[0]) * num_columns * sizeof(uint32_t);
+        uint32_t num_entries = header[0] + rows.size() / num_columns;
+        done = done && pwrite(fd, rows.data(), rows.size() * sizeof(uint32_t), offset) == ssize_t(rows.size() * sizeof(uint32_t));
+        done = done && pwrite(fd, &num_entries, sizeof(num_entries), 0) == sizeof(num_entries);
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        return done;
+    }
+}
+
+int main()
+{
+    uint32_t failures = 0;
+
+    removeFile("table52.tbl");
+    removeFile("table53.tbl");
+    {
+        RelationalTable create("table52.tbl", 2);
+        TableWriter writer("table52.tbl");
+        for (uint32_t id = 0; id < 100; id++)
+        {
+            uint32_t row[2] = {id, id * 2};
+            writer.appendRow_uint32_t(row);
+        }
+    }
+    failures += NumOpenTableHandles() != 0;
+
+    // opening a table again, by any path, shares the first one's descriptor and header
+    {
+        uint64_t opens = fileOpens();
+        RelationalTable first("table52.tbl");
+        uint64_t first_opens = fileOpens() - opens;
+        RelationalTable second("./table52.tbl");
+        RelationalTable copy = first;
+        uint64_t reuses = g_instrumentation.events[size_t(Counter::HandleReuses)];
+        std::cout << "handles: " << NumOpenTableHandles() << " open for 3 tables, " << first_opens << " file opens for the first and "
+                  << fileOpens() - opens - first_opens << " for the second" << std::endl;
+        failures += NumOpenTableHandles() != 1 || fileOpens() - opens != first_opens || reuses == 0;
+
+        // reads go through the open descriptor, and the counts come from the resident header
+        opens = fileOpens();
+        uint64_t sum = 0;
+        for (uint32_t id = 0; id < 100; id++)
+        {
+            sum += second.getRow_uint32_t(id)[1];
+        }
+        uint32_t num_entries = first.readNumEntries();
+        std::cout << "reads: 100 rows and the header with " << fileOpens() - opens << " file opens" << std::endl;
+        failures += sum != 9900 || num_entries != 100 || first.readNumColumns() != 2 || fileOpens() != opens;
+
+        // appends in this process reach every table of the file at once
+        first.addRow_uint32_t({100, 200});
+        {
+            TableWriter writer("table52.tbl");
+            uint32_t row[2] = {101, 202};
+            writer.appendRow_uint32_t(row);
+        }
+        failures += second.readNumEntries() != 102 || copy.readNumEntries() != 102 || second.getRow_uint32_t(101)[1] != 202;
+
+        // so do appends the handle isn't told of, e.g. from another process
+        bool appended = appendBehindTheBack("table52.tbl", {102, 204, 103, 206}, 2);
+        std::cout << "appends: " << second.readNumEntries() << " rows seen after two more from elsewhere" << std::endl;
+        failures += !appended || second.readNumEntries() != 104 || second.getRow_uint32_t(103)[1] != 206;
+
+        // a file made again under the same name is a new table; the old one's tables keep reading the old file
+        removeFile("table52.tbl");
+        RelationalTable remade("table52.tbl", 3);
+        failures += NumOpenTableHandles() != 2 || remade.readNumEntries() != 0 || remade.readNumColumns() != 3;
+        failures += first.readNumEntries() != 104 || first.getRow_uint32_t(50)[0] != 50;
+    }
+    failures += NumOpenTableHandles() != 0;
+
+    // threads opening the same table all end up with one handle
+    {
+        RelationalTable create("table53.tbl", 1);
+        create.addRow_uint32_t({7});
+    }
+    std::vector<std::shared_ptr<TableHandle>> handles(4);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < handles.size(); t++)
+    {
+        threads.emplace_back([&handles, t]
+                             { handles[t] = OpenTableHandle("table53.tbl"); });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    bool shared = handles[0] != nullptr;
+    for (const std::shared_ptr<TableHandle> &handle : handles)
+    {
+        shared = shared && handle == handles[0];
+    }
+    std::cout << "threads: " << (shared ? "one handle" : "several handles") << std::endl;
+    failures += !shared || handles[0]->numEntries() != 1 || OpenTableHandle("table54.tbl") != nullptr;
+
+    std::cout << failures << " failures" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+#include "../rt/rt.hpp"
+#include "../rt/helper.hpp"
+#include "../rt/table_writer.hpp"
+
+#include <atomic>
+#include <thread>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+    // Append rows {first, first * 3}, {first + 1, ...}, ... in batches, flushing after each
+    void appendBatches(const std::string &file_name, uint32_t first, uint32_t num_rows, uint32_t batch_rows)
+    {
+        TableWriter writer(file_name, batch_rows * 2 * sizeof(uint32_t));
+        for (uint32_t id = first; id < first + num_rows; id++)
+        {
+            uint32_t row[2] = {id, id * 3};
+            writer.appendRow_uint32_t(row);
+            if ((id - first) % batch_rows == batch_rows - 1)
+            {
+                writer.flush();
+            }
+        }
+    }
+}
+
+int main()
+{
+    uint32_t failures = 0;
+
+    removeFile("table55.tbl");
+    removeFile("table56.tbl");
+    removeFile("table57.tbl");
+
+    // readers scanning while a writer appends only ever see whole committed rows
+    const uint32_t num_rows = 200000;
+    {
+        RelationalTable create("table55.tbl", 2);
+    }
+    std::atomic<bool> writing(true);
+    std::atomic<uint32_t> torn(0), snapshots(0);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 2; r++)
+    {
+        readers.emplace_back([&]
+                             {
+            RelationalTable table("table55.tbl");
+            table.mapFile();
+            bool last = false;
+            while (!last)
+            {
+                last = !writing.load();
+                ColumnView<uint32_t> ids = table.viewColumn_uint32_t(0);
+                ColumnView<uint32_t> tripled = table.viewColumn_uint32_t(1);
+                uint32_t rows = std::min(ids.size(), tripled.size());
+                for (uint32_t i = 0; i < rows; i++)
+                {
+                    torn += ids[i] != i || tripled[i] != i * 3;
+                }
+                snapshots++;
+            } });
+    }
+    // and a view taken before the file grows still reads its rows after every remap
+    RelationalTable early("table55.tbl");
+    early.mapFile();
+    appendBatches("table55.tbl", 0, 1000, 1000);
+    ColumnView<uint32_t> early_ids = early.viewColumn_uint32_t(0);
+    appendBatches("table55.tbl", 1000, num_rows - 1000, 1000);
+    writing = false;
+    for (std::thread &reader : readers)
+    {
+        reader.join();
+    }
+    early.viewColumn_uint32_t(1);
+    uint32_t early_bad = 0;
+    for (uint32_t i = 0; i < early_ids.size(); i++)
+    {
+        early_bad += early_ids[i] != i;
+    }
+    std::cout << "readers: " << snapshots << " scans during appends, " << torn << " bad rows" << std::endl;
+    failures += torn != 0 || early_ids.size() != 1000 || early_bad != 0 || RelationalTable("table55.tbl").readNumEntries() != num_rows;
+
+    // writers in two processes commit one at a time, each batch after the other's rows
+    {
+        RelationalTable create("table56.tbl", 2);
+    }
+    const uint32_t per_writer = 20000;
+    pid_t child = fork();
+    if (child == 0)
+    {
+        appendBatches("table56.tbl", per_writer, per_writer, 100);
+        _exit(0);
+    }
+    appendBatches("table56.tbl", 0, per_writer, 100);
+    int status = 0;
+    waitpid(child, &status, 0);
+    RelationalTable both("table56.tbl");
+    std::vector<uint32_t> seen(2 * per_writer, 0);
+    uint32_t bad = 0;
+    for (uint32_t row = 0; row < both.readNumEntries(); row++)
+    {
+        std::vector<uint32_t> cells = both.getRow_uint32_t(row);
+        bool intact = cells.size() == 2 && cells[0] < seen.size() && cells[1] == cells[0] * 3;
+        bad += !intact;
+        if (intact)
+        {
+            seen[cells[0]]++;
+        }
+    }
+    uint32_t once = 0;
+    for (uint32_t count : seen)
+    {
+        once += count == 1;
+    }
+    std::cout << "two processes: " << both.readNumEntries() << " rows, " << once << " appended exactly once" << std::endl;
+    failures += !WIFEXITED(status) || both.readNumEntries() != 2 * per_writer || bad != 0 || once != 2 * per_writer;
+
+    // a writer's NULL marks on rows it hasn't committed move with them when another writer commits first
+    {
+        RelationalTable create("table57.tbl", 2);
+        TableWriter first("table57.tbl");
+        TableWriter second("table57.tbl");
+        uint32_t row[2] = {1, 2};
+        first.appendRow_uint32_t(row);
+        first.setNull(0, 1);
+        for (int i = 0; i < 3; i++)
+        {
+            second.appendRow_uint32_t(row);
+        }
+        second.setNull(1, 0);
+        second.flush();
+        first.flush();
+    }
+    RelationalTable nulls("table57.tbl");
+    bool moved = nulls.readNumEntries() == 4 && nulls.isNull(1, 0) && nulls.isNull(3, 1) && !nulls.isNull(0, 1);
+    std::cout << "NULL marks: " << (moved ? "moved with their rows" : "left behind") << std::endl;
+    failures += !moved;
+
+    std::cout << failures << " failures" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
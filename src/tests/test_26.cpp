@@ -0,0 +1,170 @@
+#include "../rt/rt.hpp"
+#include "../rt/helper.hpp"
+#include "../rt/table_log.hpp"
+#include "../rt/table_writer.hpp"
+#include "../rt/instrumentation.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+    uint64_t logSyncs()
+    {
+        return g_instrumentation.events[size_t(Counter::LogSyncs)];
+    }
+
+    // Log batches of rows {id, id * 7} for ids first, first + 1, ...
+    bool logBatches(TableLog &log, uint32_t first, uint32_t num_batches, uint32_t batch_rows)
+    {
+        std::vector<uint32_t> batch;
+        for (uint32_t b = 0; b < num_batches; b++)
+        {
+            batch.clear();
+            for (uint32_t id = first + b * batch_rows; id < first + (b + 1) * batch_rows; id++)
+            {
+                batch.push_back(id);
+                batch.push_back(id * 7);
+            }
+            if (!log.appendRows_uint32_t(batch.data(), batch_rows))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Whether the table holds rows {id, id * 7} for ids 0 .. num_rows - 1, each once, in any order
+    bool holdsEachOnce(const std::string &file_name, uint32_t num_rows)
+    {
+        RelationalTable table(file_name);
+        std::vector<uint32_t> seen(num_rows, 0);
+        for (uint32_t row = 0; row < table.readNumEntries(); row++)
+        {
+            std::vector<uint32_t> cells = table.getRow_uint32_t(row);
+            if (cells.size() != 2 || cells[0] >= num_rows || cells[1] != cells[0] * 7 || seen[cells[0]]++ > 0)
+            {
+                return false;
+            }
+        }
+        return table.readNumEntries() == num_rows;
+    }
+
+    std::string readFile(const std::string &file_name)
+    {
+        std::ifstream file(file_name, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    void writeFile(const std::string &file_name, const std::string &bytes)
+    {
+        std::ofstream file(file_name, std::ios::binary | std::ios::trunc);
+        file.write(bytes.data(), bytes.size());
+    }
+}
+
+int main()
+{
+    uint32_t failures = 0;
+
+    for (const char *name : {"table58.tbl", "table59.tbl", "table60.tbl", "table61.tbl"})
+    {
+        removeFile(name);
+        removeFile(TableLog::fileNameFor(name));
+    }
+
+    // threads appending at once share writes and syncs of the log, and every row reaches the table once
+    {
+        RelationalTable create("table58.tbl", 2);
+    }
+    const uint32_t num_threads = 4, num_batches = 200, batch_rows = 10;
+    uint64_t syncs = logSyncs();
+    {
+        TableLog log("table58.tbl");
+        std::vector<std::thread> threads;
+        std::vector<char> logged(num_threads, 0);
+        for (uint32_t t = 0; t < num_threads; t++)
+        {
+            threads.emplace_back([&log, &logged, t]
+                                 { logged[t] = logBatches(log, t * num_batches * batch_rows, num_batches, batch_rows); });
+        }
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+        failures += std::count(logged.begin(), logged.end(), 0) != 0 || !fileExists(TableLog::fileNameFor("table58.tbl"));
+        failures += !log.close();
+    }
+    syncs = logSyncs() - syncs;
+    std::cout << "group commit: " << num_threads * num_batches << " batches in " << syncs << " syncs" << std::endl;
+    failures += syncs > num_threads * num_batches || !holdsEachOnce("table58.tbl", num_threads * num_batches * batch_rows);
+    failures += fileExists(TableLog::fileNameFor("table58.tbl"));
+
+    // with a sync interval appends don't wait for the disk; the rows still reach readers and the disk
+    {
+        RelationalTable create("table59.tbl", 2);
+    }
+    {
+        syncs = logSyncs();
+        TableLog log("table59.tbl", 1000);
+        bool logged = logBatches(log, 0, 100, 10);
+        uint64_t unsynced = logSyncs() - syncs;
+        bool synced = log.sync() && logSyncs() > syncs;
+        bool applied = log.waitApplied();
+        std::cout << "interval: " << unsynced << " syncs for 100 batches, then " << logSyncs() - syncs << " after sync()" << std::endl;
+        failures += !logged || unsynced >= 100 || !synced || !applied || RelationalTable("table59.tbl").readNumEntries() != 1000;
+    }
+    failures += !holdsEachOnce("table59.tbl", 1000);
+
+    // a process killed while appending leaves its log; recovery brings the table up to date and ignores a torn tail
+    {
+        RelationalTable create("table60.tbl", 2);
+    }
+    pid_t child = fork();
+    if (child == 0)
+    {
+        TableLog log("table60.tbl");
+        logBatches(log, 0, 50, 100);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    std::string log_name = TableLog::fileNameFor("table60.tbl");
+    std::string crashed_log = readFile(log_name);
+    const uint32_t torn[] = {0x59544E45, 5000, 100, 0, 1, 2};
+    writeFile(log_name, crashed_log + std::string(reinterpret_cast<const char *>(torn), sizeof(torn)));
+    bool recovered = WIFEXITED(status) && !crashed_log.empty() && RecoverTableLog("table60.tbl");
+    std::cout << "recovery: " << RelationalTable("table60.tbl").readNumEntries() << " rows after a crash" << std::endl;
+    failures += !recovered || !holdsEachOnce("table60.tbl", 5000) || fileExists(log_name);
+
+    // replaying is idempotent: entries the table has are skipped, and one failing its checksum ends the log
+    {
+        uint32_t first_row;
+        std::memcpy(&first_row, crashed_log.data() + 16 + 4, sizeof(first_row));
+        int fd = ::open("table60.tbl", O_RDWR);
+        failures += fd < 0 || pwrite(fd, &first_row, sizeof(first_row), 0) != sizeof(first_row);
+        ::close(fd);
+        std::string corrupt = crashed_log;
+        corrupt[corrupt.size() - 1] ^= 1;
+        writeFile(log_name, corrupt);
+        recovered = RecoverTableLog("table60.tbl");
+        std::cout << "checksums: " << RelationalTable("table60.tbl").readNumEntries() << " rows from a log with a corrupt last entry" << std::endl;
+        failures += !recovered || RelationalTable("table60.tbl").readNumEntries() != 4900 || !holdsEachOnce("table60.tbl", 4900);
+    }
+
+    // a log of some other table is refused and kept
+    {
+        RelationalTable create("table61.tbl", 3);
+    }
+    writeFile(TableLog::fileNameFor("table61.tbl"), crashed_log);
+    failures += RecoverTableLog("table61.tbl") || !fileExists(TableLog::fileNameFor("table61.tbl"));
+    failures += TableLog("table61.tbl").isOpen();
+
+    std::cout << failures << " failures" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,178 @@
+#include "../rt/rt.hpp"
+#include "../rt/helper.hpp"
+#include "../rt/async_io.hpp"
+#include "../rt/table_writer.hpp"
+#include "../columnar-rt/row_group_pipeline.hpp"
+
+#include <random>
+#include <sstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+    const char *backendName(AsyncReader::Backend backend)
+    {
+        return backend == AsyncReader::Backend::Uring ? "io_uring" : "threads";
+    }
+
+    // Read the file's cells in blocks of block_cells, out of order and several at a time; the number of blocks that came back wrong
+    uint32_t readBlocks(const std::string &file_name, AsyncReader::Backend backend, uint32_t num_cells, uint32_t block_cells, AsyncReader::Backend &used)
+    {
+        int fd = ::open(file_name.c_str(), O_RDONLY);
+        AsyncReader reader(fd, 4, backend);
+        used = reader.backend();
+        uint32_t num_blocks = num_cells / block_cells;
+        std::vector<std::vector<uint32_t>> blocks(num_blocks, std::vector<uint32_t>(block_cells));
+        uint32_t wrong = 0, submitted = 0, completed = 0;
+        uint32_t cell; // extra reads land here
+        while (completed < num_blocks)
+        {
+            // blocks in reverse order, as many as the queue takes
+            while (submitted < num_blocks && reader.inFlight() < reader.queueDepth())
+            {
+                uint32_t block = num_blocks - 1 - submitted++;
+                wrong += !reader.submit(blocks[block].data(), block_cells * sizeof(uint32_t), off_t(block) * block_cells * sizeof(uint32_t), block);
+            }
+            // a full queue refuses more
+            bool full = reader.inFlight() == reader.queueDepth();
+            wrong += reader.submit(&cell, sizeof(cell), 0, num_blocks) == full;
+            uint64_t tag;
+            bool read_all;
+            if (!reader.complete(tag, read_all))
+            {
+                return wrong + 1;
+            }
+            completed += tag < num_blocks;
+            if (tag >= num_blocks)
+            {
+                continue;
+            }
+            for (uint32_t i = 0; i < block_cells && read_all; i++)
+            {
+                read_all = blocks[tag][i] == tag * block_cells + i;
+            }
+            wrong += !read_all;
+        }
+        uint64_t tag;
+        bool read_all;
+        while (reader.complete(tag, read_all))
+        {
+        }
+
+        // past the end of the file a read comes back short
+        uint32_t past_end[4];
+        reader.submit(past_end, sizeof(past_end), off_t(num_cells - 2) * sizeof(uint32_t), 99);
+        wrong += !reader.complete(tag, read_all) || tag != 99 || read_all || reader.complete(tag, read_all);
+        ::close(fd);
+        return wrong;
+    }
+}
+
+int main()
+{
+    uint32_t failures = 0;
+
+    // a file of the numbers 0, 1, 2, ... read back through either backend
+    removeFile("table62.tbl");
+    const uint32_t num_cells = 1 << 20;
+    {
+        std::vector<uint32_t> cells(num_cells);
+        for (uint32_t i = 0; i < num_cells; i++)
+        {
+            cells[i] = i;
+        }
+        std::ofstream file("table62.tbl", std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(cells.data()), cells.size() * sizeof(uint32_t));
+    }
+    for (AsyncReader::Backend backend : {AsyncReader::Backend::Uring, AsyncReader::Backend::Threads})
+    {
+        AsyncReader::Backend used;
+        uint32_t wrong = readBlocks("table62.tbl", backend, num_cells, 4096, used);
+        std::cout << backendName(backend) << ": reads through " << backendName(used) << ", " << wrong << " wrong" << std::endl;
+        failures += wrong != 0 || (backend == AsyncReader::Backend::Threads && used != backend);
+    }
+
+    // row groups prefetched through either backend have the chunks read one at a time, whichever columns are asked for
+    removeFile("table63.tbl");
+    removeFile("table64.tbl");
+    removeFile("table65.tbl");
+    const uint32_t num_rows = 20000;
+    std::mt19937 random(5);
+    {
+        RelationalTable create("table63.tbl", 5);
+        TableWriter writer("table63.tbl");
+        for (uint32_t id = 0; id < num_rows; id++)
+        {
+            uint32_t row[5] = {id, id % 7, uint32_t(random()), id / 100, uint32_t(random() % 1000)};
+            writer.appendRow_uint32_t(row);
+        }
+    }
+    RelationalTable("table63.tbl").compressData("table64.tbl", std::vector<RepresentationKind>(5, RepresentationKind::Adaptive), 1000);
+    ColumnarRelationalTable compressed("table64.tbl");
+    std::vector<const RowGroupInfo *> groups;
+    for (uint32_t g = 0; g < compressed.numRowGroups(); g += 1 + g % 2)
+    {
+        groups.push_back(&compressed.rowGroup(g));
+    }
+    std::ifstream file("table64.tbl", std::ios::binary);
+    for (AsyncReader::Backend backend : {AsyncReader::Backend::Uring, AsyncReader::Backend::Threads})
+    {
+        for (const std::vector<uint32_t> &columns : std::vector<std::vector<uint32_t>>{{4, 0, 1}, {3}, {0, 1, 2, 3, 4}})
+        {
+            RowGroupPrefetcher prefetcher("table64.tbl", groups, columns, 3, backend);
+            const RowGroupInfo *info;
+            uint32_t handed_out = 0, wrong = 0;
+            std::vector<uint8_t> chunk;
+            while (prefetcher.next(info))
+            {
+                wrong += info != groups[handed_out++];
+                for (uint32_t column : columns)
+                {
+                    ReadColumnChunk(file, *info, column, chunk);
+                    wrong += chunk.size() != prefetcher.chunkSize(column) || !std::equal(chunk.begin(), chunk.end(), prefetcher.chunk(column));
+                }
+            }
+            failures += handed_out != groups.size() || wrong != 0;
+        }
+    }
+    std::cout << "prefetch: " << groups.size() << " of " << compressed.numRowGroups() << " groups" << std::endl;
+
+    // scans read through the prefetcher and compressing through the reader give what they did before
+    ColumnarRelationalTable scanned("table64.tbl");
+    uint64_t sum = 0, expected = 0;
+    uint32_t rows_seen = 0;
+    Predicate equals3;
+    ParsePredicate("1 = 3", CellType::Uint32, equals3);
+    scanned.scanBatches({0, 3}, {equals3}, [&](uint32_t, const ColumnBatch &columns)
+                        { columns.forEachSelected([&](uint32_t i)
+                                                  {
+                                                      sum += columns.column(0)[i] + columns.column(1)[i];
+                                                      rows_seen++;
+                                                  }); });
+    for (uint32_t id = 3; id < num_rows; id += 7)
+    {
+        expected += id + id / 100;
+    }
+    std::cout << "scan: " << rows_seen << " rows with column 1 = 3" << std::endl;
+    failures += rows_seen != (num_rows - 3 + 6) / 7 || sum != expected;
+    // and so do filters and aggregates, which read ahead the same way
+    SelectionBitmap selected = scanned.filter({equals3});
+    Aggregate total;
+    ParseAggregate("sum(3)", CellType::Uint32, total);
+    std::ostringstream printed;
+    scanned.aggregate({total}, 1, CellType::Uint32).print(printed);
+    uint64_t sum3 = 0;
+    for (uint32_t id = 3; id < num_rows; id += 7)
+    {
+        sum3 += id / 100;
+    }
+    failures += selected.count() != rows_seen || !selected.test(3) || selected.test(4);
+    failures += printed.str().find("\n3 " + std::to_string(sum3) + " ") == std::string::npos;
+    RelationalTable restored = RelationalTable::decompressData("table64.tbl", "table65.tbl");
+    failures += restored.readNumEntries() != num_rows || restored.getRow_uint32_t(12345) != RelationalTable("table63.tbl").getRow_uint32_t(12345);
+
+    std::cout << failures << " failures" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+#include "../rt/rt.hpp"
+#include "../rt/helper.hpp"
+#include "../rt/table_writer.hpp"
+#include "../rt/instrumentation.hpp"
+#include "../coding/block_codec.hpp"
+#include "../columnar-rt/columnar_rt.hpp"
+
+#include <filesystem>
+#include <random>
+#include <sstream>
+
+namespace
+{
+    // Whether LZ at the level gives the bytes back, and how big it made them
+    bool roundTrips(const std::vector<uint8_t> &bytes, uint32_t level, size_t &compressed_size)
+    {
+        std::vector<uint8_t> compressed;
+        LzCompress(bytes.data(), bytes.size(), level, compressed);
+        compressed_size = compressed.size();
+        std::vector<uint8_t> restored(bytes.size());
+        LzDecompress(compressed.data(), compressed.size(), restored.data(), restored.size());
+        return restored == bytes;
+    }
+
+    bool throwsOn(const std::vector<uint8_t> &block, size_t out_size)
+    {
+        std::vector<uint8_t> out(out_size);
+        try
+        {
+            LzDecompress(block.data(), block.size(), out.data(), out.size());
+        }
+        catch (const char *)
+        {
+            return true;
+        }
+        return false;
+    }
+
+    std::string printed(const Aggregation &aggregation)
+    {
+        std::ostringstream out;
+        aggregation.print(out);
+        return out.str();
+    }
+
+    uint64_t blockDecompressions()
+    {
+        return g_instrumentation.events[size_t(Counter::BlockDecompressions)];
+    }
+}
+
+int main()
+{
+    uint32_t failures = 0;
+
+    // the codec gives back whatever it is given, at the fastest and the most thorough level
+    std::mt19937 random(11);
+    std::vector<std::vector<uint8_t>> inputs(5);
+    inputs[1] = {7};
+    inputs[2].assign(100000, 'a');
+    for (uint32_t i = 0; i < 100000; i++)
+    {
+        inputs[3].push_back(uint8_t(random()));
+        inputs[4].push_back(uint8_t("columnar row groups "[i % 20] ^ (i % 997 == 0)));
+    }
+    for (uint32_t level : {1u, MAX_BLOCK_LEVEL})
+    {
+        std::cout << "level " << level << ":";
+        for (const std::vector<uint8_t> &input : inputs)
+        {
+            size_t compressed_size;
+            failures += !roundTrips(input, level, compressed_size);
+            std::cout << " " << input.size() << " -> " << compressed_size;
+        }
+        std::cout << std::endl;
+    }
+
+    // malformed blocks are refused, not read past
+    failures += !throwsOn({}, 0) || !throwsOn({0x10}, 1) || !throwsOn({0x00, 1, 0}, 4) || !throwsOn({0x10, 'x', 2, 0}, 5) || !throwsOn({0x10, 'x'}, 2);
+
+    BlockCompression lz, lz_fast, lz_best, none, bad;
+    failures += !ParseBlockCompression("lz", lz) || !ParseBlockCompression("lz:1", lz_fast) || !ParseBlockCompression("lz:9", lz_best) || !ParseBlockCompression("none", none);
+    failures += ParseBlockCompression("lz:0", bad) || ParseBlockCompression("lz:10", bad) || ParseBlockCompression("zstd", bad) || lz.level != DEFAULT_BLOCK_LEVEL;
+
+    // chunks that don't shrink enough stay as they are
+    {
+        RepresentationKind kind = RepresentationKind::Direct;
+        std::vector<uint8_t> chunk = inputs[3];
+        failures += CompressChunk(lz, kind, chunk) || kind != RepresentationKind::Direct || chunk != inputs[3];
+        chunk = inputs[4];
+        failures += !CompressChunk(lz, kind, chunk) || !IsBlockCompressed(kind) || BaseRepresentation(kind) != RepresentationKind::Direct;
+        failures += UncompressedChunkSize(chunk.data(), chunk.size()) != inputs[4].size();
+    }
+
+    // sales(id, item, price, quantity): item and price are Direct whatever the representation, but repeat
+    removeFile("table66.tbl");
+    removeFile("table67.tbl");
+    removeFile("table68.tbl");
+    removeFile("table69.tbl");
+    const uint32_t num_rows = 50000;
+    {
+        RelationalTable create("table66.tbl", 4);
+        TableWriter writer("table66.tbl");
+        for (uint32_t id = 0; id < num_rows; id++)
+        {
+            uint32_t item = (id * 7919) % 300 * 2654435761u;
+            uint32_t row[4] = {id, item, 100 + item % 99991, uint32_t(random() % 5)};
+            writer.appendRow_uint32_t(row);
+        }
+    }
+    RelationalTable sales("table66.tbl");
+    std::vector<RepresentationKind> adaptive(4, RepresentationKind::Adaptive);
+    failures += !sales.compressData("table67.tbl", adaptive, 1024, 0, 2);
+    failures += !sales.compressData("table68.tbl", adaptive, 1024, 0, 2, {none, lz, lz_best, lz});
+    size_t plain_bytes = std::filesystem::file_size("table67.tbl"), block_bytes = std::filesystem::file_size("table68.tbl");
+    std::cout << "file: " << plain_bytes << " bytes encoded, " << block_bytes << " with block compression" << std::endl;
+    failures += block_bytes * 2 > plain_bytes;
+
+    // every read of the block-compressed file gives what the other one does
+    ColumnarRelationalTable plain("table67.tbl"), block("table68.tbl");
+    uint32_t compressed_chunks = 0;
+    for (uint32_t g = 0; g < block.numRowGroups(); g++)
+    {
+        const RowGroupInfo &info = block.rowGroup(g);
+        compressed_chunks += IsBlockCompressed(info.representations[1]) + IsBlockCompressed(info.representations[2]);
+        failures += IsBlockCompressed(info.representations[0]);
+    }
+    std::cout << "chunks: " << compressed_chunks << " of " << 2 * block.numRowGroups() << " item and price chunks block-compressed" << std::endl;
+    failures += compressed_chunks != 2 * block.numRowGroups();
+
+    uint64_t decompressions = blockDecompressions();
+    failures += block.readColumns_uint32({0, 1, 2, 3}) != plain.readColumns_uint32({0, 1, 2, 3});
+    failures += block.getRow_uint32_t(31337) != plain.getRow_uint32_t(31337);
+    Predicate cheap;
+    ParsePredicate("2 < 50000", CellType::Uint32, cheap);
+    SelectionBitmap block_rows = block.filter({cheap}), plain_rows = plain.filter({cheap});
+    failures += block_rows.count() == 0 || block_rows.count() != plain_rows.count();
+    Aggregate total, count;
+    ParseAggregate("sum(2)", CellType::Uint32, total);
+    ParseAggregate("count(1)", CellType::Uint32, count);
+    failures += printed(block.aggregate({total, count})) != printed(plain.aggregate({total, count}));
+    failures += printed(block.aggregate({total}, 3, CellType::Uint32)) != printed(plain.aggregate({total}, 3, CellType::Uint32));
+    decompressions = blockDecompressions() - decompressions;
+    std::cout << "reads: " << decompressions << " chunks uncompressed" << std::endl;
+    failures += decompressions == 0;
+
+    std::ostringstream stats;
+    block.printStats(stats);
+    failures += stats.str().find("Direct+Block") == std::string::npos;
+
+    RelationalTable restored = RelationalTable::decompressData("table68.tbl", "table69.tbl", 2);
+    failures += restored.readNumEntries() != num_rows || restored.getRow_uint32_t(4242) != sales.getRow_uint32_t(4242);
+
+    // rows appended to a columnar table are compressed as set, per table or per column
+    removeFile("table70.tbl");
+    {
+        ColumnarRelationalTable appended("table70.tbl", 4);
+        appended.setBlockCompression(lz_fast);
+        for (uint32_t row = 0; row < 3000; row++)
+        {
+            appended.addRow_uint32_t(sales.getRow_uint32_t(row));
+        }
+        appended.flush();
+        appended.setBlockCompression({none, none, none, none});
+        for (uint32_t row = 3000; row < 5000; row++)
+        {
+            appended.addRow_uint32_t(sales.getRow_uint32_t(row));
+        }
+    }
+    ColumnarRelationalTable appended("table70.tbl");
+    const RowGroupInfo &first = appended.rowGroup(0), &last = appended.rowGroup(appended.numRowGroups() - 1);
+    failures += !IsBlockCompressed(first.representations[1]) || IsBlockCompressed(last.representations[1]);
+    failures += appended.readNumEntries() != 5000 || appended.getRow_uint32_t(4999) != sales.getRow_uint32_t(4999) || appended.getRow_uint32_t(10) != sales.getRow_uint32_t(10);
+
+    std::cout << failures << " failures" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -44,10 +44,10 @@ int main()
 
     std::cout << std::endl;
 
-    // Make table 7 via full outer join
+    // Make table 7 via cross join
     removeFile("table7.tbl");
     
-    RelationalTable c = a.full_outer_join(b, "table7.tbl");
+    RelationalTable c = a.cross_join(b, "table7.tbl");
 
     c.printTable();
 
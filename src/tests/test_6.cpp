@@ -48,7 +48,7 @@ int main()
     removeFile("table10.tbl");
     
     std::vector<uint32_t> col1 = {0, 1, 2};
-    std::vector<uint32_t> col2 = {2, 1, 0};
+    std::vector<uint32_t> col2 = {0, 1, 2};
     RelationalTable c = a.inner_join(b, "table10.tbl", col1, col2);
 
     c.printTable();
@@ -0,0 +1,69 @@
+#include "../rt/rt.hpp"
+#include "../rt/helper.hpp"
+#include "../coding/coding.hpp"
+
+int main()
+{
+    // Round trip every representation on a column it can hold
+    std::vector<uint32_t> values;
+    for (uint32_t i = 0; i < 3000; i++)
+    {
+        values.push_back(1000 + i / 300);
+    }
+
+    RepresentationKind kinds[] = {Direct, RunLengthEncoded, DictionaryOneByte, OneSByteDeltaEncoded, BitPacked};
+    for (RepresentationKind kind : kinds)
+    {
+        std::vector<uint8_t> bytes;
+        std::vector<uint32_t> decoded;
+        bool encoded = EncodeColumn_uint32(values.data(), values.size(), kind, bytes);
+        DecodeColumn_uint32(kind, bytes.data(), bytes.size(), decoded);
+        std::cout << RepresentationKindName(kind) << " " << encoded << " " << bytes.size() << " " << (decoded == values) << std::endl;
+    }
+
+    std::vector<uint32_t> constant(100, 7);
+    std::vector<uint8_t> constant_bytes;
+    std::vector<uint32_t> constant_decoded;
+    std::cout << "Constant " << EncodeColumn_uint32(constant.data(), constant.size(), Constant, constant_bytes) << " ";
+    DecodeColumn_uint32(Constant, constant_bytes.data(), constant_bytes.size(), constant_decoded);
+    std::cout << constant_bytes.size() << " " << (constant_decoded == constant) << std::endl;
+    std::cout << "Constant on varying values " << EncodeColumn_uint32(values.data(), values.size(), Constant, constant_bytes) << std::endl;
+
+    // coding.py buffer formats
+    std::vector<uint8_t> buffer;
+    for (uint32_t i = 0; i < 4096; i++)
+    {
+        buffer.push_back(i % 4 == 1 ? 1 : 0);
+    }
+    for (char method : {'R', 'B'})
+    {
+        std::vector<uint8_t> encoded, decoded;
+        EncodeBuffer(buffer, method, encoded);
+        DecodeBuffer(encoded.data(), encoded.size(), decoded);
+        std::cout << method << " " << encoded.size() << " " << (decoded == buffer) << std::endl;
+    }
+
+    // Compress a table into row groups and decompress it again
+    removeFile("table11.tbl");
+    removeFile("table11_compressed.tbl");
+    removeFile("table12.tbl");
+
+    RelationalTable a("table11.tbl", 3);
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        a.addRow_uint32_t({i, i % 2, 5});
+    }
+    a.compressData("table11_compressed.tbl", {OneSByteDeltaEncoded, DictionaryOneByte, RunLengthEncoded}, 4);
+
+    RelationalTable b = RelationalTable::decompressData("table11_compressed.tbl", "table12.tbl");
+    for (uint32_t i = 0; i < b.readNumEntries(); i++)
+    {
+        for (uint32_t item : b.getRow_uint32_t(i))
+        {
+            std::cout << item << " ";
+        }
+        std::cout << std::endl;
+    }
+
+    return 0;
+}
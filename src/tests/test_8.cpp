@@ -0,0 +1,70 @@
+#include "../coding/coding.hpp"
+#include "../coding/kernels.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+int main()
+{
+    // Every kernel set must decode exactly like the scalar one
+    std::mt19937 rng(7);
+    std::vector<const DecodeKernels *> kernels = AvailableDecodeKernels();
+    std::cout << "Active kernels: " << ActiveDecodeKernels().name << std::endl;
+
+    int failures = 0;
+    for (uint32_t bits = 1; bits <= 32; bits++)
+    {
+        for (size_t count : {1, 7, 31, 100, 1023, 1024, 2500})
+        {
+            std::vector<uint32_t> values(count);
+            for (uint32_t &v : values)
+            {
+                v = bits == 32 ? uint32_t(rng()) : uint32_t(rng()) & ((1u << bits) - 1);
+            }
+
+            std::vector<uint8_t> bytes;
+            EncodeColumn_uint32(values.data(), values.size(), BitPacked, bytes);
+
+            std::vector<int8_t> deltas(count);
+            for (int8_t &d : deltas)
+            {
+                d = int8_t(rng());
+            }
+            std::vector<uint32_t> expected(count + 1);
+            kernels[0]->decode_deltas(123456, deltas.data(), count, expected.data());
+
+            for (const DecodeKernels *k : kernels)
+            {
+                // unpack the first chunk directly
+                size_t chunk = std::min<size_t>(count, BIT_PACKING_CHUNK_SIZE);
+                std::vector<uint32_t> unpacked(chunk);
+                k->unpack_bits(bytes.data() + 13, bytes[8], chunk, unpacked.data());
+                if (!std::equal(unpacked.begin(), unpacked.end(), values.begin()))
+                {
+                    std::cout << k->name << " unpack mismatch at " << bits << " bits, " << count << " values" << std::endl;
+                    failures++;
+                }
+
+                std::vector<uint32_t> summed(count + 1);
+                k->decode_deltas(123456, deltas.data(), count, summed.data());
+                if (summed != expected)
+                {
+                    std::cout << k->name << " delta mismatch for " << count << " values" << std::endl;
+                    failures++;
+                }
+            }
+
+            std::vector<uint32_t> decoded;
+            DecodeColumn_uint32(BitPacked, bytes.data(), bytes.size(), decoded);
+            if (decoded != values)
+            {
+                std::cout << "column mismatch at " << bits << " bits, " << count << " values" << std::endl;
+                failures++;
+            }
+        }
+    }
+
+    std::cout << "Kernel mismatches: " << failures << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,44 @@
+#include "../rt/rt.hpp"
+#include "../rt/helper.hpp"
+
+int main()
+{
+    removeFile("table13.tbl");
+
+    RelationalTable a("table13.tbl", 3);
+    a.addRow_uint32_t({1, 2, 3});
+    a.addRow_uint32_t({4, 5, 6});
+
+    // Rows and columns straight out of the mapping
+    a.mapFile();
+    for (uint32_t i = 0; i < a.readNumEntries(); i++)
+    {
+        for (uint32_t item : a.viewRow_uint32_t(i))
+        {
+            std::cout << item << " ";
+        }
+        std::cout << std::endl;
+    }
+
+    // Rows appended after mapping show up once the mapping is refreshed
+    a.addRow_uint32_t({7, 8, 9});
+    ColumnView<uint32_t> column = a.viewColumn_uint32_t(1);
+    for (uint32_t i = 0; i < column.size(); i++)
+    {
+        std::cout << column[i] << " ";
+    }
+    std::cout << std::endl;
+
+    for (uint32_t item : a.getRow_uint32_t(2))
+    {
+        std::cout << item << " ";
+    }
+    std::cout << std::endl;
+
+    // Rows past the committed ones aren't read
+    size_t past_end = RelationalTable("table13.tbl").getRow_uint32_t(a.readNumEntries()).size();
+    std::cout << "past the end: " << past_end << " cells" << std::endl;
+
+    a.printTable();
+    return 0;
+}